@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program measures the cost of Adaptive Data Rate (ADR) decisions at the
+ * network server. Each of nDevices devices sends nRounds uplinks with the ADR
+ * bit set, each forwarded by a random number of gateways, and the network
+ * server handles each of them as it would before replying:
+ * - the NetworkStatus merges the gateway copies of the uplink;
+ * - the AdrComponent is informed of each copy, and then decides whether to
+ *   send a LinkAdrReq to the device.
+ * The decision is compared with the cost of walking the last historyRange
+ * entries of the packet history of the device to compute their average SNR,
+ * as the AdrComponent used to do for each decision.
+ */
+
+#include "ns3/adr-component.h"
+#include "ns3/class-a-end-device-lorawan-mac.h"
+#include "ns3/command-line.h"
+#include "ns3/config.h"
+#include "ns3/integer.h"
+#include "ns3/log.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lora-tag.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/network-status.h"
+#include "ns3/parsed-uplink.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("AdrBenchmark");
+
+/**
+ * The wall-clock time taken by each way of handling the uplinks, in seconds.
+ */
+struct Timings
+{
+    double status = 0; //!< Merging of the gateway copies in the NetworkStatus
+    double walk = 0;   //!< Walks of the packet history
+    double adr = 0;    //!< Handling of the uplinks by the AdrComponent
+    double sink = 0;   //!< Sum of the results of the walks, so that they aren't optimized away
+};
+
+/**
+ * Compute the average SNR of the last packets of a device by walking its
+ * packet history, as the AdrComponent used to do.
+ *
+ * \param packetList The packet history of the device.
+ * \param historyRange The number of packets to consider.
+ * \return The average SNR [dB].
+ */
+double
+WalkHistory(const EndDeviceStatus::ReceivedPacketList& packetList, int historyRange)
+{
+    double sum = 0;
+    for (int i = 0; i < historyRange; i++)
+    {
+        const EndDeviceStatus::GatewayList& gwList = packetList.GetRecent(i).gwList;
+        double rxPower = 0;
+        for (std::size_t gw = 0; gw < gwList.GetSize(); gw++)
+        {
+            rxPower += gwList.Get(gw).rxPower;
+        }
+        rxPower /= gwList.GetSize();
+        sum += rxPower + 174 - 10 * log10(125000) - 6;
+    }
+    return sum / historyRange;
+}
+
+/**
+ * Handle one uplink of each device.
+ *
+ * \param status The NetworkStatus of the network server.
+ * \param adr The AdrComponent of the network server.
+ * \param gwAddresses The addresses of the gateways.
+ * \param round The index of the round, used as frame counter.
+ * \param historyRange The HistoryRange of the AdrComponent.
+ * \param timings The timings, updated by this function.
+ */
+void
+ProcessRound(Ptr<NetworkStatus> status,
+             Ptr<AdrComponent> adr,
+             const std::vector<Address>* gwAddresses,
+             uint32_t round,
+             int historyRange,
+             Timings* timings)
+{
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(round + 1);
+
+    // Build the uplinks of this round
+    uint32_t nDevices = status->CountEndDevices();
+    std::vector<Ptr<const ParsedUplink>> uplinks;
+    std::vector<uint32_t> nGateways;
+    std::vector<Ptr<EndDeviceStatus>> edStatuses;
+    uplinks.reserve(nDevices);
+    for (uint32_t address = 0; address < nDevices; address++)
+    {
+        Ptr<Packet> packet = Create<Packet>(20);
+        LoraFrameHeader frameHdr;
+        frameHdr.SetAsUplink();
+        frameHdr.SetAddress(LoraDeviceAddress(address));
+        frameHdr.SetFCnt(round);
+        frameHdr.SetAdr(true);
+        packet->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        packet->AddHeader(macHdr);
+        LoraTag tag(7);
+        tag.SetFrequency(868.1);
+        tag.SetReceivePower(uniform->GetValue(-130, -90));
+        packet->AddPacketTag(tag);
+
+        uplinks.push_back(Create<ParsedUplink>(packet));
+        nGateways.push_back(uniform->GetInteger(1, gwAddresses->size()));
+        edStatuses.push_back(status->GetEndDeviceStatus(LoraDeviceAddress(address)));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nDevices; i++)
+    {
+        for (uint32_t gw = 0; gw < nGateways[i]; gw++)
+        {
+            status->OnReceivedPacket(uplinks[i], (*gwAddresses)[gw], gw);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    timings->status += std::chrono::duration<double>(end - begin).count();
+
+    if (round + 1 >= uint32_t(historyRange))
+    {
+        begin = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < nDevices; i++)
+        {
+            timings->sink += WalkHistory(edStatuses[i]->GetReceivedPacketList(), historyRange);
+        }
+        end = std::chrono::steady_clock::now();
+        timings->walk += std::chrono::duration<double>(end - begin).count();
+    }
+
+    begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nDevices; i++)
+    {
+        for (uint32_t gw = 0; gw < nGateways[i]; gw++)
+        {
+            adr->OnReceivedPacket(uplinks[i], edStatuses[i], status);
+        }
+        adr->BeforeSendingReply(edStatuses[i], status);
+    }
+    end = std::chrono::steady_clock::now();
+    timings->adr += std::chrono::duration<double>(end - begin).count();
+
+    for (uint32_t i = 0; i < nDevices; i++)
+    {
+        edStatuses[i]->InitializeReply();
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t nDevices = 100000;
+    uint32_t nRounds = 25;
+    uint32_t nGateways = 4;
+    int historyRange = 20;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nDevices", "Number of devices", nDevices);
+    cmd.AddValue("nRounds", "Number of uplinks sent by each device", nRounds);
+    cmd.AddValue("nGateways", "Maximum number of gateways forwarding each uplink", nGateways);
+    cmd.AddValue("historyRange", "HistoryRange of the AdrComponent", historyRange);
+    cmd.Parse(argc, argv);
+
+    Config::SetDefault("ns3::EndDeviceStatus::HistoryDepth", UintegerValue(historyRange));
+
+    // A single MAC layer is shared by all devices, since only their
+    // addresses matter here
+    Ptr<ClassAEndDeviceLorawanMac> edMac = CreateObject<ClassAEndDeviceLorawanMac>();
+
+    Ptr<NetworkStatus> status = CreateObject<NetworkStatus>();
+    for (uint32_t address = 0; address < nDevices; address++)
+    {
+        edMac->SetDeviceAddress(LoraDeviceAddress(address));
+        status->AddNode(edMac);
+    }
+
+    std::vector<Address> gwAddresses;
+    for (uint32_t gw = 0; gw < nGateways; gw++)
+    {
+        gwAddresses.push_back(Mac48Address::Allocate());
+        status->AddGateway(gwAddresses.back(),
+                           Create<GatewayStatus>(gwAddresses.back(), nullptr, nullptr));
+    }
+
+    Ptr<AdrComponent> adr = CreateObject<AdrComponent>();
+    adr->SetAttribute("HistoryRange", IntegerValue(historyRange));
+
+    // Rounds are spaced by more than the DeduplicationWindow, so that all the
+    // copies of an uplink are merged but the next uplink is a new one
+    Timings timings;
+    for (uint32_t round = 0; round < nRounds; round++)
+    {
+        Simulator::Schedule(Seconds(2 * round),
+                            &ProcessRound,
+                            status,
+                            adr,
+                            &gwAddresses,
+                            round,
+                            historyRange,
+                            &timings);
+    }
+    Simulator::Run();
+    Simulator::Destroy();
+
+    uint32_t nDecisions =
+        nRounds >= uint32_t(historyRange) ? nDevices * (nRounds - historyRange + 1) : 0;
+    uint32_t nUplinks = nDevices * nRounds;
+    std::cout << "Devices: " << nDevices << ", HistoryRange: " << historyRange << std::endl;
+    std::cout << "NetworkStatus: " << timings.status / nUplinks * 1e9 << " ns/uplink" << std::endl;
+    std::cout << "AdrComponent: " << timings.adr / nUplinks * 1e9 << " ns/uplink" << std::endl;
+    if (nDecisions > 0)
+    {
+        std::cout << "History walk: " << timings.walk / nDecisions * 1e9 << " ns/decision"
+                  << " (average SNR " << timings.sink / nDecisions << " dB)" << std::endl;
+    }
+
+    return 0;
+}
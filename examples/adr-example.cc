@@ -98,6 +98,7 @@ main(int argc, char* argv[])
     cmd.AddValue("MType", "ns3::EndDeviceLorawanMac::MType");
     cmd.AddValue("EDDRAdaptation", "ns3::EndDeviceLorawanMac::EnableEDDataRateAdaptation");
     cmd.AddValue("ChangeTransmissionPower", "ns3::AdrComponent::ChangeTransmissionPower");
+    cmd.AddValue("AdrPeriod", "ns3::AdrComponent::Period");
     cmd.AddValue("AdrEnabled", "Whether to enable Adaptive Data Rate (ADR)", adrEnabled);
     cmd.AddValue("nDevices", "Number of devices to simulate", nDevices);
     cmd.AddValue("PeriodsToSimulate", "Number of periods (20m) to simulate", nPeriodsOf20Minutes);
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+/*
+ * Replacements of the global operator new and operator delete that count the
+ * allocations of a program, for the benchmarks of the module. Since it
+ * defines the replacement functions, this header must be included by a
+ * single translation unit of each program.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/**
+ * The number of calls to operator new made so far.
+ */
+static uint64_t g_allocations = 0;
+
+/**
+ * The number of bytes requested to operator new so far.
+ */
+static uint64_t g_allocatedBytes = 0;
+
+/**
+ * The number of bytes currently allocated through operator new.
+ */
+static uint64_t g_liveBytes = 0;
+
+void*
+operator new(std::size_t size)
+{
+    // Store the size of the block in front of it, keeping the alignment
+    auto block = static_cast<std::size_t*>(std::malloc(size + alignof(std::max_align_t)));
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    *block = size;
+    g_allocations++;
+    g_allocatedBytes += size;
+    g_liveBytes += size;
+    return reinterpret_cast<char*>(block) + alignof(std::max_align_t);
+}
+
+void
+operator delete(void* pointer) noexcept
+{
+    if (pointer)
+    {
+        auto block = reinterpret_cast<std::size_t*>(static_cast<char*>(pointer) -
+                                                    alignof(std::max_align_t));
+        g_liveBytes -= *block;
+        std::free(block);
+    }
+}
+
+void
+operator delete(void* pointer, std::size_t /* size */) noexcept
+{
+    operator delete(pointer);
+}
+
+#endif /* ALLOCATION_COUNTER_H */
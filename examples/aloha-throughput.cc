@@ -48,6 +48,7 @@
 
 #include <algorithm>
 #include <ctime>
+#include <fstream>
 
 using namespace ns3;
 using namespace lorawan;
@@ -103,6 +104,7 @@ int
 main(int argc, char* argv[])
 {
     std::string interferenceMatrix = "aloha";
+    std::string metricsFile = "";
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nDevices", "Number of end devices to include in the simulation", nDevices);
@@ -111,6 +113,9 @@ main(int argc, char* argv[])
                  "Interference matrix to use [aloha, goursaud]",
                  interferenceMatrix);
     cmd.AddValue("radius", "Radius (m) of the deployment", radiusMeters);
+    cmd.AddValue("metricsFile",
+                 "File to write the metrics of the run to, one \"name value\" pair per line",
+                 metricsFile);
     cmd.Parse(argc, argv);
 
     int appPeriodSeconds = simulationTimeSeconds;
@@ -372,5 +377,16 @@ main(int argc, char* argv[])
         std::cout << packetsSent.at(i) << " " << packetsReceived.at(i) << std::endl;
     }
 
+    if (!metricsFile.empty())
+    {
+        std::ofstream metrics(metricsFile);
+        helper.GetPacketTracker().PrintMetrics(metrics, Seconds(0), appStopTime);
+        for (int i = 0; i < 6; i++)
+        {
+            metrics << "sentSF" << i + 7 << " " << packetsSent.at(i) << std::endl;
+            metrics << "receivedSF" << i + 7 << " " << packetsReceived.at(i) << std::endl;
+        }
+    }
+
     return 0;
 }
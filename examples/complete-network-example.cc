@@ -48,6 +48,7 @@
 
 #include <algorithm>
 #include <ctime>
+#include <fstream>
 
 using namespace ns3;
 using namespace lorawan;
@@ -68,6 +69,7 @@ int appPeriodSeconds = 600; //!< Duration (s) of the inter-transmission time of
 
 // Output control
 bool printBuildingInfo = true; //!< Whether to print building information
+std::string metricsFile = "";  //!< File to write the metrics of the run to, if any
 
 int
 main(int argc, char* argv[])
@@ -80,6 +82,9 @@ main(int argc, char* argv[])
                  "The period in seconds to be used by periodically transmitting applications",
                  appPeriodSeconds);
     cmd.AddValue("print", "Whether or not to print building information", printBuildingInfo);
+    cmd.AddValue("metricsFile",
+                 "File to write the metrics of the run to, one \"name value\" pair per line",
+                 metricsFile);
     cmd.Parse(argc, argv);
 
     // Set up logging
@@ -363,5 +368,11 @@ main(int argc, char* argv[])
     LoraPacketTracker& tracker = helper.GetPacketTracker();
     std::cout << tracker.CountMacPacketsGlobally(Seconds(0), appStopTime + Hours(1)) << std::endl;
 
+    if (!metricsFile.empty())
+    {
+        std::ofstream metrics(metricsFile);
+        tracker.PrintMetrics(metrics, Seconds(0), appStopTime + Hours(1));
+    }
+
     return 0;
 }
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This script simulates a gateway at the center of a disc of end devices,
+ * and measures the packet delivery ratio of the devices in a region of
+ * interest around it. In hybrid mode, only the devices in the region are
+ * simulated, and the others are replaced by an AggregateInterferenceSource;
+ * otherwise, all devices are simulated explicitly. Both modes should give
+ * similar delivery ratios, the hybrid one at a fraction of the cost.
+ */
+
+#include "ns3/aggregate-interference-source.h"
+#include "ns3/boolean.h"
+#include "ns3/command-line.h"
+#include "ns3/double.h"
+#include "ns3/forwarder-helper.h"
+#include "ns3/log.h"
+#include "ns3/lora-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/network-server-helper.h"
+#include "ns3/node-container.h"
+#include "ns3/periodic-sender-helper.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/position-allocator.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <chrono>
+#include <cmath>
+#include <unordered_set>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("HybridBackgroundExample");
+
+// Network settings
+int nDevices = 100000;              //!< Number of end devices in the whole disc
+double radiusMeters = 10000;        //!< Radius (m) of the deployment
+double regionRadiusMeters = 2000;   //!< Radius (m) of the region of interest
+double simulationTimeSeconds = 600; //!< Scenario duration (s) in simulated time
+int appPeriodSeconds = 600;         //!< Duration (s) of the inter-transmission time of end devices
+bool hybrid = true;                 //!< Whether to replace devices outside the region
+
+// Counters of the packets of the region of interest
+std::unordered_set<uint64_t> g_regionPackets; //!< Uids of the packets sent in the region
+uint32_t g_received = 0;                      //!< Packets of the region received by the gateway
+
+/**
+ * Record a packet sent by a device of the region of interest.
+ *
+ * \param packet The packet.
+ * \param senderNodeId The node id of the sender.
+ */
+void
+OnTransmission(Ptr<const Packet> packet, uint32_t senderNodeId)
+{
+    g_regionPackets.insert(packet->GetUid());
+}
+
+/**
+ * Count the packets of the region of interest received by the gateway.
+ *
+ * \param packet The packet.
+ * \param receiverNodeId The node id of the gateway.
+ */
+void
+OnReception(Ptr<const Packet> packet, uint32_t receiverNodeId)
+{
+    g_received += g_regionPackets.count(packet->GetUid());
+}
+
+int
+main(int argc, char* argv[])
+{
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nDevices", "Number of end devices in the whole disc", nDevices);
+    cmd.AddValue("radius", "The radius (m) of the disc", radiusMeters);
+    cmd.AddValue("regionRadius", "The radius (m) of the region of interest", regionRadiusMeters);
+    cmd.AddValue("simulationTime", "The time (s) for which to simulate", simulationTimeSeconds);
+    cmd.AddValue("appPeriod",
+                 "The period in seconds to be used by periodically transmitting applications",
+                 appPeriodSeconds);
+    cmd.AddValue("hybrid", "Whether to replace the devices outside the region", hybrid);
+    cmd.Parse(argc, argv);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    /************************
+     *  Create the channel  *
+     ************************/
+
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+
+    // Both modes only deliver transmissions above the same floor
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+    channel->SetAttribute("InterferenceFloor", DoubleValue(-150));
+    channel->SetAttribute("SpatialIndex", BooleanValue(true));
+
+    /************************
+     *  Create the helpers  *
+     ************************/
+
+    LoraPhyHelper phyHelper = LoraPhyHelper();
+    phyHelper.SetChannel(channel);
+    LorawanMacHelper macHelper = LorawanMacHelper();
+    LoraHelper helper = LoraHelper();
+    NetworkServerHelper nsHelper = NetworkServerHelper();
+    ForwarderHelper forHelper = ForwarderHelper();
+
+    /************************
+     *  Create End Devices  *
+     ************************/
+
+    // In hybrid mode, only the share of the population in the region is created
+    int nExplicit = nDevices;
+    double explicitRadius = radiusMeters;
+    if (hybrid)
+    {
+        nExplicit = int(std::round(nDevices * std::pow(regionRadiusMeters / radiusMeters, 2)));
+        explicitRadius = regionRadiusMeters;
+    }
+
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator("ns3::UniformDiscPositionAllocator",
+                                  "rho",
+                                  DoubleValue(explicitRadius),
+                                  "Z",
+                                  DoubleValue(1.2));
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+
+    NodeContainer endDevices;
+    endDevices.Create(nExplicit);
+    mobility.Install(endDevices);
+
+    Ptr<LoraDeviceAddressGenerator> addrGen = CreateObject<LoraDeviceAddressGenerator>(54, 1864);
+    macHelper.SetAddressGenerator(addrGen);
+    phyHelper.SetDeviceType(LoraPhyHelper::ED);
+    macHelper.SetDeviceType(LorawanMacHelper::ED_A);
+    helper.Install(phyHelper, macHelper, endDevices);
+
+    /*********************
+     *  Create Gateways  *
+     *********************/
+
+    NodeContainer gateways;
+    gateways.Create(1);
+    Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator>();
+    allocator->Add(Vector(0.0, 0.0, 15.0));
+    mobility.SetPositionAllocator(allocator);
+    mobility.Install(gateways);
+
+    phyHelper.SetDeviceType(LoraPhyHelper::GW);
+    macHelper.SetDeviceType(LorawanMacHelper::GW);
+    helper.Install(phyHelper, macHelper, gateways);
+
+    LorawanMacHelper::SetSpreadingFactorsUp(endDevices, gateways, channel);
+
+    /*********************************************
+     *  Install applications on the end devices  *
+     *********************************************/
+
+    Time appStopTime = Seconds(simulationTimeSeconds);
+    PeriodicSenderHelper appHelper = PeriodicSenderHelper();
+    appHelper.SetPeriod(Seconds(appPeriodSeconds));
+    appHelper.SetPacketSize(23);
+    ApplicationContainer appContainer = appHelper.Install(endDevices);
+    appContainer.Start(Seconds(0));
+    appContainer.Stop(appStopTime);
+
+    /**********************************
+     *  Create the background traffic  *
+     **********************************/
+
+    Ptr<AggregateInterferenceSource> background = CreateObject<AggregateInterferenceSource>();
+    if (hybrid)
+    {
+        Ptr<UniformDiscPositionAllocator> backgroundAllocator =
+            CreateObject<UniformDiscPositionAllocator>();
+        backgroundAllocator->SetRho(radiusMeters);
+        backgroundAllocator->SetZ(1.2);
+        background->SetAttribute("NDevices", UintegerValue(nDevices - nExplicit));
+        background->SetAttribute("Period", TimeValue(Seconds(appPeriodSeconds)));
+        background->SetAttribute("PacketSize", UintegerValue(23));
+        background->SetPositionAllocator(backgroundAllocator);
+        background->SetRegion(Vector(0, 0, 0), regionRadiusMeters);
+        background->Install(channel, gateways);
+        background->Start(Seconds(0));
+        background->Stop(appStopTime);
+    }
+
+    /**************************
+     *  Create network server  *
+     ***************************/
+
+    Ptr<Node> networkServer = CreateObject<Node>();
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
+    p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+    P2PGwRegistration_t gwRegistration;
+    for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
+    {
+        auto container = p2p.Install(networkServer, *gw);
+        auto serverP2PNetDev = DynamicCast<PointToPointNetDevice>(container.Get(0));
+        gwRegistration.emplace_back(serverP2PNetDev, *gw);
+    }
+    nsHelper.SetGatewaysP2P(gwRegistration);
+    nsHelper.SetEndDevices(endDevices);
+    nsHelper.Install(networkServer);
+    forHelper.Install(gateways);
+
+    // Only the devices of the region of interest are measured
+    for (auto ed = endDevices.Begin(); ed != endDevices.End(); ++ed)
+    {
+        Vector position = (*ed)->GetObject<MobilityModel>()->GetPosition();
+        if (std::hypot(position.x, position.y) < regionRadiusMeters)
+        {
+            (*ed)->GetDevice(0)->GetObject<LoraNetDevice>()->GetPhy()->TraceConnectWithoutContext(
+                "StartSending",
+                MakeCallback(&OnTransmission));
+        }
+    }
+    gateways.Get(0)->GetDevice(0)->GetObject<LoraNetDevice>()->GetPhy()->TraceConnectWithoutContext(
+        "ReceivedPacket",
+        MakeCallback(&OnReception));
+
+    ////////////////
+    // Simulation //
+    ////////////////
+
+    Simulator::Stop(appStopTime + Hours(1));
+
+    NS_LOG_INFO("Running simulation...");
+    Simulator::Run();
+    Simulator::Destroy();
+
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << (hybrid ? "Hybrid" : "Explicit") << " mode: " << nExplicit
+              << " explicit devices, " << background->GetTransmissionCount()
+              << " background transmissions" << std::endl;
+    std::cout << "Region of interest: " << g_regionPackets.size() << " packets sent, "
+              << g_received << " received (PDR "
+              << (g_regionPackets.empty() ? 0 : double(g_received) / g_regionPackets.size())
+              << ")" << std::endl;
+    std::cout << "Wall-clock time: " << std::chrono::duration<double>(end - begin).count()
+              << " s" << std::endl;
+
+    return 0;
+}
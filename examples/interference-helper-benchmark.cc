@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program measures the cost of interference computations at a busy
+ * gateway. A synthetic trace of incoming signals (Poisson arrivals spread over
+ * the channels of the EU868 band, random spreading factors) is replayed against
+ * three event stores:
+ * - a list of all events, scanned for every packet;
+ * - one bucket of events per frequency, sorted by start time, so that only
+ *   events that can overlap with the packet are visited;
+ * - the LoraInterferenceHelper.
+ * The first two compute the interference energy of each event with a scalar
+ * kernel working in dB, as LoraInterferenceHelper used to do. All runs must
+ * reach the same outcome for every packet. The number of calls to operator new
+ * made while registering the events is also reported for each store: events
+ * themselves are recycled by their pool, so this counts the allocations made
+ * by the containers of each store. Finally, the memory taken by the first
+ * event of a helper is measured over many helpers, since most devices of a
+ * network only hear a few signals at a time.
+ */
+
+#include "allocation-counter.h"
+
+#include "ns3/command-line.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/lora-interference-helper.h"
+#include "ns3/lora-phy.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("InterferenceHelperBenchmark");
+
+/**
+ * A signal of the synthetic gateway load.
+ */
+struct Signal
+{
+    Time start;       //!< The arrival time of the signal
+    Time duration;    //!< The duration of the signal
+    double rxPower;   //!< The received power in dBm
+    uint8_t sf;       //!< The spreading factor
+    double frequency; //!< The frequency in MHz
+};
+
+/**
+ * Scalar interference kernel: for each interferer, convert its power to W and
+ * add its overlap-weighted energy to the one of its spreading factor, then
+ * compare the SNIR in dB of each spreading factor with the collision matrix.
+ *
+ * \param event The event for which to check the outcome.
+ * \param begin The first candidate interferer.
+ * \param end The end of the candidate interferers.
+ * \return The sf of the packets that caused the loss, or 0 if there was no loss.
+ */
+template <typename Iterator>
+uint8_t
+ComputeOutcome(Ptr<LoraInterferenceHelper::Event> event, Iterator begin, Iterator end)
+{
+    std::vector<double> cumulativeInterferenceEnergy(6, 0);
+    for (auto it = begin; it != end; it++)
+    {
+        Ptr<LoraInterferenceHelper::Event> interferer = *it;
+        if (!(interferer->GetFrequency() == event->GetFrequency()) || interferer == event)
+        {
+            continue;
+        }
+        Time overlap = std::min(event->GetEndTime(), interferer->GetEndTime()) -
+                       std::max(event->GetStartTime(), interferer->GetStartTime());
+        if (overlap.IsStrictlyNegative())
+        {
+            overlap = Seconds(0);
+        }
+        double interfererPowerW = pow(10, interferer->GetRxPowerdBm() / 10) / 1000;
+        cumulativeInterferenceEnergy.at(unsigned(interferer->GetSpreadingFactor()) - 7) +=
+            overlap.GetSeconds() * interfererPowerW;
+    }
+
+    uint8_t sf = event->GetSpreadingFactor();
+    for (auto currentSf = uint8_t(7); currentSf <= uint8_t(12); currentSf++)
+    {
+        double signalPowerW = pow(10, event->GetRxPowerdBm() / 10) / 1000;
+        double signalEnergy = event->GetDuration().GetSeconds() * signalPowerW;
+        double snirIsolation =
+            LoraInterferenceHelper::collisionSnirGoursaud[unsigned(sf) - 7][currentSf - 7];
+        double snir =
+            10 * log10(signalEnergy / cumulativeInterferenceEnergy.at(unsigned(currentSf) - 7));
+        if (snir < snirIsolation)
+        {
+            return currentSf;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Build the transmission a signal belongs to.
+ *
+ * \param signal The signal impinging on the antenna.
+ * \return The transmission.
+ */
+Ptr<LoraInterferenceHelper::Transmission>
+CreateTransmission(const Signal& signal)
+{
+    return Create<LoraInterferenceHelper::Transmission>(signal.duration,
+                                                        signal.sf,
+                                                        nullptr,
+                                                        signal.frequency);
+}
+
+/**
+ * Reference event store: a single list of events, scanned in full for every
+ * packet and cleaned when it grows beyond 100 events.
+ */
+class ListEventStore
+{
+  public:
+    /**
+     * Register a new event.
+     *
+     * \param signal The signal impinging on the antenna.
+     * \return The newly created event.
+     */
+    Ptr<LoraInterferenceHelper::Event> Add(const Signal& signal)
+    {
+        Ptr<LoraInterferenceHelper::Event> event =
+            Create<LoraInterferenceHelper::Event>(CreateTransmission(signal), signal.rxPower);
+        m_events.push_back(event);
+        if (m_events.size() > 100)
+        {
+            for (auto it = m_events.begin(); it != m_events.end();)
+            {
+                if ((*it)->GetEndTime() + Seconds(2) < Simulator::Now())
+                {
+                    it = m_events.erase(it);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+        return event;
+    }
+
+    /**
+     * Determine whether the event was destroyed by interference.
+     *
+     * \param event The event for which to check the outcome.
+     * \return The sf of the packets that caused the loss, or 0 if there was no loss.
+     */
+    uint8_t IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Event> event)
+    {
+        return ComputeOutcome(event, m_events.begin(), m_events.end());
+    }
+
+  private:
+    std::list<Ptr<LoraInterferenceHelper::Event>> m_events; //!< The registered events
+};
+
+/**
+ * Reference event store: one bucket of events per frequency, sorted by start
+ * time, with the overlapping events found by binary search.
+ */
+class BucketEventStore
+{
+  public:
+    /**
+     * Register a new event.
+     *
+     * \param signal The signal impinging on the antenna.
+     * \return The newly created event.
+     */
+    Ptr<LoraInterferenceHelper::Event> Add(const Signal& signal)
+    {
+        Ptr<LoraInterferenceHelper::Event> event =
+            Create<LoraInterferenceHelper::Event>(CreateTransmission(signal), signal.rxPower);
+        auto& bucket = m_events[signal.frequency];
+        bucket.push_back(event);
+        m_maxEventDuration = std::max(m_maxEventDuration, signal.duration);
+        Time threshold = std::max(Seconds(2), m_maxEventDuration);
+        while (bucket.front()->GetEndTime() + threshold < Simulator::Now())
+        {
+            bucket.pop_front();
+        }
+        return event;
+    }
+
+    /**
+     * Determine whether the event was destroyed by interference.
+     *
+     * \param event The event for which to check the outcome.
+     * \return The sf of the packets that caused the loss, or 0 if there was no loss.
+     */
+    uint8_t IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Event> event)
+    {
+        const auto& bucket = m_events[event->GetFrequency()];
+        auto first = std::lower_bound(bucket.begin(),
+                                      bucket.end(),
+                                      event->GetStartTime() - m_maxEventDuration,
+                                      [](const Ptr<LoraInterferenceHelper::Event>& e, Time t) {
+                                          return e->GetStartTime() < t;
+                                      });
+        auto last = std::lower_bound(first,
+                                     bucket.end(),
+                                     event->GetEndTime(),
+                                     [](const Ptr<LoraInterferenceHelper::Event>& e, Time t) {
+                                         return e->GetStartTime() < t;
+                                     });
+        return ComputeOutcome(event, first, last);
+    }
+
+  private:
+    std::map<double, std::deque<Ptr<LoraInterferenceHelper::Event>>>
+        m_events;            //!< The registered events, by frequency
+    Time m_maxEventDuration; //!< The duration of the longest registered event
+};
+
+/**
+ * Replay the trace against an event store.
+ *
+ * \param store The event store under test.
+ * \param trace The signals to replay.
+ * \param outcomes The outcome of each packet, filled by this function.
+ * \param allocations The number of calls to operator new made while registering
+ *        the events, filled by this function.
+ * \return The wall-clock time taken by the simulation, in seconds.
+ */
+template <typename Store>
+double
+Replay(Store& store,
+       const std::vector<Signal>& trace,
+       std::vector<uint8_t>& outcomes,
+       std::size_t& allocations)
+{
+    outcomes.assign(trace.size(), 0);
+    allocations = 0;
+    for (std::size_t i = 0; i < trace.size(); i++)
+    {
+        Simulator::Schedule(trace[i].start, [&store, &trace, &outcomes, &allocations, i]() {
+            std::size_t before = g_allocations;
+            Ptr<LoraInterferenceHelper::Event> event = store.Add(trace[i]);
+            allocations += g_allocations - before;
+            Simulator::Schedule(trace[i].duration, [&store, &outcomes, event, i]() {
+                outcomes[i] = store.IsDestroyedByInterference(event);
+            });
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    Simulator::Run();
+    auto end = std::chrono::steady_clock::now();
+    Simulator::Destroy();
+
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+/**
+ * Adapter exposing a LoraInterferenceHelper with the same interface as ListEventStore.
+ */
+struct HelperEventStore
+{
+    /**
+     * Register a new event.
+     *
+     * \param signal The signal impinging on the antenna.
+     * \return The newly created event.
+     */
+    Ptr<LoraInterferenceHelper::Event> Add(const Signal& signal)
+    {
+        return helper.Add(CreateTransmission(signal), signal.rxPower);
+    }
+
+    /**
+     * Determine whether the event was destroyed by interference.
+     *
+     * \param event The event for which to check the outcome.
+     * \return The sf of the packets that caused the loss, or 0 if there was no loss.
+     */
+    uint8_t IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Event> event)
+    {
+        return helper.IsDestroyedByInterference(event);
+    }
+
+    LoraInterferenceHelper helper; //!< The helper under test
+};
+
+int
+main(int argc, char* argv[])
+{
+    double eventsPerSecond = 10000;
+    double simTime = 10;
+    int payloadSize = 20;
+    uint32_t nHelpers = 10000;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("eventsPerSecond", "Rate of signals arriving at the gateway", eventsPerSecond);
+    cmd.AddValue("simTime", "Duration of the synthetic load, in seconds", simTime);
+    cmd.AddValue("payloadSize", "Payload size of each packet, in bytes", payloadSize);
+    cmd.AddValue("nHelpers", "Number of helpers receiving a single event", nHelpers);
+    cmd.Parse(argc, argv);
+
+    /************************
+     *  Generate the trace  *
+     ************************/
+
+    const std::vector<double> frequencies = {868.1, 868.3, 868.5, 867.1, 867.3, 867.5, 867.7, 867.9};
+
+    Ptr<ExponentialRandomVariable> interArrival = CreateObject<ExponentialRandomVariable>();
+    interArrival->SetAttribute("Mean", DoubleValue(1 / eventsPerSecond));
+    interArrival->SetStream(1);
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(2);
+
+    // Precompute the duration of a packet at each spreading factor
+    std::vector<Time> durations;
+    LoraTxParameters txParams;
+    for (uint8_t sf = 7; sf <= 12; sf++)
+    {
+        txParams.sf = sf;
+        txParams.lowDataRateOptimizationEnabled = sf >= 11;
+        durations.push_back(LoraPhy::GetOnAirTime(Create<Packet>(payloadSize), txParams));
+    }
+
+    std::vector<Signal> trace;
+    for (Time t = Seconds(interArrival->GetValue()); t < Seconds(simTime);
+         t += Seconds(interArrival->GetValue()))
+    {
+        auto sf = uint8_t(uniform->GetInteger(7, 12));
+        trace.push_back({t,
+                         durations[sf - 7],
+                         uniform->GetValue(-130, -60),
+                         sf,
+                         frequencies[uniform->GetInteger(0, frequencies.size() - 1)]});
+    }
+
+    /*******************
+     *  Run the tests  *
+     *******************/
+
+    std::vector<uint8_t> listOutcomes;
+    std::vector<uint8_t> bucketOutcomes;
+    std::vector<uint8_t> helperOutcomes;
+
+    std::size_t listAllocations = 0;
+    std::size_t bucketAllocations = 0;
+    std::size_t helperAllocations = 0;
+
+    ListEventStore listStore;
+    double listTime = Replay(listStore, trace, listOutcomes, listAllocations);
+    BucketEventStore bucketStore;
+    double bucketTime = Replay(bucketStore, trace, bucketOutcomes, bucketAllocations);
+    HelperEventStore helperStore;
+    double helperTime = Replay(helperStore, trace, helperOutcomes, helperAllocations);
+
+    std::size_t mismatches = 0;
+    std::size_t destroyed = 0;
+    for (std::size_t i = 0; i < trace.size(); i++)
+    {
+        mismatches += (listOutcomes[i] != helperOutcomes[i]);
+        mismatches += (bucketOutcomes[i] != helperOutcomes[i]);
+        destroyed += (helperOutcomes[i] != 0);
+    }
+
+    // Measure the memory taken by registering a single event at many helpers
+    std::vector<LoraInterferenceHelper> helpers(nHelpers);
+    std::vector<Ptr<LoraInterferenceHelper::Event>> events;
+    events.reserve(nHelpers);
+    Ptr<LoraInterferenceHelper::Transmission> transmission = CreateTransmission(trace.front());
+    uint64_t liveBytes = g_liveBytes;
+    for (auto& helper : helpers)
+    {
+        events.push_back(helper.Add(transmission, trace.front().rxPower));
+    }
+    double bytesPerHelper = double(g_liveBytes - liveBytes) / nHelpers;
+
+    std::cout << "Signals: " << trace.size() << " (" << destroyed << " destroyed)" << std::endl;
+    std::cout << "List event store: " << listTime << " s, "
+              << listTime / trace.size() * 1e9 << " ns/packet, "
+              << double(listAllocations) / trace.size() << " allocations/packet" << std::endl;
+    std::cout << "Bucket event store: " << bucketTime << " s, "
+              << bucketTime / trace.size() * 1e9 << " ns/packet, "
+              << double(bucketAllocations) / trace.size() << " allocations/packet" << std::endl;
+    std::cout << "LoraInterferenceHelper: " << helperTime << " s, "
+              << helperTime / trace.size() * 1e9 << " ns/packet, "
+              << double(helperAllocations) / trace.size() << " allocations/packet" << std::endl;
+    std::cout << "Speedup over the list event store: " << listTime / helperTime << "x"
+              << std::endl;
+    std::cout << "Speedup over the bucket event store: " << bucketTime / helperTime << "x"
+              << std::endl;
+    std::cout << "Outcome mismatches: " << mismatches << std::endl;
+    std::cout << "Memory taken by the first event of a helper: " << bytesPerHelper << " bytes"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,879 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program runs microbenchmarks of the hot paths of the module, and
+ * reports for each of them the wall-clock time, the number of calls to
+ * operator new and the number of bytes they allocate, per operation:
+ * - channel-send: LoraChannel::Send to nReceivers PHYs;
+ * - interference-add and interference-outcome: LoraInterferenceHelper::Add
+ *   and IsDestroyedByInterference, under a Poisson load over the EU868
+ *   channels;
+ * - on-air-time: LoraPhy::GetOnAirTime, over all spreading factors;
+ * - frame-header-serialize and frame-header-deserialize: a downlink
+ *   LoraFrameHeader carrying MAC commands;
+ * - insert-received-packet: EndDeviceStatus::InsertReceivedPacket, for
+ *   uplinks received by nGateways gateways;
+ * - adr-decision: AdrComponent::BeforeSendingReply, with a full history;
+ * - tracker-phy and tracker-mac: the PHY and MAC trace sinks of the
+ *   LoraPacketTracker, for each uplink.
+ * Only the calls under test are measured: the cost of reading the clock around
+ * them is calibrated and subtracted. Each benchmark runs repetitions times,
+ * and the fastest run is reported, as a table or, for regression tracking, as
+ * CSV or JSON. The number of operations of each benchmark can be scaled, and
+ * benchmarks can be selected by a substring of their name.
+ */
+
+#include "allocation-counter.h"
+
+#include "ns3/abort.h"
+#include "ns3/adr-component.h"
+#include "ns3/buffer.h"
+#include "ns3/class-a-end-device-lorawan-mac.h"
+#include "ns3/command-line.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
+#include "ns3/end-device-status.h"
+#include "ns3/integer.h"
+#include "ns3/log.h"
+#include "ns3/lora-channel.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lora-interference-helper.h"
+#include "ns3/lora-packet-tracker.h"
+#include "ns3/lora-phy.h"
+#include "ns3/lora-tag.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/network-status.h"
+#include "ns3/parsed-uplink.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simple-end-device-lora-phy.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("LorawanBench");
+
+// Benchmark settings
+uint32_t nReceivers = 100;     //!< Number of PHYs reached by each LoraChannel::Send
+uint32_t nGateways = 4;        //!< Number of gateways receiving each uplink
+double eventsPerSecond = 1000; //!< Rate of the signals arriving at the interference helper
+
+/**
+ * Results of the calls under test, kept so that they aren't optimized away.
+ */
+uint64_t g_sink = 0;
+
+/**
+ * Accumulator of the cost of the measured sections of a benchmark.
+ */
+class Probe
+{
+  public:
+    /**
+     * Start a measured section.
+     */
+    void Start()
+    {
+        m_allocations -= g_allocations;
+        m_bytes -= g_allocatedBytes;
+        m_begin = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * End a measured section.
+     *
+     * \param operations The number of operations performed in the section.
+     */
+    void Stop(uint64_t operations = 1)
+    {
+        auto end = std::chrono::steady_clock::now();
+        m_seconds += std::chrono::duration<double>(end - m_begin).count();
+        m_allocations += g_allocations;
+        m_bytes += g_allocatedBytes;
+        m_operations += operations;
+        m_sections++;
+    }
+
+    /**
+     * Measure the cost of an empty section, to be subtracted from the measured ones.
+     */
+    static void Calibrate()
+    {
+        for (int run = 0; run < 10; run++)
+        {
+            Probe probe;
+            for (int i = 0; i < 100000; i++)
+            {
+                probe.Start();
+                probe.Stop();
+            }
+            s_overhead = std::min(s_overhead, probe.m_seconds / probe.m_sections);
+        }
+    }
+
+    /**
+     * \return The number of operations measured.
+     */
+    uint64_t GetOperations() const
+    {
+        return m_operations;
+    }
+
+    /**
+     * \return The time per operation, in nanoseconds.
+     */
+    double GetNsPerOp() const
+    {
+        double seconds = std::max(0.0, m_seconds - m_sections * s_overhead);
+        return seconds / m_operations * 1e9;
+    }
+
+    /**
+     * \return The number of calls to operator new per operation.
+     */
+    double GetAllocationsPerOp() const
+    {
+        return double(m_allocations) / m_operations;
+    }
+
+    /**
+     * \return The number of bytes allocated per operation.
+     */
+    double GetBytesPerOp() const
+    {
+        return double(m_bytes) / m_operations;
+    }
+
+  private:
+    std::chrono::steady_clock::time_point m_begin; //!< The start of the current section
+    double m_seconds = 0;                          //!< The time spent in the sections
+    uint64_t m_allocations = 0;                    //!< The calls to operator new in the sections
+    uint64_t m_bytes = 0;                          //!< The bytes allocated in the sections
+    uint64_t m_operations = 0;                     //!< The operations performed in the sections
+    uint64_t m_sections = 0;                       //!< The number of sections
+
+    static double s_overhead; //!< The time taken by an empty section, in seconds
+};
+
+double Probe::s_overhead = std::numeric_limits<double>::infinity();
+
+/**
+ * A microbenchmark.
+ */
+struct Benchmark
+{
+    std::string name;                          //!< The name reported for the benchmark
+    uint64_t operations;                       //!< The default number of operations
+    std::function<void(uint64_t, Probe&)> run; //!< Perform the operations, measuring them
+};
+
+/**
+ * Build an uplink packet, as the MAC layer of an end device would.
+ *
+ * \param address The address of the device.
+ * \param fCnt The frame counter of the packet.
+ * \return The packet.
+ */
+Ptr<Packet>
+CreateUplink(uint32_t address, uint32_t fCnt)
+{
+    Ptr<Packet> packet = Create<Packet>(20);
+    LoraFrameHeader frameHdr;
+    frameHdr.SetAsUplink();
+    frameHdr.SetAddress(LoraDeviceAddress(address));
+    frameHdr.SetFCnt(fCnt);
+    frameHdr.SetAdr(true);
+    packet->AddHeader(frameHdr);
+    LorawanMacHeader macHdr;
+    macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+    packet->AddHeader(macHdr);
+    return packet;
+}
+
+/**
+ * Build an uplink as received by the network server.
+ *
+ * \param address The address of the device.
+ * \param fCnt The frame counter of the packet.
+ * \param rxPower The power the packet was received with [dBm].
+ * \return The uplink with its decoded headers.
+ */
+Ptr<const ParsedUplink>
+CreateParsedUplink(uint32_t address, uint32_t fCnt, double rxPower)
+{
+    Ptr<Packet> packet = CreateUplink(address, fCnt);
+    LoraTag tag(7);
+    tag.SetFrequency(868.1);
+    tag.SetReceivePower(rxPower);
+    packet->AddPacketTag(tag);
+    return Create<ParsedUplink>(packet);
+}
+
+/**
+ * Send packets from one PHY to nReceivers others, in batches, letting the
+ * receptions happen between batches.
+ *
+ * \param n The number of packets to send.
+ * \param probe The probe measuring the calls to LoraChannel::Send.
+ */
+void
+BenchChannelSend(uint64_t n, Probe& probe)
+{
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+
+    std::vector<Ptr<SimpleEndDeviceLoraPhy>> phys;
+    for (uint32_t i = 0; i <= nReceivers; i++)
+    {
+        Ptr<SimpleEndDeviceLoraPhy> phy = CreateObject<SimpleEndDeviceLoraPhy>();
+        Ptr<ConstantPositionMobilityModel> mobility =
+            CreateObject<ConstantPositionMobilityModel>();
+        mobility->SetPosition(Vector(10.0 * i, 0.0, 0.0));
+        phy->SetMobility(mobility);
+        phy->SetFrequency(868.1);
+        phy->SetSpreadingFactor(7);
+        phy->SwitchToStandby();
+        phy->SetChannel(channel);
+        channel->Add(phy);
+        phys.push_back(phy);
+    }
+
+    LoraTxParameters txParams;
+    txParams.sf = 7;
+    Ptr<Packet> packet = CreateUplink(1, 0);
+    Time duration = LoraPhy::GetOnAirTime(packet, txParams);
+
+    const uint64_t batchSize = 100;
+    std::vector<Ptr<Packet>> batch;
+    for (uint64_t sent = 0; sent < n; sent += batch.size())
+    {
+        batch.clear();
+        for (uint64_t i = 0; i < std::min(batchSize, n - sent); i++)
+        {
+            batch.push_back(packet->Copy());
+        }
+
+        probe.Start();
+        for (const auto& p : batch)
+        {
+            channel->Send(phys[0], p, 14, txParams, duration, 868.1);
+        }
+        probe.Stop(batch.size());
+
+        Simulator::Run();
+    }
+}
+
+/**
+ * A Poisson load of signals arriving at an interference helper.
+ */
+class InterferenceLoad
+{
+  public:
+    /**
+     * Prepare the load.
+     *
+     * \param n The number of signals.
+     * \param probe The probe measuring the calls under test.
+     * \param measureAdd Whether to measure the calls to Add, or the ones to
+     *        IsDestroyedByInterference.
+     */
+    InterferenceLoad(uint64_t n, Probe& probe, bool measureAdd)
+        : m_remaining(n),
+          m_probe(probe),
+          m_measureAdd(measureAdd)
+    {
+        m_interArrival = CreateObject<ExponentialRandomVariable>();
+        m_interArrival->SetAttribute("Mean", DoubleValue(1 / eventsPerSecond));
+        m_interArrival->SetStream(1);
+        m_uniform = CreateObject<UniformRandomVariable>();
+        m_uniform->SetStream(2);
+
+        m_frequencies = {868.1, 868.3, 868.5, 867.1, 867.3, 867.5, 867.7, 867.9};
+        LoraTxParameters txParams;
+        for (uint8_t sf = 7; sf <= 12; sf++)
+        {
+            txParams.sf = sf;
+            txParams.lowDataRateOptimizationEnabled = sf >= 11;
+            m_durations.push_back(LoraPhy::GetOnAirTime(CreateUplink(1, 0), txParams));
+        }
+    }
+
+    /**
+     * Replay the load.
+     */
+    void Run()
+    {
+        Simulator::Schedule(Seconds(m_interArrival->GetValue()), &InterferenceLoad::Arrive, this);
+        Simulator::Run();
+    }
+
+  private:
+    /**
+     * Register a new signal, and schedule the next one.
+     */
+    void Arrive()
+    {
+        auto sf = uint8_t(m_uniform->GetInteger(7, 12));
+        Ptr<LoraInterferenceHelper::Transmission> transmission =
+            Create<LoraInterferenceHelper::Transmission>(
+                m_durations[sf - 7],
+                sf,
+                nullptr,
+                m_frequencies[m_uniform->GetInteger(0, m_frequencies.size() - 1)]);
+        double rxPower = m_uniform->GetValue(-130, -60);
+
+        if (m_measureAdd)
+        {
+            m_probe.Start();
+        }
+        Ptr<LoraInterferenceHelper::Event> event = m_helper.Add(transmission, rxPower);
+        if (m_measureAdd)
+        {
+            m_probe.Stop();
+        }
+        Simulator::Schedule(transmission->GetDuration(), &InterferenceLoad::End, this, event);
+
+        if (--m_remaining > 0)
+        {
+            Simulator::Schedule(Seconds(m_interArrival->GetValue()),
+                                &InterferenceLoad::Arrive,
+                                this);
+        }
+    }
+
+    /**
+     * Compute the outcome of a signal at its end.
+     *
+     * \param event The event of the signal.
+     */
+    void End(Ptr<LoraInterferenceHelper::Event> event)
+    {
+        if (!m_measureAdd)
+        {
+            m_probe.Start();
+        }
+        g_sink += m_helper.IsDestroyedByInterference(event);
+        if (!m_measureAdd)
+        {
+            m_probe.Stop();
+        }
+    }
+
+    LoraInterferenceHelper m_helper;               //!< The helper under test
+    uint64_t m_remaining;                          //!< The number of signals left to register
+    Probe& m_probe;                                //!< The probe measuring the calls under test
+    bool m_measureAdd;                             //!< Whether Add is measured
+    Ptr<ExponentialRandomVariable> m_interArrival; //!< The time between two signals
+    Ptr<UniformRandomVariable> m_uniform;          //!< Draws the parameters of the signals
+    std::vector<Time> m_durations;                 //!< The duration of signals, by SF - 7
+    std::vector<double> m_frequencies;             //!< The frequencies of the signals [MHz]
+};
+
+/**
+ * Compute the on-air time of packets of several sizes at all spreading factors.
+ *
+ * \param n The number of computations.
+ * \param probe The probe measuring the calls to LoraPhy::GetOnAirTime.
+ */
+void
+BenchOnAirTime(uint64_t n, Probe& probe)
+{
+    std::vector<std::pair<Ptr<Packet>, LoraTxParameters>> combinations;
+    for (uint32_t size : {10, 20, 51, 115})
+    {
+        for (uint8_t sf = 7; sf <= 12; sf++)
+        {
+            LoraTxParameters txParams;
+            txParams.sf = sf;
+            txParams.lowDataRateOptimizationEnabled = sf >= 11;
+            combinations.emplace_back(Create<Packet>(size), txParams);
+        }
+    }
+
+    probe.Start();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        const auto& combination = combinations[i % combinations.size()];
+        g_sink += LoraPhy::GetOnAirTime(combination.first, combination.second).GetTimeStep();
+    }
+    probe.Stop(n);
+}
+
+/**
+ * Build the frame header of a downlink carrying the MAC commands a network
+ * server typically sends.
+ *
+ * \return The frame header.
+ */
+LoraFrameHeader
+CreateDownlinkFrameHeader()
+{
+    LoraFrameHeader frameHdr;
+    frameHdr.SetAsDownlink();
+    frameHdr.SetAddress(LoraDeviceAddress(1));
+    frameHdr.SetFCnt(1);
+    frameHdr.SetAck(true);
+    frameHdr.AddLinkAdrReq(5, 1, {0, 1, 2}, 1);
+    frameHdr.AddDutyCycleReq(0);
+    frameHdr.AddRxParamSetupReq(0, 0, 869.525);
+    frameHdr.AddDevStatusReq();
+    return frameHdr;
+}
+
+/**
+ * Serialize a downlink frame header with MAC commands.
+ *
+ * \param n The number of serializations.
+ * \param probe The probe measuring the calls to LoraFrameHeader::Serialize.
+ */
+void
+BenchFrameHeaderSerialize(uint64_t n, Probe& probe)
+{
+    LoraFrameHeader frameHdr = CreateDownlinkFrameHeader();
+    Buffer buffer;
+    buffer.AddAtStart(frameHdr.GetSerializedSize());
+
+    probe.Start();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        frameHdr.Serialize(buffer.Begin());
+    }
+    probe.Stop(n);
+}
+
+/**
+ * Deserialize a downlink frame header with MAC commands.
+ *
+ * \param n The number of deserializations.
+ * \param probe The probe measuring the calls to LoraFrameHeader::Deserialize.
+ */
+void
+BenchFrameHeaderDeserialize(uint64_t n, Probe& probe)
+{
+    LoraFrameHeader frameHdr = CreateDownlinkFrameHeader();
+    Buffer buffer;
+    buffer.AddAtStart(frameHdr.GetSerializedSize());
+    frameHdr.Serialize(buffer.Begin());
+
+    probe.Start();
+    for (uint64_t i = 0; i < n; i++)
+    {
+        LoraFrameHeader received;
+        received.SetAsDownlink();
+        g_sink += received.Deserialize(buffer.Begin());
+    }
+    probe.Stop(n);
+}
+
+/**
+ * Insert the copies of an uplink received by each gateway in the status of
+ * its device, and schedule the next uplink after the deduplication window.
+ *
+ * \param status The status of the device.
+ * \param gwAddresses The addresses of the gateways.
+ * \param probe The probe measuring the calls to InsertReceivedPacket.
+ * \param fCnt The frame counter of the uplink.
+ * \param nUplinks The number of uplinks left to insert.
+ */
+void
+InsertUplink(Ptr<EndDeviceStatus> status,
+             const std::vector<Address>* gwAddresses,
+             Probe* probe,
+             uint32_t fCnt,
+             uint64_t nUplinks)
+{
+    Ptr<const ParsedUplink> uplink = CreateParsedUplink(1, fCnt, -110);
+
+    probe->Start();
+    for (uint32_t gw = 0; gw < gwAddresses->size(); gw++)
+    {
+        status->InsertReceivedPacket(uplink, (*gwAddresses)[gw], gw);
+    }
+    probe->Stop(gwAddresses->size());
+
+    if (nUplinks > 1)
+    {
+        Simulator::Schedule(Seconds(2),
+                            &InsertUplink,
+                            status,
+                            gwAddresses,
+                            probe,
+                            fCnt + 1,
+                            nUplinks - 1);
+    }
+}
+
+/**
+ * Insert uplinks received by nGateways gateways in the status of a device.
+ *
+ * \param n The number of insertions.
+ * \param probe The probe measuring the calls to EndDeviceStatus::InsertReceivedPacket.
+ */
+void
+BenchInsertReceivedPacket(uint64_t n, Probe& probe)
+{
+    Ptr<ClassAEndDeviceLorawanMac> edMac = CreateObject<ClassAEndDeviceLorawanMac>();
+    Ptr<EndDeviceStatus> status = CreateObject<EndDeviceStatus>(LoraDeviceAddress(1), edMac);
+
+    std::vector<Address> gwAddresses;
+    for (uint32_t gw = 0; gw < nGateways; gw++)
+    {
+        gwAddresses.push_back(Mac48Address::Allocate());
+    }
+
+    Simulator::Schedule(Seconds(0),
+                        &InsertUplink,
+                        status,
+                        &gwAddresses,
+                        &probe,
+                        0,
+                        std::max<uint64_t>(1, n / nGateways));
+    Simulator::Run();
+}
+
+/**
+ * Let the network server receive one uplink of each device, forwarded by all
+ * gateways.
+ *
+ * \param status The NetworkStatus of the network server.
+ * \param adr The AdrComponent of the network server.
+ * \param gwAddresses The addresses of the gateways.
+ * \param round The index of the round, used as frame counter.
+ */
+void
+ReceiveRound(Ptr<NetworkStatus> status,
+             Ptr<AdrComponent> adr,
+             std::vector<Address>* gwAddresses,
+             uint32_t round)
+{
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(round + 1);
+
+    for (uint32_t address = 0; address < uint32_t(status->CountEndDevices()); address++)
+    {
+        Ptr<const ParsedUplink> uplink =
+            CreateParsedUplink(address, round, uniform->GetValue(-130, -90));
+        Ptr<EndDeviceStatus> edStatus = status->GetEndDeviceStatus(LoraDeviceAddress(address));
+        for (uint32_t gw = 0; gw < gwAddresses->size(); gw++)
+        {
+            status->OnReceivedPacket(uplink, (*gwAddresses)[gw], gw);
+            adr->OnReceivedPacket(uplink, edStatus, status);
+        }
+    }
+}
+
+/**
+ * Take the ADR decision of each device, resetting the replies in between.
+ *
+ * \param status The NetworkStatus of the network server.
+ * \param adr The AdrComponent of the network server.
+ * \param probe The probe measuring the calls to AdrComponent::BeforeSendingReply.
+ * \param n The number of decisions.
+ */
+void
+DecideAdr(Ptr<NetworkStatus> status, Ptr<AdrComponent> adr, Probe* probe, uint64_t n)
+{
+    std::vector<Ptr<EndDeviceStatus>> edStatuses;
+    for (uint32_t address = 0; address < uint32_t(status->CountEndDevices()); address++)
+    {
+        edStatuses.push_back(status->GetEndDeviceStatus(LoraDeviceAddress(address)));
+    }
+
+    for (uint64_t decided = 0; decided < n; decided += edStatuses.size())
+    {
+        probe->Start();
+        for (const auto& edStatus : edStatuses)
+        {
+            adr->BeforeSendingReply(edStatus, status);
+        }
+        probe->Stop(edStatuses.size());
+
+        for (const auto& edStatus : edStatuses)
+        {
+            edStatus->InitializeReply();
+        }
+    }
+}
+
+/**
+ * Take ADR decisions for devices whose history is full.
+ *
+ * \param n The number of decisions.
+ * \param probe The probe measuring the calls to AdrComponent::BeforeSendingReply.
+ */
+void
+BenchAdrDecision(uint64_t n, Probe& probe)
+{
+    const uint32_t nDevices = 1000;
+    const int historyRange = 20;
+
+    // A single MAC layer is shared by all devices, since only their
+    // addresses matter here
+    Ptr<ClassAEndDeviceLorawanMac> edMac = CreateObject<ClassAEndDeviceLorawanMac>();
+    Ptr<NetworkStatus> status = CreateObject<NetworkStatus>();
+    for (uint32_t address = 0; address < nDevices; address++)
+    {
+        edMac->SetDeviceAddress(LoraDeviceAddress(address));
+        status->AddNode(edMac);
+    }
+
+    std::vector<Address> gwAddresses;
+    for (uint32_t gw = 0; gw < nGateways; gw++)
+    {
+        gwAddresses.push_back(Mac48Address::Allocate());
+        status->AddGateway(gwAddresses.back(),
+                           Create<GatewayStatus>(gwAddresses.back(), nullptr, nullptr));
+    }
+
+    Ptr<AdrComponent> adr = CreateObject<AdrComponent>();
+    adr->SetAttribute("HistoryRange", IntegerValue(historyRange));
+
+    // Rounds are spaced by more than the DeduplicationWindow, so that each
+    // round fills a new entry of the history of each device
+    for (uint32_t round = 0; round < historyRange; round++)
+    {
+        Simulator::Schedule(Seconds(2 * round), &ReceiveRound, status, adr, &gwAddresses, round);
+    }
+    Simulator::Schedule(Seconds(2 * historyRange), &DecideAdr, status, adr, &probe, n);
+    Simulator::Run();
+}
+
+/**
+ * Build batches of uplink packets.
+ *
+ * \param count The number of packets.
+ * \return The packets.
+ */
+std::vector<Ptr<Packet>>
+CreateUplinks(uint64_t count)
+{
+    std::vector<Ptr<Packet>> packets;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        packets.push_back(CreateUplink(i % 1000, i / 1000));
+    }
+    return packets;
+}
+
+/**
+ * Feed the PHY trace sinks of a LoraPacketTracker with uplinks, each reaching
+ * nGateways gateways with different outcomes.
+ *
+ * \param n The number of uplinks.
+ * \param probe The probe measuring the trace sinks.
+ */
+void
+BenchTrackerPhy(uint64_t n, Probe& probe)
+{
+    LoraPacketTracker tracker;
+    const uint64_t batchSize = 1000;
+    for (uint64_t fed = 0; fed < n; fed += batchSize)
+    {
+        std::vector<Ptr<Packet>> packets = CreateUplinks(std::min(batchSize, n - fed));
+
+        probe.Start();
+        for (uint64_t i = 0; i < packets.size(); i++)
+        {
+            tracker.TransmissionCallback(packets[i], i);
+            for (uint32_t gw = 0; gw < nGateways; gw++)
+            {
+                switch ((i + gw) % 4)
+                {
+                case 0:
+                    tracker.PacketReceptionCallback(packets[i], 1000 + gw);
+                    break;
+                case 1:
+                    tracker.InterferenceCallback(packets[i], 1000 + gw);
+                    break;
+                case 2:
+                    tracker.UnderSensitivityCallback(packets[i], 1000 + gw);
+                    break;
+                default:
+                    tracker.NoMoreReceiversCallback(packets[i], 1000 + gw);
+                    break;
+                }
+            }
+        }
+        probe.Stop(packets.size());
+    }
+}
+
+/**
+ * Feed the MAC trace sinks of a LoraPacketTracker with uplinks, each received
+ * by the MAC layer of a gateway.
+ *
+ * \param n The number of uplinks.
+ * \param probe The probe measuring the trace sinks.
+ */
+void
+BenchTrackerMac(uint64_t n, Probe& probe)
+{
+    LoraPacketTracker tracker;
+    const uint64_t batchSize = 1000;
+    for (uint64_t fed = 0; fed < n; fed += batchSize)
+    {
+        std::vector<Ptr<Packet>> packets = CreateUplinks(std::min(batchSize, n - fed));
+
+        probe.Start();
+        for (const auto& packet : packets)
+        {
+            tracker.MacTransmissionCallback(packet);
+            tracker.MacGwReceptionCallback(packet);
+        }
+        probe.Stop(packets.size());
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    double scale = 1;
+    uint32_t repetitions = 3;
+    std::string filter;
+    std::string format = "text";
+    std::string outputFile;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("scale", "Factor applied to the number of operations of each benchmark", scale);
+    cmd.AddValue("repetitions",
+                 "Number of runs of each benchmark, the fastest is reported",
+                 repetitions);
+    cmd.AddValue("filter", "Only run the benchmarks whose name contains this string", filter);
+    cmd.AddValue("format", "Output format: text, csv or json", format);
+    cmd.AddValue("outputFile",
+                 "File to write the results to, instead of the standard output",
+                 outputFile);
+    cmd.AddValue("nReceivers", "Number of PHYs reached by each LoraChannel::Send", nReceivers);
+    cmd.AddValue("nGateways", "Number of gateways receiving each uplink", nGateways);
+    cmd.AddValue("eventsPerSecond",
+                 "Rate of the signals arriving at the interference helper",
+                 eventsPerSecond);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_UNLESS(format == "text" || format == "csv" || format == "json",
+                        "Unknown output format " << format);
+    NS_ABORT_MSG_UNLESS(repetitions > 0, "At least one repetition is needed");
+
+    std::vector<Benchmark> benchmarks = {
+        {"channel-send", 20000, &BenchChannelSend},
+        {"interference-add",
+         200000,
+         [](uint64_t n, Probe& probe) { InterferenceLoad(n, probe, true).Run(); }},
+        {"interference-outcome",
+         200000,
+         [](uint64_t n, Probe& probe) { InterferenceLoad(n, probe, false).Run(); }},
+        {"on-air-time", 1000000, &BenchOnAirTime},
+        {"frame-header-serialize", 1000000, &BenchFrameHeaderSerialize},
+        {"frame-header-deserialize", 1000000, &BenchFrameHeaderDeserialize},
+        {"insert-received-packet", 200000, &BenchInsertReceivedPacket},
+        {"adr-decision", 100000, &BenchAdrDecision},
+        {"tracker-phy", 100000, &BenchTrackerPhy},
+        {"tracker-mac", 100000, &BenchTrackerMac},
+    };
+
+    // Let the simulator allocate its state before measuring
+    Simulator::Now();
+    Probe::Calibrate();
+
+    std::vector<std::pair<std::string, Probe>> results;
+    for (const auto& benchmark : benchmarks)
+    {
+        if (benchmark.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        uint64_t n = std::max<uint64_t>(1, uint64_t(benchmark.operations * scale));
+
+        Probe fastest;
+        for (uint32_t run = 0; run < repetitions; run++)
+        {
+            Probe probe;
+            benchmark.run(n, probe);
+            Simulator::Destroy();
+            if (run == 0 || probe.GetNsPerOp() < fastest.GetNsPerOp())
+            {
+                fastest = probe;
+            }
+        }
+        results.emplace_back(benchmark.name, fastest);
+        NS_LOG_INFO("Ran " << benchmark.name);
+    }
+
+    std::ofstream file;
+    if (!outputFile.empty())
+    {
+        file.open(outputFile);
+        NS_ABORT_MSG_UNLESS(file.is_open(), "Can't open " << outputFile);
+    }
+    std::ostream& os = outputFile.empty() ? std::cout : file;
+
+    if (format == "csv")
+    {
+        os << "benchmark,operations,ns_per_op,allocations_per_op,bytes_per_op" << std::endl;
+        for (const auto& [name, probe] : results)
+        {
+            os << name << "," << probe.GetOperations() << "," << probe.GetNsPerOp() << ","
+               << probe.GetAllocationsPerOp() << "," << probe.GetBytesPerOp() << std::endl;
+        }
+    }
+    else if (format == "json")
+    {
+        os << "[" << std::endl;
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            const auto& [name, probe] = results[i];
+            os << "  {\"benchmark\": \"" << name << "\", \"operations\": " << probe.GetOperations()
+               << ", \"ns_per_op\": " << probe.GetNsPerOp()
+               << ", \"allocations_per_op\": " << probe.GetAllocationsPerOp()
+               << ", \"bytes_per_op\": " << probe.GetBytesPerOp() << "}"
+               << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        os << "]" << std::endl;
+    }
+    else
+    {
+        os << std::left << std::setw(26) << "Benchmark" << std::right << std::setw(12)
+           << "Operations" << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op"
+           << std::setw(12) << "bytes/op" << std::endl;
+        os << std::fixed << std::setprecision(1);
+        for (const auto& [name, probe] : results)
+        {
+            os << std::left << std::setw(26) << name << std::right << std::setw(12)
+               << probe.GetOperations() << std::setw(12) << probe.GetNsPerOp() << std::setw(12)
+               << probe.GetAllocationsPerOp() << std::setw(12) << probe.GetBytesPerOp()
+               << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program measures the cost of handling uplinks in the NetworkStatus of
+ * the network server as the number of registered devices grows. For each
+ * network size (10 times larger at each step, from 10000 devices up to
+ * maxDevices), a sequence of uplinks from random devices, one every 10 ms and
+ * each forwarded by a random number of gateways, is fed to
+ * NetworkStatus::OnReceivedPacket. Each gateway copy also performs the two
+ * device lookups done by the scheduler and the controller. The same lookups
+ * are then timed on a std::map keyed by device address, as NetworkStatus used
+ * to do, and on the EndDeviceStatusMap of the NetworkStatus.
+ */
+
+#include "ns3/abort.h"
+#include "ns3/class-a-end-device-lorawan-mac.h"
+#include "ns3/command-line.h"
+#include "ns3/log.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lora-tag.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/mac48-address.h"
+#include "ns3/network-status.h"
+#include "ns3/parsed-uplink.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("NetworkStatusBenchmark");
+
+/**
+ * An uplink of the synthetic sequence.
+ */
+struct Uplink
+{
+    Ptr<const ParsedUplink> uplink; //!< The decoded packet
+    uint32_t nGateways;             //!< The number of gateways forwarding the packet
+};
+
+/**
+ * Build a sequence of uplinks from random devices.
+ *
+ * \param nUplinks The number of uplinks.
+ * \param nDevices The number of devices, whose addresses are 0 to nDevices - 1.
+ * \param nGateways The maximum number of gateways forwarding each uplink.
+ * \return The uplinks.
+ */
+std::vector<Uplink>
+BuildUplinks(uint32_t nUplinks, uint32_t nDevices, uint32_t nGateways)
+{
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(1);
+
+    std::vector<Uplink> uplinks;
+    uplinks.reserve(nUplinks);
+    for (uint32_t i = 0; i < nUplinks; i++)
+    {
+        Ptr<Packet> packet = Create<Packet>(20);
+        LoraFrameHeader frameHdr;
+        frameHdr.SetAsUplink();
+        frameHdr.SetAddress(LoraDeviceAddress(uniform->GetInteger(0, nDevices - 1)));
+        frameHdr.SetFCnt(i);
+        packet->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        packet->AddHeader(macHdr);
+        LoraTag tag(7);
+        tag.SetFrequency(868.1);
+        tag.SetReceivePower(uniform->GetValue(-130, -90));
+        packet->AddPacketTag(tag);
+
+        uplinks.push_back({Create<ParsedUplink>(packet), uniform->GetInteger(1, nGateways)});
+    }
+    return uplinks;
+}
+
+/**
+ * Handle the gateway copies of an uplink, as the network server does.
+ *
+ * \param status The NetworkStatus under test.
+ * \param uplink The uplink.
+ * \param gwAddresses The addresses of the gateways.
+ * \param elapsed The wall-clock time taken so far, in seconds, updated by this function.
+ */
+void
+ProcessUplink(Ptr<NetworkStatus> status,
+              const Uplink* uplink,
+              const std::vector<Address>* gwAddresses,
+              double* elapsed)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t gw = 0; gw < uplink->nGateways; gw++)
+    {
+        status->GetEndDeviceStatus(uplink->uplink->GetAddress());
+        status->OnReceivedPacket(uplink->uplink, (*gwAddresses)[gw], gw);
+        status->GetEndDeviceStatus(uplink->uplink->GetAddress());
+    }
+    auto end = std::chrono::steady_clock::now();
+    *elapsed += std::chrono::duration<double>(end - begin).count();
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t nUplinks = 100000;
+    uint32_t nGateways = 4;
+    uint32_t maxDevices = 1000000;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nUplinks", "Number of uplinks to process for each network size", nUplinks);
+    cmd.AddValue("nGateways", "Maximum number of gateways forwarding each uplink", nGateways);
+    cmd.AddValue("maxDevices", "Number of devices of the largest network", maxDevices);
+    cmd.Parse(argc, argv);
+
+    // A single MAC layer is shared by all devices, since only their
+    // addresses matter here
+    Ptr<ClassAEndDeviceLorawanMac> edMac = CreateObject<ClassAEndDeviceLorawanMac>();
+
+    std::cout << "Devices\tNetworkStatus [ns/uplink]\tstd::map lookups [ns/uplink]\t"
+                 "EndDeviceStatusMap lookups [ns/uplink]"
+              << std::endl;
+
+    for (uint32_t nDevices = std::min(uint32_t(10000), maxDevices); nDevices <= maxDevices;
+         nDevices *= 10)
+    {
+        Ptr<NetworkStatus> status = CreateObject<NetworkStatus>();
+        std::map<LoraDeviceAddress, Ptr<EndDeviceStatus>> map;
+        for (uint32_t address = 0; address < nDevices; address++)
+        {
+            edMac->SetDeviceAddress(LoraDeviceAddress(address));
+            status->AddNode(edMac);
+            map.emplace(LoraDeviceAddress(address),
+                        status->GetEndDeviceStatus(LoraDeviceAddress(address)));
+        }
+
+        std::vector<Address> gwAddresses;
+        for (uint32_t gw = 0; gw < nGateways; gw++)
+        {
+            gwAddresses.push_back(Mac48Address::Allocate());
+            status->AddGateway(gwAddresses.back(),
+                               Create<GatewayStatus>(gwAddresses.back(), nullptr, nullptr));
+        }
+
+        std::vector<Uplink> uplinks = BuildUplinks(nUplinks, nDevices, nGateways);
+
+        // Full handling of each gateway copy by the NetworkStatus, spread over
+        // the simulated time so that deduplication entries expire
+        double statusTime = 0;
+        for (uint32_t i = 0; i < nUplinks; i++)
+        {
+            Simulator::Schedule(MilliSeconds(10 * i),
+                                &ProcessUplink,
+                                status,
+                                &uplinks[i],
+                                &gwAddresses,
+                                &statusTime);
+        }
+        Simulator::Run();
+        Simulator::Destroy();
+
+        // Device lookups only, three per gateway copy
+        std::size_t copies = 0;
+        std::size_t found = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (const auto& uplink : uplinks)
+        {
+            copies += uplink.nGateways;
+            for (uint32_t i = 0; i < 3 * uplink.nGateways; i++)
+            {
+                found += map.find(uplink.uplink->GetAddress()) != map.end();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        double mapTime = std::chrono::duration<double>(end - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        for (const auto& uplink : uplinks)
+        {
+            for (uint32_t i = 0; i < 3 * uplink.nGateways; i++)
+            {
+                found += bool(status->m_endDeviceStatuses.Find(uplink.uplink->GetAddress()));
+            }
+        }
+        end = std::chrono::steady_clock::now();
+        double registryTime = std::chrono::duration<double>(end - begin).count();
+
+        NS_ABORT_MSG_IF(found != 2 * 3 * copies, "Some devices were not found");
+        std::cout << nDevices << "\t" << statusTime / nUplinks * 1e9 << "\t"
+                  << mapTime / nUplinks * 1e9 << "\t" << registryTime / nUplinks * 1e9
+                  << std::endl;
+
+        if (nDevices == maxDevices)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2018 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program measures the memory and CPU cost of tracking PHY-layer uplink
+ * outcomes. A synthetic sequence of uplink packets, each heard by a random
+ * number of gateways, is fed to the trace sinks of:
+ * - a tracker storing packets in a std::map keyed by packet pointer, with a
+ *   std::map of outcomes per packet, as LoraPacketTracker used to do;
+ * - the LoraPacketTracker.
+ * Memory is measured by counting the bytes allocated through operator new in
+ * this program, so that it includes the packets kept alive by each tracker.
+ * Both trackers must give the same counts for every gateway.
+ */
+
+#include "allocation-counter.h"
+
+#include "ns3/command-line.h"
+#include "ns3/log.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lora-packet-tracker.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/simulator.h"
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("PacketTrackerBenchmark");
+
+/**
+ * A tracker keeping PHY-layer outcomes in maps keyed by packet pointer.
+ */
+struct MapPacketTracker
+{
+    /**
+     * The metrics of a packet.
+     */
+    struct Status
+    {
+        Ptr<const Packet> packet;                      //!< Packet being tracked
+        uint32_t senderId;                             //!< Node id of the packet sender
+        Time sendTime;                                 //!< Timestamp of pkt radio tx start
+        std::map<int, enum PhyPacketOutcome> outcomes; //!< Outcomes, by gateway id
+    };
+
+    /**
+     * \param packet The packet to be checked.
+     * \return True if the packet is uplink.
+     */
+    bool IsUplink(Ptr<const Packet> packet)
+    {
+        LorawanMacHeader mHdr;
+        Ptr<Packet> copy = packet->Copy();
+        copy->RemoveHeader(mHdr);
+        return mHdr.IsUplink();
+    }
+
+    /**
+     * Trace a packet TX start.
+     *
+     * \param packet The packet being transmitted.
+     * \param edId Id of end device transmitting the packet.
+     */
+    void TransmissionCallback(Ptr<const Packet> packet, uint32_t edId)
+    {
+        if (IsUplink(packet))
+        {
+            Status status;
+            status.packet = packet;
+            status.sendTime = Simulator::Now();
+            status.senderId = edId;
+            tracker.insert(std::pair<Ptr<const Packet>, Status>(packet, status));
+        }
+    }
+
+    /**
+     * Trace the outcome of a packet at a gateway.
+     *
+     * \param packet The packet being received.
+     * \param gwId Id of the gateway.
+     * \param outcome The outcome of the reception.
+     */
+    void OutcomeCallback(Ptr<const Packet> packet, uint32_t gwId, PhyPacketOutcome outcome)
+    {
+        if (IsUplink(packet))
+        {
+            auto it = tracker.find(packet);
+            (*it).second.outcomes.insert(std::pair<int, enum PhyPacketOutcome>(gwId, outcome));
+        }
+    }
+
+    /**
+     * \param gwId Node id of the gateway.
+     * \return The number of packets sent and the number of each outcome at the gateway.
+     */
+    std::vector<int> CountPhyPacketsPerGw(int gwId)
+    {
+        std::vector<int> packetCounts(6, 0);
+        for (const auto& entry : tracker)
+        {
+            packetCounts.at(0)++;
+            auto outcome = entry.second.outcomes.find(gwId);
+            if (outcome != entry.second.outcomes.end() && outcome->second != UNSET)
+            {
+                packetCounts.at(outcome->second + 1)++;
+            }
+        }
+        return packetCounts;
+    }
+
+    std::map<Ptr<const Packet>, Status> tracker; //!< Packet map of PHY layer metrics
+};
+
+/**
+ * Feed the sequence of uplinks to a tracker.
+ *
+ * \param tracker The tracker under test.
+ * \param outcome Function reporting an outcome to the tracker.
+ * \param nPackets The number of uplinks.
+ * \param nGateways The number of gateways.
+ * \param payloadSize The application payload size.
+ * \param bytes The number of bytes allocated by the tracker, filled by this function.
+ * \return The wall-clock time taken by the trace sinks, in seconds.
+ */
+template <typename Tracker, typename Outcome>
+double
+Feed(Tracker& tracker,
+     Outcome outcome,
+     uint32_t nPackets,
+     uint32_t nGateways,
+     uint32_t payloadSize,
+     std::size_t& bytes)
+{
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(1);
+
+    std::size_t before = g_liveBytes;
+    double elapsed = 0;
+    for (uint32_t i = 0; i < nPackets; i++)
+    {
+        Ptr<Packet> packet = Create<Packet>(payloadSize);
+        LoraFrameHeader frameHdr;
+        packet->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        packet->AddHeader(macHdr);
+
+        // Each packet reaches between one and all gateways
+        uint32_t nReceivers = uniform->GetInteger(1, nGateways);
+
+        auto begin = std::chrono::steady_clock::now();
+        tracker.TransmissionCallback(packet, i % 1000);
+        for (uint32_t gw = 0; gw < nReceivers; gw++)
+        {
+            outcome(packet, 1000 + gw, PhyPacketOutcome(gw % 5));
+        }
+        auto end = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration<double>(end - begin).count();
+    }
+    bytes = g_liveBytes - before;
+
+    return elapsed;
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t nPackets = 100000;
+    uint32_t nGateways = 4;
+    uint32_t payloadSize = 20;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nPackets", "Number of uplink packets to track", nPackets);
+    cmd.AddValue("nGateways", "Maximum number of gateways hearing each packet", nGateways);
+    cmd.AddValue("payloadSize", "Payload size of each packet, in bytes", payloadSize);
+    cmd.Parse(argc, argv);
+
+    // Let the simulator allocate its state before measuring
+    Simulator::Now();
+
+    std::size_t mapBytes = 0;
+    std::size_t trackerBytes = 0;
+
+    auto mapTracker = new MapPacketTracker;
+    double mapTime = Feed(
+        *mapTracker,
+        [mapTracker](Ptr<const Packet> packet, uint32_t gwId, PhyPacketOutcome outcome) {
+            mapTracker->OutcomeCallback(packet, gwId, outcome);
+        },
+        nPackets,
+        nGateways,
+        payloadSize,
+        mapBytes);
+
+    auto tracker = new LoraPacketTracker;
+    double trackerTime = Feed(
+        *tracker,
+        [tracker](Ptr<const Packet> packet, uint32_t gwId, PhyPacketOutcome outcome) {
+            switch (outcome)
+            {
+            case RECEIVED:
+                tracker->PacketReceptionCallback(packet, gwId);
+                break;
+            case INTERFERED:
+                tracker->InterferenceCallback(packet, gwId);
+                break;
+            case NO_MORE_RECEIVERS:
+                tracker->NoMoreReceiversCallback(packet, gwId);
+                break;
+            case UNDER_SENSITIVITY:
+                tracker->UnderSensitivityCallback(packet, gwId);
+                break;
+            default:
+                tracker->LostBecauseTxCallback(packet, gwId);
+                break;
+            }
+        },
+        nPackets,
+        nGateways,
+        payloadSize,
+        trackerBytes);
+
+    std::size_t mismatches = 0;
+    for (uint32_t gw = 0; gw < nGateways; gw++)
+    {
+        mismatches += mapTracker->CountPhyPacketsPerGw(1000 + gw) !=
+                      tracker->CountPhyPacketsPerGw(Seconds(0), Seconds(0), 1000 + gw);
+    }
+
+    std::cout << "Packets: " << nPackets << std::endl;
+    std::cout << "Map tracker: " << mapTime / nPackets * 1e9 << " ns/packet, "
+              << double(mapBytes) / nPackets << " bytes/packet" << std::endl;
+    std::cout << "LoraPacketTracker: " << trackerTime / nPackets * 1e9 << " ns/packet, "
+              << double(trackerBytes) / nPackets << " bytes/packet ("
+              << double(tracker->GetMemoryUsage()) / nPackets << " reported)" << std::endl;
+    std::cout << "Count mismatches: " << mismatches << std::endl;
+
+    delete mapTracker;
+    delete tracker;
+
+    return 0;
+}
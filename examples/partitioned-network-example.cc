@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This script simulates the scenario of complete-network-example, without
+ * buildings, over several processes. The deployment disc is split into
+ * vertical strips of equal width, one per MPI process, and each process
+ * simulates the end devices and gateways of its strip. Transmissions heard
+ * across the border of a strip are forwarded by a LoraChannelPartitionProxy.
+ * The network server is simulated by the first process.
+ *
+ * Run it with, for instance:
+ *   mpirun -np 4 ./ns3 run partitioned-network-example
+ *
+ * Each process prints the number of packets sent by its end devices and the
+ * number of packets received by its gateways. The first process then prints
+ * the packet delivery ratio of the whole network, measured at the network
+ * server, with its 95% confidence interval: running the script with a single
+ * process and with several ones, for the same RngRun, should give
+ * overlapping intervals.
+ */
+
+#include "ns3/boolean.h"
+#include "ns3/class-a-end-device-lorawan-mac.h"
+#include "ns3/command-line.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
+#include "ns3/forwarder-helper.h"
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/lora-channel-partition-proxy.h"
+#include "ns3/lora-helper.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/network-server-helper.h"
+#include "ns3/network-server.h"
+#include "ns3/node-container.h"
+#include "ns3/parsed-uplink.h"
+#include "ns3/periodic-sender-helper.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/position-allocator.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mpi.h>
+#include <set>
+#include <utility>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("PartitionedNetworkExample");
+
+// Network settings
+int nDevices = 2000;                //!< Number of end device nodes to create
+int nGateways = 4;                  //!< Number of gateway nodes to create
+double radiusMeters = 6400;         //!< Radius (m) of the deployment
+double simulationTimeSeconds = 600; //!< Scenario duration (s) in simulated time
+int appPeriodSeconds = 600;         //!< Duration (s) of the inter-transmission time of end devices
+
+// Local counters
+uint32_t g_sent = 0;     //!< Packets sent by the end devices of this process
+uint32_t g_received = 0; //!< Packets received by the gateways of this process
+
+/// Address and frame counter of the uplinks received by the network server
+std::set<std::pair<uint32_t, uint16_t>> g_serverUplinks;
+
+/**
+ * Count a packet sent by a local end device.
+ *
+ * \param packet The packet.
+ */
+void
+OnSent(Ptr<const Packet> packet)
+{
+    g_sent++;
+}
+
+/**
+ * Count a packet received by a local gateway.
+ *
+ * \param packet The packet.
+ * \param gwId The id of the gateway.
+ */
+void
+OnReceived(Ptr<const Packet> packet, uint32_t gwId)
+{
+    g_received++;
+}
+
+/**
+ * Record an uplink received by the network server, which gets one copy of it
+ * per gateway.
+ *
+ * \param packet The packet.
+ */
+void
+OnServerReceived(Ptr<const Packet> packet)
+{
+    Ptr<const ParsedUplink> uplink = Create<ParsedUplink>(packet);
+    g_serverUplinks.emplace(uplink->GetAddress().Get(), uplink->GetFrameHeader().GetFCnt());
+}
+
+/**
+ * Get the system id of the process simulating a position.
+ *
+ * \param position The position.
+ * \param nPartitions The number of processes.
+ * \return The system id of the strip containing the position.
+ */
+uint32_t
+GetPartition(Vector position, uint32_t nPartitions)
+{
+    double width = 2 * radiusMeters / nPartitions;
+    int strip = int((position.x + radiusMeters) / width);
+    return uint32_t(std::clamp(strip, 0, int(nPartitions) - 1));
+}
+
+int
+main(int argc, char* argv[])
+{
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nDevices", "Number of end devices to include in the simulation", nDevices);
+    cmd.AddValue("nGateways", "Number of gateways to include in the simulation", nGateways);
+    cmd.AddValue("radius", "The radius (m) of the area to simulate", radiusMeters);
+    cmd.AddValue("simulationTime", "The time (s) for which to simulate", simulationTimeSeconds);
+    cmd.AddValue("appPeriod",
+                 "The period in seconds to be used by periodically transmitting applications",
+                 appPeriodSeconds);
+    cmd.Parse(argc, argv);
+
+    // Use the granted time window distributed simulator
+    GlobalValue::Bind("SimulatorImplementationType",
+                      StringValue("ns3::DistributedSimulatorImpl"));
+    MpiInterface::Enable(&argc, &argv);
+
+    uint32_t systemId = MpiInterface::GetSystemId();
+    uint32_t nPartitions = MpiInterface::GetSize();
+
+    /************************
+     *  Create the channel  *
+     ************************/
+
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+
+    // The interference floor bounds the range of transmissions, so that the
+    // spatial index restricts forwarding to transmissions crossing a border
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+    channel->SetAttribute("InterferenceFloor", DoubleValue(-150));
+    channel->SetAttribute("SpatialIndex", BooleanValue(true));
+
+    /************************
+     *  Create the helpers  *
+     ************************/
+
+    LoraPhyHelper phyHelper = LoraPhyHelper();
+    phyHelper.SetChannel(channel);
+    LorawanMacHelper macHelper = LorawanMacHelper();
+    LoraHelper helper = LoraHelper();
+    NetworkServerHelper nsHelper = NetworkServerHelper();
+    ForwarderHelper forHelper = ForwarderHelper();
+
+    /******************
+     *  Create nodes  *
+     ******************/
+
+    // All processes draw the same positions, and assign each node to the
+    // process simulating its strip
+    Ptr<UniformDiscPositionAllocator> edAllocator = CreateObject<UniformDiscPositionAllocator>();
+    edAllocator->SetRho(radiusMeters);
+    edAllocator->AssignStreams(0);
+
+    NodeContainer endDevices;
+    NodeContainer localEndDevices;
+    for (int i = 0; i < nDevices; i++)
+    {
+        Vector position = edAllocator->GetNext();
+        position.z = 1.2;
+        Ptr<Node> node = CreateObject<Node>(GetPartition(position, nPartitions));
+        Ptr<ConstantPositionMobilityModel> mobility =
+            CreateObject<ConstantPositionMobilityModel>();
+        mobility->SetPosition(position);
+        node->AggregateObject(mobility);
+        endDevices.Add(node);
+        if (node->GetSystemId() == systemId)
+        {
+            localEndDevices.Add(node);
+        }
+    }
+
+    // Gateways are evenly spaced along the x axis
+    NodeContainer gateways;
+    NodeContainer localGateways;
+    for (int i = 0; i < nGateways; i++)
+    {
+        Vector position(-radiusMeters + (2 * i + 1) * radiusMeters / nGateways, 0, 15);
+        Ptr<Node> node = CreateObject<Node>(GetPartition(position, nPartitions));
+        Ptr<ConstantPositionMobilityModel> mobility =
+            CreateObject<ConstantPositionMobilityModel>();
+        mobility->SetPosition(position);
+        node->AggregateObject(mobility);
+        gateways.Add(node);
+        if (node->GetSystemId() == systemId)
+        {
+            localGateways.Add(node);
+        }
+    }
+
+    // Create the LoraNetDevices of all nodes, so that each process knows
+    // which PHYs are simulated by the others
+    Ptr<LoraDeviceAddressGenerator> addrGen = CreateObject<LoraDeviceAddressGenerator>(54, 1864);
+    macHelper.SetAddressGenerator(addrGen);
+    phyHelper.SetDeviceType(LoraPhyHelper::ED);
+    macHelper.SetDeviceType(LorawanMacHelper::ED_A);
+    helper.Install(phyHelper, macHelper, endDevices);
+
+    phyHelper.SetDeviceType(LoraPhyHelper::GW);
+    macHelper.SetDeviceType(LorawanMacHelper::GW);
+    helper.Install(phyHelper, macHelper, gateways);
+
+    LorawanMacHelper::SetSpreadingFactorsUp(endDevices, gateways, channel);
+
+    // Forward transmissions across the borders of the strips
+    Ptr<LoraChannelPartitionProxy> proxy = CreateObject<LoraChannelPartitionProxy>();
+    proxy->Install(channel);
+
+    /**************************
+     *  Create network server  *
+     ***************************/
+
+    // The network server is simulated by the first process, and reaches the
+    // gateways of the other processes through remote point to point links
+    Ptr<Node> networkServer = CreateObject<Node>(0);
+
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
+    p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+    P2PGwRegistration_t gwRegistration;
+    for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
+    {
+        auto container = p2p.Install(networkServer, *gw);
+        auto serverP2PNetDev = DynamicCast<PointToPointNetDevice>(container.Get(0));
+        gwRegistration.emplace_back(serverP2PNetDev, *gw);
+    }
+
+    /**********************************************
+     *  Install applications on the local nodes  *
+     **********************************************/
+
+    Time appStopTime = Seconds(simulationTimeSeconds);
+    PeriodicSenderHelper appHelper = PeriodicSenderHelper();
+    appHelper.SetPeriod(Seconds(appPeriodSeconds));
+    appHelper.SetPacketSize(23);
+    ApplicationContainer appContainer = appHelper.Install(localEndDevices);
+    appContainer.Start(Seconds(0));
+    appContainer.Stop(appStopTime);
+
+    if (systemId == 0)
+    {
+        nsHelper.SetGatewaysP2P(gwRegistration);
+        nsHelper.SetEndDevices(endDevices);
+        nsHelper.Install(networkServer);
+        networkServer->GetApplication(0)->TraceConnectWithoutContext(
+            "ReceivedPacket",
+            MakeCallback(&OnServerReceived));
+    }
+
+    forHelper.Install(localGateways);
+
+    // Count the local traffic
+    for (auto ed = localEndDevices.Begin(); ed != localEndDevices.End(); ++ed)
+    {
+        Ptr<LoraNetDevice> device = (*ed)->GetDevice(0)->GetObject<LoraNetDevice>();
+        device->GetMac()->TraceConnectWithoutContext("SentNewPacket", MakeCallback(&OnSent));
+    }
+    for (auto gw = localGateways.Begin(); gw != localGateways.End(); ++gw)
+    {
+        Ptr<LoraNetDevice> device = (*gw)->GetDevice(0)->GetObject<LoraNetDevice>();
+        device->GetPhy()->TraceConnectWithoutContext("ReceivedPacket",
+                                                     MakeCallback(&OnReceived));
+    }
+
+    ////////////////
+    // Simulation //
+    ////////////////
+
+    Simulator::Stop(appStopTime + Hours(1));
+
+    NS_LOG_INFO("Running simulation...");
+    Simulator::Run();
+
+    std::cout << "System " << systemId << ": " << localEndDevices.GetN() << " end devices, "
+              << localGateways.GetN() << " gateways, " << g_sent << " packets sent, "
+              << g_received << " gateway receptions" << std::endl;
+
+    // Sum the packets sent by all processes, and compare them to the uplinks
+    // received by the network server of the first one
+    uint32_t totalSent = 0;
+    MPI_Reduce(&g_sent, &totalSent, 1, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (systemId == 0)
+    {
+        double pdr = totalSent ? double(g_serverUplinks.size()) / totalSent : 0;
+        double halfWidth = totalSent ? 1.96 * std::sqrt(pdr * (1 - pdr) / totalSent) : 0;
+        std::cout << nPartitions << " processes: " << totalSent << " packets sent, "
+                  << g_serverUplinks.size() << " received by the network server (PDR " << pdr
+                  << ", 95% CI [" << pdr - halfWidth << ", " << pdr + halfWidth << "])"
+                  << std::endl;
+    }
+
+    Simulator::Destroy();
+
+    MpiInterface::Disable();
+
+    return 0;
+}
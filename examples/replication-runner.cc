@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program runs independent replications of a simulation program over a
+ * grid of parameters, using all the cores of the machine, and merges their
+ * metrics into a single file with confidence intervals.
+ *
+ * The grid is given as a list of parameters separated by semicolons, each with
+ * a list of values separated by commas, for instance:
+ *   --program=build/contrib/lorawan/examples/ns3-dev-aloha-throughput-default
+ *   --grid="nDevices=500,1000;radius=0,7500" --runs=10
+ * Each combination of values is run with RngRun values from firstRun to
+ * firstRun + runs - 1, and with a --metricsFile argument: the program must
+ * write its metrics to that file as "name value" lines, which
+ * LoraPacketTracker::PrintMetrics does (see aloha-throughput and
+ * complete-network-example).
+ *
+ * Each run is executed in its own directory under outputDir, which holds its
+ * standard output and error (output.log), any file it writes to its working
+ * directory, and its metrics (metrics.txt), which are only moved in place once
+ * the run has completed. Runs whose metrics are already present are not
+ * executed again, so that an interrupted campaign can be resumed, or extended
+ * with more runs or parameter values. Once all runs are done, the mean,
+ * standard deviation and 95% confidence interval half-width of each metric,
+ * over all the runs of each combination, are written to outputDir/results.csv.
+ */
+
+#include "ns3/abort.h"
+#include "ns3/command-line.h"
+#include "ns3/log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("ReplicationRunner");
+
+/**
+ * A parameter of the grid.
+ */
+struct Parameter
+{
+    std::string name;                //!< The name of the command line argument
+    std::vector<std::string> values; //!< The values to try
+};
+
+/**
+ * A point of the grid, as (name, value) pairs.
+ */
+typedef std::vector<std::pair<std::string, std::string>> Point;
+
+/**
+ * A replication of a point of the grid.
+ */
+struct Job
+{
+    std::size_t point; //!< The index of the point
+    uint32_t run;      //!< The RngRun value
+    std::string dir;   //!< The working directory of the run
+};
+
+/**
+ * Split a string.
+ *
+ * \param text The string.
+ * \param separator The separator.
+ * \return The parts of the string, without empty ones.
+ */
+std::vector<std::string>
+Split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::istringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator))
+    {
+        if (!part.empty())
+        {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+/**
+ * Parse a parameter grid of the form "a=1,2;b=x,y".
+ *
+ * \param grid The grid description.
+ * \return The parameters.
+ */
+std::vector<Parameter>
+ParseGrid(const std::string& grid)
+{
+    std::vector<Parameter> parameters;
+    for (const auto& entry : Split(grid, ';'))
+    {
+        std::size_t equal = entry.find('=');
+        NS_ABORT_MSG_IF(equal == std::string::npos || equal == 0,
+                        "Invalid grid entry \"" << entry << "\"");
+        Parameter parameter;
+        parameter.name = entry.substr(0, equal);
+        parameter.values = Split(entry.substr(equal + 1), ',');
+        NS_ABORT_MSG_IF(parameter.values.empty(), "No values for " << parameter.name);
+        parameters.push_back(parameter);
+    }
+    return parameters;
+}
+
+/**
+ * Compute the points of a grid, the last parameter varying fastest.
+ *
+ * \param parameters The parameters of the grid.
+ * \return The points.
+ */
+std::vector<Point>
+ExpandGrid(const std::vector<Parameter>& parameters)
+{
+    std::vector<Point> points = {Point()};
+    for (const auto& parameter : parameters)
+    {
+        std::vector<Point> expanded;
+        for (const auto& point : points)
+        {
+            for (const auto& value : parameter.values)
+            {
+                expanded.push_back(point);
+                expanded.back().emplace_back(parameter.name, value);
+            }
+        }
+        points = expanded;
+    }
+    return points;
+}
+
+/**
+ * Get the name of the directory of a run.
+ *
+ * \param point The point of the grid.
+ * \param run The RngRun value.
+ * \return A name made of the parameter values and of the run.
+ */
+std::string
+GetRunName(const Point& point, uint32_t run)
+{
+    std::string name;
+    for (const auto& parameter : point)
+    {
+        name += parameter.first + "-" + parameter.second + "_";
+    }
+    name += "run-" + std::to_string(run);
+    // Keep the name usable as a directory name
+    for (auto& c : name)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.')
+        {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+/**
+ * Create a directory, if it doesn't exist.
+ *
+ * \param path The path of the directory.
+ */
+void
+MakeDirectory(const std::string& path)
+{
+    NS_ABORT_MSG_IF(mkdir(path.c_str(), 0755) != 0 && errno != EEXIST,
+                    "Cannot create directory " << path);
+}
+
+/**
+ * Check whether a file exists.
+ *
+ * \param path The path of the file.
+ * \return True if it exists.
+ */
+bool
+FileExists(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+/**
+ * Start a run in a child process.
+ *
+ * \param program The absolute path of the simulation program.
+ * \param point The point of the grid.
+ * \param job The run.
+ * \return The process id of the child.
+ */
+pid_t
+Spawn(const std::string& program, const Point& point, const Job& job)
+{
+    std::vector<std::string> args = {program};
+    for (const auto& parameter : point)
+    {
+        args.push_back("--" + parameter.first + "=" + parameter.second);
+    }
+    args.push_back("--RngRun=" + std::to_string(job.run));
+    args.push_back("--metricsFile=metrics.partial");
+    std::vector<char*> argv;
+    for (auto& arg : args)
+    {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "Cannot create a process");
+    if (pid == 0)
+    {
+        // Run the program in its directory, with its output in the log
+        if (chdir(job.dir.c_str()) != 0)
+        {
+            _exit(127);
+        }
+        int log = open("output.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log < 0)
+        {
+            _exit(127);
+        }
+        dup2(log, STDOUT_FILENO);
+        dup2(log, STDERR_FILENO);
+        close(log);
+        execv(program.c_str(), argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * Get the 0.975 quantile of the Student's t distribution, which gives the
+ * half-width of two-sided 95% confidence intervals.
+ *
+ * \param dof The degrees of freedom.
+ * \return The quantile.
+ */
+double
+GetStudentQuantile(uint32_t dof)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                   2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                   2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                   2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+    if (dof <= 30)
+    {
+        return table[dof - 1];
+    }
+    // Cornish-Fisher expansion around the normal quantile
+    double z = 1.959964;
+    return z + (std::pow(z, 3) + z) / (4 * dof) +
+           (5 * std::pow(z, 5) + 16 * std::pow(z, 3) + 3 * z) / (96 * std::pow(dof, 2));
+}
+
+/**
+ * Read the metrics of a run.
+ *
+ * \param path The path of the metrics file.
+ * \param names The names of the metrics, in order of appearance, updated by this function.
+ * \param samples The samples of each metric, updated by this function.
+ */
+void
+ReadMetrics(const std::string& path,
+            std::vector<std::string>& names,
+            std::map<std::string, std::vector<double>>& samples)
+{
+    std::ifstream file(path);
+    std::string name;
+    double value;
+    while (file >> name >> value)
+    {
+        if (samples.find(name) == samples.end())
+        {
+            names.push_back(name);
+        }
+        samples[name].push_back(value);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string program = "";
+    std::string grid = "";
+    uint32_t runs = 10;
+    uint32_t firstRun = 1;
+    uint32_t nJobs = std::max(1U, std::thread::hardware_concurrency());
+    std::string outputDir = "replications";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("program", "Path of the simulation program to run", program);
+    cmd.AddValue("grid", "Parameter grid, as \"name=value,value;name=value\"", grid);
+    cmd.AddValue("runs", "Number of replications of each point of the grid", runs);
+    cmd.AddValue("firstRun", "RngRun value of the first replication", firstRun);
+    cmd.AddValue("jobs", "Number of replications to run in parallel", nJobs);
+    cmd.AddValue("outputDir", "Directory where runs and results are stored", outputDir);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(program.empty(), "No program given");
+    NS_ABORT_MSG_IF(runs == 0 || nJobs == 0, "At least one run and one job are needed");
+
+    // Runs are executed in their own directories
+    char resolved[PATH_MAX];
+    NS_ABORT_MSG_IF(!realpath(program.c_str(), resolved), "Cannot find " << program);
+    program = resolved;
+
+    std::vector<Parameter> parameters = ParseGrid(grid);
+    std::vector<Point> points = ExpandGrid(parameters);
+
+    // List the runs that are not done yet
+    MakeDirectory(outputDir);
+    std::vector<Job> jobs;
+    std::size_t nDone = 0;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        for (uint32_t run = firstRun; run < firstRun + runs; run++)
+        {
+            Job job = {i, run, outputDir + "/" + GetRunName(points[i], run)};
+            if (FileExists(job.dir + "/metrics.txt"))
+            {
+                nDone++;
+                continue;
+            }
+            MakeDirectory(job.dir);
+            jobs.push_back(job);
+        }
+    }
+    std::cout << points.size() << " points, " << points.size() * runs << " runs, " << nDone
+              << " already done" << std::endl;
+
+    // Keep nJobs runs going until all are done
+    std::map<pid_t, Job> running;
+    std::size_t next = 0;
+    std::size_t nFailed = 0;
+    while (next < jobs.size() || !running.empty())
+    {
+        while (running.size() < nJobs && next < jobs.size())
+        {
+            const Job& job = jobs[next++];
+            running.emplace(Spawn(program, points[job.point], job), job);
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        NS_ABORT_MSG_IF(pid < 0, "Cannot wait for the runs");
+        auto it = running.find(pid);
+        if (it == running.end())
+        {
+            continue;
+        }
+        const Job& job = it->second;
+        bool success = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                       std::rename((job.dir + "/metrics.partial").c_str(),
+                                   (job.dir + "/metrics.txt").c_str()) == 0;
+        if (success)
+        {
+            nDone++;
+            std::cout << "[" << nDone << "/" << points.size() * runs << "] " << job.dir
+                      << std::endl;
+        }
+        else
+        {
+            nFailed++;
+            std::cerr << "Run failed, see " << job.dir << "/output.log" << std::endl;
+        }
+        running.erase(it);
+    }
+
+    // Merge the metrics of all the runs of each point
+    std::ofstream results(outputDir + "/results.csv");
+    results.precision(10);
+    for (const auto& parameter : parameters)
+    {
+        results << parameter.name << ",";
+    }
+    results << "metric,runs,mean,stddev,ci95" << std::endl;
+    for (const auto& point : points)
+    {
+        std::vector<std::string> names;
+        std::map<std::string, std::vector<double>> samples;
+        for (uint32_t run = firstRun; run < firstRun + runs; run++)
+        {
+            ReadMetrics(outputDir + "/" + GetRunName(point, run) + "/metrics.txt", names, samples);
+        }
+
+        for (const auto& name : names)
+        {
+            const std::vector<double>& values = samples[name];
+            std::size_t n = values.size();
+            double mean = 0;
+            for (double value : values)
+            {
+                mean += value;
+            }
+            mean /= n;
+            double variance = 0;
+            for (double value : values)
+            {
+                variance += (value - mean) * (value - mean);
+            }
+            double stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0;
+            double ci = n > 1 ? GetStudentQuantile(n - 1) * stddev / std::sqrt(n) : std::nan("");
+
+            for (const auto& parameter : point)
+            {
+                results << parameter.second << ",";
+            }
+            results << name << "," << n << "," << mean << "," << stddev << "," << ci << std::endl;
+        }
+    }
+    std::cout << "Results written to " << outputDir << "/results.csv" << std::endl;
+
+    return nFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,535 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * This program measures how the cost of a complete simulation grows with the
+ * number of end devices. For each size in nDevices, it builds the deployment
+ * of complete-network-example (end devices on a disc around a single gateway,
+ * sending a packet every appPeriod, with packet tracking enabled) without its
+ * buildings and correlated shadowing, so that the cost measured is the one of
+ * the module, on a log-distance channel. The channel uses the listening
+ * fan-out, the spatial index and an interference floor of -150 dBm by
+ * default, which can each be changed through the listeningFanOut,
+ * spatialIndex and interferenceFloor parameters. It simulates the scenario
+ * for simulationTime, and reports, along with the channel settings:
+ * - the wall-clock time and the growth of the resident set size of each phase:
+ *   topology (nodes, mobility and applications), lora-install
+ *   (LoraHelper::Install and the spreading factors), ns-install
+ *   (NetworkServerHelper::Install and the forwarders), run
+ *   (Simulator::Run) and report (the counts of the LoraPacketTracker);
+ * - the number of events processed by the simulator, and their rate;
+ * - the peak resident set size of the process;
+ * - the memory per end device, as the growth of the resident set size up to
+ *   the end of ns-install divided by the number of devices;
+ * - the memory per tracked packet, as reported by the LoraPacketTracker,
+ *   divided by the number of packets sent by the MAC layers.
+ * Each size is simulated in a child process, so that its peak memory is
+ * measured on its own, and with the same seed, unless RngSeed or RngRun are
+ * given. The results are printed as text, CSV or JSON.
+ */
+
+#include "ns3/abort.h"
+#include "ns3/boolean.h"
+#include "ns3/command-line.h"
+#include "ns3/double.h"
+#include "ns3/forwarder-helper.h"
+#include "ns3/log.h"
+#include "ns3/lora-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/network-server-helper.h"
+#include "ns3/node-container.h"
+#include "ns3/periodic-sender-helper.h"
+#include "ns3/point-to-point-helper.h"
+#include "ns3/position-allocator.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+using namespace lorawan;
+
+NS_LOG_COMPONENT_DEFINE("ScalabilityBenchmark");
+
+// Network settings
+double radiusMeters = 6400;          //!< Radius (m) of the deployment
+double simulationTimeSeconds = 3600; //!< Scenario duration (s) in simulated time
+int appPeriodSeconds = 600;          //!< Duration (s) of the inter-transmission time of end devices
+
+// Channel settings
+bool listeningFanOut = true;        //!< Whether to only deliver to listening PHYs
+bool spatialIndex = true;           //!< Whether to find the PHYs in range with a spatial index
+double interferenceFloorDbm = -150; //!< Power (dBm) below which transmissions are not delivered
+
+/**
+ * The cost of a phase of the simulation.
+ */
+struct Phase
+{
+    std::string name; //!< The name of the phase
+    double seconds;   //!< The wall-clock time taken by the phase
+    int64_t rssBytes; //!< The growth of the resident set size during the phase
+};
+
+/**
+ * The cost of the simulation of a size.
+ */
+struct Result
+{
+    uint32_t nDevices;         //!< The number of end devices
+    std::vector<Phase> phases; //!< The cost of each phase
+    uint64_t events;           //!< The number of events processed by the simulator
+    uint64_t peakRssBytes;     //!< The peak resident set size of the process
+    int64_t deviceBytes;       //!< The growth of the resident set size up to ns-install
+    uint64_t trackedPackets;   //!< The number of packets sent by the MAC layers
+    std::size_t trackerBytes;  //!< The memory used by the LoraPacketTracker
+};
+
+/**
+ * Get the resident set size of the process.
+ *
+ * \return The resident set size, in bytes, or 0 if it is not available.
+ */
+int64_t
+GetRss()
+{
+    // Only available on Linux
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0;
+    int64_t resident = 0;
+    if (statm >> size >> resident)
+    {
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+    return 0;
+}
+
+/**
+ * Get the peak resident set size of the process.
+ *
+ * \return The peak resident set size, in bytes.
+ */
+uint64_t
+GetPeakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/**
+ * Measures the phases of a simulation.
+ */
+class PhaseTimer
+{
+  public:
+    /**
+     * End the current phase, if any, and start a new one.
+     *
+     * \param name The name of the new phase.
+     */
+    void Begin(std::string name)
+    {
+        End();
+        m_name = name;
+        m_rss = GetRss();
+        m_begin = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * End the current phase, if any.
+     */
+    void End()
+    {
+        if (!m_name.empty())
+        {
+            auto end = std::chrono::steady_clock::now();
+            m_phases.push_back({m_name,
+                                std::chrono::duration<double>(end - m_begin).count(),
+                                GetRss() - m_rss});
+            m_name.clear();
+        }
+    }
+
+    /**
+     * \return The phases measured so far.
+     */
+    const std::vector<Phase>& GetPhases() const
+    {
+        return m_phases;
+    }
+
+  private:
+    std::string m_name;                            //!< The name of the current phase
+    std::chrono::steady_clock::time_point m_begin; //!< The start of the current phase
+    int64_t m_rss = 0;                             //!< The resident set size at its start
+    std::vector<Phase> m_phases;                   //!< The phases measured so far
+};
+
+/**
+ * Build and simulate the scenario with a number of end devices.
+ *
+ * \param nDevices The number of end devices.
+ * \return The cost of the simulation.
+ */
+Result
+Simulate(uint32_t nDevices)
+{
+    Result result;
+    result.nDevices = nDevices;
+    int64_t initialRss = GetRss();
+    PhaseTimer timer;
+
+    /**************
+     *  Topology  *
+     **************/
+
+    timer.Begin("topology");
+
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+    channel->SetAttribute("ListeningFanOut", BooleanValue(listeningFanOut));
+    channel->SetAttribute("SpatialIndex", BooleanValue(spatialIndex));
+    channel->SetAttribute("InterferenceFloor", DoubleValue(interferenceFloorDbm));
+
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator("ns3::UniformDiscPositionAllocator",
+                                  "rho",
+                                  DoubleValue(radiusMeters),
+                                  "Z",
+                                  DoubleValue(1.2));
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+
+    NodeContainer endDevices;
+    endDevices.Create(nDevices);
+    mobility.Install(endDevices);
+
+    NodeContainer gateways;
+    gateways.Create(1);
+    Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator>();
+    allocator->Add(Vector(0.0, 0.0, 15.0));
+    mobility.SetPositionAllocator(allocator);
+    mobility.Install(gateways);
+
+    Time appStopTime = Seconds(simulationTimeSeconds);
+    PeriodicSenderHelper appHelper = PeriodicSenderHelper();
+    appHelper.SetPeriod(Seconds(appPeriodSeconds));
+    appHelper.SetPacketSize(23);
+    ApplicationContainer appContainer = appHelper.Install(endDevices);
+    appContainer.Start(Seconds(0));
+    appContainer.Stop(appStopTime);
+
+    /*****************************
+     *  LoraHelper installation  *
+     *****************************/
+
+    timer.Begin("lora-install");
+
+    LoraPhyHelper phyHelper = LoraPhyHelper();
+    phyHelper.SetChannel(channel);
+    LorawanMacHelper macHelper = LorawanMacHelper();
+    LoraHelper helper = LoraHelper();
+    helper.EnablePacketTracking();
+
+    Ptr<LoraDeviceAddressGenerator> addrGen = CreateObject<LoraDeviceAddressGenerator>(54, 1864);
+    macHelper.SetAddressGenerator(addrGen);
+    phyHelper.SetDeviceType(LoraPhyHelper::ED);
+    macHelper.SetDeviceType(LorawanMacHelper::ED_A);
+    helper.Install(phyHelper, macHelper, endDevices);
+
+    phyHelper.SetDeviceType(LoraPhyHelper::GW);
+    macHelper.SetDeviceType(LorawanMacHelper::GW);
+    helper.Install(phyHelper, macHelper, gateways);
+
+    LorawanMacHelper::SetSpreadingFactorsUp(endDevices, gateways, channel);
+
+    /*********************************
+     *  Network server installation  *
+     *********************************/
+
+    timer.Begin("ns-install");
+
+    Ptr<Node> networkServer = CreateObject<Node>();
+    PointToPointHelper p2p;
+    p2p.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
+    p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+    P2PGwRegistration_t gwRegistration;
+    for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
+    {
+        auto container = p2p.Install(networkServer, *gw);
+        auto serverP2PNetDev = DynamicCast<PointToPointNetDevice>(container.Get(0));
+        gwRegistration.emplace_back(serverP2PNetDev, *gw);
+    }
+    NetworkServerHelper nsHelper = NetworkServerHelper();
+    nsHelper.SetGatewaysP2P(gwRegistration);
+    nsHelper.SetEndDevices(endDevices);
+    nsHelper.Install(networkServer);
+    ForwarderHelper forHelper = ForwarderHelper();
+    forHelper.Install(gateways);
+
+    timer.End();
+    result.deviceBytes = GetRss() - initialRss;
+
+    ////////////////
+    // Simulation //
+    ////////////////
+
+    timer.Begin("run");
+
+    Simulator::Stop(appStopTime);
+    Simulator::Run();
+    result.events = Simulator::GetEventCount();
+
+    ///////////////
+    // Reporting //
+    ///////////////
+
+    timer.Begin("report");
+
+    LoraPacketTracker& tracker = helper.GetPacketTracker();
+    std::istringstream mac(tracker.CountMacPacketsGlobally(Seconds(0), appStopTime));
+    mac >> result.trackedPackets;
+    uint64_t sink = 0;
+    for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
+    {
+        sink += tracker.CountPhyPacketsPerGw(Seconds(0), appStopTime, (*gw)->GetId()).at(1);
+    }
+    result.trackerBytes = tracker.GetMemoryUsage();
+    NS_LOG_INFO(sink << " packets received by the gateways");
+
+    timer.End();
+    result.phases = timer.GetPhases();
+    result.peakRssBytes = GetPeakRss();
+
+    Simulator::Destroy();
+
+    return result;
+}
+
+/**
+ * Print the header of the results.
+ *
+ * \param format The output format.
+ */
+void
+PrintHeader(const std::string& format)
+{
+    if (format == "csv")
+    {
+        std::cout << "devices";
+        for (const auto& phase : {"topology", "lora-install", "ns-install", "run", "report"})
+        {
+            std::cout << "," << phase << "_seconds," << phase << "_rss_bytes";
+        }
+        std::cout << ",events,events_per_second,peak_rss_bytes,bytes_per_device,"
+                  << "tracked_packets,bytes_per_tracked_packet,listening_fan_out,spatial_index,"
+                  << "interference_floor_dbm" << std::endl;
+    }
+    else if (format == "json")
+    {
+        std::cout << "[" << std::endl;
+    }
+}
+
+/**
+ * Print the results of a size.
+ *
+ * \param format The output format.
+ * \param result The results.
+ * \param first Whether these are the first results printed.
+ */
+void
+PrintResult(const std::string& format, const Result& result, bool first)
+{
+    double runSeconds = 0;
+    double totalSeconds = 0;
+    for (const auto& phase : result.phases)
+    {
+        totalSeconds += phase.seconds;
+        runSeconds += phase.name == "run" ? phase.seconds : 0;
+    }
+    double eventsPerSecond = runSeconds > 0 ? result.events / runSeconds : 0;
+    double bytesPerDevice = double(result.deviceBytes) / result.nDevices;
+    double bytesPerPacket =
+        result.trackedPackets > 0 ? double(result.trackerBytes) / result.trackedPackets : 0;
+
+    if (format == "csv")
+    {
+        std::cout << result.nDevices;
+        for (const auto& phase : result.phases)
+        {
+            std::cout << "," << phase.seconds << "," << phase.rssBytes;
+        }
+        std::cout << "," << result.events << "," << eventsPerSecond << ","
+                  << result.peakRssBytes << "," << bytesPerDevice << ","
+                  << result.trackedPackets << "," << bytesPerPacket << "," << listeningFanOut
+                  << "," << spatialIndex << "," << interferenceFloorDbm << std::endl;
+    }
+    else if (format == "json")
+    {
+        std::cout << (first ? "" : ",\n") << "  {\"devices\": " << result.nDevices
+                  << ", \"phases\": {";
+        for (std::size_t i = 0; i < result.phases.size(); i++)
+        {
+            std::cout << (i > 0 ? ", " : "") << "\"" << result.phases[i].name
+                      << "\": {\"seconds\": " << result.phases[i].seconds
+                      << ", \"rss_bytes\": " << result.phases[i].rssBytes << "}";
+        }
+        std::cout << "}, \"events\": " << result.events
+                  << ", \"events_per_second\": " << eventsPerSecond
+                  << ", \"peak_rss_bytes\": " << result.peakRssBytes
+                  << ", \"bytes_per_device\": " << bytesPerDevice
+                  << ", \"tracked_packets\": " << result.trackedPackets
+                  << ", \"bytes_per_tracked_packet\": " << bytesPerPacket
+                  << ", \"listening_fan_out\": " << (listeningFanOut ? "true" : "false")
+                  << ", \"spatial_index\": " << (spatialIndex ? "true" : "false")
+                  << ", \"interference_floor_dbm\": " << interferenceFloorDbm << "}";
+    }
+    else
+    {
+        std::cout << "Devices: " << result.nDevices << std::endl;
+        std::cout << "  Channel: listening fan-out " << (listeningFanOut ? "on" : "off")
+                  << ", spatial index " << (spatialIndex ? "on" : "off")
+                  << ", interference floor " << interferenceFloorDbm << " dBm" << std::endl;
+        std::cout << std::left << std::setw(16) << "  Phase" << std::right << std::setw(12)
+                  << "Wall (s)" << std::setw(14) << "RSS (MB)" << std::endl;
+        std::cout << std::fixed << std::setprecision(3);
+        for (const auto& phase : result.phases)
+        {
+            std::cout << std::left << std::setw(16) << "  " + phase.name << std::right
+                      << std::setw(12) << phase.seconds << std::setw(14)
+                      << phase.rssBytes / 1e6 << std::endl;
+        }
+        std::cout << std::left << std::setw(16) << "  total" << std::right << std::setw(12)
+                  << totalSeconds << std::endl;
+        std::cout << std::defaultfloat;
+        std::cout << "  Events: " << result.events << " (" << eventsPerSecond
+                  << " events/s)" << std::endl;
+        std::cout << "  Peak RSS: " << result.peakRssBytes / 1e6 << " MB" << std::endl;
+        std::cout << "  Memory per device: " << bytesPerDevice << " bytes" << std::endl;
+        std::cout << "  Memory per tracked packet: " << bytesPerPacket << " bytes ("
+                  << result.trackedPackets << " packets)" << std::endl;
+    }
+    std::cout.flush();
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string sizes = "1000,10000,100000,1000000";
+    std::string format = "text";
+
+    // Every size is simulated with the same seed, unless told otherwise
+    RngSeedManager::SetSeed(1);
+    RngSeedManager::SetRun(1);
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("nDevices", "Comma-separated numbers of end devices to simulate", sizes);
+    cmd.AddValue("radius", "The radius (m) of the area to simulate", radiusMeters);
+    cmd.AddValue("simulationTime", "The time (s) for which to simulate", simulationTimeSeconds);
+    cmd.AddValue("appPeriod",
+                 "The period in seconds to be used by periodically transmitting applications",
+                 appPeriodSeconds);
+    cmd.AddValue("listeningFanOut",
+                 "Whether the channel only delivers transmissions to listening PHYs",
+                 listeningFanOut);
+    cmd.AddValue("spatialIndex",
+                 "Whether the channel finds the PHYs in range with a spatial index",
+                 spatialIndex);
+    cmd.AddValue("interferenceFloor",
+                 "The power (dBm) below which the channel doesn't deliver transmissions",
+                 interferenceFloorDbm);
+    cmd.AddValue("format", "Output format: text, csv or json", format);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_UNLESS(format == "text" || format == "csv" || format == "json",
+                        "Unknown output format " << format);
+
+    std::vector<uint32_t> nDevices;
+    std::istringstream list(sizes);
+    std::string size;
+    while (std::getline(list, size, ','))
+    {
+        nDevices.push_back(std::stoul(size));
+        NS_ABORT_MSG_IF(nDevices.back() == 0, "The number of end devices must be positive");
+    }
+
+    PrintHeader(format);
+
+    // A single size is simulated in this process, which eases profiling
+    if (nDevices.size() == 1)
+    {
+        PrintResult(format, Simulate(nDevices[0]), true);
+    }
+    else
+    {
+        bool first = true;
+        for (std::size_t i = 0; i < nDevices.size(); i++)
+        {
+            // Don't let the child flush what the parent buffered
+            std::cout.flush();
+            std::fflush(nullptr);
+
+            pid_t pid = fork();
+            NS_ABORT_MSG_IF(pid < 0, "Can't fork");
+            if (pid == 0)
+            {
+                PrintResult(format, Simulate(nDevices[i]), first);
+                std::exit(0);
+            }
+
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                std::cerr << "The simulation of " << nDevices[i] << " devices failed"
+                          << std::endl;
+            }
+            else
+            {
+                first = false;
+            }
+        }
+    }
+
+    if (format == "json")
+    {
+        std::cout << std::endl << "]" << std::endl;
+    }
+
+    return 0;
+}
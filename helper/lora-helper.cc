@@ -239,6 +239,7 @@ LoraHelper::EnablePeriodicPhyPerformancePrinting(NodeContainer gateways,
 {
     NS_LOG_FUNCTION(this);
 
+    EnableAggregation(interval);
     DoPrintPhyPerformance(gateways, filename);
 
     Simulator::Schedule(interval,
@@ -287,6 +288,7 @@ LoraHelper::EnablePeriodicGlobalPerformancePrinting(std::string filename, Time i
 {
     NS_LOG_FUNCTION(this << filename << interval);
 
+    EnableAggregation(interval);
     DoPrintGlobalPerformance(filename);
 
     Simulator::Schedule(interval,
@@ -324,6 +326,19 @@ LoraHelper::DoPrintGlobalPerformance(std::string filename)
     outputFile.close();
 }
 
+void
+LoraHelper::EnableAggregation(Time interval)
+{
+    NS_LOG_FUNCTION(this << interval);
+
+    // Let the tracker count the packets of each interval as they are traced,
+    // instead of going through all of its records at every print
+    if (!m_packetTracker->IsAggregationEnabled())
+    {
+        m_packetTracker->EnableAggregation(interval);
+    }
+}
+
 void
 LoraHelper::DoPrintSimulationTime(Time interval)
 {
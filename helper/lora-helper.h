@@ -110,7 +110,8 @@ class LoraHelper
      * Periodically prints PHY-level performance at every gateway in the container.
      *
      * For each input gateway print counters for totPacketsSent, receivedPackets, interferedPackets,
-     * noMoreGwPackets, underSensitivityPackets and lostBecauseTxPackets.
+     * noMoreGwPackets, underSensitivityPackets and lostBecauseTxPackets. Unless it was already
+     * enabled, the packet tracker aggregates counts over the printing interval.
      *
      * \param gateways The gateways to track.
      * \param filename The output filename.
@@ -134,7 +135,8 @@ class LoraHelper
 
     /**
      * Periodically print global performance as the total number of send and received
-     * packets.
+     * packets. Unless it was already enabled, the packet tracker aggregates counts over the
+     * printing interval.
      *
      * \param filename The output filename.
      * \param interval The time interval for printing.
@@ -175,6 +177,14 @@ class LoraHelper
                              std::string filename);
 
   private:
+    /**
+     * Make the packet tracker count packets per interval as they are traced,
+     * unless it already does.
+     *
+     * \param interval The printing interval, used as the bucket size.
+     */
+    void EnableAggregation(Time interval);
+
     /**
      * Actually print the simulation time and re-schedule execution of this
      * function.
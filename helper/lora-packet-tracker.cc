@@ -23,8 +23,10 @@
 #include "ns3/lorawan-mac-header.h"
 #include "ns3/simulator.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 
 namespace ns3
 {
@@ -32,7 +34,52 @@ namespace lorawan
 {
 NS_LOG_COMPONENT_DEFINE("LoraPacketTracker");
 
+void
+BucketCounters::Add(int64_t bucket)
+{
+    NS_ASSERT(bucket >= 0);
+
+    if (bucket >= int64_t(m_totals.size()))
+    {
+        m_totals.resize(bucket + 1, m_totals.empty() ? 0 : m_totals.back());
+    }
+    for (auto i = std::size_t(bucket); i < m_totals.size(); i++)
+    {
+        m_totals[i]++;
+    }
+}
+
+int64_t
+BucketCounters::Count(int64_t first, int64_t last) const
+{
+    if (last <= first)
+    {
+        return 0;
+    }
+    return GetTotal(last - 1) - GetTotal(first - 1);
+}
+
+std::size_t
+BucketCounters::GetMemoryUsage() const
+{
+    return m_totals.capacity() * sizeof(int64_t);
+}
+
+int64_t
+BucketCounters::GetTotal(int64_t bucket) const
+{
+    if (bucket < 0 || m_totals.empty())
+    {
+        return 0;
+    }
+    return m_totals[std::min(std::size_t(bucket), m_totals.size() - 1)];
+}
+
 LoraPacketTracker::LoraPacketTracker()
+    : m_bucketSize(Seconds(0)),
+      m_aggregationStart(Seconds(0)),
+      m_retainPackets(true),
+      m_recordLifetime(Minutes(1))
 {
     NS_LOG_FUNCTION(this);
 }
@@ -42,6 +89,25 @@ LoraPacketTracker::~LoraPacketTracker()
     NS_LOG_FUNCTION(this);
 }
 
+void
+LoraPacketTracker::EnableAggregation(Time bucketSize, bool retainPackets, Time recordLifetime)
+{
+    NS_LOG_FUNCTION(this << bucketSize << retainPackets << recordLifetime);
+    NS_ABORT_MSG_UNLESS(bucketSize.IsStrictlyPositive(), "The bucket size must be positive");
+    NS_ABORT_MSG_IF(IsAggregationEnabled(), "Aggregation is already enabled");
+
+    m_bucketSize = bucketSize;
+    m_aggregationStart = Simulator::Now();
+    m_retainPackets = retainPackets;
+    m_recordLifetime = recordLifetime;
+}
+
+bool
+LoraPacketTracker::IsAggregationEnabled() const
+{
+    return m_bucketSize.IsStrictlyPositive();
+}
+
 /////////////////
 // MAC metrics //
 /////////////////
@@ -53,13 +119,25 @@ LoraPacketTracker::MacTransmissionCallback(Ptr<const Packet> packet)
     {
         NS_LOG_INFO("A new packet was sent by the MAC layer");
 
-        MacPacketStatus status;
-        status.packet = packet;
-        status.sendTime = Simulator::Now();
-        status.senderId = Simulator::GetContext();
-        status.receivedTime = Time::Max();
+        DropOldRecords();
 
-        m_macPacketTracker.insert(std::pair<Ptr<const Packet>, MacPacketStatus>(packet, status));
+        auto entry = m_macPacketTracker.Insert(packet->GetUid());
+        if (entry.second)
+        {
+            MacPacketStatus& status = *entry.first;
+            status.sendTime = Simulator::Now();
+            status.senderId = Simulator::GetContext();
+            status.receivedTime = Time::Max();
+
+            if (!m_retainPackets)
+            {
+                m_macRecordTimes.emplace_back(status.sendTime, packet->GetUid());
+            }
+            if (m_bucketSize.IsStrictlyPositive())
+            {
+                m_macSent.Add(GetBucket(status.sendTime));
+            }
+        }
     }
 }
 
@@ -73,13 +151,29 @@ LoraPacketTracker::RequiredTransmissionsCallback(uint8_t reqTx,
     NS_LOG_DEBUG("Packet: " << packet << "ReqTx " << unsigned(reqTx) << ", succ: " << success
                             << ", firstAttempt: " << firstAttempt.GetSeconds());
 
-    RetransmissionStatus entry;
-    entry.firstAttempt = firstAttempt;
-    entry.finishTime = Simulator::Now();
-    entry.reTxAttempts = reqTx;
-    entry.successful = success;
+    if (m_retainPackets)
+    {
+        auto entry = m_reTransmissionTracker.Insert(packet->GetUid());
+        if (!entry.second)
+        {
+            return;
+        }
+
+        RetransmissionStatus& status = *entry.first;
+        status.firstAttempt = firstAttempt;
+        status.finishTime = Simulator::Now();
+        status.reTxAttempts = reqTx;
+        status.successful = success;
+    }
 
-    m_reTransmissionTracker.insert(std::pair<Ptr<Packet>, RetransmissionStatus>(packet, entry));
+    if (m_bucketSize.IsStrictlyPositive())
+    {
+        m_retxProcesses.Add(GetBucket(firstAttempt));
+        if (success)
+        {
+            m_retxSuccesses.Add(GetBucket(firstAttempt));
+        }
+    }
 }
 
 void
@@ -91,11 +185,15 @@ LoraPacketTracker::MacGwReceptionCallback(Ptr<const Packet> packet)
                     << " at the MAC layer of gateway " << Simulator::GetContext());
 
         // Find the received packet in the m_macPacketTracker
-        auto it = m_macPacketTracker.find(packet);
-        if (it != m_macPacketTracker.end())
+        MacPacketStatus* status = m_macPacketTracker.Find(packet->GetUid());
+        if (status)
         {
-            (*it).second.receptionTimes.insert(
-                std::pair<int, Time>(Simulator::GetContext(), Simulator::Now()));
+            bool first = status->receptionTimes.IsEmpty();
+            if (status->receptionTimes.Insert(Simulator::GetContext(), Simulator::Now()) &&
+                first && m_bucketSize.IsStrictlyPositive())
+            {
+                m_macReceived.Add(GetBucket(status->sendTime));
+            }
         }
         else
         {
@@ -114,80 +212,146 @@ LoraPacketTracker::TransmissionCallback(Ptr<const Packet> packet, uint32_t edId)
     if (IsUplink(packet))
     {
         NS_LOG_INFO("PHY packet " << packet << " was transmitted by device " << edId);
+        DropOldRecords();
+
         // Create a packetStatus
-        PacketStatus status;
-        status.packet = packet;
-        status.sendTime = Simulator::Now();
-        status.senderId = edId;
+        auto entry = m_packetTracker.Insert(packet->GetUid());
+        if (entry.second)
+        {
+            PacketStatus& status = *entry.first;
+            status.sendTime = Simulator::Now();
+            status.senderId = edId;
 
-        m_packetTracker.insert(std::pair<Ptr<const Packet>, PacketStatus>(packet, status));
+            if (!m_retainPackets)
+            {
+                m_phyRecordTimes.emplace_back(status.sendTime, packet->GetUid());
+            }
+            if (m_bucketSize.IsStrictlyPositive())
+            {
+                m_phySent.Add(GetBucket(status.sendTime));
+            }
+        }
     }
 }
 
 void
 LoraPacketTracker::PacketReceptionCallback(Ptr<const Packet> packet, uint32_t gwId)
 {
-    if (IsUplink(packet))
+    // Only uplink packets are tracked
+    PacketStatus* status = m_packetTracker.Find(packet->GetUid());
+    if (status)
     {
-        // Remove the successfully received packet from the list of sent ones
         NS_LOG_INFO("PHY packet " << packet << " was successfully received at gateway " << gwId);
-
-        auto it = m_packetTracker.find(packet);
-        (*it).second.outcomes.insert(std::pair<int, enum PhyPacketOutcome>(gwId, RECEIVED));
+        RecordOutcome(*status, gwId, RECEIVED);
     }
 }
 
 void
 LoraPacketTracker::InterferenceCallback(Ptr<const Packet> packet, uint32_t gwId)
 {
-    if (IsUplink(packet))
+    // Only uplink packets are tracked
+    PacketStatus* status = m_packetTracker.Find(packet->GetUid());
+    if (status)
     {
         NS_LOG_INFO("PHY packet " << packet << " was interfered at gateway " << gwId);
-
-        auto it = m_packetTracker.find(packet);
-        (*it).second.outcomes.insert(std::pair<int, enum PhyPacketOutcome>(gwId, INTERFERED));
+        RecordOutcome(*status, gwId, INTERFERED);
     }
 }
 
 void
 LoraPacketTracker::NoMoreReceiversCallback(Ptr<const Packet> packet, uint32_t gwId)
 {
-    if (IsUplink(packet))
+    // Only uplink packets are tracked
+    PacketStatus* status = m_packetTracker.Find(packet->GetUid());
+    if (status)
     {
         NS_LOG_INFO("PHY packet " << packet << " was lost because no more receivers at gateway "
                                   << gwId);
-        auto it = m_packetTracker.find(packet);
-        (*it).second.outcomes.insert(
-            std::pair<int, enum PhyPacketOutcome>(gwId, NO_MORE_RECEIVERS));
+        RecordOutcome(*status, gwId, NO_MORE_RECEIVERS);
     }
 }
 
 void
 LoraPacketTracker::UnderSensitivityCallback(Ptr<const Packet> packet, uint32_t gwId)
 {
-    if (IsUplink(packet))
+    // Only uplink packets are tracked
+    PacketStatus* status = m_packetTracker.Find(packet->GetUid());
+    if (status)
     {
         NS_LOG_INFO("PHY packet " << packet << " was lost because under sensitivity at gateway "
                                   << gwId);
-
-        auto it = m_packetTracker.find(packet);
-        (*it).second.outcomes.insert(
-            std::pair<int, enum PhyPacketOutcome>(gwId, UNDER_SENSITIVITY));
+        RecordOutcome(*status, gwId, UNDER_SENSITIVITY);
     }
 }
 
 void
 LoraPacketTracker::LostBecauseTxCallback(Ptr<const Packet> packet, uint32_t gwId)
 {
-    if (IsUplink(packet))
+    // Only uplink packets are tracked
+    PacketStatus* status = m_packetTracker.Find(packet->GetUid());
+    if (status)
     {
         NS_LOG_INFO(
             "PHY packet " << packet
                           << " was lost because of concurrent downlink transmission at gateway "
                           << gwId);
+        RecordOutcome(*status, gwId, LOST_BECAUSE_TX);
+    }
+}
 
-        auto it = m_packetTracker.find(packet);
-        (*it).second.outcomes.insert(std::pair<int, enum PhyPacketOutcome>(gwId, LOST_BECAUSE_TX));
+void
+LoraPacketTracker::RecordOutcome(PacketStatus& status, uint32_t gwId, enum PhyPacketOutcome outcome)
+{
+    if (status.outcomes.Insert(gwId, outcome) && m_bucketSize.IsStrictlyPositive())
+    {
+        m_phyOutcomes[gwId][outcome].Add(GetBucket(status.sendTime));
+    }
+}
+
+int64_t
+LoraPacketTracker::GetBucket(Time time) const
+{
+    return time.GetTimeStep() / m_bucketSize.GetTimeStep();
+}
+
+bool
+LoraPacketTracker::UseAggregates(Time startTime, Time stopTime) const
+{
+    if (!IsAggregationEnabled())
+    {
+        return false;
+    }
+
+    bool aligned = startTime.GetTimeStep() % m_bucketSize.GetTimeStep() == 0 &&
+                   stopTime.GetTimeStep() % m_bucketSize.GetTimeStep() == 0;
+    if (!aligned && !m_retainPackets)
+    {
+        NS_LOG_WARN("Packet records are not retained: rounding the interval ["
+                    << startTime.As(Time::S) << ", " << stopTime.As(Time::S)
+                    << ") down to the bucket size");
+    }
+    // The counters miss the packets sent before aggregation was enabled
+    return (aligned && startTime >= m_aggregationStart) || !m_retainPackets;
+}
+
+void
+LoraPacketTracker::DropOldRecords()
+{
+    if (m_retainPackets)
+    {
+        return;
+    }
+
+    Time oldest = Simulator::Now() - m_recordLifetime;
+    while (!m_phyRecordTimes.empty() && m_phyRecordTimes.front().first < oldest)
+    {
+        m_packetTracker.Erase(m_phyRecordTimes.front().second);
+        m_phyRecordTimes.pop_front();
+    }
+    while (!m_macRecordTimes.empty() && m_macRecordTimes.front().first < oldest)
+    {
+        m_macPacketTracker.Erase(m_macRecordTimes.front().second);
+        m_macRecordTimes.pop_front();
     }
 }
 
@@ -196,9 +360,14 @@ LoraPacketTracker::IsUplink(Ptr<const Packet> packet)
 {
     NS_LOG_FUNCTION(this);
 
+    uint64_t uid = packet->GetUid();
+    if (m_packetTracker.Find(uid) || m_macPacketTracker.Find(uid))
+    {
+        return true;
+    }
+
     LorawanMacHeader mHdr;
-    Ptr<Packet> copy = packet->Copy();
-    copy->RemoveHeader(mHdr);
+    packet->PeekHeader(mHdr);
     return mHdr.IsUplink();
 }
 
@@ -215,19 +384,35 @@ LoraPacketTracker::CountPhyPacketsPerGw(Time startTime, Time stopTime, int gwId)
 
     std::vector<int> packetCounts(6, 0);
 
-    for (auto itPhy = m_packetTracker.begin(); itPhy != m_packetTracker.end(); ++itPhy)
+    if (UseAggregates(startTime, stopTime))
     {
-        if ((*itPhy).second.sendTime >= startTime && (*itPhy).second.sendTime <= stopTime)
+        int64_t first = GetBucket(startTime);
+        int64_t last = GetBucket(stopTime);
+        packetCounts.at(0) = m_phySent.Count(first, last);
+        auto it = m_phyOutcomes.find(gwId);
+        if (it != m_phyOutcomes.end())
+        {
+            for (int outcome = RECEIVED; outcome < UNSET; outcome++)
+            {
+                packetCounts.at(outcome + 1) = it->second[outcome].Count(first, last);
+            }
+        }
+        return packetCounts;
+    }
+
+    m_packetTracker.ForEach([&](uint64_t uid, const PacketStatus& status) {
+        if (status.sendTime >= startTime && status.sendTime < stopTime)
         {
             packetCounts.at(0)++;
 
-            NS_LOG_DEBUG("Dealing with packet " << (*itPhy).second.packet);
-            NS_LOG_DEBUG("This packet was received by " << (*itPhy).second.outcomes.size()
+            NS_LOG_DEBUG("Dealing with packet " << uid);
+            NS_LOG_DEBUG("This packet was received by " << status.outcomes.Size()
                                                         << " gateways");
 
-            if ((*itPhy).second.outcomes.count(gwId) > 0)
+            const PhyPacketOutcome* outcome = status.outcomes.Find(gwId);
+            if (outcome)
             {
-                switch ((*itPhy).second.outcomes.at(gwId))
+                switch (*outcome)
                 {
                 case RECEIVED: {
                     packetCounts.at(1)++;
@@ -255,7 +440,7 @@ LoraPacketTracker::CountPhyPacketsPerGw(Time startTime, Time stopTime, int gwId)
                 }
             }
         }
-    }
+    });
 
     return packetCounts;
 }
@@ -267,49 +452,7 @@ LoraPacketTracker::PrintPhyPacketsPerGw(Time startTime, Time stopTime, int gwId)
     // the function, the following fields: totPacketsSent receivedPackets
     // interferedPackets noMoreGwPackets underSensitivityPackets lostBecauseTxPackets
 
-    std::vector<int> packetCounts(6, 0);
-
-    for (auto itPhy = m_packetTracker.begin(); itPhy != m_packetTracker.end(); ++itPhy)
-    {
-        if ((*itPhy).second.sendTime >= startTime && (*itPhy).second.sendTime <= stopTime)
-        {
-            packetCounts.at(0)++;
-
-            NS_LOG_DEBUG("Dealing with packet " << (*itPhy).second.packet);
-            NS_LOG_DEBUG("This packet was received by " << (*itPhy).second.outcomes.size()
-                                                        << " gateways");
-
-            if ((*itPhy).second.outcomes.count(gwId) > 0)
-            {
-                switch ((*itPhy).second.outcomes.at(gwId))
-                {
-                case RECEIVED: {
-                    packetCounts.at(1)++;
-                    break;
-                }
-                case INTERFERED: {
-                    packetCounts.at(2)++;
-                    break;
-                }
-                case NO_MORE_RECEIVERS: {
-                    packetCounts.at(3)++;
-                    break;
-                }
-                case UNDER_SENSITIVITY: {
-                    packetCounts.at(4)++;
-                    break;
-                }
-                case LOST_BECAUSE_TX: {
-                    packetCounts.at(5)++;
-                    break;
-                }
-                case UNSET: {
-                    break;
-                }
-                }
-            }
-        }
-    }
+    std::vector<int> packetCounts = CountPhyPacketsPerGw(startTime, stopTime, gwId);
 
     std::string output("");
     for (int i = 0; i < 6; ++i)
@@ -325,46 +468,119 @@ LoraPacketTracker::CountMacPacketsGlobally(Time startTime, Time stopTime)
 {
     NS_LOG_FUNCTION(this << startTime << stopTime);
 
-    double sent = 0;
-    double received = 0;
-    for (auto it = m_macPacketTracker.begin(); it != m_macPacketTracker.end(); ++it)
+    auto [sent, received] = CountMacPackets(startTime, stopTime);
+    return std::to_string(double(sent)) + " " + std::to_string(double(received));
+}
+
+std::string
+LoraPacketTracker::CountMacPacketsGloballyCpsr(Time startTime, Time stopTime)
+{
+    NS_LOG_FUNCTION(this << startTime << stopTime);
+
+    auto [sent, received] = CountRetransmissionProcesses(startTime, stopTime);
+    return std::to_string(double(sent)) + " " + std::to_string(double(received));
+}
+
+void
+LoraPacketTracker::PrintMetrics(std::ostream& os, Time startTime, Time stopTime)
+{
+    NS_LOG_FUNCTION(this << startTime << stopTime);
+
+    auto [macSent, macReceived] = CountMacPackets(startTime, stopTime);
+    auto [cpsrSent, cpsrSuccesses] = CountRetransmissionProcesses(startTime, stopTime);
+
+    // Print the ratio with enough digits to be read back exactly, whatever
+    // the precision of the stream
+    std::streamsize precision = os.precision(std::numeric_limits<double>::max_digits10);
+    os << "macSent " << macSent << std::endl;
+    os << "macReceived " << macReceived << std::endl;
+    os << "macPdr " << (macSent > 0 ? double(macReceived) / macSent : 0) << std::endl;
+    os << "cpsrSent " << cpsrSent << std::endl;
+    os << "cpsrSuccesses " << cpsrSuccesses << std::endl;
+    os.precision(precision);
+}
+
+std::pair<uint64_t, uint64_t>
+LoraPacketTracker::CountMacPackets(Time startTime, Time stopTime)
+{
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    if (UseAggregates(startTime, stopTime))
     {
-        if ((*it).second.sendTime >= startTime && (*it).second.sendTime <= stopTime)
+        sent = m_macSent.Count(GetBucket(startTime), GetBucket(stopTime));
+        received = m_macReceived.Count(GetBucket(startTime), GetBucket(stopTime));
+        return {sent, received};
+    }
+
+    m_macPacketTracker.ForEach([&](uint64_t, const MacPacketStatus& status) {
+        if (status.sendTime >= startTime && status.sendTime < stopTime)
         {
             sent++;
-            if (!(*it).second.receptionTimes.empty())
+            if (!status.receptionTimes.IsEmpty())
             {
                 received++;
             }
         }
-    }
+    });
 
-    return std::to_string(sent) + " " + std::to_string(received);
+    return {sent, received};
 }
 
-std::string
-LoraPacketTracker::CountMacPacketsGloballyCpsr(Time startTime, Time stopTime)
+std::pair<uint64_t, uint64_t>
+LoraPacketTracker::CountRetransmissionProcesses(Time startTime, Time stopTime)
 {
-    NS_LOG_FUNCTION(this << startTime << stopTime);
-
-    double sent = 0;
-    double received = 0;
-    for (auto it = m_reTransmissionTracker.begin(); it != m_reTransmissionTracker.end(); ++it)
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    if (UseAggregates(startTime, stopTime))
     {
-        if ((*it).second.firstAttempt >= startTime && (*it).second.firstAttempt <= stopTime)
+        sent = m_retxProcesses.Count(GetBucket(startTime), GetBucket(stopTime));
+        received = m_retxSuccesses.Count(GetBucket(startTime), GetBucket(stopTime));
+        return {sent, received};
+    }
+
+    m_reTransmissionTracker.ForEach([&](uint64_t, const RetransmissionStatus& status) {
+        if (status.firstAttempt >= startTime && status.firstAttempt < stopTime)
         {
             sent++;
             NS_LOG_DEBUG("Found a packet");
-            NS_LOG_DEBUG("Number of attempts: " << unsigned(it->second.reTxAttempts)
-                                                << ", successful: " << it->second.successful);
-            if (it->second.successful)
+            NS_LOG_DEBUG("Number of attempts: " << unsigned(status.reTxAttempts)
+                                                << ", successful: " << status.successful);
+            if (status.successful)
             {
                 received++;
             }
         }
-    }
+    });
+
+    return {sent, received};
+}
+
+std::size_t
+LoraPacketTracker::GetMemoryUsage() const
+{
+    NS_LOG_FUNCTION(this);
 
-    return std::to_string(sent) + " " + std::to_string(received);
+    std::size_t bytes = m_packetTracker.GetMemoryUsage() + m_macPacketTracker.GetMemoryUsage() +
+                        m_reTransmissionTracker.GetMemoryUsage();
+    m_packetTracker.ForEach([&bytes](uint64_t, const PacketStatus& status) {
+        bytes += status.outcomes.GetHeapUsage();
+    });
+    m_macPacketTracker.ForEach([&bytes](uint64_t, const MacPacketStatus& status) {
+        bytes += status.receptionTimes.GetHeapUsage();
+    });
+    bytes += (m_phyRecordTimes.size() + m_macRecordTimes.size()) *
+             sizeof(std::pair<Time, uint64_t>);
+    bytes += m_phySent.GetMemoryUsage() + m_macSent.GetMemoryUsage() +
+             m_macReceived.GetMemoryUsage() + m_retxProcesses.GetMemoryUsage() +
+             m_retxSuccesses.GetMemoryUsage();
+    for (const auto& gateway : m_phyOutcomes)
+    {
+        for (const auto& counters : gateway.second)
+        {
+            bytes += counters.GetMemoryUsage();
+        }
+    }
+    return bytes;
 }
 
 } // namespace lorawan
@@ -23,8 +23,13 @@
 #include "ns3/nstime.h"
 #include "ns3/packet.h"
 
-#include <map>
+#include <array>
+#include <deque>
+#include <limits>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3
 {
@@ -41,6 +46,69 @@ enum PhyPacketOutcome
     UNSET
 };
 
+/**
+ * \ingroup lorawan
+ *
+ * Small map from gateway node ids to the metrics of a packet at each gateway.
+ *
+ * Most packets are heard by a handful of gateways: the first entries are stored
+ * inline, and only further ones are allocated on the heap. Entries are never
+ * overwritten, as with std::map::insert.
+ */
+template <typename T>
+class GatewayValues
+{
+  public:
+    static const std::size_t inlineSize = 3; //!< Number of entries stored inline
+
+    /**
+     * Add the value of a gateway, unless the gateway already has one.
+     *
+     * \param gwId The node id of the gateway.
+     * \param value The value to store.
+     * \return True if the value was stored.
+     */
+    bool Insert(uint32_t gwId, const T& value);
+
+    /**
+     * Look up the value of a gateway.
+     *
+     * \param gwId The node id of the gateway.
+     * \return A pointer to the value, or nullptr if the gateway has none.
+     */
+    const T* Find(uint32_t gwId) const;
+
+    /**
+     * \return The number of gateways with a value.
+     */
+    std::size_t Size() const;
+
+    /**
+     * \return True if no gateway has a value.
+     */
+    bool IsEmpty() const;
+
+    /**
+     * \return The number of bytes allocated on the heap for the entries that
+     * don't fit inline.
+     */
+    std::size_t GetHeapUsage() const;
+
+  private:
+    /**
+     * The value of a gateway.
+     */
+    struct Entry
+    {
+        uint32_t gwId; //!< The node id of the gateway
+        T value;       //!< The value
+    };
+
+    std::array<Entry, inlineSize> m_inline;        //!< The first entries
+    uint8_t m_nInline = 0;                         //!< The number of inline entries in use
+    std::unique_ptr<std::vector<Entry>> m_overflow; //!< The entries that don't fit inline
+};
+
 /**
  * \ingroup lorawan
  *
@@ -48,11 +116,10 @@ enum PhyPacketOutcome
  */
 struct PacketStatus
 {
-    Ptr<const Packet> packet;                      //!< Packet being tracked
     uint32_t senderId;                             //!< Node id of the packet sender
     Time sendTime;                                 //!< Timestamp of pkt radio tx start
-    std::map<int, enum PhyPacketOutcome> outcomes; //!< Reception outcome of this pkt at the end of
-                                                   //!< the tx, mapped by gateway's node id
+    GatewayValues<enum PhyPacketOutcome> outcomes; //!< Reception outcome of this pkt at the end
+                                                   //!< of the tx, mapped by gateway's node id
 };
 
 /**
@@ -64,12 +131,11 @@ struct PacketStatus
  */
 struct MacPacketStatus
 {
-    Ptr<const Packet> packet; //!< Packet being tracked
-    uint32_t senderId;        //!< Node id of the packet sender
+    uint32_t senderId; //!< Node id of the packet sender
     Time sendTime;     //!< Timestamp of the pkt leaving MAC layer to go down the stack of sender
     Time receivedTime; //!< Time of first reception (placeholder field)
                        //!< \todo Field set to max and not used
-    std::map<int, Time> receptionTimes; //!< Timestamp of the pkt leaving MAC layer to go up the
+    GatewayValues<Time> receptionTimes; //!< Timestamp of the pkt leaving MAC layer to go up the
                                         //!< stack, mapped by receiver's node id
 };
 
@@ -86,9 +152,151 @@ struct RetransmissionStatus
     bool successful;      //!< Whether the retransmission procedure was successful
 };
 
-typedef std::map<Ptr<const Packet>, MacPacketStatus> MacPacketData;
-typedef std::map<Ptr<const Packet>, PacketStatus> PhyPacketData;
-typedef std::map<Ptr<const Packet>, RetransmissionStatus> RetransmissionData;
+/**
+ * \ingroup lorawan
+ *
+ * Hash table from packet uids (see Packet::GetUid) to packet metrics.
+ *
+ * Entries are stored in a single array with open addressing and linear probing,
+ * so that a lookup usually touches a single cache line and no memory is
+ * allocated per packet. Copies of a packet share its uid, so that the metrics
+ * of a packet can be found from any of its copies.
+ */
+template <typename T>
+class PacketUidMap
+{
+  public:
+    /**
+     * Look up the metrics of a packet.
+     *
+     * \param uid The uid of the packet.
+     * \return A pointer to the metrics, or nullptr if the packet is not tracked.
+     */
+    T* Find(uint64_t uid);
+
+    /** \copydoc Find */
+    const T* Find(uint64_t uid) const;
+
+    /**
+     * Start tracking a packet, unless it is already tracked.
+     *
+     * \param uid The uid of the packet.
+     * \return A pointer to the metrics of the packet, and whether they were
+     * just created.
+     */
+    std::pair<T*, bool> Insert(uint64_t uid);
+
+    /**
+     * Stop tracking a packet.
+     *
+     * \param uid The uid of the packet.
+     * \return True if the packet was tracked.
+     */
+    bool Erase(uint64_t uid);
+
+    /**
+     * \return The number of tracked packets.
+     */
+    std::size_t Size() const;
+
+    /**
+     * Stop tracking all packets.
+     */
+    void Clear();
+
+    /**
+     * Call a function on the metrics of each tracked packet, in no particular
+     * order.
+     *
+     * \param f The function, taking the uid of the packet and its metrics.
+     */
+    template <typename F>
+    void ForEach(F f) const;
+
+    /**
+     * \return The number of bytes allocated for the table.
+     */
+    std::size_t GetMemoryUsage() const;
+
+  private:
+    /**
+     * An entry of the table.
+     */
+    struct Slot
+    {
+        uint64_t uid = EMPTY; //!< The uid of the packet, or EMPTY
+        T value;              //!< The metrics of the packet
+    };
+
+    static constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max(); //!< Uid of free slots
+
+    /**
+     * \param uid The uid of a packet.
+     * \return The first slot to probe for the packet.
+     */
+    std::size_t GetHome(uint64_t uid) const;
+
+    /**
+     * \param uid The uid of a packet.
+     * \return The slot of the packet, or the free slot where it would be inserted.
+     */
+    std::size_t Probe(uint64_t uid) const;
+
+    /**
+     * Double the capacity of the table and insert the entries again.
+     */
+    void Grow();
+
+    std::vector<Slot> m_slots; //!< The table, whose size is zero or a power of two
+    std::size_t m_size = 0;    //!< The number of tracked packets
+    uint8_t m_bits = 0;        //!< The base 2 logarithm of the size of the table
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Number of events per time bucket, stored as running totals so that the
+ * number of events in any range of buckets is found in constant time.
+ *
+ * Adding an event updates the totals of its bucket and of all later ones: this
+ * is cheap as long as events are added to one of the last buckets, which is the
+ * case for outcomes that are counted a few seconds after the packet was sent.
+ */
+class BucketCounters
+{
+  public:
+    /**
+     * Count an event.
+     *
+     * \param bucket The non-negative index of the bucket of the event.
+     */
+    void Add(int64_t bucket);
+
+    /**
+     * \param first The index of the first bucket.
+     * \param last The index of the bucket after the last one.
+     * \return The number of events in buckets [first, last).
+     */
+    int64_t Count(int64_t first, int64_t last) const;
+
+    /**
+     * \return The number of bytes allocated for the counters.
+     */
+    std::size_t GetMemoryUsage() const;
+
+  private:
+    /**
+     * \param bucket The index of a bucket.
+     * \return The number of events in the buckets up to this one, included.
+     */
+    int64_t GetTotal(int64_t bucket) const;
+
+    std::vector<int64_t> m_totals; //!< Number of events up to each bucket, included
+};
+
+typedef PacketUidMap<MacPacketStatus> MacPacketData;
+typedef PacketUidMap<PacketStatus> PhyPacketData;
+typedef PacketUidMap<RetransmissionStatus> RetransmissionData;
 
 /**
  * \ingroup lorawan
@@ -101,6 +309,38 @@ class LoraPacketTracker
     LoraPacketTracker();  //!< Default constructor
     ~LoraPacketTracker(); //!< Destructor
 
+    /**
+     * Count packets per time bucket as they are traced, so that the counting
+     * functions don't need to go through the history of packets.
+     *
+     * Packets are counted in the bucket of the time they were sent. Counting
+     * functions use these counters when both ends of the interval are
+     * multiples of the bucket size, and the interval starts after aggregation
+     * was enabled. Other intervals are counted from the packet records, if
+     * they are retained, or rounded down to the bucket size otherwise. Both
+     * ways count the same packets, since intervals are always half-open.
+     *
+     * Aggregation can only be enabled once, since the counters can't be
+     * moved to other buckets.
+     *
+     * \param bucketSize The duration of the time buckets.
+     * \param retainPackets Whether to keep the record of each packet for the
+     * whole simulation. If false, records are dropped after recordLifetime,
+     * and only aggregated counts are available.
+     * \param recordLifetime How long a packet record is kept when records are
+     * not retained. It must be longer than the time between the transmission
+     * of a packet and the last trace about it, including retransmissions of
+     * the same packet.
+     */
+    void EnableAggregation(Time bucketSize,
+                           bool retainPackets = true,
+                           Time recordLifetime = Minutes(1));
+
+    /**
+     * \return Whether packets are counted per time bucket.
+     */
+    bool IsAggregationEnabled() const;
+
     ///////////////////////////
     // PHY layer trace sinks //
     ///////////////////////////
@@ -197,6 +437,9 @@ class LoraPacketTracker
     /**
      * Check whether a packet is uplink.
      *
+     * Tracked packets are known to be uplink: the MAC header is only read the
+     * first time a packet is seen.
+     *
      * \param packet The packet to be checked.
      * \return True if the packet is uplink, false otherwise.
      */
@@ -208,7 +451,8 @@ class LoraPacketTracker
 
     /**
      * Count packets in a time interval to evaluate the performance at PHY level of a specific
-     * gateway. It counts the total number of uplink packets sent over the radio medium, and - from
+     * gateway. It counts the total number of uplink packets sent over the radio medium in
+     * [startTime, stopTime), like all the counting functions below, and - from
      * the perspective of the specified gateway - the number of such packets correctly received,
      * lost to interference, lost to unavailability of the gateway's reception paths, lost for being
      * under the RSSI sensitivity threshold, and lost due to concurrent downlink transmission of the
@@ -279,11 +523,323 @@ class LoraPacketTracker
      */
     std::string CountMacPacketsGloballyCpsr(Time startTime, Time stopTime);
 
+    /**
+     * In a time interval, print the global MAC level metrics of the network,
+     * one "name value" pair per line, so that they can be collected across
+     * simulation runs: the number of sent packets (macSent), of packets received
+     * by at least one gateway (macReceived), their ratio (macPdr), the number of
+     * retransmission processes (cpsrSent) and of successful ones (cpsrSuccesses).
+     *
+     * \param os The output stream.
+     * \param startTime Timestamp of the start of the measurement.
+     * \param stopTime Timestamp of the end of the measurement.
+     */
+    void PrintMetrics(std::ostream& os, Time startTime, Time stopTime);
+
+    /**
+     * Estimate the memory used to store the metrics of the tracked packets.
+     *
+     * \return The number of bytes allocated by the tracker.
+     */
+    std::size_t GetMemoryUsage() const;
+
   private:
+    /**
+     * Store the outcome of a packet at a gateway, and count it.
+     *
+     * \param status The record of the packet.
+     * \param gwId Id of the gateway.
+     * \param outcome The outcome of the packet at the gateway.
+     */
+    void RecordOutcome(PacketStatus& status, uint32_t gwId, enum PhyPacketOutcome outcome);
+
+    /**
+     * \param time A time of the simulation.
+     * \return The index of the time bucket containing it.
+     */
+    int64_t GetBucket(Time time) const;
+
+    /**
+     * Check whether a counting interval can be answered from the counters.
+     *
+     * \param startTime Timestamp of the start of the measurement.
+     * \param stopTime Timestamp of the end of the measurement.
+     * \return True if the counters should be used.
+     */
+    bool UseAggregates(Time startTime, Time stopTime) const;
+
+    /**
+     * Count the uplinks sent by the MAC layer in a time interval, and those
+     * received by at least one gateway.
+     *
+     * \param startTime Timestamp of the start of the measurement.
+     * \param stopTime Timestamp of the end of the measurement.
+     * \return The number of sent packets and the number of received ones.
+     */
+    std::pair<uint64_t, uint64_t> CountMacPackets(Time startTime, Time stopTime);
+
+    /**
+     * Count the retransmission processes whose first attempt is in a time
+     * interval, and those that were successful.
+     *
+     * \param startTime Timestamp of the start of the measurement.
+     * \param stopTime Timestamp of the end of the measurement.
+     * \return The number of processes and the number of successful ones.
+     */
+    std::pair<uint64_t, uint64_t> CountRetransmissionProcesses(Time startTime, Time stopTime);
+
+    /**
+     * Drop the records that are older than m_recordLifetime, when records are
+     * not retained.
+     */
+    void DropOldRecords();
+
     PhyPacketData m_packetTracker;              //!< Packet map of PHY layer metrics
     MacPacketData m_macPacketTracker;           //!< Packet map of MAC layer metrics
     RetransmissionData m_reTransmissionTracker; //!< Packet map of retransmission process metrics
+
+    Time m_bucketSize;       //!< Duration of the time buckets, or zero if not aggregating
+    Time m_aggregationStart; //!< The time aggregation was enabled
+    bool m_retainPackets;    //!< Whether records are kept for the whole simulation
+    Time m_recordLifetime;   //!< How long records are kept if they are not retained
+
+    /**
+     * The uids of the records, in the order they were created, to drop them when
+     * they are not retained.
+     */
+    std::deque<std::pair<Time, uint64_t>> m_phyRecordTimes;
+    std::deque<std::pair<Time, uint64_t>> m_macRecordTimes; //!< \copydoc m_phyRecordTimes
+
+    BucketCounters m_phySent; //!< Uplinks sent by the PHY layer
+    std::unordered_map<uint32_t, std::array<BucketCounters, UNSET>>
+        m_phyOutcomes;              //!< Uplinks per gateway and outcome
+    BucketCounters m_macSent;       //!< Uplinks sent by the MAC layer
+    BucketCounters m_macReceived;   //!< Uplinks received by the MAC layer of a gateway
+    BucketCounters m_retxProcesses; //!< Finished retransmission processes, by first attempt
+    BucketCounters m_retxSuccesses; //!< Successful retransmission processes, by first attempt
 };
+
+/***************************************************************
+ *  Implementation of the templates declared above.
+ ***************************************************************/
+
+template <typename T>
+bool
+GatewayValues<T>::Insert(uint32_t gwId, const T& value)
+{
+    if (Find(gwId))
+    {
+        return false;
+    }
+    if (m_nInline < inlineSize)
+    {
+        m_inline[m_nInline++] = {gwId, value};
+    }
+    else
+    {
+        if (!m_overflow)
+        {
+            m_overflow = std::make_unique<std::vector<Entry>>();
+        }
+        m_overflow->push_back({gwId, value});
+    }
+    return true;
+}
+
+template <typename T>
+const T*
+GatewayValues<T>::Find(uint32_t gwId) const
+{
+    for (uint8_t i = 0; i < m_nInline; i++)
+    {
+        if (m_inline[i].gwId == gwId)
+        {
+            return &m_inline[i].value;
+        }
+    }
+    if (m_overflow)
+    {
+        for (const auto& entry : *m_overflow)
+        {
+            if (entry.gwId == gwId)
+            {
+                return &entry.value;
+            }
+        }
+    }
+    return nullptr;
+}
+
+template <typename T>
+std::size_t
+GatewayValues<T>::Size() const
+{
+    return m_nInline + (m_overflow ? m_overflow->size() : 0);
+}
+
+template <typename T>
+bool
+GatewayValues<T>::IsEmpty() const
+{
+    return m_nInline == 0;
+}
+
+template <typename T>
+std::size_t
+GatewayValues<T>::GetHeapUsage() const
+{
+    return m_overflow ? sizeof(*m_overflow) + m_overflow->capacity() * sizeof(Entry) : 0;
+}
+
+template <typename T>
+T*
+PacketUidMap<T>::Find(uint64_t uid)
+{
+    return const_cast<T*>(static_cast<const PacketUidMap<T>*>(this)->Find(uid));
+}
+
+template <typename T>
+const T*
+PacketUidMap<T>::Find(uint64_t uid) const
+{
+    if (m_size == 0)
+    {
+        return nullptr;
+    }
+    const Slot& slot = m_slots[Probe(uid)];
+    return slot.uid == uid ? &slot.value : nullptr;
+}
+
+template <typename T>
+std::pair<T*, bool>
+PacketUidMap<T>::Insert(uint64_t uid)
+{
+    // Keep the load factor below 3/4
+    if (4 * (m_size + 1) > 3 * m_slots.size())
+    {
+        Grow();
+    }
+
+    Slot& slot = m_slots[Probe(uid)];
+    if (slot.uid == uid)
+    {
+        return {&slot.value, false};
+    }
+    slot.uid = uid;
+    m_size++;
+    return {&slot.value, true};
+}
+
+template <typename T>
+bool
+PacketUidMap<T>::Erase(uint64_t uid)
+{
+    if (m_size == 0)
+    {
+        return false;
+    }
+    std::size_t hole = Probe(uid);
+    if (m_slots[hole].uid != uid)
+    {
+        return false;
+    }
+
+    // Shift back the following entries of the cluster that can't be found
+    // anymore once the slot is freed
+    std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = (hole + 1) & mask; m_slots[i].uid != EMPTY; i = (i + 1) & mask)
+    {
+        std::size_t home = GetHome(m_slots[i].uid);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            m_slots[hole] = std::move(m_slots[i]);
+            hole = i;
+        }
+    }
+    m_slots[hole] = Slot();
+    m_size--;
+    return true;
+}
+
+template <typename T>
+std::size_t
+PacketUidMap<T>::Size() const
+{
+    return m_size;
+}
+
+template <typename T>
+void
+PacketUidMap<T>::Clear()
+{
+    m_slots.clear();
+    m_size = 0;
+    m_bits = 0;
+}
+
+template <typename T>
+template <typename F>
+void
+PacketUidMap<T>::ForEach(F f) const
+{
+    for (const auto& slot : m_slots)
+    {
+        if (slot.uid != EMPTY)
+        {
+            f(slot.uid, slot.value);
+        }
+    }
+}
+
+template <typename T>
+std::size_t
+PacketUidMap<T>::GetMemoryUsage() const
+{
+    return m_slots.capacity() * sizeof(Slot);
+}
+
+template <typename T>
+std::size_t
+PacketUidMap<T>::GetHome(uint64_t uid) const
+{
+    // Fibonacci hashing spreads the consecutive uids of packets over the table
+    return std::size_t((uid * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits));
+}
+
+template <typename T>
+std::size_t
+PacketUidMap<T>::Probe(uint64_t uid) const
+{
+    std::size_t mask = m_slots.size() - 1;
+    std::size_t i = GetHome(uid);
+    while (m_slots[i].uid != uid && m_slots[i].uid != EMPTY)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+template <typename T>
+void
+PacketUidMap<T>::Grow()
+{
+    std::vector<Slot> slots(m_slots.empty() ? 16 : 2 * m_slots.size());
+    std::swap(slots, m_slots);
+    m_bits = 0;
+    while ((std::size_t(1) << m_bits) < m_slots.size())
+    {
+        m_bits++;
+    }
+
+    for (auto& slot : slots)
+    {
+        if (slot.uid != EMPTY)
+        {
+            m_slots[Probe(slot.uid)] = std::move(slot);
+        }
+    }
+}
+
 } // namespace lorawan
 } // namespace ns3
 #endif
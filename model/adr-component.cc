@@ -19,6 +19,11 @@
 
 #include "adr-component.h"
 
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+
 namespace ns3
 {
 namespace lorawan
@@ -69,11 +74,18 @@ AdrComponent::GetTypeId()
                           "Whether to toggle the transmission power or not",
                           BooleanValue(true),
                           MakeBooleanAccessor(&AdrComponent::m_toggleTxPower),
-                          MakeBooleanChecker());
+                          MakeBooleanChecker())
+            .AddAttribute("Period",
+                          "If positive, run the ADR algorithm for all devices with this period "
+                          "instead of before each reply",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&AdrComponent::m_period),
+                          MakeTimeChecker(Seconds(0)));
     return tid;
 }
 
 AdrComponent::AdrComponent()
+    : m_newUplinks(false)
 {
 }
 
@@ -82,14 +94,23 @@ AdrComponent::~AdrComponent()
 }
 
 void
-AdrComponent::OnReceivedPacket(Ptr<const Packet> packet,
+AdrComponent::OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                                Ptr<EndDeviceStatus> status,
                                Ptr<NetworkStatus> networkStatus)
 {
-    NS_LOG_FUNCTION(this->GetTypeId() << packet << networkStatus);
+    NS_LOG_FUNCTION(this->GetTypeId() << uplink->GetPacket() << networkStatus);
 
     // We will only act just before reply, when all Gateways will have received
-    // the packet, since we need their respective received power.
+    // the packet, since we need their respective received power. The previous
+    // packets of the device, however, are complete, and can be added to its
+    // history now.
+    UpdateHistory(uplink->GetAddress(), status);
+    m_newUplinks = true;
+
+    if (m_period.IsStrictlyPositive() && !m_periodicEvent.IsRunning())
+    {
+        m_periodicEvent = Simulator::Schedule(m_period, &AdrComponent::RunPeriodicAdr, this);
+    }
 }
 
 void
@@ -97,20 +118,24 @@ AdrComponent::BeforeSendingReply(Ptr<EndDeviceStatus> status, Ptr<NetworkStatus>
 {
     NS_LOG_FUNCTION(this << status << networkStatus);
 
-    Ptr<Packet> myPacket = status->GetLastPacketReceivedFromDevice()->Copy();
-    LorawanMacHeader mHdr;
-    LoraFrameHeader fHdr;
-    fHdr.SetAsUplink();
-    myPacket->RemoveHeader(mHdr);
-    myPacket->RemoveHeader(fHdr);
+    if (m_period.IsStrictlyPositive())
+    {
+        // LinkAdrReq commands are queued by RunPeriodicAdr
+        return;
+    }
+
+    const LoraFrameHeader& fHdr = status->GetLastReceivedUplink()->GetFrameHeader();
 
     // Execute the Adaptive Data Rate (ADR) algorithm only if the request bit is set
     if (fHdr.GetAdr())
     {
-        if (int(status->GetReceivedPacketList().size()) < historyRange)
+        NS_ABORT_MSG_IF(int(status->GetReceivedPacketList().GetCapacity()) < historyRange,
+                        "The HistoryDepth of EndDeviceStatus is smaller than the HistoryRange");
+
+        if (int(status->GetReceivedPacketList().GetSize()) < historyRange)
         {
             NS_LOG_ERROR("Not enough packets received by this device ("
-                         << status->GetReceivedPacketList().size()
+                         << status->GetReceivedPacketList().GetSize()
                          << ") for the algorithm to work (need " << historyRange << ")");
         }
         else
@@ -138,25 +163,7 @@ AdrComponent::BeforeSendingReply(Ptr<EndDeviceStatus> status, Ptr<NetworkStatus>
 
             if (newDataRate != SfToDr(spreadingFactor) || newTxPower != transmissionPower)
             {
-                // Create a list with mandatory channel indexes
-                int channels[] = {0, 1, 2};
-                std::list<int> enabledChannels(channels, channels + sizeof(channels) / sizeof(int));
-
-                // Repetitions Setting
-                const int rep = 1;
-
-                NS_LOG_DEBUG("Sending LinkAdrReq with DR = " << (unsigned)newDataRate
-                                                             << " and TP = " << (unsigned)newTxPower
-                                                             << " dBm");
-
-                status->m_reply.frameHeader.AddLinkAdrReq(newDataRate,
-                                                          GetTxPowerIndex(newTxPower),
-                                                          enabledChannels,
-                                                          rep);
-                status->m_reply.frameHeader.SetAsDownlink();
-                status->m_reply.macHeader.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_DOWN);
-
-                status->m_reply.needsReply = true;
+                QueueLinkAdrReq(status, newDataRate, newTxPower);
             }
             else
             {
@@ -170,6 +177,131 @@ AdrComponent::BeforeSendingReply(Ptr<EndDeviceStatus> status, Ptr<NetworkStatus>
     }
 }
 
+void
+AdrComponent::RunPeriodicAdr()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Without new uplinks, the histories didn't change since the last run:
+    // stop until the next uplink schedules a run again
+    if (!m_newUplinks)
+    {
+        NS_LOG_DEBUG("No uplinks since the last run, stopping");
+        return;
+    }
+    m_newUplinks = false;
+
+    // Take a snapshot of the devices whose last packet requested ADR and that
+    // don't have a LinkAdrReq waiting already
+    std::vector<Ptr<EndDeviceStatus>> statuses;
+    std::vector<double> margins;
+    std::vector<int> spreadingFactors;
+    std::vector<double> txPowers;
+    for (auto& entry : m_histories)
+    {
+        Ptr<EndDeviceStatus> status = entry.second.status;
+        if (!status->GetLastReceivedUplink()->GetFrameHeader().GetAdr() || HasLinkAdrReq(status))
+        {
+            continue;
+        }
+
+        NS_ABORT_MSG_IF(int(status->GetReceivedPacketList().GetCapacity()) < historyRange,
+                        "The HistoryDepth of EndDeviceStatus is smaller than the HistoryRange");
+        if (int(status->GetReceivedPacketList().GetSize()) < historyRange)
+        {
+            continue;
+        }
+
+        uint8_t spreadingFactor = status->GetFirstReceiveWindowSpreadingFactor();
+        statuses.push_back(status);
+        margins.push_back(GetHistorySNR(LoraDeviceAddress(entry.first), status) -
+                          threshold[SfToDr(spreadingFactor)]);
+        spreadingFactors.push_back(spreadingFactor);
+        txPowers.push_back(status->GetMac()->GetTransmissionPower());
+    }
+
+    NS_LOG_DEBUG("Running ADR for " << statuses.size() << " devices");
+
+    // Same algorithm as AdrImplementation, with its loops replaced by closed
+    // forms so that each step is a loop over all devices
+    std::size_t nDevices = statuses.size();
+    std::vector<int> steps(nDevices);
+    std::vector<int> newSpreadingFactors(nDevices);
+    std::vector<double> newTxPowers(nDevices);
+    for (std::size_t i = 0; i < nDevices; i++)
+    {
+        steps[i] = std::floor(margins[i] / 3);
+    }
+    for (std::size_t i = 0; i < nDevices; i++)
+    {
+        // Increase the data rate first
+        int sfSteps = std::min(std::max(steps[i], 0),
+                               std::max(spreadingFactors[i] - min_spreadingFactor, 0));
+        newSpreadingFactors[i] = spreadingFactors[i] - sfSteps;
+        steps[i] -= sfSteps;
+    }
+    for (std::size_t i = 0; i < nDevices; i++)
+    {
+        // Then decrease the transmission power with the steps left, or
+        // increase it if the margin is negative
+        int down = std::min(
+            std::max(steps[i], 0),
+            int(std::ceil(std::max(txPowers[i] - min_transmissionPower, 0.0) / 2)));
+        int up = std::min(
+            std::max(-steps[i], 0),
+            int(std::ceil(std::max(max_transmissionPower - txPowers[i], 0.0) / 2)));
+        newTxPowers[i] = txPowers[i] + 2 * (up - down);
+    }
+
+    for (std::size_t i = 0; i < nDevices; i++)
+    {
+        uint8_t newDataRate = SfToDr(newSpreadingFactors[i]);
+        uint8_t newTxPower = m_toggleTxPower ? uint8_t(newTxPowers[i]) : uint8_t(txPowers[i]);
+        if (newDataRate != SfToDr(spreadingFactors[i]) || newTxPower != uint8_t(txPowers[i]))
+        {
+            QueueLinkAdrReq(statuses[i], newDataRate, newTxPower);
+        }
+    }
+
+    m_periodicEvent = Simulator::Schedule(m_period, &AdrComponent::RunPeriodicAdr, this);
+}
+
+void
+AdrComponent::QueueLinkAdrReq(Ptr<EndDeviceStatus> status, uint8_t dataRate, uint8_t txPower)
+{
+    // Create a list with mandatory channel indexes
+    int channels[] = {0, 1, 2};
+    std::list<int> enabledChannels(channels, channels + sizeof(channels) / sizeof(int));
+
+    // Repetitions Setting
+    const int rep = 1;
+
+    NS_LOG_DEBUG("Sending LinkAdrReq with DR = " << (unsigned)dataRate << " and TP = "
+                                                 << (unsigned)txPower << " dBm");
+
+    status->m_reply.frameHeader.AddLinkAdrReq(dataRate,
+                                              GetTxPowerIndex(txPower),
+                                              enabledChannels,
+                                              rep);
+    status->m_reply.frameHeader.SetAsDownlink();
+    status->m_reply.macHeader.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_DOWN);
+
+    status->m_reply.needsReply = true;
+}
+
+bool
+AdrComponent::HasLinkAdrReq(Ptr<EndDeviceStatus> status) const
+{
+    for (const auto& command : status->m_reply.frameHeader.GetCommands())
+    {
+        if (command->GetCommandType() == LINK_ADR_REQ)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void
 AdrComponent::OnFailedReply(Ptr<EndDeviceStatus> status, Ptr<NetworkStatus> networkStatus)
 {
@@ -182,18 +314,7 @@ AdrComponent::AdrImplementation(uint8_t* newDataRate,
                                 Ptr<EndDeviceStatus> status)
 {
     // Compute the maximum or median SNR, based on the boolean value historyAveraging
-    double m_SNR = 0;
-    switch (historyAveraging)
-    {
-    case AdrComponent::AVERAGE:
-        m_SNR = GetAverageSNR(status->GetReceivedPacketList(), historyRange);
-        break;
-    case AdrComponent::MAXIMUM:
-        m_SNR = GetMaxSNR(status->GetReceivedPacketList(), historyRange);
-        break;
-    case AdrComponent::MINIMUM:
-        m_SNR = GetMinSNR(status->GetReceivedPacketList(), historyRange);
-    }
+    double m_SNR = GetHistorySNR(status->GetLastReceivedUplink()->GetAddress(), status);
 
     NS_LOG_DEBUG("m_SNR = " << m_SNR);
 
@@ -291,16 +412,15 @@ AdrComponent::RxPowerToSNR(double transmissionPower) const
 
 // Get the maximum received power (it considers the values in dB!)
 double
-AdrComponent::GetMinTxFromGateways(EndDeviceStatus::GatewayList gwList)
+AdrComponent::GetMinTxFromGateways(const EndDeviceStatus::GatewayList& gwList)
 {
-    auto it = gwList.begin();
-    double min = it->second.rxPower;
+    double min = gwList.Get(0).rxPower;
 
-    for (; it != gwList.end(); it++)
+    for (std::size_t i = 0; i < gwList.GetSize(); i++)
     {
-        if (it->second.rxPower < min)
+        if (gwList.Get(i).rxPower < min)
         {
-            min = it->second.rxPower;
+            min = gwList.Get(i).rxPower;
         }
     }
 
@@ -309,16 +429,15 @@ AdrComponent::GetMinTxFromGateways(EndDeviceStatus::GatewayList gwList)
 
 // Get the maximum received power (it considers the values in dB!)
 double
-AdrComponent::GetMaxTxFromGateways(EndDeviceStatus::GatewayList gwList)
+AdrComponent::GetMaxTxFromGateways(const EndDeviceStatus::GatewayList& gwList)
 {
-    auto it = gwList.begin();
-    double max = it->second.rxPower;
+    double max = gwList.Get(0).rxPower;
 
-    for (; it != gwList.end(); it++)
+    for (std::size_t i = 0; i < gwList.GetSize(); i++)
     {
-        if (it->second.rxPower > max)
+        if (gwList.Get(i).rxPower > max)
         {
-            max = it->second.rxPower;
+            max = gwList.Get(i).rxPower;
         }
     }
 
@@ -327,17 +446,18 @@ AdrComponent::GetMaxTxFromGateways(EndDeviceStatus::GatewayList gwList)
 
 // Get the maximum received power
 double
-AdrComponent::GetAverageTxFromGateways(EndDeviceStatus::GatewayList gwList)
+AdrComponent::GetAverageTxFromGateways(const EndDeviceStatus::GatewayList& gwList)
 {
     double sum = 0;
 
-    for (auto it = gwList.begin(); it != gwList.end(); it++)
+    for (std::size_t i = 0; i < gwList.GetSize(); i++)
     {
-        NS_LOG_DEBUG("Gateway at " << it->first << " has TP " << it->second.rxPower);
-        sum += it->second.rxPower;
+        NS_LOG_DEBUG("Gateway at " << gwList.Get(i).gwAddress << " has TP "
+                                   << gwList.Get(i).rxPower);
+        sum += gwList.Get(i).rxPower;
     }
 
-    double average = sum / gwList.size();
+    double average = sum / gwList.GetSize();
 
     NS_LOG_DEBUG("TP (average) = " << average);
 
@@ -345,7 +465,7 @@ AdrComponent::GetAverageTxFromGateways(EndDeviceStatus::GatewayList gwList)
 }
 
 double
-AdrComponent::GetReceivedPower(EndDeviceStatus::GatewayList gwList)
+AdrComponent::GetReceivedPower(const EndDeviceStatus::GatewayList& gwList)
 {
     switch (tpAveraging)
     {
@@ -360,84 +480,75 @@ AdrComponent::GetReceivedPower(EndDeviceStatus::GatewayList gwList)
     }
 }
 
-// TODO Make this more elegant
-double
-AdrComponent::GetMinSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange)
+AdrComponent::DeviceHistory&
+AdrComponent::UpdateHistory(LoraDeviceAddress address, Ptr<EndDeviceStatus> status)
 {
-    double m_SNR;
-
-    // Take elements from the list starting at the end
-    auto it = packetList.rbegin();
-    double min = RxPowerToSNR(GetReceivedPower(it->second.gwList));
-
-    for (int i = 0; i < historyRange; i++, it++)
+    DeviceHistory& history = m_histories[address.Get()];
+    if (!history.status)
     {
-        m_SNR = RxPowerToSNR(GetReceivedPower(it->second.gwList));
-
-        NS_LOG_DEBUG("Received power: " << GetReceivedPower(it->second.gwList));
-        NS_LOG_DEBUG("m_SNR = " << m_SNR);
-
-        if (m_SNR < min)
-        {
-            min = m_SNR;
-        }
+        history.status = status;
+    }
+    std::size_t capacity = std::max(historyRange - 1, 0);
+    if (history.window.GetCapacity() != capacity)
+    {
+        // The HistoryRange changed: start over from the packets still in the
+        // history of the device
+        history.window = SnrWindow(capacity);
+        history.sealed = 0;
     }
 
-    NS_LOG_DEBUG("SNR (min) = " << min);
-
-    return min;
-}
-
-double
-AdrComponent::GetMaxSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange)
-{
-    double m_SNR;
-
-    // Take elements from the list starting at the end
-    auto it = packetList.rbegin();
-    double max = RxPowerToSNR(GetReceivedPower(it->second.gwList));
+    // Skip the packets that left the history of the device, or that would
+    // leave the window anyway
+    const EndDeviceStatus::ReceivedPacketList& packetList = status->GetReceivedPacketList();
+    if (packetList.IsEmpty())
+    {
+        return history;
+    }
+    uint64_t last = packetList.GetInsertedCount() - 1;
+    uint64_t first = std::max({history.sealed,
+                               packetList.GetInsertedCount() - packetList.GetSize(),
+                               last - std::min<uint64_t>(last, capacity)});
 
-    for (int i = 0; i < historyRange; i++, it++)
+    for (uint64_t sequence = first; sequence < last; sequence++)
     {
-        m_SNR = RxPowerToSNR(GetReceivedPower(it->second.gwList));
+        const EndDeviceStatus::GatewayList& gwList = packetList.GetRecent(last - sequence).gwList;
+        double snr = RxPowerToSNR(GetReceivedPower(gwList));
 
-        NS_LOG_DEBUG("Received power: " << GetReceivedPower(it->second.gwList));
-        NS_LOG_DEBUG("m_SNR = " << m_SNR);
+        NS_LOG_DEBUG("Received power: " << GetReceivedPower(gwList));
+        NS_LOG_DEBUG("m_SNR = " << snr);
 
-        if (m_SNR > max)
-        {
-            max = m_SNR;
-        }
+        history.window.Push(snr);
     }
+    history.sealed = std::max(history.sealed, last);
 
-    NS_LOG_DEBUG("SNR (max) = " << max);
-
-    return max;
+    return history;
 }
 
 double
-AdrComponent::GetAverageSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange)
+AdrComponent::GetHistorySNR(LoraDeviceAddress address, Ptr<EndDeviceStatus> status)
 {
-    double sum = 0;
-    double m_SNR;
+    const SnrWindow& window = UpdateHistory(address, status).window;
 
-    // Take elements from the list starting at the end
-    auto it = packetList.rbegin();
-    for (int i = 0; i < historyRange; i++, it++)
-    {
-        m_SNR = RxPowerToSNR(GetReceivedPower(it->second.gwList));
+    // The last packet is combined with the window
+    double snr = RxPowerToSNR(GetReceivedPower(status->GetReceivedPacketList().GetRecent().gwList));
 
-        NS_LOG_DEBUG("Received power: " << GetReceivedPower(it->second.gwList));
-        NS_LOG_DEBUG("m_SNR = " << m_SNR);
-
-        sum += m_SNR;
+    switch (historyAveraging)
+    {
+    case AdrComponent::AVERAGE:
+        snr = (window.GetSum() + snr) / (window.GetSize() + 1);
+        NS_LOG_DEBUG("SNR (average) = " << snr);
+        break;
+    case AdrComponent::MAXIMUM:
+        snr = window.GetSize() ? std::max(window.GetMax(), snr) : snr;
+        NS_LOG_DEBUG("SNR (max) = " << snr);
+        break;
+    case AdrComponent::MINIMUM:
+        snr = window.GetSize() ? std::min(window.GetMin(), snr) : snr;
+        NS_LOG_DEBUG("SNR (min) = " << snr);
+        break;
     }
 
-    double average = sum / historyRange;
-
-    NS_LOG_DEBUG("SNR (average) = " << average);
-
-    return average;
+    return snr;
 }
 
 int
@@ -476,5 +587,100 @@ AdrComponent::GetTxPowerIndex(int txPower)
         return 7;
     }
 }
+
+AdrComponent::SnrWindow::SnrWindow(std::size_t capacity)
+    : m_values(capacity)
+{
+    NS_ASSERT_MSG(capacity <= 255, "SnrWindow positions are stored on 8 bits");
+    m_min.positions.resize(capacity);
+    m_max.positions.resize(capacity);
+}
+
+void
+AdrComponent::SnrWindow::Push(double snr)
+{
+    if (m_values.empty())
+    {
+        return;
+    }
+
+    std::size_t position = m_next;
+    if (m_size == m_values.size())
+    {
+        // The oldest value leaves the window
+        m_sum -= m_values[position];
+        PopFront(m_min, position);
+        PopFront(m_max, position);
+    }
+    else
+    {
+        m_size++;
+    }
+
+    m_values[position] = snr;
+    m_sum += snr;
+    PushBack(m_min, position, [](double value, double other) { return value <= other; });
+    PushBack(m_max, position, [](double value, double other) { return value >= other; });
+    m_next = (position + 1) % m_values.size();
+}
+
+std::size_t
+AdrComponent::SnrWindow::GetSize() const
+{
+    return m_size;
+}
+
+std::size_t
+AdrComponent::SnrWindow::GetCapacity() const
+{
+    return m_values.size();
+}
+
+double
+AdrComponent::SnrWindow::GetSum() const
+{
+    return m_sum;
+}
+
+double
+AdrComponent::SnrWindow::GetMin() const
+{
+    NS_ASSERT(m_min.size > 0);
+    return m_values[m_min.positions[m_min.head]];
+}
+
+double
+AdrComponent::SnrWindow::GetMax() const
+{
+    NS_ASSERT(m_max.size > 0);
+    return m_values[m_max.positions[m_max.head]];
+}
+
+template <typename Dominates>
+void
+AdrComponent::SnrWindow::PushBack(MonotonicQueue& queue, std::size_t position, Dominates dominates)
+{
+    std::size_t capacity = m_values.size();
+
+    // Older values that the new one dominates can never be the extreme again
+    while (queue.size > 0 &&
+           dominates(m_values[position],
+                     m_values[queue.positions[(queue.head + queue.size - 1) % capacity]]))
+    {
+        queue.size--;
+    }
+    queue.positions[(queue.head + queue.size) % capacity] = position;
+    queue.size++;
+}
+
+void
+AdrComponent::SnrWindow::PopFront(MonotonicQueue& queue, std::size_t position)
+{
+    if (queue.size > 0 && queue.positions[queue.head] == position)
+    {
+        queue.head = (queue.head + 1) % m_values.size();
+        queue.size--;
+    }
+}
 } // namespace lorawan
 } // namespace ns3
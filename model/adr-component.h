@@ -23,10 +23,18 @@
 #include "network-controller-components.h"
 #include "network-status.h"
 
+#include "ns3/event-id.h"
 #include "ns3/log.h"
+#include "ns3/nstime.h"
 #include "ns3/object.h"
 #include "ns3/packet.h"
 
+#include <unordered_map>
+#include <vector>
+
+class AdrHistoryTest;
+class AdrPeriodicTest;
+
 namespace ns3
 {
 namespace lorawan
@@ -36,6 +44,11 @@ namespace lorawan
  * \ingroup lorawan
  *
  * LinkAdrRequest commands management
+ *
+ * By default, the ADR algorithm runs for a device just before a reply is sent to it. If the Period
+ * attribute is set, it instead runs for all devices at once every Period, and the resulting
+ * LinkAdrReq commands are queued in the replies of the devices, to be sent at their next downlink
+ * opportunity.
  */
 class AdrComponent : public NetworkControllerComponent
 {
@@ -59,7 +72,7 @@ class AdrComponent : public NetworkControllerComponent
     AdrComponent();           //!< Default constructor
     ~AdrComponent() override; //!< Destructor
 
-    void OnReceivedPacket(Ptr<const Packet> packet,
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                           Ptr<EndDeviceStatus> status,
                           Ptr<NetworkStatus> networkStatus) override;
 
@@ -68,6 +81,146 @@ class AdrComponent : public NetworkControllerComponent
     void OnFailedReply(Ptr<EndDeviceStatus> status, Ptr<NetworkStatus> networkStatus) override;
 
   private:
+    friend class ::AdrHistoryTest;
+    friend class ::AdrPeriodicTest;
+
+    /**
+     * Sliding window over the Signal to Noise Ratio (SNR) of the last packets of a device.
+     *
+     * The sum, minimum and maximum of the window are kept up to date as packets are added, the
+     * latter two through monotonic queues, so that each of them is available in constant time.
+     */
+    class SnrWindow
+    {
+      public:
+        /**
+         * Construct an empty window.
+         *
+         * \param capacity The maximum number of packets in the window (at most 255).
+         */
+        SnrWindow(std::size_t capacity = 0);
+
+        /**
+         * Add the SNR of a packet, dropping the oldest one if the window is full.
+         *
+         * \param snr The SNR of the packet [dB].
+         */
+        void Push(double snr);
+
+        /**
+         * \return The number of packets in the window.
+         */
+        std::size_t GetSize() const;
+
+        /**
+         * \return The maximum number of packets in the window.
+         */
+        std::size_t GetCapacity() const;
+
+        /**
+         * \return The sum of the SNR of the packets in the window.
+         */
+        double GetSum() const;
+
+        /**
+         * \return The minimum SNR of the packets in the window, which must not be empty.
+         */
+        double GetMin() const;
+
+        /**
+         * \return The maximum SNR of the packets in the window, which must not be empty.
+         */
+        double GetMax() const;
+
+      private:
+        /**
+         * Positions in the window whose values are monotonic, from the oldest to the newest, stored
+         * in a ring buffer.
+         */
+        struct MonotonicQueue
+        {
+            std::vector<uint8_t> positions; //!< The ring buffer of positions
+            std::size_t head = 0;           //!< The index of the oldest position
+            std::size_t size = 0;           //!< The number of positions in the queue
+        };
+
+        /**
+         * Add a position at the back of a monotonic queue, removing the positions whose value is
+         * dominated by the new one.
+         *
+         * \param queue The queue.
+         * \param position The position of the new value.
+         * \param dominates Whether its first argument makes its second one useless.
+         */
+        template <typename Dominates>
+        void PushBack(MonotonicQueue& queue, std::size_t position, Dominates dominates);
+
+        /**
+         * Remove a position from the front of a monotonic queue, if it is there.
+         *
+         * \param queue The queue.
+         * \param position The position leaving the window.
+         */
+        void PopFront(MonotonicQueue& queue, std::size_t position);
+
+        std::vector<double> m_values; //!< The ring buffer of values
+        std::size_t m_next = 0;       //!< The position of the next value
+        std::size_t m_size = 0;       //!< The number of values in the window
+        double m_sum = 0;             //!< The sum of the values
+        MonotonicQueue m_min;         //!< Queue of increasing values, giving the minimum
+        MonotonicQueue m_max;         //!< Queue of decreasing values, giving the maximum
+    };
+
+    /**
+     * The packet history of a device, as seen by ADR.
+     */
+    struct DeviceHistory
+    {
+        SnrWindow window;            //!< The SNR of the packets preceding the last one
+        uint64_t sealed = 0;         //!< The number of packets added to the window so far
+        Ptr<EndDeviceStatus> status; //!< The status of the device
+    };
+
+    /**
+     * Add to the window of a device the SNR of the packets that preceded its last one.
+     *
+     * The SNR of a packet is computed once, when the next packet of the device is received, so
+     * that all gateway copies of the packet have been merged in its reception information. The
+     * last packet is left out, since more copies of it may still arrive.
+     *
+     * \param address The address of the device.
+     * \param status The status of the device.
+     * \return The packet history of the device.
+     */
+    DeviceHistory& UpdateHistory(LoraDeviceAddress address, Ptr<EndDeviceStatus> status);
+
+    /**
+     * Run the ADR algorithm for all devices whose last packet requested it, and schedule the next
+     * run after Period. If no uplink was received since the last run, nothing is done and no run
+     * is scheduled: the next uplink schedules one.
+     *
+     * The SNR margin, spreading factor and transmission power of the devices are gathered in
+     * arrays, and the new parameters of all devices are computed in loops over these arrays.
+     */
+    void RunPeriodicAdr();
+
+    /**
+     * Add a LinkAdrReq command to the reply to a device.
+     *
+     * \param status The status of the device.
+     * \param dataRate The new data rate of the device.
+     * \param txPower The new transmission power of the device [dBm].
+     */
+    void QueueLinkAdrReq(Ptr<EndDeviceStatus> status, uint8_t dataRate, uint8_t txPower);
+
+    /**
+     * Check whether the reply to a device already contains a LinkAdrReq command.
+     *
+     * \param status The status of the device.
+     * \return True if a LinkAdrReq command is waiting to be sent to the device.
+     */
+    bool HasLinkAdrReq(Ptr<EndDeviceStatus> status) const;
+
     /**
      * Implementation of the default Adaptive Data Rate (ADR) procedure.
      *
@@ -109,53 +262,38 @@ class AdrComponent : public NetworkControllerComponent
      * \param gwList List of gateways paired with reception information.
      * \return Min RSSI of transmission as double.
      */
-    double GetMinTxFromGateways(EndDeviceStatus::GatewayList gwList);
+    double GetMinTxFromGateways(const EndDeviceStatus::GatewayList& gwList);
     /**
      * Get the max RSSI (dBm) among gateways receiving the same transmission.
      *
      * \param gwList List of gateways paired with packet reception information.
      * \return Max RSSI of transmission as double.
      */
-    double GetMaxTxFromGateways(EndDeviceStatus::GatewayList gwList);
+    double GetMaxTxFromGateways(const EndDeviceStatus::GatewayList& gwList);
     /**
      * Get the average RSSI (dBm) of gateways receiving the same transmission.
      *
      * \param gwList List of gateways paired with packet reception information.
      * \return Average RSSI of transmission as double.
      */
-    double GetAverageTxFromGateways(EndDeviceStatus::GatewayList gwList);
+    double GetAverageTxFromGateways(const EndDeviceStatus::GatewayList& gwList);
     /**
      * Get RSSI metric for a transmission according to chosen gateway aggregation policy.
      *
      * \param gwList List of gateways paired with packet reception information.
      * \return RSSI of tranmsmission as double.
      */
-    double GetReceivedPower(EndDeviceStatus::GatewayList gwList);
+    double GetReceivedPower(const EndDeviceStatus::GatewayList& gwList);
 
     /**
-     * Get the min Signal to Noise Ratio (SNR) of the receive packet history.
-     *
-     * \param packetList History of received packets with reception information.
-     * \param historyRange Number of packets to consider going back in time.
-     * \return Min SNR among packets as double.
-     */
-    double GetMinSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange);
-    /**
-     * Get the max Signal to Noise Ratio (SNR) of the receive packet history.
-     *
-     * \param packetList History of received packets with reception information.
-     * \param historyRange Number of packets to consider going back in time.
-     * \return Max SNR among packets as double.
-     */
-    double GetMaxSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange);
-    /**
-     * Get the average Signal to Noise Ratio (SNR) of the received packet history.
+     * Get the Signal to Noise Ratio (SNR) of the last historyRange packets of a device, combined
+     * according to the history aggregation policy.
      *
-     * \param packetList History of received packets with reception information.
-     * \param historyRange Number of packets to consider going back in time.
-     * \return Average SNR of packets as double.
+     * \param address The address of the device.
+     * \param status The status of the device.
+     * \return The combined SNR [dB].
      */
-    double GetAverageSNR(EndDeviceStatus::ReceivedPacketList packetList, int historyRange);
+    double GetHistorySNR(LoraDeviceAddress address, Ptr<EndDeviceStatus> status);
 
     /**
      * Get the LoRaWAN protocol TXPower configuration index from the Equivalent Isotropically
@@ -186,6 +324,12 @@ class AdrComponent : public NetworkControllerComponent
                //!< levels ranging from 7 to 12 (the SNR values are in dB).
 
     bool m_toggleTxPower; //!< Whether to control transmission power of end devices or not
+
+    std::unordered_map<uint32_t, DeviceHistory> m_histories; //!< Packet histories, by address
+
+    Time m_period;           //!< The period of the ADR algorithm, zero to run it before each reply
+    EventId m_periodicEvent; //!< The next run of the ADR algorithm
+    bool m_newUplinks;       //!< Whether uplinks were received since the last run
 };
 } // namespace lorawan
 } // namespace ns3
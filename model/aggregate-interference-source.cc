@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aggregate-interference-source.h"
+
+#include "end-device-lora-phy.h"
+#include "lora-frame-header.h"
+#include "lora-net-device.h"
+#include "lorawan-mac-header.h"
+
+#include "ns3/abort.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3
+{
+namespace lorawan
+{
+
+NS_LOG_COMPONENT_DEFINE("AggregateInterferenceSource");
+
+NS_OBJECT_ENSURE_REGISTERED(AggregateInterferenceSource);
+
+TypeId
+AggregateInterferenceSource::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::AggregateInterferenceSource")
+            .SetParent<Object>()
+            .SetGroupName("lorawan")
+            .AddConstructor<AggregateInterferenceSource>()
+            .AddAttribute("NDevices",
+                          "The number of end devices outside of the region of interest",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&AggregateInterferenceSource::m_nDevices),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("Period",
+                          "The period of the transmissions of each device",
+                          TimeValue(Seconds(600)),
+                          MakeTimeAccessor(&AggregateInterferenceSource::m_period),
+                          MakeTimeChecker(TimeStep(1)))
+            .AddAttribute("PacketSize",
+                          "The application payload of the transmissions of each device, in bytes",
+                          UintegerValue(23),
+                          MakeUintegerAccessor(&AggregateInterferenceSource::m_pktSize),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TxPower",
+                          "The transmission power of the devices, in dBm",
+                          DoubleValue(14),
+                          MakeDoubleAccessor(&AggregateInterferenceSource::m_txPowerDbm),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("NSamples",
+                          "The number of devices whose reception powers are computed to sample "
+                          "the path loss distribution of the population",
+                          UintegerValue(10000),
+                          MakeUintegerAccessor(&AggregateInterferenceSource::m_nSamples),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+AggregateInterferenceSource::AggregateInterferenceSource()
+    : m_regionRadius(0),
+      m_frequencies({868.1, 868.3, 868.5}),
+      m_nTransmissions(0)
+{
+    NS_LOG_FUNCTION(this);
+
+    m_interval = CreateObject<ExponentialRandomVariable>();
+    m_uniform = CreateObject<UniformRandomVariable>();
+}
+
+AggregateInterferenceSource::~AggregateInterferenceSource()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+AggregateInterferenceSource::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_nextTransmission.Cancel();
+    m_phys.clear();
+    m_allocator = nullptr;
+    m_packets.fill(nullptr);
+
+    Object::DoDispose();
+}
+
+void
+AggregateInterferenceSource::SetPositionAllocator(Ptr<PositionAllocator> allocator)
+{
+    m_allocator = allocator;
+}
+
+void
+AggregateInterferenceSource::SetRegion(Vector center, double radius)
+{
+    NS_LOG_FUNCTION(this << center << radius);
+
+    m_regionCenter = center;
+    m_regionRadius = radius;
+}
+
+void
+AggregateInterferenceSource::SetFrequencies(std::vector<double> frequenciesMHz)
+{
+    NS_ASSERT(!frequenciesMHz.empty());
+
+    m_frequencies = frequenciesMHz;
+}
+
+void
+AggregateInterferenceSource::Install(Ptr<LoraChannel> channel, NodeContainer gateways)
+{
+    NS_LOG_FUNCTION(this << channel);
+
+    NS_ABORT_MSG_UNLESS(m_allocator, "No position allocator was set");
+
+    m_phys.clear();
+    for (auto gw = gateways.Begin(); gw != gateways.End(); ++gw)
+    {
+        Ptr<LoraNetDevice> device = (*gw)->GetDevice(0)->GetObject<LoraNetDevice>();
+        NS_ASSERT(device);
+        m_phys.push_back(device->GetPhy());
+    }
+
+    // Transmissions under the floor of the channel would not be delivered
+    DoubleValue floor;
+    channel->GetAttribute("InterferenceFloor", floor);
+
+    // Sample the population, keeping the powers at the gateways it reaches
+    m_samples.clear();
+    m_rxGateways.clear();
+    m_rxPowers.clear();
+    Ptr<ConstantPositionMobilityModel> sender = CreateObject<ConstantPositionMobilityModel>();
+    for (uint32_t i = 0; i < m_nSamples; i++)
+    {
+        Vector position;
+        uint32_t attempts = 0;
+        do
+        {
+            position = m_allocator->GetNext();
+            NS_ABORT_MSG_IF(++attempts > 1000,
+                            "The position allocator only draws positions in the region");
+        } while (m_regionRadius > 0 &&
+                 std::hypot(position.x - m_regionCenter.x, position.y - m_regionCenter.y) <
+                     m_regionRadius);
+        sender->SetPosition(position);
+
+        Sample sample;
+        sample.offset = m_rxPowers.size();
+        double highestRxPower = -std::numeric_limits<double>::infinity();
+        for (uint32_t gw = 0; gw < m_phys.size(); gw++)
+        {
+            double rxPower = channel->GetRxPower(m_txPowerDbm, sender, m_phys[gw]->GetMobility());
+            highestRxPower = std::max(highestRxPower, rxPower);
+            if (rxPower >= floor.Get())
+            {
+                m_rxGateways.push_back(gw);
+                m_rxPowers.push_back(rxPower);
+            }
+        }
+        sample.nPowers = m_rxPowers.size() - sample.offset;
+
+        // Same assignment as LorawanMacHelper::SetSpreadingFactorsUp
+        sample.sf = 12;
+        for (uint8_t sf = 7; sf <= 12; sf++)
+        {
+            if (highestRxPower > EndDeviceLoraPhy::sensitivity[sf - 7])
+            {
+                sample.sf = sf;
+                break;
+            }
+        }
+        m_samples.push_back(sample);
+    }
+
+    // Build the packets sent by the devices, as the MAC layer would
+    for (uint8_t sf = 7; sf <= 12; sf++)
+    {
+        Ptr<Packet> packet = Create<Packet>(m_pktSize);
+        LoraFrameHeader frameHdr;
+        frameHdr.SetAsUplink();
+        frameHdr.SetFPort(1);
+        packet->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        packet->AddHeader(macHdr);
+
+        LoraTxParameters txParams;
+        txParams.sf = sf;
+        txParams.headerDisabled = false;
+        txParams.codingRate = 1;
+        txParams.bandwidthHz = 125000;
+        txParams.nPreamble = 8;
+        txParams.crcEnabled = true;
+        txParams.lowDataRateOptimizationEnabled = LoraPhy::GetTSym(txParams) > MilliSeconds(16);
+
+        m_packets[sf - 7] = packet;
+        m_durations[sf - 7] = LoraPhy::GetOnAirTime(packet, txParams);
+    }
+
+    // The transmissions of devices with random phases form a Poisson process
+    if (m_nDevices > 0)
+    {
+        m_interval->SetAttribute("Mean", DoubleValue(m_period.GetSeconds() / m_nDevices));
+    }
+
+    NS_LOG_INFO("Sampled " << m_samples.size() << " devices reaching on average "
+                           << double(m_rxPowers.size()) / m_samples.size() << " gateways");
+}
+
+void
+AggregateInterferenceSource::Start(Time start)
+{
+    NS_LOG_FUNCTION(this << start);
+
+    NS_ABORT_MSG_IF(m_samples.empty(), "The source was not installed");
+
+    if (m_nDevices > 0)
+    {
+        m_nextTransmission.Cancel();
+        m_nextTransmission = Simulator::Schedule(start + Seconds(m_interval->GetValue()),
+                                                 &AggregateInterferenceSource::Transmit,
+                                                 this);
+    }
+}
+
+void
+AggregateInterferenceSource::Stop(Time stop)
+{
+    NS_LOG_FUNCTION(this << stop);
+
+    Simulator::Schedule(stop, &AggregateInterferenceSource::DoStop, this);
+}
+
+void
+AggregateInterferenceSource::DoStop()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_nextTransmission.Cancel();
+}
+
+uint64_t
+AggregateInterferenceSource::GetTransmissionCount() const
+{
+    return m_nTransmissions;
+}
+
+int64_t
+AggregateInterferenceSource::AssignStreams(int64_t stream)
+{
+    NS_LOG_FUNCTION(this << stream);
+
+    m_interval->SetStream(stream);
+    m_uniform->SetStream(stream + 1);
+    return 2;
+}
+
+void
+AggregateInterferenceSource::Transmit()
+{
+    NS_LOG_FUNCTION(this);
+
+    const Sample& sample = m_samples[m_uniform->GetInteger(0, m_samples.size() - 1)];
+    double frequencyMHz = m_frequencies[m_uniform->GetInteger(0, m_frequencies.size() - 1)];
+    m_nTransmissions++;
+
+    if (sample.nPowers > 0)
+    {
+        Ptr<LoraInterferenceHelper::Transmission> transmission =
+            Create<LoraInterferenceHelper::Transmission>(m_durations[sample.sf - 7],
+                                                         sample.sf,
+                                                         m_packets[sample.sf - 7],
+                                                         frequencyMHz);
+        for (std::size_t k = sample.offset; k < sample.offset + sample.nPowers; k++)
+        {
+            m_phys[m_rxGateways[k]]->AddInterference(transmission, m_rxPowers[k]);
+        }
+    }
+
+    m_nextTransmission = Simulator::Schedule(Seconds(m_interval->GetValue()),
+                                             &AggregateInterferenceSource::Transmit,
+                                             this);
+}
+
+} // namespace lorawan
+} // namespace ns3
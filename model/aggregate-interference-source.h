@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AGGREGATE_INTERFERENCE_SOURCE_H
+#define AGGREGATE_INTERFERENCE_SOURCE_H
+
+#include "lora-channel.h"
+#include "lora-interference-helper.h"
+#include "lora-phy.h"
+
+#include "ns3/event-id.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/position-allocator.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/vector.h"
+
+#include <array>
+#include <vector>
+
+namespace ns3
+{
+namespace lorawan
+{
+
+/**
+ * \ingroup lorawan
+ *
+ * Stands for a population of end devices that are not simulated explicitly,
+ * by injecting their transmissions as interference at the gateways.
+ *
+ * The population is made of NDevices devices, placed by a position allocator
+ * outside of a circular region of interest, where devices are simulated
+ * explicitly. Each device is assumed to send a packet of PacketSize bytes every
+ * Period, with a random phase: the superposition of their transmissions is
+ * approximated by a Poisson process of rate NDevices / Period. At calibration
+ * (Install), the position of NSamples devices is drawn from the allocator,
+ * and the power each of them is received with at each gateway is computed with
+ * the propagation loss of the channel, so that the path loss distribution of
+ * the population is sampled, including the correlation between the powers
+ * received by different gateways. Each device gets the spreading factor that
+ * LorawanMacHelper::SetSpreadingFactorsUp would assign it.
+ *
+ * Each transmission of the process picks one of the sampled devices and a
+ * random frequency, and is added to the LoraInterferenceHelper of each gateway
+ * it reaches above the InterferenceFloor of the channel, as a LoRa
+ * transmission of that spreading factor and frequency would. Background
+ * transmissions are only interference: they don't occupy the reception paths
+ * of gateways, and are not seen by end devices.
+ */
+class AggregateInterferenceSource : public Object
+{
+  public:
+    /**
+     *  Register this type.
+     *  \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    AggregateInterferenceSource();           //!< Default constructor
+    ~AggregateInterferenceSource() override; //!< Destructor
+
+    /**
+     * Set the position allocator drawing the positions of background devices.
+     *
+     * \param allocator The position allocator.
+     */
+    void SetPositionAllocator(Ptr<PositionAllocator> allocator);
+
+    /**
+     * Set the region where devices are simulated explicitly: positions drawn
+     * inside it are discarded.
+     *
+     * \param center The center of the region.
+     * \param radius The radius of the region, on the X and Y coordinates [m].
+     */
+    void SetRegion(Vector center, double radius);
+
+    /**
+     * Set the frequencies used by the background devices.
+     *
+     * \param frequenciesMHz The frequencies [MHz].
+     */
+    void SetFrequencies(std::vector<double> frequenciesMHz);
+
+    /**
+     * Sample the population of background devices, and attach the source to
+     * the gateways.
+     *
+     * \param channel The channel, whose propagation loss is used.
+     * \param gateways The gateways receiving the background transmissions.
+     */
+    void Install(Ptr<LoraChannel> channel, NodeContainer gateways);
+
+    /**
+     * Schedule the start of the background transmissions.
+     *
+     * \param start The time of the start.
+     */
+    void Start(Time start);
+
+    /**
+     * Schedule the end of the background transmissions.
+     *
+     * \param stop The time of the end.
+     */
+    void Stop(Time stop);
+
+    /**
+     * Get the number of background transmissions injected so far.
+     *
+     * \return The number of transmissions.
+     */
+    uint64_t GetTransmissionCount() const;
+
+    /**
+     * Assign a fixed random variable stream number to the random variables
+     * used by this source.
+     *
+     * \param stream The first stream index to use.
+     * \return The number of stream indices assigned.
+     */
+    int64_t AssignStreams(int64_t stream);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * A device of the sampled population.
+     */
+    struct Sample
+    {
+        uint8_t sf;          //!< The spreading factor of the device
+        std::size_t offset;  //!< The index of its first power in m_rxPowers
+        std::size_t nPowers; //!< The number of gateways reached by the device
+    };
+
+    /**
+     * Inject a background transmission, and schedule the next one.
+     */
+    void Transmit();
+
+    /**
+     * Stop injecting transmissions.
+     */
+    void DoStop();
+
+    uint32_t m_nDevices; //!< The number of background devices
+    Time m_period;       //!< The period of the transmissions of each device
+    uint32_t m_pktSize;  //!< The application payload of the transmissions [bytes]
+    double m_txPowerDbm; //!< The transmission power of the devices [dBm]
+    uint32_t m_nSamples; //!< The number of devices sampled at calibration
+
+    Ptr<PositionAllocator> m_allocator; //!< The positions of background devices
+    Vector m_regionCenter;              //!< The center of the region of interest
+    double m_regionRadius;              //!< The radius of the region of interest
+    std::vector<double> m_frequencies;  //!< The frequencies of the devices [MHz]
+
+    std::vector<Ptr<LoraPhy>> m_phys;     //!< The PHYs of the gateways
+    std::vector<Sample> m_samples;        //!< The sampled devices
+    std::vector<uint32_t> m_rxGateways;   //!< The gateway reached by each power
+    std::vector<double> m_rxPowers;       //!< The powers received from the sampled devices
+    std::array<Time, 6> m_durations;      //!< The on-air time of packets, by SF - 7
+    std::array<Ptr<Packet>, 6> m_packets; //!< The packet of transmissions, by SF - 7
+
+    Ptr<ExponentialRandomVariable> m_interval; //!< The time between two transmissions
+    Ptr<UniformRandomVariable> m_uniform;      //!< Picks samples and frequencies
+    EventId m_nextTransmission;                //!< The next transmission
+    uint64_t m_nTransmissions;                 //!< The number of transmissions injected
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* AGGREGATE_INTERFERENCE_SOURCE_H */
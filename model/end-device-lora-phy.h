@@ -152,12 +152,11 @@ class EndDeviceLoraPhy : public LoraPhy
     EndDeviceLoraPhy();           //!< Default constructor
     ~EndDeviceLoraPhy() override; //!< Destructor
 
+    using LoraPhy::StartReceive;
+
     // Implementation of LoraPhy's pure virtual functions
-    void StartReceive(Ptr<Packet> packet,
-                      double rxPowerDbm,
-                      uint8_t sf,
-                      Time duration,
-                      double frequencyMHz) override = 0;
+    void StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                      double rxPowerDbm) override = 0;
 
     // Implementation of LoraPhy's pure virtual functions
     void EndReceive(Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event) override = 0;
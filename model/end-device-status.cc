@@ -29,8 +29,10 @@
 #include "ns3/packet.h"
 #include "ns3/pointer.h"
 #include "ns3/simulator.h"
+#include "ns3/uinteger.h"
 
 #include <algorithm>
+#include <cstddef>
 
 namespace ns3
 {
@@ -39,13 +41,39 @@ namespace lorawan
 
 NS_LOG_COMPONENT_DEFINE("EndDeviceStatus");
 
+namespace
+{
+
+/// The size of the header in front of each EndDeviceStatus, which points to its pool
+constexpr std::size_t STATUS_HEADER_SIZE = alignof(std::max_align_t);
+
+/// The size of a block of a pool, which can hold a status or a link of the free list
+constexpr std::size_t STATUS_BLOCK_SIZE =
+    STATUS_HEADER_SIZE + (sizeof(EndDeviceStatus) + alignof(std::max_align_t) - 1) /
+                             alignof(std::max_align_t) * alignof(std::max_align_t);
+
+} // namespace
+
 TypeId
 EndDeviceStatus::GetTypeId()
 {
     static TypeId tid = TypeId("ns3::EndDeviceStatus")
                             .SetParent<Object>()
                             .AddConstructor<EndDeviceStatus>()
-                            .SetGroupName("lorawan");
+                            .SetGroupName("lorawan")
+                            .AddAttribute("HistoryDepth",
+                                          "Number of most recent packets whose reception "
+                                          "information is kept",
+                                          UintegerValue(20),
+                                          MakeUintegerAccessor(&EndDeviceStatus::SetHistoryDepth,
+                                                               &EndDeviceStatus::GetHistoryDepth),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("DeduplicationWindow",
+                                          "Time during which copies of a packet received by "
+                                          "other gateways are merged with the first one",
+                                          TimeValue(Seconds(1)),
+                                          MakeTimeAccessor(&EndDeviceStatus::m_dedupWindow),
+                                          MakeTimeChecker());
     return tid;
 }
 
@@ -53,7 +81,6 @@ EndDeviceStatus::EndDeviceStatus(LoraDeviceAddress endDeviceAddress,
                                  Ptr<ClassAEndDeviceLorawanMac> endDeviceMac)
     : m_reply(EndDeviceStatus::Reply()),
       m_endDeviceAddress(endDeviceAddress),
-      m_receivedPacketList(ReceivedPacketList()),
       m_mac(endDeviceMac)
 {
     NS_LOG_FUNCTION(endDeviceAddress);
@@ -65,7 +92,6 @@ EndDeviceStatus::EndDeviceStatus()
 
     // Initialize data structure
     m_reply = EndDeviceStatus::Reply();
-    m_receivedPacketList = ReceivedPacketList();
 }
 
 EndDeviceStatus::~EndDeviceStatus()
@@ -128,13 +154,7 @@ EndDeviceStatus::GetCompleteReplyPacket()
 
     // Add headers
     m_reply.frameHeader.SetAddress(m_endDeviceAddress);
-    Ptr<Packet> lastPacket = GetLastPacketReceivedFromDevice()->Copy();
-    LorawanMacHeader mHdr;
-    LoraFrameHeader fHdr;
-    fHdr.SetAsUplink();
-    lastPacket->RemoveHeader(mHdr);
-    lastPacket->RemoveHeader(fHdr);
-    m_reply.frameHeader.SetFCnt(fHdr.GetFCnt());
+    m_reply.frameHeader.SetFCnt(GetLastReceivedUplink()->GetFCnt());
     m_reply.macHeader.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_DOWN);
     replyPacket->AddHeader(m_reply.frameHeader);
     replyPacket->AddHeader(m_reply.macHeader);
@@ -180,13 +200,26 @@ EndDeviceStatus::GetMac()
     return m_mac;
 }
 
-EndDeviceStatus::ReceivedPacketList
+const EndDeviceStatus::ReceivedPacketList&
 EndDeviceStatus::GetReceivedPacketList() const
 {
     NS_LOG_FUNCTION_NOARGS();
     return m_receivedPacketList;
 }
 
+uint32_t
+EndDeviceStatus::GetHistoryDepth() const
+{
+    return m_receivedPacketList.GetCapacity();
+}
+
+void
+EndDeviceStatus::SetHistoryDepth(uint32_t depth)
+{
+    NS_LOG_FUNCTION(this << depth);
+    m_receivedPacketList.SetCapacity(depth);
+}
+
 void
 EndDeviceStatus::SetFirstReceiveWindowSpreadingFactor(uint8_t sf)
 {
@@ -241,24 +274,14 @@ EndDeviceStatus::SetReplyPayload(Ptr<Packet> replyPayload)
 ///////////////////////
 
 void
-EndDeviceStatus::InsertReceivedPacket(Ptr<const Packet> receivedPacket, const Address& gwAddress)
+EndDeviceStatus::InsertReceivedPacket(Ptr<const ParsedUplink> uplink,
+                                      const Address& gwAddress,
+                                      uint32_t gwId)
 {
     NS_LOG_FUNCTION_NOARGS();
 
-    // Create a copy of the packet
-    Ptr<Packet> myPacket = receivedPacket->Copy();
-
-    // Extract the headers
-    LorawanMacHeader macHdr;
-    myPacket->RemoveHeader(macHdr);
-
-    LoraFrameHeader frameHdr;
-    frameHdr.SetAsUplink();
-    myPacket->RemoveHeader(frameHdr);
-
     // Update current parameters
-    LoraTag tag;
-    myPacket->RemovePacketTag(tag);
+    const LoraTag& tag = uplink->GetTag();
     SetFirstReceiveWindowSpreadingFactor(tag.GetSpreadingFactor());
     SetFirstReceiveWindowFrequency(tag.GetFrequency());
 
@@ -266,59 +289,55 @@ EndDeviceStatus::InsertReceivedPacket(Ptr<const Packet> receivedPacket, const Ad
     ReceivedPacketInfo info;
     info.sf = tag.GetSpreadingFactor();
     info.frequency = tag.GetFrequency();
-    info.packet = receivedPacket;
-
-    double rcvPower = tag.GetReceivePower();
+    info.fCnt = uplink->GetFCnt();
+
+    PacketInfoPerGw gwInfo;
+    gwInfo.receivedTime = Simulator::Now();
+    gwInfo.rxPower = tag.GetReceivePower();
+    gwInfo.gwAddress = gwAddress;
+    gwInfo.gwId = gwId;
+
+    // Forget the packets first received before the deduplication window. The
+    // index is kept in a vector since a device rarely sends more than one packet
+    // per window, so that a device costs no allocation besides its entries.
+    auto live = std::find_if(m_dedupIndex.begin(), m_dedupIndex.end(), [this](const auto& e) {
+        return e.firstReceived + m_dedupWindow > Simulator::Now();
+    });
+    m_dedupIndex.erase(m_dedupIndex.begin(), live);
 
     // Perform insertion in list, also checking that the packet isn't already in
     // the list (it could have been already received by another gateway)
-
-    // Start searching from the end
-    auto it = m_receivedPacketList.rbegin();
-    for (; it != m_receivedPacketList.rend(); it++)
+    auto dedup = std::find_if(m_dedupIndex.begin(), m_dedupIndex.end(), [&info](const auto& e) {
+        return e.fCnt == info.fCnt;
+    });
+    if (dedup != m_dedupIndex.end())
     {
-        // Get the frame counter of the current packet to compare it with the
-        // newly received one
-        Ptr<Packet> packetCopy = ((*it).first)->Copy();
-        LorawanMacHeader currentMacHdr;
-        packetCopy->RemoveHeader(currentMacHdr);
-        LoraFrameHeader currentFrameHdr;
-        frameHdr.SetAsUplink();
-        packetCopy->RemoveHeader(currentFrameHdr);
-
-        NS_LOG_DEBUG("Received packet's frame counter: " << unsigned(frameHdr.GetFCnt())
-                                                         << "\nCurrent packet's frame counter: "
-                                                         << unsigned(currentFrameHdr.GetFCnt()));
-
-        if (frameHdr.GetFCnt() == currentFrameHdr.GetFCnt())
-        {
-            NS_LOG_INFO("Packet was already received by another gateway");
-
-            // This packet had already been received from another gateway:
-            // add this gateway's reception information.
-            GatewayList& gwList = it->second.gwList;
-
-            PacketInfoPerGw gwInfo;
-            gwInfo.receivedTime = Simulator::Now();
-            gwInfo.rxPower = rcvPower;
-            gwInfo.gwAddress = gwAddress;
-            gwList.insert(std::pair<Address, PacketInfoPerGw>(gwAddress, gwInfo));
+        NS_LOG_INFO("Packet was already received by another gateway");
 
-            NS_LOG_DEBUG("Size of gateway list: " << gwList.size());
+        // The packet may have left the list already, if more than HistoryDepth
+        // packets were received in the deduplication window
+        uint64_t age = m_receivedPacketList.GetInsertedCount() - 1 - dedup->sequence;
+        if (age < m_receivedPacketList.GetSize())
+        {
+            // Add this gateway's reception information
+            GatewayList& gwList = m_receivedPacketList.GetRecent(age).gwList;
+            gwList.Insert(gwInfo);
 
-            break; // Exit from the cycle
+            NS_LOG_DEBUG("Size of gateway list: " << gwList.GetSize());
         }
+        return;
     }
-    if (it == m_receivedPacketList.rend())
-    {
-        NS_LOG_INFO("Packet was received for the first time");
-        PacketInfoPerGw gwInfo;
-        gwInfo.receivedTime = Simulator::Now();
-        gwInfo.rxPower = rcvPower;
-        gwInfo.gwAddress = gwAddress;
-        info.gwList.insert(std::pair<Address, PacketInfoPerGw>(gwAddress, gwInfo));
-        m_receivedPacketList.emplace_back(receivedPacket, info);
-    }
+
+    NS_LOG_INFO("Packet was received for the first time");
+    info.gwList.Insert(gwInfo);
+    m_receivedPacketList.Insert(info);
+    m_lastUplink = uplink;
+
+    DedupEntry entry;
+    entry.fCnt = info.fCnt;
+    entry.sequence = m_receivedPacketList.GetInsertedCount() - 1;
+    entry.firstReceived = Simulator::Now();
+    m_dedupIndex.push_back(entry);
     NS_LOG_DEBUG(*this);
 }
 
@@ -326,10 +345,9 @@ EndDeviceStatus::ReceivedPacketInfo
 EndDeviceStatus::GetLastReceivedPacketInfo()
 {
     NS_LOG_FUNCTION_NOARGS();
-    auto it = m_receivedPacketList.rbegin();
-    if (it != m_receivedPacketList.rend())
+    if (!m_receivedPacketList.IsEmpty())
     {
-        return it->second;
+        return m_receivedPacketList.GetRecent();
     }
     else
     {
@@ -341,10 +359,9 @@ Ptr<const Packet>
 EndDeviceStatus::GetLastPacketReceivedFromDevice()
 {
     NS_LOG_FUNCTION_NOARGS();
-    auto it = m_receivedPacketList.rbegin();
-    if (it != m_receivedPacketList.rend())
+    if (m_lastUplink)
     {
-        return it->first;
+        return m_lastUplink->GetPacket();
     }
     else
     {
@@ -352,6 +369,13 @@ EndDeviceStatus::GetLastPacketReceivedFromDevice()
     }
 }
 
+Ptr<const ParsedUplink>
+EndDeviceStatus::GetLastReceivedUplink() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_lastUplink;
+}
+
 void
 EndDeviceStatus::InitializeReply()
 {
@@ -390,35 +414,237 @@ EndDeviceStatus::GetPowerGatewayMap()
     // Create a map of the gateways
     // Key: received power
     // Value: address of the corresponding gateway
-    ReceivedPacketInfo info = m_receivedPacketList.back().second;
-    GatewayList gwList = info.gwList;
+    const GatewayList& gwList = m_receivedPacketList.GetRecent().gwList;
 
     std::map<double, Address> gatewayPowers;
 
-    for (auto it = gwList.begin(); it != gwList.end(); it++)
+    for (std::size_t i = 0; i < gwList.GetSize(); i++)
     {
-        Address currentGwAddress = (*it).first;
-        double currentRxPower = (*it).second.rxPower;
+        Address currentGwAddress = gwList.Get(i).gwAddress;
+        double currentRxPower = gwList.Get(i).rxPower;
         gatewayPowers.insert(std::pair<double, Address>(currentRxPower, currentGwAddress));
     }
 
     return gatewayPowers;
 }
 
+void*
+EndDeviceStatus::operator new(std::size_t size)
+{
+    // Objects of derived classes have no header
+    if (size != sizeof(EndDeviceStatus))
+    {
+        return ::operator new(size);
+    }
+
+    auto block = static_cast<char*>(::operator new(STATUS_HEADER_SIZE + size));
+    *reinterpret_cast<Pool**>(block) = nullptr;
+    return block + STATUS_HEADER_SIZE;
+}
+
+void*
+EndDeviceStatus::operator new(std::size_t size, Pool& pool)
+{
+    // Objects of derived classes don't fit the blocks of the pool
+    if (size != sizeof(EndDeviceStatus))
+    {
+        return operator new(size);
+    }
+
+    // The status keeps its pool alive until it is released
+    auto block = static_cast<char*>(pool.Allocate());
+    *reinterpret_cast<Pool**>(block) = &pool;
+    pool.Ref();
+    return block + STATUS_HEADER_SIZE;
+}
+
+void
+EndDeviceStatus::operator delete(void* pointer, std::size_t size)
+{
+    if (size != sizeof(EndDeviceStatus))
+    {
+        ::operator delete(pointer);
+        return;
+    }
+
+    char* block = static_cast<char*>(pointer) - STATUS_HEADER_SIZE;
+    Pool* pool = *reinterpret_cast<Pool**>(block);
+    if (!pool)
+    {
+        ::operator delete(block);
+        return;
+    }
+    pool->Release(block);
+    pool->Unref();
+}
+
+void
+EndDeviceStatus::operator delete(void* pointer, Pool& pool)
+{
+    operator delete(pointer, sizeof(EndDeviceStatus));
+}
+
+EndDeviceStatus::Pool::~Pool()
+{
+    for (char* chunk : m_chunks)
+    {
+        ::operator delete(chunk);
+    }
+}
+
+void*
+EndDeviceStatus::Pool::Allocate()
+{
+    if (m_freeList)
+    {
+        void* block = m_freeList;
+        m_freeList = *static_cast<void**>(block);
+        return block;
+    }
+    if (m_nextBlock == CHUNK_SIZE)
+    {
+        m_chunks.push_back(static_cast<char*>(::operator new(CHUNK_SIZE * STATUS_BLOCK_SIZE)));
+        m_nextBlock = 0;
+    }
+    return m_chunks.back() + STATUS_BLOCK_SIZE * m_nextBlock++;
+}
+
+void
+EndDeviceStatus::Pool::Release(void* block)
+{
+    *static_cast<void**>(block) = m_freeList;
+    m_freeList = block;
+}
+
+bool
+EndDeviceStatus::GatewayList::Insert(const PacketInfoPerGw& info)
+{
+    for (std::size_t i = 0; i < GetSize(); i++)
+    {
+        if (Get(i).gwAddress == info.gwAddress)
+        {
+            return false;
+        }
+    }
+
+    if (m_nInline < m_inline.size())
+    {
+        m_inline[m_nInline++] = info;
+    }
+    else
+    {
+        m_spilled.push_back(info);
+    }
+    return true;
+}
+
+const EndDeviceStatus::PacketInfoPerGw&
+EndDeviceStatus::GatewayList::Get(std::size_t i) const
+{
+    NS_ASSERT(i < GetSize());
+    return i < m_nInline ? m_inline[i] : m_spilled[i - m_nInline];
+}
+
+std::size_t
+EndDeviceStatus::GatewayList::GetSize() const
+{
+    return m_nInline + m_spilled.size();
+}
+
+EndDeviceStatus::ReceivedPacketList::ReceivedPacketList(std::size_t capacity)
+    : m_capacity(capacity)
+{
+    NS_ASSERT(capacity > 0);
+}
+
+EndDeviceStatus::ReceivedPacketInfo&
+EndDeviceStatus::ReceivedPacketList::Insert(const ReceivedPacketInfo& info)
+{
+    // Slots are allocated as the list fills up, and reused once it is full
+    std::size_t slot = m_next;
+    if (m_packets.size() < m_capacity)
+    {
+        m_packets.push_back(info);
+    }
+    else
+    {
+        m_packets[slot] = info;
+    }
+    m_next = (m_next + 1) % m_capacity;
+    m_inserted++;
+    return m_packets[slot];
+}
+
+const EndDeviceStatus::ReceivedPacketInfo&
+EndDeviceStatus::ReceivedPacketList::GetRecent(std::size_t age) const
+{
+    NS_ASSERT(age < m_packets.size());
+    return m_packets[(m_next + m_packets.size() - 1 - age) % m_packets.size()];
+}
+
+EndDeviceStatus::ReceivedPacketInfo&
+EndDeviceStatus::ReceivedPacketList::GetRecent(std::size_t age)
+{
+    NS_ASSERT(age < m_packets.size());
+    return m_packets[(m_next + m_packets.size() - 1 - age) % m_packets.size()];
+}
+
+std::size_t
+EndDeviceStatus::ReceivedPacketList::GetSize() const
+{
+    return m_packets.size();
+}
+
+bool
+EndDeviceStatus::ReceivedPacketList::IsEmpty() const
+{
+    return m_packets.empty();
+}
+
+std::size_t
+EndDeviceStatus::ReceivedPacketList::GetCapacity() const
+{
+    return m_capacity;
+}
+
+uint64_t
+EndDeviceStatus::ReceivedPacketList::GetInsertedCount() const
+{
+    return m_inserted;
+}
+
+void
+EndDeviceStatus::ReceivedPacketList::SetCapacity(std::size_t capacity)
+{
+    NS_ASSERT(capacity > 0);
+
+    // Move the most recent packets to a new buffer, from the oldest one
+    std::vector<ReceivedPacketInfo> packets;
+    packets.reserve(std::min(capacity, m_packets.size()));
+    for (std::size_t age = std::min(capacity, m_packets.size()); age-- > 0;)
+    {
+        packets.push_back(GetRecent(age));
+    }
+    m_packets = std::move(packets);
+    m_capacity = capacity;
+    m_next = m_packets.size() % m_capacity;
+}
+
 std::ostream&
 operator<<(std::ostream& os, const EndDeviceStatus& status)
 {
-    os << "Total packets received: " << status.m_receivedPacketList.size() << std::endl;
+    const EndDeviceStatus::ReceivedPacketList& packetList = status.m_receivedPacketList;
+    os << "Last packets received: " << packetList.GetSize() << std::endl;
 
-    for (auto j = status.m_receivedPacketList.begin(); j != status.m_receivedPacketList.end(); j++)
+    // Print the packets from the oldest to the newest
+    for (std::size_t age = packetList.GetSize(); age-- > 0;)
     {
-        EndDeviceStatus::ReceivedPacketInfo info = (*j).second;
-        EndDeviceStatus::GatewayList gatewayList = info.gwList;
-        Ptr<const Packet> pkt = (*j).first;
-        os << pkt << " " << gatewayList.size() << std::endl;
-        for (auto k = gatewayList.begin(); k != gatewayList.end(); k++)
+        const EndDeviceStatus::GatewayList& gatewayList = packetList.GetRecent(age).gwList;
+        os << unsigned(packetList.GetRecent(age).fCnt) << " " << gatewayList.GetSize()
+           << std::endl;
+        for (std::size_t k = 0; k < gatewayList.GetSize(); k++)
         {
-            EndDeviceStatus::PacketInfoPerGw infoPerGw = (*k).second;
+            const EndDeviceStatus::PacketInfoPerGw& infoPerGw = gatewayList.Get(k);
             os << "  " << infoPerGw.gwAddress << " " << infoPerGw.rxPower << std::endl;
         }
     }
@@ -26,11 +26,15 @@
 #include "lora-frame-header.h"
 #include "lora-net-device.h"
 #include "lorawan-mac-header.h"
+#include "parsed-uplink.h"
 
+#include "ns3/nstime.h"
 #include "ns3/object.h"
 #include "ns3/pointer.h"
 
+#include <array>
 #include <iostream>
+#include <vector>
 
 namespace ns3
 {
@@ -67,6 +71,7 @@ namespace lorawan
  *                           - Updated reply
  *                       --- Received Packets
  *                           - Received packets list (see below).
+ *                           - Last received packet
  *
  *
  * Private Access:
@@ -74,10 +79,20 @@ namespace lorawan
  *  (Received packets list) - List of gateways that received the packet (see below)
  *                          - Spreading Factor (SF) of the received packet
  *                          - Frequency of the received packet
- *                          - Bandwidth of the received packet
+ *                          - Frame counter of the received packet
  *
  *  (Gateway list) - Time at which the packet was received
  *                 - Reception power
+ *
+ * The received packets list only keeps the reception information of the
+ * HistoryDepth most recent packets, in a ring buffer, so that the memory used
+ * by this object doesn't grow with the simulated time. Apart from the last
+ * one, received packets are not kept.
+ *
+ * Copies of a packet forwarded by different gateways are merged in the same
+ * entry of the received packets list, through an index of the frame counters
+ * received in the last DeduplicationWindow. A packet whose frame counter was
+ * first received earlier than that is considered a new packet.
  */
 class EndDeviceStatus : public Object
 {
@@ -147,14 +162,46 @@ class EndDeviceStatus : public Object
     struct PacketInfoPerGw
     {
         Address gwAddress; //!< Address of the gateway that received the packet.
+        uint32_t gwId = 0; //!< Id of the gateway that received the packet (see NetworkStatus).
         Time receivedTime; //!< Time at which the packet was received by this gateway.
         double rxPower;    //!< Reception power of the packet at this gateway.
     };
 
     /**
-     * typedef of a list of gateways with relative reception information.
+     * List of gateways with relative reception information, in order of
+     * reception.
+     *
+     * The first entries are stored inline, since a packet is usually received
+     * by a few gateways: further entries are stored on the heap.
      */
-    typedef std::map<Address, PacketInfoPerGw> GatewayList;
+    class GatewayList
+    {
+      public:
+        /**
+         * Add the reception information of a gateway, unless the list already
+         * holds information for that gateway.
+         *
+         * \param info The reception information.
+         * \return True if the information was added.
+         */
+        bool Insert(const PacketInfoPerGw& info);
+
+        /**
+         * \param i The index of the gateway, in order of reception.
+         * \return The reception information of the gateway.
+         */
+        const PacketInfoPerGw& Get(std::size_t i) const;
+
+        /**
+         * \return The number of gateways in the list.
+         */
+        std::size_t GetSize() const;
+
+      private:
+        std::array<PacketInfoPerGw, 4> m_inline; //!< The first gateways of the list
+        std::vector<PacketInfoPerGw> m_spilled;  //!< The gateways that don't fit inline
+        uint8_t m_nInline = 0;                   //!< The number of gateways stored inline
+    };
 
     /**
      * Structure saving information regarding all packet receptions.
@@ -162,16 +209,81 @@ class EndDeviceStatus : public Object
     struct ReceivedPacketInfo
     {
         // Members
-        Ptr<const Packet> packet = nullptr; //!< The received packet
-        GatewayList gwList;                 //!< List of gateways that received this packet
-        uint8_t sf;                         //!< Spreading factor used to send this packet
-        double frequency;                   //!< Carrier frequency [MHz] used to send this packet
+        GatewayList gwList; //!< List of gateways that received this packet
+        uint8_t sf;         //!< Spreading factor used to send this packet
+        double frequency;   //!< Carrier frequency [MHz] used to send this packet
+        uint16_t fCnt = 0;  //!< Frame counter of this packet
     };
 
     /**
-     * typedef of a list of packets paired to their reception info.
+     * Ring buffer holding the reception information of the most recent
+     * packets. Once the buffer is full, each new packet overwrites the oldest
+     * one.
      */
-    typedef std::list<std::pair<Ptr<const Packet>, ReceivedPacketInfo>> ReceivedPacketList;
+    class ReceivedPacketList
+    {
+      public:
+        /**
+         * \param capacity The maximum number of packets in the list.
+         */
+        ReceivedPacketList(std::size_t capacity);
+
+        /**
+         * Add the reception information of a packet, dropping the oldest
+         * packet if the list is full.
+         *
+         * \param info The reception information.
+         * \return A reference to the information stored in the list.
+         */
+        ReceivedPacketInfo& Insert(const ReceivedPacketInfo& info);
+
+        /**
+         * \param age The number of packets received after the requested one.
+         * \return The reception information of the packet, with age 0 being
+         *         the last received packet.
+         */
+        const ReceivedPacketInfo& GetRecent(std::size_t age = 0) const;
+
+        /**
+         * \copydoc GetRecent
+         */
+        ReceivedPacketInfo& GetRecent(std::size_t age = 0);
+
+        /**
+         * \return The number of packets in the list.
+         */
+        std::size_t GetSize() const;
+
+        /**
+         * \return Whether the list holds no packets.
+         */
+        bool IsEmpty() const;
+
+        /**
+         * \return The maximum number of packets in the list.
+         */
+        std::size_t GetCapacity() const;
+
+        /**
+         * \return The number of packets inserted in the list since its
+         *         creation, including the ones that were dropped.
+         */
+        uint64_t GetInsertedCount() const;
+
+        /**
+         * Change the maximum number of packets in the list, keeping the most
+         * recent ones.
+         *
+         * \param capacity The maximum number of packets in the list.
+         */
+        void SetCapacity(std::size_t capacity);
+
+      private:
+        std::vector<ReceivedPacketInfo> m_packets; //!< The packets, in circular order
+        std::size_t m_capacity;                    //!< The maximum number of packets
+        std::size_t m_next = 0;                    //!< The slot of the next packet
+        uint64_t m_inserted = 0;                   //!< The number of inserted packets
+    };
 
     /*******************************************/
     /* Proper EndDeviceStatus class definition */
@@ -229,7 +341,21 @@ class EndDeviceStatus : public Object
      *
      * \return The received packet list.
      */
-    ReceivedPacketList GetReceivedPacketList() const;
+    const ReceivedPacketList& GetReceivedPacketList() const;
+
+    /**
+     * Get the number of packets whose reception information is kept.
+     *
+     * \return The maximum size of the received packet list.
+     */
+    uint32_t GetHistoryDepth() const;
+
+    /**
+     * Set the number of packets whose reception information is kept.
+     *
+     * \param depth The maximum size of the received packet list.
+     */
+    void SetHistoryDepth(uint32_t depth);
 
     /**
      * Set the spreading factor this device is using in the first receive window.
@@ -294,10 +420,13 @@ class EndDeviceStatus : public Object
     /**
      * Insert a received packet in the packet list.
      *
-     * \param receivedPacket The packet received.
+     * \param uplink The packet received, with its decoded headers.
      * \param gwAddress The address of the receiver gateway.
+     * \param gwId The id of the receiver gateway.
      */
-    void InsertReceivedPacket(Ptr<const Packet> receivedPacket, const Address& gwAddress);
+    void InsertReceivedPacket(Ptr<const ParsedUplink> uplink,
+                              const Address& gwAddress,
+                              uint32_t gwId);
 
     /**
      * Return the last packet that was received from this device.
@@ -306,6 +435,14 @@ class EndDeviceStatus : public Object
      */
     Ptr<const Packet> GetLastPacketReceivedFromDevice();
 
+    /**
+     * Return the last packet that was received from this device, with its
+     * decoded headers.
+     *
+     * \return The last received uplink, or nullptr if none was received.
+     */
+    Ptr<const ParsedUplink> GetLastReceivedUplink() const;
+
     /**
      * Return the information about the last packet that was received from the
      * device.
@@ -365,6 +502,78 @@ class EndDeviceStatus : public Object
      */
     friend std::ostream& operator<<(std::ostream& os, const EndDeviceStatus& status);
 
+    /**
+     * Storage for the EndDeviceStatus objects of a NetworkStatus, allocated in
+     * chunks of contiguous objects so that the statuses of the devices of a
+     * large network are close in memory. Released objects are kept in a free
+     * list for reuse. Since a status can outlive the NetworkStatus that
+     * created it, each status holds a reference to its pool, and the chunks
+     * are returned to the system once the NetworkStatus and all its statuses
+     * are gone.
+     */
+    class Pool : public SimpleRefCount<EndDeviceStatus::Pool>
+    {
+      public:
+        ~Pool(); //!< Destructor
+
+        /**
+         * Take a block able to hold an EndDeviceStatus from the free list, or
+         * from the current chunk.
+         *
+         * \return A pointer to the block.
+         */
+        void* Allocate();
+
+        /**
+         * Put a block back in the free list.
+         *
+         * \param block A pointer to the block.
+         */
+        void Release(void* block);
+
+      private:
+        /// The number of objects in each chunk
+        static constexpr std::size_t CHUNK_SIZE = 1024;
+
+        std::vector<char*> m_chunks;          //!< The chunks taken from the system
+        void* m_freeList = nullptr;           //!< The first released block
+        std::size_t m_nextBlock = CHUNK_SIZE; //!< The first unused block of the last chunk
+    };
+
+    /**
+     * Allocate an EndDeviceStatus that doesn't belong to a pool.
+     *
+     * \param size The size of the object.
+     * \return A pointer to the allocated memory.
+     */
+    static void* operator new(std::size_t size);
+
+    /**
+     * Allocate an EndDeviceStatus from a pool.
+     *
+     * \param size The size of the object.
+     * \param pool The pool to take the memory from.
+     * \return A pointer to the allocated memory.
+     */
+    static void* operator new(std::size_t size, Pool& pool);
+
+    /**
+     * Return an EndDeviceStatus to the pool it was allocated from, if any.
+     *
+     * \param pointer A pointer to the allocated memory.
+     * \param size The size of the object.
+     */
+    static void operator delete(void* pointer, std::size_t size);
+
+    /**
+     * Give the memory of an EndDeviceStatus whose construction failed back to
+     * its pool.
+     *
+     * \param pointer A pointer to the allocated memory.
+     * \param pool The pool the object was allocated from.
+     */
+    static void operator delete(void* pointer, Pool& pool);
+
   private:
     // Receive window data
     uint8_t m_firstReceiveWindowSpreadingFactor = 0;  //!< Spreading Factor (SF) for RX1 window
@@ -373,7 +582,21 @@ class EndDeviceStatus : public Object
     double m_secondReceiveWindowFrequency = 869.525;  //!< Frequency [MHz] for RX2 window
     EventId m_receiveWindowEvent; //!< Event storing the next scheduled downlink transmission
 
-    ReceivedPacketList m_receivedPacketList; //!< List of received packets
+    ReceivedPacketList m_receivedPacketList{20}; //!< List of the last received packets
+    Ptr<const ParsedUplink> m_lastUplink;        //!< Last packet received from this device
+
+    /**
+     * Entry of the deduplication index.
+     */
+    struct DedupEntry
+    {
+        uint16_t fCnt;      //!< Frame counter of the packet
+        uint64_t sequence;  //!< Insertion count of the packet in the received packet list
+        Time firstReceived; //!< Time at which the packet was first received
+    };
+
+    Time m_dedupWindow = Seconds(1); //!< Time during which copies of a packet are merged
+    std::vector<DedupEntry> m_dedupIndex; //!< Packets first received in the window, oldest first
 
     /// \note Using this attribute is 'cheating', since we are assuming perfect
     /// synchronization between the info at the device and at the network server
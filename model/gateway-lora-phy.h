@@ -62,11 +62,10 @@ class GatewayLoraPhy : public LoraPhy
     GatewayLoraPhy();           //!< Default constructor
     ~GatewayLoraPhy() override; //!< Destructor
 
-    void StartReceive(Ptr<Packet> packet,
-                      double rxPowerDbm,
-                      uint8_t sf,
-                      Time duration,
-                      double frequencyMHz) override = 0;
+    using LoraPhy::StartReceive;
+
+    void StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                      double rxPowerDbm) override = 0;
 
     void EndReceive(Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event) override = 0;
 
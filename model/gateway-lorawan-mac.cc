@@ -78,14 +78,7 @@ GatewayLorawanMac::Send(Ptr<Packet> packet)
         return;
     }
 
-    LoraTxParameters params;
-    params.sf = GetSfFromDataRate(dataRate);
-    params.headerDisabled = false;
-    params.codingRate = 1;
-    params.bandwidthHz = GetBandwidthFromDataRate(dataRate);
-    params.nPreamble = 8;
-    params.crcEnabled = true;
-    params.lowDataRateOptimizationEnabled = LoraPhy::GetTSym(params) > MilliSeconds(16);
+    LoraTxParameters params = GetTxParameters(dataRate);
 
     // Get the duration
     Time duration = m_phy->GetOnAirTime(packet, params);
@@ -156,5 +149,35 @@ GatewayLorawanMac::GetWaitingTime(double frequency)
 
     return m_channelHelper.GetWaitingTime(CreateObject<LogicalLoraChannel>(frequency));
 }
+
+Time
+GatewayLorawanMac::GetOnAirTime(Ptr<const Packet> packet)
+{
+    LoraTag tag;
+    packet->PeekPacketTag(tag);
+
+    return LoraPhy::GetOnAirTime(packet->GetSize(), GetTxParameters(tag.GetDataRate()));
+}
+
+Ptr<SubBand>
+GatewayLorawanMac::GetSubBand(double frequency)
+{
+    return m_channelHelper.GetSubBandFromFrequency(frequency);
+}
+
+LoraTxParameters
+GatewayLorawanMac::GetTxParameters(uint8_t dataRate)
+{
+    LoraTxParameters params;
+    params.sf = GetSfFromDataRate(dataRate);
+    params.headerDisabled = false;
+    params.codingRate = 1;
+    params.bandwidthHz = GetBandwidthFromDataRate(dataRate);
+    params.nPreamble = 8;
+    params.crcEnabled = true;
+    params.lowDataRateOptimizationEnabled = LoraPhy::GetTSym(params) > MilliSeconds(16);
+
+    return params;
+}
 } // namespace lorawan
 } // namespace ns3
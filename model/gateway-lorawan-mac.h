@@ -72,7 +72,31 @@ class GatewayLorawanMac : public LorawanMac
      */
     Time GetWaitingTime(double frequency);
 
+    /**
+     * Compute the time on air of a downlink packet sent by this gateway.
+     *
+     * \param packet The packet, carrying a LoraTag with its data rate.
+     * \return The duration of the transmission.
+     */
+    Time GetOnAirTime(Ptr<const Packet> packet);
+
+    /**
+     * Get the sub-band whose duty cycle limits the transmissions of this gateway on a frequency.
+     *
+     * \param frequency The frequency value [MHz].
+     * \return A pointer to the SubBand.
+     */
+    Ptr<SubBand> GetSubBand(double frequency);
+
   private:
+    /**
+     * Get the parameters of a downlink transmission at a data rate.
+     *
+     * \param dataRate The data rate of the transmission.
+     * \return The transmission parameters.
+     */
+    LoraTxParameters GetTxParameters(uint8_t dataRate);
+
   protected:
 };
 
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "lora-channel-partition-proxy.h"
+
+#include "ns3/abort.h"
+#include "ns3/distributed-simulator-impl.h"
+#include "ns3/log.h"
+#include "ns3/mpi-interface.h"
+#include "ns3/mpi-receiver.h"
+#include "ns3/node.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simulator.h"
+
+#include <cstring>
+
+namespace ns3
+{
+namespace lorawan
+{
+
+NS_LOG_COMPONENT_DEFINE("LoraChannelPartitionProxy");
+
+NS_OBJECT_ENSURE_REGISTERED(LoraPartitionHeader);
+NS_OBJECT_ENSURE_REGISTERED(LoraChannelPartitionProxy);
+
+namespace
+{
+
+/**
+ * Write a double to a buffer, in network byte order.
+ *
+ * \param i The buffer iterator.
+ * \param value The value to write.
+ */
+void
+WriteDouble(Buffer::Iterator& i, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    i.WriteHtonU64(bits);
+}
+
+/**
+ * Read a double written by WriteDouble.
+ *
+ * \param i The buffer iterator.
+ * \return The value.
+ */
+double
+ReadDouble(Buffer::Iterator& i)
+{
+    uint64_t bits = i.ReadNtohU64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+/*************************
+ *  LoraPartitionHeader  *
+ *************************/
+
+TypeId
+LoraPartitionHeader::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LoraPartitionHeader")
+                            .SetParent<Header>()
+                            .SetGroupName("lorawan")
+                            .AddConstructor<LoraPartitionHeader>();
+    return tid;
+}
+
+LoraPartitionHeader::LoraPartitionHeader()
+    : txPowerDbm(0),
+      sf(0),
+      frequencyMHz(0)
+{
+}
+
+LoraPartitionHeader::~LoraPartitionHeader()
+{
+}
+
+TypeId
+LoraPartitionHeader::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+uint32_t
+LoraPartitionHeader::GetSerializedSize() const
+{
+    // Position, power, duration and frequency, plus the spreading factor
+    return 6 * 8 + 1;
+}
+
+void
+LoraPartitionHeader::Serialize(Buffer::Iterator start) const
+{
+    WriteDouble(start, senderPosition.x);
+    WriteDouble(start, senderPosition.y);
+    WriteDouble(start, senderPosition.z);
+    WriteDouble(start, txPowerDbm);
+    start.WriteU8(sf);
+    start.WriteHtonU64(uint64_t(duration.GetTimeStep()));
+    WriteDouble(start, frequencyMHz);
+}
+
+uint32_t
+LoraPartitionHeader::Deserialize(Buffer::Iterator start)
+{
+    senderPosition.x = ReadDouble(start);
+    senderPosition.y = ReadDouble(start);
+    senderPosition.z = ReadDouble(start);
+    txPowerDbm = ReadDouble(start);
+    sf = start.ReadU8();
+    duration = TimeStep(int64_t(start.ReadNtohU64()));
+    frequencyMHz = ReadDouble(start);
+    return GetSerializedSize();
+}
+
+void
+LoraPartitionHeader::Print(std::ostream& os) const
+{
+    os << "Sender position: " << senderPosition << ", TxPower: " << txPowerDbm
+       << " dBm, SF: " << unsigned(sf) << ", Duration: " << duration
+       << ", Frequency: " << frequencyMHz << " MHz";
+}
+
+/*******************************
+ *  LoraChannelPartitionProxy  *
+ *******************************/
+
+TypeId
+LoraChannelPartitionProxy::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LoraChannelPartitionProxy")
+            .SetParent<Object>()
+            .SetGroupName("lorawan")
+            .AddConstructor<LoraChannelPartitionProxy>()
+            .AddAttribute("Guard",
+                          "The delay after which transmissions forwarded to another process "
+                          "are delivered. It bounds the lookahead of the distributed simulator, "
+                          "and delays replies to devices near a border by up to twice its value",
+                          TimeValue(MilliSeconds(1)),
+                          MakeTimeAccessor(&LoraChannelPartitionProxy::m_guard),
+                          MakeTimeChecker(TimeStep(1)));
+    return tid;
+}
+
+LoraChannelPartitionProxy::LoraChannelPartitionProxy()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+LoraChannelPartitionProxy::~LoraChannelPartitionProxy()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+LoraChannelPartitionProxy::Install(Ptr<LoraChannel> channel)
+{
+    NS_LOG_FUNCTION(this << channel);
+
+    NS_ABORT_MSG_UNLESS(MpiInterface::IsEnabled(), "The MPI interface is not enabled");
+    Ptr<DistributedSimulatorImpl> simulator =
+        DynamicCast<DistributedSimulatorImpl>(Simulator::GetImplementation());
+    NS_ABORT_MSG_UNLESS(simulator, "LoraChannelPartitionProxy requires DistributedSimulatorImpl");
+
+    // Forwarded transmissions must not be received by another process before
+    // it has been granted the time they are sent at
+    simulator->BoundLookAhead(m_guard);
+
+    // One port per process, owned by that process, so that MpiInterface can
+    // address it
+    for (uint32_t systemId = 0; systemId < MpiInterface::GetSize(); systemId++)
+    {
+        Ptr<Node> node = CreateObject<Node>(systemId);
+        Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice>();
+        node->AddDevice(device);
+        Ptr<MpiReceiver> receiver = CreateObject<MpiReceiver>();
+        receiver->SetReceiveCallback(MakeCallback(&LoraChannelPartitionProxy::Receive, this));
+        device->AggregateObject(receiver);
+        m_ports.push_back(device);
+    }
+
+    m_channel = channel;
+    m_channel->SetRemoteSendCallback(MpiInterface::GetSystemId(),
+                                     MakeCallback(&LoraChannelPartitionProxy::Send, this));
+}
+
+void
+LoraChannelPartitionProxy::Send(uint32_t systemId,
+                                Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                                double txPowerDbm,
+                                Vector senderPosition)
+{
+    NS_LOG_FUNCTION(this << systemId << transmission->GetPacket() << txPowerDbm
+                         << senderPosition);
+
+    LoraPartitionHeader header;
+    header.senderPosition = senderPosition;
+    header.txPowerDbm = txPowerDbm;
+    header.sf = transmission->GetSpreadingFactor();
+    header.duration = transmission->GetDuration();
+    header.frequencyMHz = transmission->GetFrequency();
+
+    Ptr<Packet> copy = transmission->GetPacket()->Copy();
+    copy->AddHeader(header);
+
+    Ptr<NetDevice> port = m_ports.at(systemId);
+    MpiInterface::SendPacket(copy,
+                             Simulator::Now() + m_guard,
+                             port->GetNode()->GetId(),
+                             port->GetIfIndex());
+}
+
+void
+LoraChannelPartitionProxy::Receive(Ptr<Packet> packet)
+{
+    NS_LOG_FUNCTION(this << packet);
+
+    LoraPartitionHeader header;
+    packet->RemoveHeader(header);
+
+    m_channel->DeliverRemote(packet,
+                             header.txPowerDbm,
+                             header.senderPosition,
+                             header.sf,
+                             header.duration,
+                             header.frequencyMHz);
+}
+
+} // namespace lorawan
+} // namespace ns3
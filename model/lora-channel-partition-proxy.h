@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LORA_CHANNEL_PARTITION_PROXY_H
+#define LORA_CHANNEL_PARTITION_PROXY_H
+
+#include "lora-channel.h"
+
+#include "ns3/header.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/vector.h"
+
+#include <vector>
+
+namespace ns3
+{
+namespace lorawan
+{
+
+/**
+ * \ingroup lorawan
+ *
+ * Header carrying the parameters of a transmission forwarded to another
+ * process of a distributed simulation.
+ */
+class LoraPartitionHeader : public Header
+{
+  public:
+    /**
+     *  Register this type.
+     *  \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LoraPartitionHeader();           //!< Default constructor
+    ~LoraPartitionHeader() override; //!< Destructor
+
+    // Methods inherited from Header
+    TypeId GetInstanceTypeId() const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(Buffer::Iterator start) const override;
+    uint32_t Deserialize(Buffer::Iterator start) override;
+    void Print(std::ostream& os) const override;
+
+    Vector senderPosition; //!< The position of the sender
+    double txPowerDbm;     //!< The power of the transmission
+    uint8_t sf;            //!< The spreading factor of the transmission
+    Time duration;         //!< The on-air duration of the packet
+    double frequencyMHz;   //!< The frequency of the transmission
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Forwards the transmissions of a LoraChannel between the processes of a
+ * distributed simulation, using the ns-3 MPI interface.
+ *
+ * The deployment is split into regions, each simulated by its own process:
+ * every process builds the whole topology, but the nodes of a region are
+ * created with the system id of the process simulating it, and applications
+ * are only installed on local nodes. Once installed, the proxy makes the
+ * channel deliver transmissions to local PHYs only, and forwards each
+ * transmission heard by PHYs of other regions to the processes simulating
+ * them, which deliver it after the Guard time. Receptions across the border of
+ * a region thus start up to Guard later than they would in a single-process
+ * run; the guard bounds the lookahead of the simulator, so it must be small
+ * compared to the duration of packets. Replies to uplinks forwarded across a
+ * border may also cross it back, and then start up to twice Guard later in the
+ * receive windows of end devices, which only last 8 symbols: the delays of the
+ * point to point links plus twice Guard must stay below the RX1 window at the
+ * fastest data rate (about 8 ms at SF7). The network server can be simulated by
+ * any process, and reaches the gateways of other regions through point to
+ * point links, as in a single-process simulation.
+ *
+ * Only the granted time window synchronization (DistributedSimulatorImpl) is
+ * supported, and Install must be called at the same point of the topology
+ * construction by all processes, since it creates one node per process.
+ */
+class LoraChannelPartitionProxy : public Object
+{
+  public:
+    /**
+     *  Register this type.
+     *  \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LoraChannelPartitionProxy();           //!< Default constructor
+    ~LoraChannelPartitionProxy() override; //!< Destructor
+
+    /**
+     * Connect the proxy to the channel, and make the channel forward the
+     * transmissions heard by PHYs of other processes through it.
+     *
+     * \param channel The channel shared by all regions.
+     */
+    void Install(Ptr<LoraChannel> channel);
+
+  private:
+    /**
+     * Forward a transmission to another process.
+     *
+     * \param systemId The system id of the process.
+     * \param transmission The transmission.
+     * \param txPowerDbm The power of the transmission.
+     * \param senderPosition The position of the sender.
+     */
+    void Send(uint32_t systemId,
+              Ptr<const LoraInterferenceHelper::Transmission> transmission,
+              double txPowerDbm,
+              Vector senderPosition);
+
+    /**
+     * Deliver a transmission forwarded by another process to the channel.
+     *
+     * \param packet The packet, with its LoraPartitionHeader.
+     */
+    void Receive(Ptr<Packet> packet);
+
+    Time m_guard;                        //!< The delay of forwarded transmissions
+    Ptr<LoraChannel> m_channel;          //!< The channel of this process
+    std::vector<Ptr<NetDevice>> m_ports; //!< The device receiving the transmissions of each process
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* LORA_CHANNEL_PARTITION_PROXY_H */
@@ -19,16 +19,27 @@
 
 #include "lora-channel.h"
 
+#include "correlated-shadowing-propagation-loss-model.h"
 #include "end-device-lora-phy.h"
 #include "gateway-lora-phy.h"
 
+#include "ns3/boolean.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
 #include "ns3/log.h"
+#include "ns3/node.h"
 #include "ns3/object-factory.h"
 #include "ns3/packet.h"
 #include "ns3/pointer.h"
 #include "ns3/simulator.h"
+#include "ns3/uinteger.h"
 
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
 
 namespace ns3
 {
@@ -39,6 +50,237 @@ NS_LOG_COMPONENT_DEFINE("LoraChannel");
 
 NS_OBJECT_ENSURE_REGISTERED(LoraChannel);
 
+/**
+ * \ingroup lorawan
+ *
+ * Listener that informs a LoraChannel about state changes of one of its
+ * connected end device PHYs.
+ */
+class LoraChannelPhyListener : public EndDeviceLoraPhyListener
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * \param channel The channel to notify.
+     * \param i The index of the monitored phy in the channel's phy list.
+     */
+    LoraChannelPhyListener(LoraChannel* channel, uint32_t i)
+        : m_channel(channel),
+          m_index(i)
+    {
+    }
+
+    void NotifyRxStart() override
+    {
+        m_channel->SetListening(m_index, true);
+    }
+
+    void NotifyTxStart(double txPowerDbm) override
+    {
+        m_channel->SetListening(m_index, false);
+    }
+
+    void NotifySleep() override
+    {
+        m_channel->SetListening(m_index, false);
+    }
+
+    void NotifyStandby() override
+    {
+        m_channel->SetListening(m_index, true);
+    }
+
+    /**
+     * Set the index of the monitored phy, after a phy before it was removed.
+     *
+     * \param i The new index of the monitored phy.
+     */
+    void SetIndex(uint32_t i)
+    {
+        m_index = i;
+    }
+
+  private:
+    LoraChannel* m_channel; //!< The channel to notify
+    uint32_t m_index;       //!< The index of the monitored phy
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Pool of threads computing the reception power of a transmission at a set of
+ * receivers.
+ *
+ * Each thread evaluates the loss model on its own pair of
+ * ConstantPositionMobilityModel objects, moved to the positions of the sender
+ * and of the receivers: the only objects that are shared between threads are
+ * the loss models themselves, which must not have any internal state.
+ */
+class LoraChannelPropagationWorkers
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * \param nThreads The number of threads computing the propagation,
+     * including the calling one.
+     */
+    LoraChannelPropagationWorkers(uint32_t nThreads)
+        : m_round(0),
+          m_running(0),
+          m_stop(false),
+          m_txPowerDbm(0),
+          m_senderPosition(nullptr),
+          m_receiverPositions(nullptr),
+          m_rxPowerDbm(nullptr)
+    {
+        for (uint32_t t = 0; t < nThreads; t++)
+        {
+            m_senderMobility.push_back(CreateObject<ConstantPositionMobilityModel>());
+            m_receiverMobility.push_back(CreateObject<ConstantPositionMobilityModel>());
+        }
+        // The calling thread takes care of the first share of receivers
+        for (uint32_t t = 1; t < nThreads; t++)
+        {
+            m_threads.emplace_back(&LoraChannelPropagationWorkers::Work, this, t);
+        }
+    }
+
+    ~LoraChannelPropagationWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_startCondition.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    /**
+     * Get the number of threads computing the propagation.
+     *
+     * \return The number of threads, including the calling one.
+     */
+    uint32_t GetNThreads() const
+    {
+        return m_senderMobility.size();
+    }
+
+    /**
+     * Compute the reception power at a set of receivers, and return when all
+     * threads are done.
+     *
+     * \param loss The loss model.
+     * \param txPowerDbm The power of the transmission.
+     * \param senderPosition The position of the sender.
+     * \param receiverPositions The positions of the receivers.
+     * \param rxPowerDbm The reception power at each receiver, filled by this method.
+     */
+    void Compute(Ptr<PropagationLossModel> loss,
+                 double txPowerDbm,
+                 const Vector& senderPosition,
+                 const std::vector<Vector>& receiverPositions,
+                 std::vector<double>& rxPowerDbm)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_loss = loss;
+            m_txPowerDbm = txPowerDbm;
+            m_senderPosition = &senderPosition;
+            m_receiverPositions = &receiverPositions;
+            m_rxPowerDbm = &rxPowerDbm;
+            m_running = m_threads.size();
+            m_round++;
+        }
+        m_startCondition.notify_all();
+
+        ComputeShare(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_doneCondition.wait(lock, [this]() { return m_running == 0; });
+        m_loss = nullptr;
+    }
+
+  private:
+    /**
+     * Main loop of the worker threads.
+     *
+     * \param t The index of the thread.
+     */
+    void Work(uint32_t t)
+    {
+        uint64_t round = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_startCondition.wait(lock, [this, round]() { return m_stop || m_round != round; });
+                if (m_stop)
+                {
+                    return;
+                }
+                round = m_round;
+            }
+
+            ComputeShare(t);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_running == 0)
+            {
+                m_doneCondition.notify_one();
+            }
+        }
+    }
+
+    /**
+     * Compute the reception power at the share of receivers of a thread.
+     *
+     * \param t The index of the thread.
+     */
+    void ComputeShare(uint32_t t)
+    {
+        std::size_t n = m_receiverPositions->size();
+        std::size_t nThreads = GetNThreads();
+        m_senderMobility[t]->SetPosition(*m_senderPosition);
+        for (std::size_t k = n * t / nThreads; k < n * (t + 1) / nThreads; k++)
+        {
+            m_receiverMobility[t]->SetPosition((*m_receiverPositions)[k]);
+            (*m_rxPowerDbm)[k] =
+                m_loss->CalcRxPower(m_txPowerDbm, m_senderMobility[t], m_receiverMobility[t]);
+        }
+    }
+
+    std::vector<std::thread> m_threads; //!< The worker threads
+    std::vector<Ptr<MobilityModel>>
+        m_senderMobility; //!< The sender mobility model used by each thread
+    std::vector<Ptr<MobilityModel>>
+        m_receiverMobility; //!< The receiver mobility model used by each thread
+
+    std::mutex m_mutex;                       //!< Protects the fields below
+    std::condition_variable m_startCondition; //!< Signals a new round or the stop
+    std::condition_variable m_doneCondition;  //!< Signals the end of a round
+    uint64_t m_round;                         //!< The number of rounds started so far
+    std::size_t m_running;                    //!< The number of workers still busy
+    bool m_stop;                              //!< Whether the workers must exit
+
+    Ptr<PropagationLossModel> m_loss;              //!< The loss model of the current round
+    double m_txPowerDbm;                           //!< The power of the current transmission
+    const Vector* m_senderPosition;                //!< The position of the current sender
+    const std::vector<Vector>* m_receiverPositions; //!< The positions of the current receivers
+    std::vector<double>* m_rxPowerDbm;              //!< Where to store the reception powers
+};
+
+/**
+ * The minimum number of receivers per thread for the propagation of a
+ * transmission to be computed in parallel: below this, synchronizing the
+ * threads costs more than it saves.
+ */
+static const std::size_t minReceiversPerThread = 32;
+
 TypeId
 LoraChannel::GetTypeId()
 {
@@ -57,6 +299,67 @@ LoraChannel::GetTypeId()
                           PointerValue(),
                           MakePointerAccessor(&LoraChannel::m_delay),
                           MakePointerChecker<PropagationDelayModel>())
+            .AddAttribute("ListeningFanOut",
+                          "Whether to deliver transmissions only to gateways and to end devices "
+                          "that are in STANDBY or RX state on the transmission frequency",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&LoraChannel::SetListeningFanOut,
+                                              &LoraChannel::GetListeningFanOut),
+                          MakeBooleanChecker())
+            .AddAttribute("PropagationThreads",
+                          "The number of threads computing the reception power of each "
+                          "transmission. Only used if the first propagation loss model is "
+                          "thread-safe (see LoraChannel::IsPropagationThreadSafe): the models "
+                          "after the last thread-safe one are evaluated serially",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&LoraChannel::m_propagationThreads),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("LinkBudgetCache",
+                          "Whether to cache the reception power between pairs of PHYs. Only "
+                          "used if the propagation loss models can be cached (see "
+                          "LoraChannel::IsLinkBudgetCacheable)",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&LoraChannel::m_linkBudgetCache),
+                          MakeBooleanChecker())
+            .AddAttribute("LinkBudgetCacheFloor",
+                          "The reception power (dBm) below which pairs of PHYs are only marked "
+                          "as out of reach in the link budget cache, and transmissions between "
+                          "them are dropped. Pairs below InterferenceFloor are always marked "
+                          "this way. Every other pair takes about 50 bytes, i.e., up to about "
+                          "50 N^2 bytes with N PHYs, so a finite floor should be used in large "
+                          "networks",
+                          DoubleValue(-std::numeric_limits<double>::infinity()),
+                          MakeDoubleAccessor(&LoraChannel::m_linkBudgetCacheFloor),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("InterferenceFloor",
+                          "The reception power (dBm) below which transmissions are not "
+                          "delivered to a PHY, neither as packets nor as interference",
+                          DoubleValue(-std::numeric_limits<double>::infinity()),
+                          MakeDoubleAccessor(&LoraChannel::m_interferenceFloor),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("SpatialIndex",
+                          "Whether to only deliver transmissions to PHYs within range, "
+                          "using a grid of the PHY positions (see LoraChannel::GetMaxRange)",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&LoraChannel::m_spatialIndex),
+                          MakeBooleanChecker())
+            .AddAttribute("SpatialIndexCellSize",
+                          "The side (m) of the cells of the spatial index",
+                          DoubleValue(1000),
+                          MakeDoubleAccessor(&LoraChannel::m_spatialIndexCellSize),
+                          MakeDoubleChecker<double>(0, std::numeric_limits<double>::max()))
+            .AddAttribute("MaxRange",
+                          "The maximum distance (m) at which transmissions are delivered when "
+                          "using the spatial index. If 0, it is derived from the loss model and "
+                          "the interference floor",
+                          DoubleValue(0),
+                          MakeDoubleAccessor(&LoraChannel::m_maxRange),
+                          MakeDoubleChecker<double>(0))
+            .AddTraceSource("PacketBelowInterferenceFloor",
+                            "Trace source fired whenever a packet is not delivered to a PHY "
+                            "because its reception power is below the interference floor",
+                            MakeTraceSourceAccessor(&LoraChannel::m_belowInterferenceFloor),
+                            "ns3::Packet::TracedCallback")
             .AddTraceSource("PacketSent",
                             "Trace source fired whenever a packet goes out on the channel",
                             MakeTraceSourceAccessor(&LoraChannel::m_packetSent),
@@ -65,20 +368,68 @@ LoraChannel::GetTypeId()
 }
 
 LoraChannel::LoraChannel()
+    : m_listeningFanOut(false),
+      m_propagationThreads(1),
+      m_propagationWorkers(nullptr),
+      m_linkBudgetCache(false),
+      m_linkBudgetCacheFloor(-std::numeric_limits<double>::infinity()),
+      m_interferenceFloor(-std::numeric_limits<double>::infinity()),
+      m_nBelowInterferenceFloor(0),
+      m_spatialIndex(false),
+      m_spatialIndexCellSize(1000),
+      m_maxRange(0),
+      m_spatialIndexValid(false),
+      m_maxRangesFloor(-std::numeric_limits<double>::infinity()),
+      m_systemId(0),
+      m_remotePhysValid(false)
 {
 }
 
 LoraChannel::~LoraChannel()
 {
+    delete m_propagationWorkers;
+    ClearLinkBudgetCache();
+    ClearSpatialIndex();
+    UntrackPhys();
     m_phyList.clear();
 }
 
 LoraChannel::LoraChannel(Ptr<PropagationLossModel> loss, Ptr<PropagationDelayModel> delay)
     : m_loss(loss),
-      m_delay(delay)
+      m_delay(delay),
+      m_listeningFanOut(false),
+      m_propagationThreads(1),
+      m_propagationWorkers(nullptr),
+      m_linkBudgetCache(false),
+      m_linkBudgetCacheFloor(-std::numeric_limits<double>::infinity()),
+      m_interferenceFloor(-std::numeric_limits<double>::infinity()),
+      m_nBelowInterferenceFloor(0),
+      m_spatialIndex(false),
+      m_spatialIndexCellSize(1000),
+      m_maxRange(0),
+      m_spatialIndexValid(false),
+      m_maxRangesFloor(-std::numeric_limits<double>::infinity()),
+      m_systemId(0),
+      m_remotePhysValid(false)
 {
 }
 
+void
+LoraChannel::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Stop the propagation threads
+    delete m_propagationWorkers;
+    m_propagationWorkers = nullptr;
+
+    ClearLinkBudgetCache();
+    ClearSpatialIndex();
+    m_remoteSenderMobility = nullptr;
+
+    Channel::DoDispose();
+}
+
 void
 LoraChannel::Add(Ptr<LoraPhy> phy)
 {
@@ -86,6 +437,15 @@ LoraChannel::Add(Ptr<LoraPhy> phy)
 
     // Add the new phy to the vector
     m_phyList.push_back(phy);
+    m_phyIndexes[PeekPointer(phy)] = m_phyList.size() - 1;
+    m_spatialIndexValid = false;
+    m_remotePhysValid = false;
+
+    // The listening state is only needed by ListeningFanOut
+    if (m_listeningFanOut)
+    {
+        TrackPhy(m_phyList.size() - 1);
+    }
 }
 
 void
@@ -93,8 +453,157 @@ LoraChannel::Remove(Ptr<LoraPhy> phy)
 {
     NS_LOG_FUNCTION(this << phy);
 
-    // Remove the phy from the vector
-    m_phyList.erase(find(m_phyList.begin(), m_phyList.end(), phy));
+    auto it = m_phyIndexes.find(PeekPointer(phy));
+    NS_ASSERT_MSG(it != m_phyIndexes.end(), "The phy is not connected to this channel");
+    uint32_t removed = it->second;
+    m_phyIndexes.erase(it);
+
+    // Stop tracking the removed phy, and shift the indexes of the phys after it
+    if (m_listeningFanOut)
+    {
+        UntrackPhy(removed);
+        m_phyListeners.erase(m_phyListeners.begin() + removed);
+
+        auto gw = std::lower_bound(m_alwaysListeningPhys.begin(),
+                                   m_alwaysListeningPhys.end(),
+                                   removed);
+        for (auto shifted = gw; shifted != m_alwaysListeningPhys.end(); ++shifted)
+        {
+            (*shifted)--;
+        }
+
+        std::set<uint32_t> listening(m_listeningEndDevicePhys.begin(),
+                                     m_listeningEndDevicePhys.lower_bound(removed));
+        for (auto ed = m_listeningEndDevicePhys.upper_bound(removed);
+             ed != m_listeningEndDevicePhys.end();
+             ++ed)
+        {
+            listening.insert(listening.end(), *ed - 1);
+        }
+        m_listeningEndDevicePhys.swap(listening);
+    }
+    m_phyList.erase(m_phyList.begin() + removed);
+    for (uint32_t i = removed; i < m_phyList.size(); i++)
+    {
+        m_phyIndexes[PeekPointer(m_phyList[i])] = i;
+        if (m_listeningFanOut && m_phyListeners[i])
+        {
+            m_phyListeners[i]->SetIndex(i);
+        }
+    }
+
+    // The link budget cache and the spatial index are indexed by PHY as well
+    ClearLinkBudgetCache();
+    ClearSpatialIndex();
+    m_remotePhysValid = false;
+}
+
+void
+LoraChannel::TrackPhy(uint32_t i)
+{
+    NS_LOG_FUNCTION(this << i);
+
+    Ptr<EndDeviceLoraPhy> edPhy = DynamicCast<EndDeviceLoraPhy>(m_phyList[i]);
+    if (m_phyListeners.size() <= i)
+    {
+        m_phyListeners.resize(i + 1, nullptr);
+    }
+    if (!edPhy)
+    {
+        // Gateways can receive on multiple frequencies at once and are never
+        // put to sleep: always notify them
+        m_alwaysListeningPhys.push_back(i);
+        return;
+    }
+
+    auto listener = new LoraChannelPhyListener(this, i);
+    edPhy->RegisterListener(listener);
+    m_phyListeners[i] = listener;
+
+    // Start from the state the phy is currently in
+    EndDeviceLoraPhy::State state = edPhy->GetState();
+    SetListening(i, state == EndDeviceLoraPhy::STANDBY || state == EndDeviceLoraPhy::RX);
+}
+
+void
+LoraChannel::UntrackPhys()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (uint32_t i = 0; i < m_phyListeners.size(); i++)
+    {
+        UntrackPhy(i);
+    }
+    m_phyListeners.clear();
+    m_alwaysListeningPhys.clear();
+    m_listeningEndDevicePhys.clear();
+}
+
+void
+LoraChannel::UntrackPhy(uint32_t i)
+{
+    NS_LOG_FUNCTION(this << i);
+
+    // Each end device only holds the listener of this channel it was given
+    if (m_phyListeners[i])
+    {
+        DynamicCast<EndDeviceLoraPhy>(m_phyList[i])->UnregisterListener(m_phyListeners[i]);
+        delete m_phyListeners[i];
+        m_phyListeners[i] = nullptr;
+    }
+    m_listeningEndDevicePhys.erase(i);
+    auto gw = std::lower_bound(m_alwaysListeningPhys.begin(), m_alwaysListeningPhys.end(), i);
+    if (gw != m_alwaysListeningPhys.end() && *gw == i)
+    {
+        m_alwaysListeningPhys.erase(gw);
+    }
+}
+
+void
+LoraChannel::SetListeningFanOut(bool listeningFanOut)
+{
+    NS_LOG_FUNCTION(this << listeningFanOut);
+
+    if (listeningFanOut == m_listeningFanOut)
+    {
+        return;
+    }
+
+    // Listeners are only registered while they are needed, since every state
+    // change of an end device would otherwise notify the channel
+    m_listeningFanOut = listeningFanOut;
+    if (listeningFanOut)
+    {
+        for (uint32_t i = 0; i < m_phyList.size(); i++)
+        {
+            TrackPhy(i);
+        }
+    }
+    else
+    {
+        UntrackPhys();
+    }
+}
+
+bool
+LoraChannel::GetListeningFanOut() const
+{
+    return m_listeningFanOut;
+}
+
+void
+LoraChannel::SetListening(uint32_t i, bool listening)
+{
+    NS_LOG_FUNCTION(this << i << listening);
+
+    if (listening)
+    {
+        m_listeningEndDevicePhys.insert(i);
+    }
+    else
+    {
+        m_listeningEndDevicePhys.erase(i);
+    }
 }
 
 std::size_t
@@ -124,68 +633,364 @@ LoraChannel::Send(Ptr<LoraPhy> sender,
 
     NS_ASSERT(senderMobility); // Make sure it's available
 
+    // Receivers keep a reference to the same transmission instead of a copy of
+    // its parameters
+    Ptr<LoraInterferenceHelper::Transmission> transmission =
+        Create<LoraInterferenceHelper::Transmission>(duration, txParams.sf, packet, frequencyMHz);
+    Deliver(sender, senderMobility, transmission, txPowerDbm);
+}
+
+void
+LoraChannel::SetRemoteSendCallback(uint32_t systemId, RemoteSendCallback callback)
+{
+    NS_LOG_FUNCTION(this << systemId);
+
+    m_systemId = systemId;
+    m_remoteSend = callback;
+    m_remotePhysValid = false;
+}
+
+void
+LoraChannel::DeliverRemote(Ptr<Packet> packet,
+                           double txPowerDbm,
+                           Vector senderPosition,
+                           uint8_t sf,
+                           Time duration,
+                           double frequencyMHz) const
+{
+    NS_LOG_FUNCTION(this << packet << txPowerDbm << senderPosition << unsigned(sf) << duration
+                         << frequencyMHz);
+
+    // The sender is simulated by another process: only its position matters
+    if (!m_remoteSenderMobility)
+    {
+        m_remoteSenderMobility = CreateObject<ConstantPositionMobilityModel>();
+    }
+    m_remoteSenderMobility->SetPosition(senderPosition);
+
+    Deliver(nullptr,
+            m_remoteSenderMobility,
+            Create<LoraInterferenceHelper::Transmission>(duration, sf, packet, frequencyMHz),
+            txPowerDbm);
+}
+
+void
+LoraChannel::Deliver(Ptr<LoraPhy> sender,
+                     Ptr<MobilityModel> senderMobility,
+                     Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                     double txPowerDbm) const
+{
     NS_LOG_INFO("Starting cycle over all " << m_phyList.size() << " PHYs");
     NS_LOG_INFO("Sender mobility: " << senderMobility->GetPosition());
 
-    // Cycle over all registered PHYs
-    uint32_t j = 0;
-    std::vector<Ptr<LoraPhy>>::const_iterator i;
-    for (i = m_phyList.begin(); i != m_phyList.end(); i++, j++)
+    // Prepare the parameters that are common to all receivers
+    Ptr<Packet> packet = transmission->GetPacket();
+    double frequencyMHz = transmission->GetFrequency();
+    LoraChannelParameters parameters;
+    parameters.transmission = transmission;
+
+    // Collect the receivers of this transmission
+    std::vector<uint32_t> receivers;
+    double range = m_spatialIndex ? GetMaxRange(txPowerDbm) : 0;
+    if (m_spatialIndex && std::isfinite(range))
+    {
+        GetReceiversInRange(sender,
+                            senderMobility->GetPosition(),
+                            range,
+                            frequencyMHz,
+                            receivers);
+        NS_LOG_INFO("Delivering to " << receivers.size() << " PHYs within " << range << " m");
+    }
+    else if (!m_listeningFanOut)
     {
-        // Do not deliver to the sender (*i is the current PHY)
-        if (sender != (*i))
+        // Cycle over all registered PHYs
+        receivers.reserve(m_phyList.size());
+        for (uint32_t j = 0; j < m_phyList.size(); j++)
         {
-            // Get the receiver's mobility model
-            Ptr<MobilityModel> receiverMobility = (*i)->GetMobility()->GetObject<MobilityModel>();
-
-            NS_LOG_INFO("Receiver mobility: " << receiverMobility->GetPosition());
-
-            // Compute delay using the delay model
-            Time delay = m_delay->GetDelay(senderMobility, receiverMobility);
+            // Do not deliver to the sender
+            if (sender != m_phyList[j])
+            {
+                receivers.push_back(j);
+            }
+        }
+    }
+    else
+    {
+        // The state of remote PHYs is only known by their own process, which
+        // decides whether they receive the transmission
+        const std::vector<uint32_t>& remotePhys = GetRemotePhys();
+        NS_LOG_INFO("Delivering only to " << m_alwaysListeningPhys.size() << " gateways, "
+                                          << m_listeningEndDevicePhys.size()
+                                          << " listening end devices and " << remotePhys.size()
+                                          << " remote PHYs");
 
-            // Compute received power using the loss model
-            double rxPowerDbm = GetRxPower(txPowerDbm, senderMobility, receiverMobility);
+        // Merge the sets of receivers, so that reception events are scheduled in
+        // the same order as they would be when delivering to all PHYs
+        auto gw = m_alwaysListeningPhys.begin();
+        auto ed = m_listeningEndDevicePhys.begin();
+        auto remote = remotePhys.begin();
+        while (gw != m_alwaysListeningPhys.end() || ed != m_listeningEndDevicePhys.end() ||
+               remote != remotePhys.end())
+        {
+            uint32_t j = std::min({gw != m_alwaysListeningPhys.end() ? *gw : UINT32_MAX,
+                                   ed != m_listeningEndDevicePhys.end() ? *ed : UINT32_MAX,
+                                   remote != remotePhys.end() ? *remote : UINT32_MAX});
+            bool listening = false;
+            if (gw != m_alwaysListeningPhys.end() && *gw == j)
+            {
+                listening = true;
+                ++gw;
+            }
+            if (ed != m_listeningEndDevicePhys.end() && *ed == j)
+            {
+                // End devices only listen on a single frequency
+                listening = listening || m_phyList[j]->IsOnFrequency(frequencyMHz);
+                ++ed;
+            }
+            if (remote != remotePhys.end() && *remote == j)
+            {
+                listening = true;
+                ++remote;
+            }
 
-            NS_LOG_DEBUG("Propagation: txPower="
-                         << txPowerDbm << "dbm, rxPower=" << rxPowerDbm << "dbm, "
-                         << "distance=" << senderMobility->GetDistanceFrom(receiverMobility)
-                         << "m, delay=" << delay);
+            if (listening && sender != m_phyList[j])
+            {
+                receivers.push_back(j);
+            }
+        }
+    }
 
-            // Get the id of the destination PHY to correctly format the context
-            Ptr<NetDevice> dstNetDevice = m_phyList[j]->GetDevice();
-            uint32_t dstNode = 0;
-            if (dstNetDevice)
+    // In a distributed simulation, the receivers simulated by other processes
+    // are reached through the remote send callback, once for each process.
+    // Transmissions coming from another process are only delivered locally.
+    if (!m_remoteSend.IsNull())
+    {
+        std::set<uint32_t> remoteSystems;
+        std::size_t nLocal = 0;
+        for (std::size_t k = 0; k < receivers.size(); k++)
+        {
+            uint32_t systemId = GetSystemId(receivers[k]);
+            if (systemId == m_systemId)
             {
-                NS_LOG_INFO("Getting node index from NetDevice, since it exists");
-                dstNode = dstNetDevice->GetNode()->GetId();
-                NS_LOG_DEBUG("dstNode = " << dstNode);
+                receivers[nLocal++] = receivers[k];
             }
             else
             {
-                NS_LOG_INFO("No net device connected to the PHY, using context 0");
+                remoteSystems.insert(systemId);
             }
+        }
+        receivers.resize(nLocal);
+
+        if (sender)
+        {
+            NS_LOG_INFO("Forwarding to " << remoteSystems.size() << " other partitions");
+            for (uint32_t systemId : remoteSystems)
+            {
+                m_remoteSend(systemId, transmission, txPowerDbm, senderMobility->GetPosition());
+            }
+        }
+    }
+
+    // Cached link budgets are cheaper to look up than to compute in parallel
+    bool useCache = m_linkBudgetCache && IsLinkBudgetCacheable();
+    if (!useCache && m_propagationThreads > 1 &&
+        receivers.size() >= 2 * minReceiversPerThread && GetLastThreadSafeLossModel())
+    {
+        DeliverInParallel(receivers, senderMobility, packet, txPowerDbm, parameters);
+        return;
+    }
+
+    auto senderIndex = m_phyIndexes.find(PeekPointer(sender));
+    if (useCache && senderIndex == m_phyIndexes.end())
+    {
+        NS_LOG_INFO("The sender is not connected to the channel, not using the cache");
+        useCache = false;
+    }
+
+    for (uint32_t j : receivers)
+    {
+        DeliverTo(j,
+                  useCache ? senderIndex->second : NO_CACHE,
+                  senderMobility,
+                  packet,
+                  txPowerDbm,
+                  parameters);
+    }
+}
+
+void
+LoraChannel::DeliverTo(uint32_t j,
+                       uint32_t senderIndex,
+                       Ptr<MobilityModel> senderMobility,
+                       Ptr<Packet> packet,
+                       double txPowerDbm,
+                       LoraChannelParameters parameters) const
+{
+    NS_LOG_FUNCTION(this << j << packet << txPowerDbm);
+
+    // Get the receiver's mobility model
+    Ptr<MobilityModel> receiverMobility = m_phyList[j]->GetMobility()->GetObject<MobilityModel>();
+
+    NS_LOG_INFO("Receiver mobility: " << receiverMobility->GetPosition());
+
+    // Compute delay using the delay model
+    Time delay = m_delay->GetDelay(senderMobility, receiverMobility);
 
-            // Create the parameters object based on the calculations above
-            LoraChannelParameters parameters;
-            parameters.rxPowerDbm = rxPowerDbm;
-            parameters.sf = txParams.sf;
-            parameters.duration = duration;
-            parameters.frequencyMHz = frequencyMHz;
+    // Compute received power using the loss model, or the link budget cache
+    double rxPowerDbm =
+        (senderIndex != NO_CACHE)
+            ? GetCachedRxPower(senderIndex, j, txPowerDbm, senderMobility, receiverMobility)
+            : GetRxPower(txPowerDbm, senderMobility, receiverMobility);
 
-            // Schedule the receive event
-            NS_LOG_INFO("Scheduling reception of the packet");
-            Simulator::ScheduleWithContext(dstNode,
-                                           delay,
-                                           &LoraChannel::Receive,
-                                           this,
-                                           j,
-                                           packet,
-                                           parameters);
+    NS_LOG_DEBUG("Propagation: txPower="
+                 << txPowerDbm << "dbm, rxPower=" << rxPowerDbm << "dbm, "
+                 << "distance=" << senderMobility->GetDistanceFrom(receiverMobility)
+                 << "m, delay=" << delay);
 
-            // Fire the trace source for sent packet
-            m_packetSent(packet);
+    // Complete the parameters object based on the calculations above
+    parameters.rxPowerDbm = rxPowerDbm;
+
+    ScheduleReceive(j, delay, packet, parameters);
+}
+
+void
+LoraChannel::DeliverInParallel(const std::vector<uint32_t>& receivers,
+                               Ptr<MobilityModel> senderMobility,
+                               Ptr<Packet> packet,
+                               double txPowerDbm,
+                               LoraChannelParameters parameters) const
+{
+    NS_LOG_FUNCTION(this << receivers.size() << packet << txPowerDbm);
+
+    // Use at most one thread every minReceiversPerThread receivers
+    auto nThreads = uint32_t(
+        std::min<std::size_t>(m_propagationThreads, receivers.size() / minReceiversPerThread));
+    if (!m_propagationWorkers || m_propagationWorkers->GetNThreads() != nThreads)
+    {
+        delete m_propagationWorkers;
+        m_propagationWorkers = new LoraChannelPropagationWorkers(nThreads);
+    }
+
+    // Mobility models and the delay model are only used from this thread
+    std::size_t n = receivers.size();
+    std::vector<Ptr<MobilityModel>> receiverMobilities(n);
+    std::vector<Vector> receiverPositions(n);
+    std::vector<Time> delays(n);
+    for (std::size_t k = 0; k < n; k++)
+    {
+        receiverMobilities[k] = m_phyList[receivers[k]]->GetMobility()->GetObject<MobilityModel>();
+        receiverPositions[k] = receiverMobilities[k]->GetPosition();
+        delays[k] = m_delay->GetDelay(senderMobility, receiverMobilities[k]);
+    }
+
+    // The chain is cut after the thread-safe models while the workers run,
+    // since nothing else can evaluate it in the meantime
+    Ptr<PropagationLossModel> last = GetLastThreadSafeLossModel();
+    Ptr<PropagationLossModel> next = last->GetNext();
+    last->SetNext(nullptr);
+
+    NS_LOG_INFO("Computing the reception power at " << n << " PHYs on " << nThreads
+                                                    << " threads");
+    std::vector<double> rxPowerDbm(n);
+    m_propagationWorkers->Compute(m_loss,
+                                  txPowerDbm,
+                                  senderMobility->GetPosition(),
+                                  receiverPositions,
+                                  rxPowerDbm);
+    last->SetNext(next);
+
+    // The rest of the chain is applied receiver by receiver, like in a serial
+    // run, so that random variables are drawn in the same order
+    if (next)
+    {
+        for (std::size_t k = 0; k < n; k++)
+        {
+            rxPowerDbm[k] = next->CalcRxPower(rxPowerDbm[k], senderMobility, receiverMobilities[k]);
         }
     }
+
+    // Schedule the receive events in the same order as a serial run
+    for (std::size_t k = 0; k < n; k++)
+    {
+        parameters.rxPowerDbm = rxPowerDbm[k];
+        ScheduleReceive(receivers[k], delays[k], packet, parameters);
+    }
+}
+
+void
+LoraChannel::ScheduleReceive(uint32_t j,
+                             Time delay,
+                             Ptr<Packet> packet,
+                             LoraChannelParameters parameters) const
+{
+    NS_LOG_FUNCTION(this << j << delay << packet << parameters);
+
+    // Pairs out of reach in the link budget cache have an infinite loss
+    if (parameters.rxPowerDbm < m_interferenceFloor || std::isinf(parameters.rxPowerDbm))
+    {
+        NS_LOG_INFO("Reception power below the interference floor, not delivering the packet");
+        m_nBelowInterferenceFloor++;
+        m_belowInterferenceFloor(packet);
+        return;
+    }
+
+    // Get the id of the destination PHY to correctly format the context
+    Ptr<NetDevice> dstNetDevice = m_phyList[j]->GetDevice();
+    uint32_t dstNode = 0;
+    if (dstNetDevice)
+    {
+        NS_LOG_INFO("Getting node index from NetDevice, since it exists");
+        dstNode = dstNetDevice->GetNode()->GetId();
+        NS_LOG_DEBUG("dstNode = " << dstNode);
+    }
+    else
+    {
+        NS_LOG_INFO("No net device connected to the PHY, using context 0");
+    }
+
+    // Schedule the receive event
+    NS_LOG_INFO("Scheduling reception of the packet");
+    Simulator::ScheduleWithContext(dstNode,
+                                   delay,
+                                   &LoraChannel::Receive,
+                                   this,
+                                   j,
+                                   packet,
+                                   parameters);
+
+    // Fire the trace source for sent packet
+    m_packetSent(packet);
+}
+
+uint32_t
+LoraChannel::GetSystemId(uint32_t i) const
+{
+    // PHYs without a device can't belong to another partition
+    Ptr<NetDevice> device = m_phyList[i]->GetDevice();
+    return device ? device->GetNode()->GetSystemId() : m_systemId;
+}
+
+const std::vector<uint32_t>&
+LoraChannel::GetRemotePhys() const
+{
+    // Devices are attached to the PHYs after they are connected to the
+    // channel: look for the remote ones once the simulation started
+    if (!m_remotePhysValid)
+    {
+        m_remotePhys.clear();
+        if (!m_remoteSend.IsNull())
+        {
+            for (uint32_t i = 0; i < m_phyList.size(); i++)
+            {
+                if (GetSystemId(i) != m_systemId)
+                {
+                    m_remotePhys.push_back(i);
+                }
+            }
+        }
+        m_remotePhysValid = true;
+    }
+    return m_remotePhys;
 }
 
 void
@@ -194,11 +999,7 @@ LoraChannel::Receive(uint32_t i, Ptr<Packet> packet, LoraChannelParameters param
     NS_LOG_FUNCTION(this << i << packet << parameters);
 
     // Call the appropriate PHY instance to let it begin reception
-    m_phyList[i]->StartReceive(packet,
-                               parameters.rxPowerDbm,
-                               parameters.sf,
-                               parameters.duration,
-                               parameters.frequencyMHz);
+    m_phyList[i]->StartReceive(parameters.transmission, parameters.rxPowerDbm);
 }
 
 double
@@ -209,12 +1010,490 @@ LoraChannel::GetRxPower(double txPowerDbm,
     return m_loss->CalcRxPower(txPowerDbm, senderMobility, receiverMobility);
 }
 
+/**
+ * Check whether all models in a loss chain are of one of the given types.
+ *
+ * \param loss The first model of the chain.
+ * \param types The allowed types.
+ * \return True if the chain is not empty and all models are of the allowed types.
+ */
+static bool
+ChainOnlyContains(Ptr<PropagationLossModel> loss, const std::vector<TypeId>& types)
+{
+    if (!loss)
+    {
+        return false;
+    }
+    for (Ptr<PropagationLossModel> model = loss; model; model = model->GetNext())
+    {
+        if (std::find(types.begin(), types.end(), model->GetInstanceTypeId()) == types.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The loss models that only depend on the positions of the nodes.
+ *
+ * \return The TypeIds of the models.
+ */
+static const std::vector<TypeId>&
+GetPositionOnlyLossModels()
+{
+    static const std::vector<TypeId> models = {
+        FriisPropagationLossModel::GetTypeId(),
+        TwoRayGroundPropagationLossModel::GetTypeId(),
+        LogDistancePropagationLossModel::GetTypeId(),
+        ThreeLogDistancePropagationLossModel::GetTypeId(),
+        FixedRssLossModel::GetTypeId(),
+        RangePropagationLossModel::GetTypeId(),
+    };
+    return models;
+}
+
+uint64_t
+LoraChannel::GetNBelowInterferenceFloor() const
+{
+    return m_nBelowInterferenceFloor;
+}
+
+double
+LoraChannel::GetMaxRange(double txPowerDbm) const
+{
+    NS_LOG_FUNCTION(this << txPowerDbm);
+
+    if (m_maxRange > 0)
+    {
+        return m_maxRange;
+    }
+    if (std::isinf(m_interferenceFloor) || !IsPropagationThreadSafe())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    if (!(m_maxRangesFloor == m_interferenceFloor))
+    {
+        m_maxRanges.clear();
+        m_maxRangesFloor = m_interferenceFloor;
+    }
+    auto it = m_maxRanges.find(txPowerDbm);
+    if (it != m_maxRanges.end())
+    {
+        return it->second;
+    }
+
+    // Look for the distance at which the reception power falls below the
+    // floor: double the distance until it does, then bisect.
+    Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel>();
+    Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel>();
+    auto isBelowFloor = [this, txPowerDbm, a, b](double distance) {
+        b->SetPosition(Vector(distance, 0, 0));
+        return GetRxPower(txPowerDbm, a, b) < m_interferenceFloor;
+    };
+    double low = 0;
+    double high = 1;
+    while (!isBelowFloor(high))
+    {
+        low = high;
+        high *= 2;
+        if (high > 1e8)
+        {
+            high = std::numeric_limits<double>::infinity();
+            break;
+        }
+    }
+    for (int i = 0; i < 64 && std::isfinite(high) && high - low > 1e-3; i++)
+    {
+        double middle = (low + high) / 2;
+        if (isBelowFloor(middle))
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
+    }
+
+    NS_LOG_DEBUG("Maximum range at " << txPowerDbm << " dBm: " << high << " m");
+    m_maxRanges[txPowerDbm] = high;
+    return high;
+}
+
+bool
+LoraChannel::IsListening(uint32_t i, double frequencyMHz) const
+{
+    if (m_listeningEndDevicePhys.count(i))
+    {
+        return m_phyList[i]->IsOnFrequency(frequencyMHz);
+    }
+    return std::binary_search(m_alwaysListeningPhys.begin(), m_alwaysListeningPhys.end(), i);
+}
+
+uint64_t
+LoraChannel::GetCellKey(int64_t x, int64_t y)
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+}
+
+int64_t
+LoraChannel::GetCellCoordinate(double coordinate) const
+{
+    return int64_t(std::floor(coordinate / m_spatialIndexCellSize));
+}
+
+void
+LoraChannel::GetReceiversInRange(Ptr<LoraPhy> sender,
+                                 const Vector& position,
+                                 double range,
+                                 double frequencyMHz,
+                                 std::vector<uint32_t>& receivers) const
+{
+    NS_LOG_FUNCTION(this << sender << position << range << frequencyMHz);
+
+    if (!m_spatialIndexValid)
+    {
+        BuildSpatialIndex();
+    }
+
+    // The state of remote PHYs is only known by their own process
+    const std::vector<uint32_t>& remotePhys = GetRemotePhys();
+    auto collect = [&](const std::vector<uint32_t>& cell) {
+        for (uint32_t j : cell)
+        {
+            if (sender != m_phyList[j] &&
+                (!m_listeningFanOut || IsListening(j, frequencyMHz) ||
+                 std::binary_search(remotePhys.begin(), remotePhys.end(), j)))
+            {
+                receivers.push_back(j);
+            }
+        }
+    };
+
+    // The cells intersecting the square that contains the range disc
+    int64_t xMin = GetCellCoordinate(position.x - range);
+    int64_t xMax = GetCellCoordinate(position.x + range);
+    int64_t yMin = GetCellCoordinate(position.y - range);
+    int64_t yMax = GetCellCoordinate(position.y + range);
+
+    if (double(xMax - xMin + 1) * double(yMax - yMin + 1) > double(m_cells.size()))
+    {
+        // Fewer cells are occupied than the square covers: visit the occupied ones
+        for (const auto& cell : m_cells)
+        {
+            auto x = int64_t(int32_t(cell.first >> 32));
+            auto y = int64_t(int32_t(cell.first & 0xffffffff));
+            if (x >= xMin && x <= xMax && y >= yMin && y <= yMax)
+            {
+                collect(cell.second);
+            }
+        }
+    }
+    else
+    {
+        for (int64_t x = xMin; x <= xMax; x++)
+        {
+            for (int64_t y = yMin; y <= yMax; y++)
+            {
+                auto cell = m_cells.find(GetCellKey(x, y));
+                if (cell != m_cells.end())
+                {
+                    collect(cell->second);
+                }
+            }
+        }
+    }
+
+    // Deliver in the same order as when cycling over all PHYs
+    std::sort(receivers.begin(), receivers.end());
+}
+
+void
+LoraChannel::BuildSpatialIndex() const
+{
+    NS_LOG_FUNCTION(this);
+
+    m_cells.clear();
+    m_mobilityPhys.clear();
+    m_phyCells.assign(m_phyList.size(), 0);
+    for (uint32_t i = 0; i < m_phyList.size(); i++)
+    {
+        Ptr<MobilityModel> mobility = m_phyList[i]->GetMobility();
+        Vector position = mobility->GetPosition();
+        uint64_t key =
+            GetCellKey(GetCellCoordinate(position.x), GetCellCoordinate(position.y));
+        m_cells[key].push_back(i);
+        m_phyCells[i] = key;
+        m_mobilityPhys[PeekPointer(mobility)].push_back(i);
+
+        if (m_spatialIndexMobilities.insert(mobility).second)
+        {
+            mobility->TraceConnectWithoutContext(
+                "CourseChange",
+                MakeCallback(&LoraChannel::SpatialIndexCourseChange, this));
+        }
+    }
+    m_spatialIndexValid = true;
+
+    NS_LOG_INFO("Spatial index: " << m_phyList.size() << " PHYs in " << m_cells.size()
+                                  << " cells");
+}
+
+void
+LoraChannel::SpatialIndexCourseChange(Ptr<const MobilityModel> mobility) const
+{
+    NS_LOG_FUNCTION(this << mobility);
+
+    if (!m_spatialIndexValid)
+    {
+        return;
+    }
+
+    auto phys = m_mobilityPhys.find(PeekPointer(mobility));
+    if (phys == m_mobilityPhys.end())
+    {
+        return;
+    }
+
+    Vector position = mobility->GetPosition();
+    uint64_t key = GetCellKey(GetCellCoordinate(position.x), GetCellCoordinate(position.y));
+    for (uint32_t i : phys->second)
+    {
+        if (m_phyCells[i] == key)
+        {
+            continue;
+        }
+
+        // Move the phy to its new cell
+        std::vector<uint32_t>& oldCell = m_cells[m_phyCells[i]];
+        oldCell.erase(std::find(oldCell.begin(), oldCell.end(), i));
+        if (oldCell.empty())
+        {
+            m_cells.erase(m_phyCells[i]);
+        }
+        m_cells[key].push_back(i);
+        m_phyCells[i] = key;
+    }
+}
+
+void
+LoraChannel::ClearSpatialIndex()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (const auto& mobility : m_spatialIndexMobilities)
+    {
+        mobility->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&LoraChannel::SpatialIndexCourseChange, this));
+    }
+    m_spatialIndexMobilities.clear();
+    m_cells.clear();
+    m_phyCells.clear();
+    m_mobilityPhys.clear();
+    m_spatialIndexValid = false;
+}
+
+bool
+LoraChannel::IsPropagationThreadSafe() const
+{
+    return ChainOnlyContains(m_loss, GetPositionOnlyLossModels());
+}
+
+Ptr<PropagationLossModel>
+LoraChannel::GetLastThreadSafeLossModel() const
+{
+    const std::vector<TypeId>& models = GetPositionOnlyLossModels();
+    Ptr<PropagationLossModel> last;
+    for (Ptr<PropagationLossModel> model = m_loss; model; model = model->GetNext())
+    {
+        if (std::find(models.begin(), models.end(), model->GetInstanceTypeId()) == models.end())
+        {
+            break;
+        }
+        last = model;
+    }
+    return last;
+}
+
+bool
+LoraChannel::IsLinkBudgetCacheable() const
+{
+    static std::vector<TypeId> models;
+    if (models.empty())
+    {
+        models = GetPositionOnlyLossModels();
+        models.push_back(CorrelatedShadowingPropagationLossModel::GetTypeId());
+    }
+    return ChainOnlyContains(m_loss, models);
+}
+
+double
+LoraChannel::GetCachedRxPower(uint32_t senderIndex,
+                              uint32_t receiverIndex,
+                              double txPowerDbm,
+                              Ptr<MobilityModel> senderMobility,
+                              Ptr<MobilityModel> receiverMobility) const
+{
+    if (m_linkBudgets.size() < m_phyList.size())
+    {
+        m_linkBudgets.resize(m_phyList.size(), {std::numeric_limits<double>::quiet_NaN(), {}, {}});
+    }
+    LinkBudgetRow& row = m_linkBudgets[senderIndex];
+
+    // Rows are only valid for a single transmission power
+    if (!(row.txPowerDbm == txPowerDbm))
+    {
+        NS_LOG_DEBUG("Computing the link budget of phy " << senderIndex << " at " << txPowerDbm
+                                                         << " dBm");
+        row.txPowerDbm = txPowerDbm;
+        row.rxPowerDbm.clear();
+        row.belowFloor.clear();
+        FollowCourseChanges(senderMobility);
+    }
+
+    if (receiverIndex < row.belowFloor.size() && row.belowFloor[receiverIndex])
+    {
+        return -std::numeric_limits<double>::infinity();
+    }
+    auto it = row.rxPowerDbm.find(receiverIndex);
+    if (it != row.rxPowerDbm.end())
+    {
+        return it->second;
+    }
+
+    double rxPowerDbm = GetRxPower(txPowerDbm, senderMobility, receiverMobility);
+    FollowCourseChanges(receiverMobility);
+    if (rxPowerDbm < std::max(m_linkBudgetCacheFloor, m_interferenceFloor))
+    {
+        // Pairs out of reach are not computed again, and only take one bit
+        if (row.belowFloor.size() <= receiverIndex)
+        {
+            row.belowFloor.resize(m_phyList.size(), false);
+        }
+        row.belowFloor[receiverIndex] = true;
+        return -std::numeric_limits<double>::infinity();
+    }
+    row.rxPowerDbm[receiverIndex] = rxPowerDbm;
+    return rxPowerDbm;
+}
+
+void
+LoraChannel::FillLinkBudgetCache(double txPowerDbm)
+{
+    NS_LOG_FUNCTION(this << txPowerDbm);
+
+    if (!m_linkBudgetCache || !IsLinkBudgetCacheable())
+    {
+        NS_LOG_WARN("The link budget cache is not in use");
+        return;
+    }
+
+    for (uint32_t i = 0; i < m_phyList.size(); i++)
+    {
+        Ptr<MobilityModel> senderMobility = m_phyList[i]->GetMobility();
+        for (uint32_t j = 0; j < m_phyList.size(); j++)
+        {
+            if (i != j)
+            {
+                GetCachedRxPower(i, j, txPowerDbm, senderMobility, m_phyList[j]->GetMobility());
+            }
+        }
+    }
+
+    NS_LOG_INFO("Link budget cache: " << GetLinkBudgetCacheSize() << " pairs, "
+                                      << GetLinkBudgetCacheMemoryUsage() << " bytes");
+}
+
+std::size_t
+LoraChannel::GetLinkBudgetCacheSize() const
+{
+    std::size_t size = 0;
+    for (const auto& row : m_linkBudgets)
+    {
+        size += row.rxPowerDbm.size();
+    }
+    return size;
+}
+
+std::size_t
+LoraChannel::GetLinkBudgetCacheMemoryUsage() const
+{
+    // Each entry of an unordered_map is a node holding the value and a pointer
+    // to the next node, and each bucket holds a pointer.
+    std::size_t memory = m_linkBudgets.capacity() * sizeof(LinkBudgetRow);
+    for (const auto& row : m_linkBudgets)
+    {
+        memory +=
+            row.rxPowerDbm.size() * (sizeof(std::pair<const uint32_t, double>) + sizeof(void*));
+        memory += row.rxPowerDbm.bucket_count() * sizeof(void*);
+        memory += row.belowFloor.capacity() / 8;
+    }
+    return memory;
+}
+
+void
+LoraChannel::FollowCourseChanges(Ptr<MobilityModel> mobility) const
+{
+    if (m_linkBudgetMobilities.insert(mobility).second)
+    {
+        mobility->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&LoraChannel::LinkBudgetCourseChange, this));
+    }
+}
+
+void
+LoraChannel::LinkBudgetCourseChange(Ptr<const MobilityModel> mobility) const
+{
+    NS_LOG_FUNCTION(this << mobility);
+
+    for (uint32_t i = 0; i < m_phyList.size() && i < m_linkBudgets.size(); i++)
+    {
+        if (PeekPointer(m_phyList[i]->GetMobility()) != PeekPointer(mobility))
+        {
+            continue;
+        }
+
+        // Drop the transmissions of this phy, and the receptions at this phy
+        m_linkBudgets[i].txPowerDbm = std::numeric_limits<double>::quiet_NaN();
+        m_linkBudgets[i].rxPowerDbm.clear();
+        m_linkBudgets[i].belowFloor.clear();
+        for (auto& row : m_linkBudgets)
+        {
+            row.rxPowerDbm.erase(i);
+            if (i < row.belowFloor.size())
+            {
+                row.belowFloor[i] = false;
+            }
+        }
+    }
+}
+
+void
+LoraChannel::ClearLinkBudgetCache()
+{
+    NS_LOG_FUNCTION(this);
+
+    for (const auto& mobility : m_linkBudgetMobilities)
+    {
+        mobility->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeCallback(&LoraChannel::LinkBudgetCourseChange, this));
+    }
+    m_linkBudgetMobilities.clear();
+    m_linkBudgets.clear();
+}
+
 std::ostream&
 operator<<(std::ostream& os, const LoraChannelParameters& params)
 {
-    os << "(rxPowerDbm: " << params.rxPowerDbm << ", SF: " << unsigned(params.sf)
-       << ", durationSec: " << params.duration.GetSeconds()
-       << ", frequencyMHz: " << params.frequencyMHz << ")";
+    os << "(rxPowerDbm: " << params.rxPowerDbm
+       << ", SF: " << unsigned(params.transmission->GetSpreadingFactor())
+       << ", durationSec: " << params.transmission->GetDuration().GetSeconds()
+       << ", frequencyMHz: " << params.transmission->GetFrequency() << ")";
     return os;
 }
 } // namespace lorawan
@@ -24,8 +24,10 @@
 #define LORA_CHANNEL_H
 
 #include "logical-lora-channel.h"
+#include "lora-interference-helper.h"
 #include "lora-phy.h"
 
+#include "ns3/callback.h"
 #include "ns3/channel.h"
 #include "ns3/mobility-model.h"
 #include "ns3/net-device.h"
@@ -34,6 +36,9 @@
 #include "ns3/propagation-delay-model.h"
 #include "ns3/propagation-loss-model.h"
 
+#include <map>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace ns3
@@ -46,6 +51,8 @@ namespace lorawan
 {
 
 class LoraPhy;
+class LoraChannelPhyListener;
+class LoraChannelPropagationWorkers;
 struct LoraTxParameters;
 
 /**
@@ -56,10 +63,9 @@ struct LoraTxParameters;
  */
 struct LoraChannelParameters
 {
-    double rxPowerDbm;   //!< The reception power.
-    uint8_t sf;          //!< The Spreading Factor of this transmission.
-    Time duration;       //!< The duration of the transmission.
-    double frequencyMHz; //!< The frequency [MHz] of this transmission.
+    double rxPowerDbm; //!< The reception power.
+    Ptr<const LoraInterferenceHelper::Transmission>
+        transmission; //!< The transmission, shared by all receivers.
 };
 
 /**
@@ -77,6 +83,47 @@ std::ostream& operator<<(std::ostream& os, const LoraChannelParameters& params);
  * computing the power at every receiver using a PropagationLossModel and
  * notifying them of the reception event after a delay based on some
  * PropagationDelayModel.
+ *
+ * By default, every transmission is delivered to all connected PHYs. When the
+ * ListeningFanOut attribute is enabled, the channel keeps track of the state
+ * of connected EndDeviceLoraPhy objects and only delivers a transmission to
+ * gateways and to end devices that are currently in STANDBY or RX state on
+ * the frequency of the transmission. End devices that are sleeping,
+ * transmitting or tuned to another frequency are skipped altogether: no
+ * reception event is scheduled for them, and the transmission is not recorded
+ * in their LoraInterferenceHelper.
+ *
+ * When the PropagationThreads attribute is larger than 1, the reception power
+ * towards the receivers of a transmission is computed by a pool of threads,
+ * while propagation delays are still computed, and reception events
+ * scheduled, by the simulation thread, in the same order as in a serial run.
+ * The pool only evaluates the models at the head of the loss chain that are
+ * deterministic functions of the node positions (see IsPropagationThreadSafe).
+ * The models after them, which may draw random variables or keep caches (e.g.,
+ * CorrelatedShadowingPropagationLossModel and BuildingPenetrationLoss), are
+ * then applied by the simulation thread to each receiver in turn, so that they
+ * draw the same values as in a serial run. Channels whose first loss model is
+ * not thread-safe fall back to the serial computation.
+ *
+ * When the LinkBudgetCache attribute is enabled, the reception power computed
+ * for each (sender, receiver) pair is stored and reused by later transmissions
+ * of the sender at the same power. This is only done if every model in the loss
+ * chain gives the same result every time it is evaluated for the same positions
+ * (see IsLinkBudgetCacheable). Entries involving a node are dropped when its
+ * mobility model fires its CourseChange trace source. Pairs whose reception
+ * power is below the LinkBudgetCacheFloor or the InterferenceFloor attribute
+ * are only marked as out of reach, with a single bit, and transmissions
+ * between them are dropped like those below the interference floor.
+ *
+ * In a distributed simulation, each process only simulates the nodes whose
+ * system id is its own, but connects the PHYs of all nodes to its channel.
+ * Once a remote send callback is set (see SetRemoteSendCallback, and
+ * LoraChannelPartitionProxy for an implementation on top of the ns-3 MPI
+ * interface), transmissions are only delivered to the local PHYs, and are
+ * forwarded once to each other process that simulates at least one of their
+ * receivers, which delivers them to its own PHYs through DeliverRemote. With
+ * the SpatialIndex attribute enabled, only the transmissions that reach across
+ * the border of a partition are forwarded.
  */
 class LoraChannel : public Channel
 {
@@ -166,6 +213,134 @@ class LoraChannel : public Channel
                       Ptr<MobilityModel> senderMobility,
                       Ptr<MobilityModel> receiverMobility) const;
 
+    /**
+     * Check whether the propagation models of this channel can be evaluated by
+     * multiple threads at once.
+     *
+     * This is the case when all models in the loss chain and the delay model
+     * are deterministic functions of the node positions, without internal
+     * state (e.g., LogDistancePropagationLossModel and
+     * ConstantSpeedPropagationDelayModel).
+     *
+     * \return True if the propagation can be computed in parallel.
+     */
+    bool IsPropagationThreadSafe() const;
+
+    /**
+     * Get the last model of the longest sequence of thread-safe models at the
+     * head of the loss chain, i.e., the part of the chain that can be
+     * evaluated by the propagation worker threads.
+     *
+     * \return The last thread-safe model, or nullptr if the first model of the
+     * chain is not thread-safe.
+     */
+    Ptr<PropagationLossModel> GetLastThreadSafeLossModel() const;
+
+    /**
+     * Check whether the reception power computed by the loss models of this
+     * channel can be cached.
+     *
+     * This is the case when all models in the loss chain give the same result
+     * every time they are evaluated for the same positions: the models that are
+     * thread-safe (see IsPropagationThreadSafe), and the
+     * CorrelatedShadowingPropagationLossModel, which draws the shadowing of a
+     * link once and then keeps it.
+     *
+     * \return True if the link budget cache can be used.
+     */
+    bool IsLinkBudgetCacheable() const;
+
+    /**
+     * Compute the reception power between all pairs of connected PHYs, and
+     * store it in the link budget cache.
+     *
+     * This method has no effect if the LinkBudgetCache attribute is disabled
+     * or the loss models can't be cached.
+     *
+     * \param txPowerDbm The transmission power to compute the link budget for.
+     */
+    void FillLinkBudgetCache(double txPowerDbm);
+
+    /**
+     * Get the number of (sender, receiver) pairs currently stored in the link
+     * budget cache.
+     *
+     * \return The number of cached pairs.
+     */
+    std::size_t GetLinkBudgetCacheSize() const;
+
+    /**
+     * Get an estimate of the memory used by the link budget cache.
+     *
+     * \return The memory used by the cache, in bytes.
+     */
+    std::size_t GetLinkBudgetCacheMemoryUsage() const;
+
+    /**
+     * Get the number of receptions that were dropped because their power was
+     * below the interference floor.
+     *
+     * \return The number of dropped receptions.
+     */
+    uint64_t GetNBelowInterferenceFloor() const;
+
+    /**
+     * Get the maximum distance at which a transmission can be delivered.
+     *
+     * This is the MaxRange attribute, if set. Otherwise, if the interference
+     * floor is set and the loss models only depend on the positions of the
+     * nodes (see IsPropagationThreadSafe), it is the distance at which the
+     * reception power falls below the interference floor, assuming that the
+     * loss increases with the distance. Otherwise, the range is infinite.
+     *
+     * \param txPowerDbm The power of the transmission.
+     * \return The maximum range in meters.
+     */
+    double GetMaxRange(double txPowerDbm) const;
+
+    /**
+     * Callback used to forward a transmission to the PHYs simulated by another
+     * process. The arguments are the system id of the process, the
+     * transmission, its power and the position of the sender.
+     */
+    typedef Callback<void,
+                     uint32_t,
+                     Ptr<const LoraInterferenceHelper::Transmission>,
+                     double,
+                     Vector>
+        RemoteSendCallback;
+
+    /**
+     * Make this channel deliver transmissions only to the PHYs of the nodes
+     * simulated by this process, and forward them to the other processes
+     * through a callback.
+     *
+     * \param systemId The system id of this process.
+     * \param callback The callback forwarding transmissions to another process.
+     */
+    void SetRemoteSendCallback(uint32_t systemId, RemoteSendCallback callback);
+
+    /**
+     * Deliver a transmission sent by a PHY simulated by another process to the
+     * PHYs simulated by this process.
+     *
+     * \param packet The packet that is being sent.
+     * \param txPowerDbm The power of the transmission.
+     * \param senderPosition The position of the sender.
+     * \param sf The spreading factor of the transmission.
+     * \param duration The on-air duration of the packet.
+     * \param frequencyMHz The frequency of the transmission.
+     */
+    void DeliverRemote(Ptr<Packet> packet,
+                       double txPowerDbm,
+                       Vector senderPosition,
+                       uint8_t sf,
+                       Time duration,
+                       double frequencyMHz) const;
+
+  protected:
+    void DoDispose() override;
+
   private:
     /**
      * Private method that is scheduled by LoraChannel's Send method to happen
@@ -180,6 +355,256 @@ class LoraChannel : public Channel
      */
     void Receive(uint32_t i, Ptr<Packet> packet, LoraChannelParameters parameters) const;
 
+    /**
+     * Deliver a transmission to the connected PHYs, and forward it to the other
+     * processes of a distributed simulation if it comes from a local PHY.
+     *
+     * \param sender The phy that is sending the packet, or nullptr if it is
+     * simulated by another process.
+     * \param senderMobility The mobility model of the sender.
+     * \param transmission The transmission, shared by all receivers.
+     * \param txPowerDbm The power of the transmission.
+     */
+    void Deliver(Ptr<LoraPhy> sender,
+                 Ptr<MobilityModel> senderMobility,
+                 Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                 double txPowerDbm) const;
+
+    /**
+     * Get the system id of the node of a connected PHY.
+     *
+     * \param i The index of the phy.
+     * \return The system id of the process simulating the phy.
+     */
+    uint32_t GetSystemId(uint32_t i) const;
+
+    /**
+     * Get the connected PHYs simulated by other processes, whose state is
+     * only known by their own process.
+     *
+     * \return The indexes of the remote PHYs, in increasing order.
+     */
+    const std::vector<uint32_t>& GetRemotePhys() const;
+
+    /**
+     * Compute the propagation towards a connected PHY and schedule the
+     * corresponding Receive call.
+     *
+     * \param i The index of the receiving phy.
+     * \param senderIndex The index of the sending phy, used to look up the
+     * link budget cache, or NO_CACHE to compute the reception power.
+     * \param senderMobility The mobility model of the sender.
+     * \param packet The packet that is being sent.
+     * \param txPowerDbm The power of the transmission.
+     * \param parameters The parameters of the transmission (the reception power
+     * is filled in by this method).
+     */
+    void DeliverTo(uint32_t i,
+                   uint32_t senderIndex,
+                   Ptr<MobilityModel> senderMobility,
+                   Ptr<Packet> packet,
+                   double txPowerDbm,
+                   LoraChannelParameters parameters) const;
+
+    /**
+     * Compute the propagation towards a set of receivers on the propagation
+     * worker threads, and schedule the corresponding Receive calls in order.
+     *
+     * The workers only evaluate the loss chain up to
+     * GetLastThreadSafeLossModel, and the rest of the chain is applied
+     * serially afterwards.
+     *
+     * \param receivers The indexes of the receiving PHYs.
+     * \param senderMobility The mobility model of the sender.
+     * \param packet The packet that is being sent.
+     * \param txPowerDbm The power of the transmission.
+     * \param parameters The parameters of the transmission (the reception power
+     * is filled in by this method).
+     */
+    void DeliverInParallel(const std::vector<uint32_t>& receivers,
+                           Ptr<MobilityModel> senderMobility,
+                           Ptr<Packet> packet,
+                           double txPowerDbm,
+                           LoraChannelParameters parameters) const;
+
+    /**
+     * Schedule the Receive call of a transmission at a connected PHY, unless
+     * its power is below the interference floor.
+     *
+     * \param i The index of the receiving phy.
+     * \param delay The propagation delay towards the phy.
+     * \param packet The packet that is being sent.
+     * \param parameters The parameters of the transmission at the phy.
+     */
+    void ScheduleReceive(uint32_t i,
+                         Time delay,
+                         Ptr<Packet> packet,
+                         LoraChannelParameters parameters) const;
+
+    /**
+     * Start tracking the listening state of the phy at index i.
+     *
+     * End device PHYs are monitored through an EndDeviceLoraPhyListener, while
+     * any other kind of PHY is always considered to be listening.
+     *
+     * \param i The index of the phy in m_phyList.
+     */
+    void TrackPhy(uint32_t i);
+
+    /**
+     * Stop tracking the listening state of all PHYs in m_phyList, and
+     * unregister the listeners from end device PHYs.
+     */
+    void UntrackPhys();
+
+    /**
+     * Stop tracking the listening state of the phy at index i, and unregister
+     * its listener if it is an end device.
+     *
+     * \param i The index of the phy in m_phyList.
+     */
+    void UntrackPhy(uint32_t i);
+
+    /**
+     * Enable or disable ListeningFanOut, registering or unregistering the
+     * listeners of end device PHYs accordingly.
+     *
+     * \param listeningFanOut Whether to deliver transmissions only to listening PHYs.
+     */
+    void SetListeningFanOut(bool listeningFanOut);
+
+    /**
+     * Get whether ListeningFanOut is enabled.
+     *
+     * \return Whether transmissions are only delivered to listening PHYs.
+     */
+    bool GetListeningFanOut() const;
+
+    /**
+     * Update the listening state of the end device phy at index i.
+     *
+     * This method is called by the LoraChannelPhyListener registered on the
+     * end device's PHY.
+     *
+     * \param i The index of the phy in m_phyList.
+     * \param listening Whether the phy is now able to receive (STANDBY or RX).
+     */
+    void SetListening(uint32_t i, bool listening);
+
+    /**
+     * Get the reception power of a transmission from the link budget cache,
+     * computing and storing it if it's not there yet.
+     *
+     * \param senderIndex The index of the sending phy.
+     * \param receiverIndex The index of the receiving phy.
+     * \param txPowerDbm The power of the transmission.
+     * \param senderMobility The mobility model of the sender.
+     * \param receiverMobility The mobility model of the receiver.
+     * \return The received power in dBm.
+     */
+    double GetCachedRxPower(uint32_t senderIndex,
+                            uint32_t receiverIndex,
+                            double txPowerDbm,
+                            Ptr<MobilityModel> senderMobility,
+                            Ptr<MobilityModel> receiverMobility) const;
+
+    /**
+     * Make sure that the link budget cache is notified when a mobility model
+     * changes course.
+     *
+     * \param mobility The mobility model to follow.
+     */
+    void FollowCourseChanges(Ptr<MobilityModel> mobility) const;
+
+    /**
+     * Drop the link budget cache entries of the PHYs that use a mobility model.
+     *
+     * Connected to the CourseChange trace source of the mobility models of
+     * the PHYs that have entries in the cache.
+     *
+     * \param mobility The mobility model that changed course.
+     */
+    void LinkBudgetCourseChange(Ptr<const MobilityModel> mobility) const;
+
+    /**
+     * Drop all link budget cache entries and stop following course changes.
+     */
+    void ClearLinkBudgetCache();
+
+    /**
+     * Collect the PHYs that can receive a transmission using the spatial index.
+     *
+     * With ListeningFanOut, local PHYs that are not listening on the
+     * frequency of the transmission are left out, while remote PHYs are
+     * always collected.
+     *
+     * \param sender The phy that is sending the transmission.
+     * \param position The position of the sender.
+     * \param range The maximum range of the transmission.
+     * \param frequencyMHz The frequency of the transmission.
+     * \param receivers The indexes of the receiving PHYs, in increasing order.
+     */
+    void GetReceiversInRange(Ptr<LoraPhy> sender,
+                             const Vector& position,
+                             double range,
+                             double frequencyMHz,
+                             std::vector<uint32_t>& receivers) const;
+
+    /**
+     * Check whether a connected PHY is listening on a frequency, according
+     * to the state tracked for the ListeningFanOut attribute.
+     *
+     * \param i The index of the phy.
+     * \param frequencyMHz The frequency.
+     * \return True if the phy is listening.
+     */
+    bool IsListening(uint32_t i, double frequencyMHz) const;
+
+    /**
+     * Get the key of a spatial index cell.
+     *
+     * \param x The x coordinate of the cell, in cells.
+     * \param y The y coordinate of the cell, in cells.
+     * \return The key of the cell.
+     */
+    static uint64_t GetCellKey(int64_t x, int64_t y);
+
+    /**
+     * Get the coordinate of the spatial index cell containing a coordinate.
+     *
+     * \param coordinate The coordinate, in meters.
+     * \return The coordinate of the cell, in cells.
+     */
+    int64_t GetCellCoordinate(double coordinate) const;
+
+    /**
+     * Put all connected PHYs in the spatial index.
+     */
+    void BuildSpatialIndex() const;
+
+    /**
+     * Move the PHYs that use a mobility model to the spatial index cell of
+     * their new position.
+     *
+     * Connected to the CourseChange trace source of the mobility models of
+     * the connected PHYs.
+     *
+     * \param mobility The mobility model that changed course.
+     */
+    void SpatialIndexCourseChange(Ptr<const MobilityModel> mobility) const;
+
+    /**
+     * Empty the spatial index and stop following course changes.
+     */
+    void ClearSpatialIndex();
+
+    friend class LoraChannelPhyListener;
+
+    /**
+     * The sender index passed to DeliverTo to bypass the link budget cache.
+     */
+    static constexpr uint32_t NO_CACHE = UINT32_MAX;
+
     /**
      * The vector containing the PHYs that are currently connected to the
      * channel.
@@ -199,6 +624,176 @@ class LoraChannel : public Channel
      */
     Ptr<PropagationDelayModel> m_delay;
 
+    /**
+     * Whether to deliver transmissions only to PHYs that can potentially
+     * receive them.
+     */
+    bool m_listeningFanOut;
+
+    /**
+     * Indexes of the connected PHYs that are always notified of transmissions
+     * (i.e., all PHYs that are not end devices).
+     */
+    std::vector<uint32_t> m_alwaysListeningPhys;
+
+    /**
+     * Indexes of the connected end device PHYs that are currently in STANDBY
+     * or RX state.
+     */
+    std::set<uint32_t> m_listeningEndDevicePhys;
+
+    /**
+     * The listener registered on each connected PHY, by index in m_phyList
+     * (nullptr for PHYs that are not end devices). Only filled while
+     * ListeningFanOut is enabled.
+     */
+    std::vector<LoraChannelPhyListener*> m_phyListeners;
+
+    /**
+     * The number of threads computing the propagation of each transmission.
+     */
+    uint32_t m_propagationThreads;
+
+    /**
+     * The threads computing the propagation of each transmission, created
+     * the first time they are needed.
+     */
+    mutable LoraChannelPropagationWorkers* m_propagationWorkers;
+
+    /**
+     * The index of each connected PHY in m_phyList.
+     */
+    std::unordered_map<const LoraPhy*, uint32_t> m_phyIndexes;
+
+    /**
+     * Whether to cache the reception power between pairs of PHYs.
+     */
+    bool m_linkBudgetCache;
+
+    /**
+     * The reception power below which (sender, receiver) pairs are not cached.
+     */
+    double m_linkBudgetCacheFloor;
+
+    /**
+     * The link budgets cached for the transmissions of a PHY.
+     */
+    struct LinkBudgetRow
+    {
+        double txPowerDbm; //!< The transmission power the row was computed for
+        std::unordered_map<uint32_t, double>
+            rxPowerDbm;               //!< The reception power at each receiver above the floor
+        std::vector<bool> belowFloor; //!< Whether each receiver is known to be below the floor
+    };
+
+    /**
+     * The link budget cache, with one row for each sending PHY.
+     */
+    mutable std::vector<LinkBudgetRow> m_linkBudgets;
+
+    /**
+     * The mobility models whose CourseChange trace source is followed by
+     * the link budget cache.
+     */
+    mutable std::set<Ptr<MobilityModel>> m_linkBudgetMobilities;
+
+    /**
+     * The reception power below which transmissions are not delivered.
+     */
+    double m_interferenceFloor;
+
+    /**
+     * The number of receptions dropped because of the interference floor.
+     */
+    mutable uint64_t m_nBelowInterferenceFloor;
+
+    /**
+     * Whether to only deliver transmissions to PHYs that are within range.
+     */
+    bool m_spatialIndex;
+
+    /**
+     * The side of the cells of the spatial index, in meters.
+     */
+    double m_spatialIndexCellSize;
+
+    /**
+     * The maximum range of transmissions, in meters, or 0 to derive it from
+     * the loss model and the interference floor.
+     */
+    double m_maxRange;
+
+    /**
+     * Whether the spatial index contains all connected PHYs.
+     */
+    mutable bool m_spatialIndexValid;
+
+    /**
+     * The indexes of the PHYs in each cell of the spatial index.
+     */
+    mutable std::unordered_map<uint64_t, std::vector<uint32_t>> m_cells;
+
+    /**
+     * The key of the cell each connected PHY is in.
+     */
+    mutable std::vector<uint64_t> m_phyCells;
+
+    /**
+     * The indexes of the PHYs using each mobility model.
+     */
+    mutable std::unordered_map<const MobilityModel*, std::vector<uint32_t>> m_mobilityPhys;
+
+    /**
+     * The mobility models whose CourseChange trace source is followed by
+     * the spatial index.
+     */
+    mutable std::set<Ptr<MobilityModel>> m_spatialIndexMobilities;
+
+    /**
+     * The maximum range of transmissions at each transmission power, derived
+     * for m_maxRangesFloor.
+     */
+    mutable std::map<double, double> m_maxRanges;
+
+    /**
+     * The interference floor the ranges in m_maxRanges were derived for.
+     */
+    mutable double m_maxRangesFloor;
+
+    /**
+     * The system id of the process running this channel.
+     */
+    uint32_t m_systemId;
+
+    /**
+     * The callback forwarding transmissions to the other processes of a
+     * distributed simulation, if any.
+     */
+    RemoteSendCallback m_remoteSend;
+
+    /**
+     * The indexes of the PHYs simulated by other processes, in increasing
+     * order, found at the first transmission since the PHYs were connected.
+     */
+    mutable std::vector<uint32_t> m_remotePhys;
+
+    /**
+     * Whether m_remotePhys is up to date.
+     */
+    mutable bool m_remotePhysValid;
+
+    /**
+     * The mobility model standing for the senders simulated by other
+     * processes, moved to the position of each transmission they forward.
+     */
+    mutable Ptr<MobilityModel> m_remoteSenderMobility;
+
+    /**
+     * Callback for when a reception is dropped because its power is below the
+     * interference floor.
+     */
+    TracedCallback<Ptr<const Packet>> m_belowInterferenceFloor;
+
     /**
      * Callback for when a packet is being sent on the channel.
      */
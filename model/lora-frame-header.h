@@ -221,7 +221,7 @@ class LoraFrameHeader : public Header
      * \return A pointer to a MacCommand of type T.
      */
     template <typename T>
-    inline Ptr<T> GetMacCommand();
+    inline Ptr<T> GetMacCommand() const;
 
     /**
      * Add a LinkCheckReq command.
@@ -344,7 +344,7 @@ class LoraFrameHeader : public Header
 
 template <typename T>
 Ptr<T>
-LoraFrameHeader::GetMacCommand()
+LoraFrameHeader::GetMacCommand() const
 {
     // Iterate on MAC commands and try casting
     std::list<Ptr<MacCommand>>::const_iterator it;
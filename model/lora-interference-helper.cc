@@ -22,6 +22,7 @@
 #include "ns3/enum.h"
 #include "ns3/log.h"
 
+#include <algorithm>
 #include <limits>
 
 namespace ns3
@@ -31,6 +32,60 @@ namespace lorawan
 
 NS_LOG_COMPONENT_DEFINE("LoraInterferenceHelper");
 
+namespace
+{
+
+/// The size of the header preceding each event in memory, which points to the
+/// pool the event was allocated from, or is null
+constexpr std::size_t EVENT_HEADER_SIZE = alignof(std::max_align_t);
+
+/// The size of a block of an event pool, which can hold an event with its
+/// header, or a link of the free list
+constexpr std::size_t EVENT_BLOCK_SIZE =
+    EVENT_HEADER_SIZE + (sizeof(LoraInterferenceHelper::Event) + alignof(std::max_align_t) - 1) /
+                            alignof(std::max_align_t) * alignof(std::max_align_t);
+
+} // namespace
+
+/**********************************************
+ *    LoraInterferenceHelper::Transmission    *
+ **********************************************/
+
+LoraInterferenceHelper::Transmission::Transmission(Time duration,
+                                                   uint8_t spreadingFactor,
+                                                   Ptr<Packet> packet,
+                                                   double frequencyMHz)
+    : m_duration(duration),
+      m_packet(packet),
+      m_frequencyMHz(frequencyMHz),
+      m_sf(spreadingFactor)
+{
+}
+
+Time
+LoraInterferenceHelper::Transmission::GetDuration() const
+{
+    return m_duration;
+}
+
+uint8_t
+LoraInterferenceHelper::Transmission::GetSpreadingFactor() const
+{
+    return m_sf;
+}
+
+Ptr<Packet>
+LoraInterferenceHelper::Transmission::GetPacket() const
+{
+    return m_packet;
+}
+
+double
+LoraInterferenceHelper::Transmission::GetFrequency() const
+{
+    return m_frequencyMHz;
+}
+
 /***************************************
  *    LoraInterferenceHelper::Event    *
  ***************************************/
@@ -42,15 +97,19 @@ LoraInterferenceHelper::Event::Event(Time duration,
                                      Ptr<Packet> packet,
                                      double frequencyMHz)
     : m_startTime(Simulator::Now()),
-      m_endTime(m_startTime + duration),
-      m_sf(spreadingFactor),
       m_rxPowerdBm(rxPowerdBm),
-      m_packet(packet),
-      m_frequencyMHz(frequencyMHz)
+      m_transmission(Create<Transmission>(duration, spreadingFactor, packet, frequencyMHz))
 {
     // NS_LOG_FUNCTION_NOARGS ();
 }
 
+LoraInterferenceHelper::Event::Event(Ptr<const Transmission> transmission, double rxPowerdBm)
+    : m_startTime(Simulator::Now()),
+      m_rxPowerdBm(rxPowerdBm),
+      m_transmission(transmission)
+{
+}
+
 // Event Destructor
 LoraInterferenceHelper::Event::~Event()
 {
@@ -67,13 +126,13 @@ LoraInterferenceHelper::Event::GetStartTime() const
 Time
 LoraInterferenceHelper::Event::GetEndTime() const
 {
-    return m_endTime;
+    return m_startTime + m_transmission->GetDuration();
 }
 
 Time
 LoraInterferenceHelper::Event::GetDuration() const
 {
-    return m_endTime - m_startTime;
+    return m_transmission->GetDuration();
 }
 
 double
@@ -85,26 +144,127 @@ LoraInterferenceHelper::Event::GetRxPowerdBm() const
 uint8_t
 LoraInterferenceHelper::Event::GetSpreadingFactor() const
 {
-    return m_sf;
+    return m_transmission->GetSpreadingFactor();
 }
 
 Ptr<Packet>
 LoraInterferenceHelper::Event::GetPacket() const
 {
-    return m_packet;
+    return m_transmission->GetPacket();
 }
 
 double
 LoraInterferenceHelper::Event::GetFrequency() const
 {
-    return m_frequencyMHz;
+    return m_transmission->GetFrequency();
+}
+
+Ptr<const LoraInterferenceHelper::Transmission>
+LoraInterferenceHelper::Event::GetTransmission() const
+{
+    return m_transmission;
 }
 
 void
 LoraInterferenceHelper::Event::Print(std::ostream& stream) const
 {
-    stream << "(" << m_startTime.GetSeconds() << " s - " << m_endTime.GetSeconds() << " s), SF"
-           << unsigned(m_sf) << ", " << m_rxPowerdBm << " dBm, " << m_frequencyMHz << " MHz";
+    stream << "(" << m_startTime.GetSeconds() << " s - " << GetEndTime().GetSeconds()
+           << " s), SF" << unsigned(GetSpreadingFactor()) << ", " << m_rxPowerdBm << " dBm, "
+           << GetFrequency() << " MHz";
+}
+
+void*
+LoraInterferenceHelper::Event::operator new(std::size_t size)
+{
+    // Objects of derived classes have no header
+    if (size != sizeof(Event))
+    {
+        return ::operator new(size);
+    }
+
+    auto block = static_cast<char*>(::operator new(EVENT_HEADER_SIZE + size));
+    *reinterpret_cast<EventPool**>(block) = nullptr;
+    return block + EVENT_HEADER_SIZE;
+}
+
+void*
+LoraInterferenceHelper::Event::operator new(std::size_t size, EventPool& pool)
+{
+    // Objects of derived classes don't fit the blocks of the pool
+    if (size != sizeof(Event))
+    {
+        return operator new(size);
+    }
+
+    // The event keeps its pool alive until it is released
+    auto block = static_cast<char*>(pool.Allocate());
+    *reinterpret_cast<EventPool**>(block) = &pool;
+    pool.Ref();
+    return block + EVENT_HEADER_SIZE;
+}
+
+void
+LoraInterferenceHelper::Event::operator delete(void* pointer, std::size_t size)
+{
+    if (size != sizeof(Event))
+    {
+        ::operator delete(pointer);
+        return;
+    }
+
+    char* block = static_cast<char*>(pointer) - EVENT_HEADER_SIZE;
+    EventPool* pool = *reinterpret_cast<EventPool**>(block);
+    if (!pool)
+    {
+        ::operator delete(block);
+        return;
+    }
+    pool->Release(block);
+    pool->Unref();
+}
+
+void
+LoraInterferenceHelper::Event::operator delete(void* pointer, EventPool& pool)
+{
+    operator delete(pointer, sizeof(Event));
+}
+
+/*******************************************
+ *    LoraInterferenceHelper::EventPool    *
+ *******************************************/
+
+LoraInterferenceHelper::EventPool::~EventPool()
+{
+    for (char* chunk : m_chunks)
+    {
+        ::operator delete(chunk);
+    }
+}
+
+void*
+LoraInterferenceHelper::EventPool::Allocate()
+{
+    if (m_freeList)
+    {
+        void* block = m_freeList;
+        m_freeList = *static_cast<void**>(block);
+        return block;
+    }
+    if (m_nextBlock == m_chunkSize)
+    {
+        m_chunkSize =
+            m_chunks.empty() ? FIRST_CHUNK_SIZE : std::min(2 * m_chunkSize, MAX_CHUNK_SIZE);
+        m_chunks.push_back(static_cast<char*>(::operator new(m_chunkSize * EVENT_BLOCK_SIZE)));
+        m_nextBlock = 0;
+    }
+    return m_chunks.back() + EVENT_BLOCK_SIZE * m_nextBlock++;
+}
+
+void
+LoraInterferenceHelper::EventPool::Release(void* block)
+{
+    *static_cast<void**>(block) = m_freeList;
+    m_freeList = block;
 }
 
 std::ostream&
@@ -165,6 +325,15 @@ LoraInterferenceHelper::SetCollisionMatrix(
         m_collisionSnir = LoraInterferenceHelper::collisionSnirGoursaud;
         break;
     }
+
+    // Energy ratio corresponding to each isolation value in dB
+    for (unsigned i = 0; i < 6; i++)
+    {
+        for (unsigned j = 0; j < 6; j++)
+        {
+            m_collisionSnirLinear[i][j] = pow(10, m_collisionSnir[i][j] / 10);
+        }
+    }
 }
 
 TypeId
@@ -177,7 +346,9 @@ LoraInterferenceHelper::GetTypeId()
 }
 
 LoraInterferenceHelper::LoraInterferenceHelper()
-    : m_collisionSnir(LoraInterferenceHelper::collisionSnirGoursaud)
+    : m_collisionSnir(LoraInterferenceHelper::collisionSnirGoursaud),
+      m_eventPool(Create<EventPool>()),
+      m_maxEventDuration(Seconds(0))
 {
     NS_LOG_FUNCTION(this);
 
@@ -201,24 +372,86 @@ LoraInterferenceHelper::Add(Time duration,
     NS_LOG_FUNCTION(this << duration.GetSeconds() << rxPower << unsigned(spreadingFactor) << packet
                          << frequencyMHz);
 
+    return Add(Create<Transmission>(duration, spreadingFactor, packet, frequencyMHz), rxPower);
+}
+
+Ptr<LoraInterferenceHelper::Event>
+LoraInterferenceHelper::Add(Ptr<const Transmission> transmission, double rxPower)
+{
+    NS_LOG_FUNCTION(this << transmission << rxPower);
+
     // Create an event based on the parameters
-    Ptr<LoraInterferenceHelper::Event> event =
-        Create<LoraInterferenceHelper::Event>(duration,
-                                              rxPower,
-                                              spreadingFactor,
-                                              packet,
-                                              frequencyMHz);
-
-    // Add the event to the list
-    m_events.push_back(event);
-
-    // Clean the event list
-    if (m_events.size() > 100)
+    Ptr<LoraInterferenceHelper::Event> event(new (*m_eventPool) Event(transmission, rxPower),
+                                             false);
+
+    // Add the event to the bucket of its frequency
+    EventBucket& bucket = m_events[transmission->GetFrequency()];
+    InsertEvent(bucket, event);
+    m_maxEventDuration = std::max(m_maxEventDuration, transmission->GetDuration());
+
+    // Clean the bucket
+    CleanOldEvents(bucket);
+
+    return event;
+}
+
+void
+LoraInterferenceHelper::InsertEvent(EventBucket& bucket, Ptr<LoraInterferenceHelper::Event> event)
+{
+    int64_t startTimeStep = event->GetStartTime().GetTimeStep();
+
+    // Events are created at the current time, so they are usually appended
+    auto position = bucket.startTimeSteps.end();
+    if (bucket.head < bucket.startTimeSteps.size() && bucket.startTimeSteps.back() > startTimeStep)
     {
-        CleanOldEvents();
+        position = std::upper_bound(bucket.startTimeSteps.begin() + bucket.head,
+                                    bucket.startTimeSteps.end(),
+                                    startTimeStep);
     }
+    auto index = position - bucket.startTimeSteps.begin();
+
+    bucket.events.insert(bucket.events.begin() + index, event);
+    bucket.startTimeSteps.insert(position, startTimeStep);
+    // Power [mW] = 10^(Power[dBm]/10)
+    // Power [W] = Power [mW] / 1000
+    bucket.rxPowerW.insert(bucket.rxPowerW.begin() + index,
+                           pow(10, event->GetRxPowerdBm() / 10) / 1000);
+    bucket.transmissions.insert(bucket.transmissions.begin() + index,
+                                PeekPointer(event->GetTransmission()));
+}
 
-    return event;
+bool
+LoraInterferenceHelper::IsOld(int64_t endTimeStep) const
+{
+    // An event that is still being received started at most m_maxEventDuration
+    // ago, so events that ended before that can't interfere with it anymore.
+    Time threshold = std::max(oldEventThreshold, m_maxEventDuration);
+    return endTimeStep + threshold.GetTimeStep() < Simulator::Now().GetTimeStep();
+}
+
+void
+LoraInterferenceHelper::CleanOldEvents(EventBucket& bucket)
+{
+    // Buckets are sorted by start time, so old events are found at the front.
+    // An old event queued behind a longer one is removed on a later call.
+    std::size_t size = bucket.events.size();
+    while (bucket.head < size && IsOld(bucket.GetEndTimeStep(bucket.head)))
+    {
+        bucket.events[bucket.head] = nullptr;
+        bucket.head++;
+    }
+
+    // Compact the bucket once deleted events make up half of it
+    if (2 * bucket.head > size)
+    {
+        bucket.events.erase(bucket.events.begin(), bucket.events.begin() + bucket.head);
+        bucket.startTimeSteps.erase(bucket.startTimeSteps.begin(),
+                                    bucket.startTimeSteps.begin() + bucket.head);
+        bucket.rxPowerW.erase(bucket.rxPowerW.begin(), bucket.rxPowerW.begin() + bucket.head);
+        bucket.transmissions.erase(bucket.transmissions.begin(),
+                                   bucket.transmissions.begin() + bucket.head);
+        bucket.head = 0;
+    }
 }
 
 void
@@ -226,15 +459,25 @@ LoraInterferenceHelper::CleanOldEvents()
 {
     NS_LOG_FUNCTION(this);
 
-    // Cycle the events, and clean up if an event is old.
+    // Cycle the buckets, and rebuild them with the events that are not old.
     for (auto it = m_events.begin(); it != m_events.end();)
     {
-        if ((*it)->GetEndTime() + oldEventThreshold < Simulator::Now())
+        EventBucket cleanBucket;
+        const EventBucket& bucket = it->second;
+        for (std::size_t i = bucket.head; i < bucket.events.size(); i++)
+        {
+            if (!IsOld(bucket.GetEndTimeStep(i)))
+            {
+                InsertEvent(cleanBucket, bucket.events[i]);
+            }
+        }
+        if (cleanBucket.events.empty())
         {
             it = m_events.erase(it);
         }
         else
         {
+            it->second = std::move(cleanBucket);
             it++;
         }
     }
@@ -243,7 +486,20 @@ LoraInterferenceHelper::CleanOldEvents()
 std::list<Ptr<LoraInterferenceHelper::Event>>
 LoraInterferenceHelper::GetInterferers()
 {
-    return m_events;
+    std::list<Ptr<LoraInterferenceHelper::Event>> interferers;
+    for (const auto& bucket : m_events)
+    {
+        interferers.insert(interferers.end(),
+                           bucket.second.events.begin() + bucket.second.head,
+                           bucket.second.events.end());
+    }
+    interferers.sort(
+        [](const Ptr<LoraInterferenceHelper::Event>& a,
+           const Ptr<LoraInterferenceHelper::Event>& b) {
+            return a->GetStartTime() < b->GetStartTime();
+        });
+
+    return interferers;
 }
 
 void
@@ -253,9 +509,9 @@ LoraInterferenceHelper::PrintEvents(std::ostream& stream)
 
     stream << "Currently registered events:" << std::endl;
 
-    for (auto it = m_events.begin(); it != m_events.end(); it++)
+    for (const auto& event : GetInterferers())
     {
-        (*it)->Print(stream);
+        event->Print(stream);
         stream << std::endl;
     }
 }
@@ -265,104 +521,83 @@ LoraInterferenceHelper::IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Ev
 {
     NS_LOG_FUNCTION(this << event);
 
-    NS_LOG_INFO("Current number of events in LoraInterferenceHelper: " << m_events.size());
-
     // We want to see the interference affecting this event: cycle through events
     // that overlap with this one and see whether it survives the interference or
     // not.
 
     // Gather information about the event
     double rxPowerDbm = event->GetRxPowerdBm();
-    uint8_t sf = event->GetSpreadingFactor();
+    unsigned sfIndex = unsigned(event->GetSpreadingFactor()) - 7;
     double frequency = event->GetFrequency();
-
-    // Handy information about the time frame when the packet was received
-    Time now = Simulator::Now();
-    Time duration = event->GetDuration();
-    Time packetStartTime = now - duration;
-
-    // Get the list of interfering events
-    std::list<Ptr<LoraInterferenceHelper::Event>>::iterator it;
+    int64_t startTimeStep = event->GetStartTime().GetTimeStep();
+    int64_t endTimeStep = event->GetEndTime().GetTimeStep();
 
     // Energy for interferers of various SFs
-    std::vector<double> cumulativeInterferenceEnergy(6, 0);
-
-    // Cycle over the events
-    for (it = m_events.begin(); it != m_events.end();)
+    std::array<double, 6> cumulativeInterferenceEnergy = {};
+
+    // Only consider events on the same channel: we assume there's no
+    // interchannel interference.
+    static const EventBucket noEvents;
+    auto bucketIt = m_events.find(frequency);
+    const EventBucket& bucket = (bucketIt != m_events.end()) ? bucketIt->second : noEvents;
+
+    NS_LOG_INFO("Current number of events on this frequency: "
+                << bucket.events.size() - bucket.head);
+
+    // Events that started more than m_maxEventDuration before this one ended
+    // before it started, and events that start after this one has ended don't
+    // overlap with it: only cycle over the events in between.
+    auto starts = bucket.startTimeSteps.begin();
+    std::size_t first =
+        std::lower_bound(starts + bucket.head,
+                         bucket.startTimeSteps.end(),
+                         startTimeStep - m_maxEventDuration.GetTimeStep()) -
+        starts;
+    std::size_t last =
+        std::lower_bound(starts + first, bucket.startTimeSteps.end(), endTimeStep) - starts;
+
+    for (std::size_t i = first; i < last; i++)
     {
-        // Pointer to the current interferer
-        Ptr<LoraInterferenceHelper::Event> interferer = *it;
+        // Compute the time the two events are overlapping
+        int64_t overlap = std::min(bucket.GetEndTimeStep(i), endTimeStep) -
+                          std::max(bucket.startTimeSteps[i], startTimeStep);
 
-        // Only consider the current event if the channel is the same: we
-        // assume there's no interchannel interference. Also skip the current
-        // event if it's the same that we want to analyze.
-        if (!(interferer->GetFrequency() == frequency) || interferer == event)
+        // Skip events that don't overlap, and the current event if it's the
+        // same that we want to analyze.
+        if (overlap <= 0 || bucket.events[i] == event)
         {
-            NS_LOG_DEBUG("Different channel or same event");
-            it++;
-            continue; // Continues from the first line inside the for cycle
+            continue;
         }
 
-        NS_LOG_DEBUG("Interferer on same channel");
-
-        // Gather information about this interferer
-        uint8_t interfererSf = interferer->GetSpreadingFactor();
-        double interfererPower = interferer->GetRxPowerdBm();
-        Time interfererStartTime = interferer->GetStartTime();
-        Time interfererEndTime = interferer->GetEndTime();
-
-        NS_LOG_INFO("Found an interferer: sf = " << unsigned(interfererSf)
-                                                 << ", power = " << interfererPower
-                                                 << ", start time = " << interfererStartTime
-                                                 << ", end time = " << interfererEndTime);
-
-        // Compute the fraction of time the two events are overlapping
-        Time overlap = GetOverlapTime(event, interferer);
-
-        NS_LOG_DEBUG("The two events overlap for " << overlap.GetSeconds() << " s.");
-
-        // Compute the equivalent energy of the interference
-        // Power [mW] = 10^(Power[dBm]/10)
-        // Power [W] = Power [mW] / 1000
-        double interfererPowerW = pow(10, interfererPower / 10) / 1000;
         // Energy [J] = Time [s] * Power [W]
-        double interferenceEnergy = overlap.GetSeconds() * interfererPowerW;
-        cumulativeInterferenceEnergy.at(unsigned(interfererSf) - 7) += interferenceEnergy;
-        NS_LOG_DEBUG("Interferer power in W: " << interfererPowerW);
-        NS_LOG_DEBUG("Interference energy: " << interferenceEnergy);
-        it++;
+        cumulativeInterferenceEnergy[bucket.transmissions[i]->GetSpreadingFactor() - 7] +=
+            TimeStep(overlap).GetSeconds() * bucket.rxPowerW[i];
     }
 
-    // For each spreading factor, check if there was destructive interference
-    for (auto currentSf = uint8_t(7); currentSf <= uint8_t(12); currentSf++)
+    // Use the computed cumulativeInterferenceEnergy to determine whether the
+    // interference with each spreading factor destroys the packet
+    double signalPowerW = pow(10, rxPowerDbm / 10) / 1000;
+    double signalEnergy = event->GetDuration().GetSeconds() * signalPowerW;
+    NS_LOG_DEBUG("Signal energy: " << signalEnergy);
+
+    for (unsigned currentSfIndex = 0; currentSfIndex < 6; currentSfIndex++)
     {
         NS_LOG_DEBUG("Cumulative Interference Energy: "
-                     << cumulativeInterferenceEnergy.at(unsigned(currentSf) - 7));
-
-        // Use the computed cumulativeInterferenceEnergy to determine whether the
-        // interference with this spreading factor destroys the packet
-        double signalPowerW = pow(10, rxPowerDbm / 10) / 1000;
-        double signalEnergy = duration.GetSeconds() * signalPowerW;
-        NS_LOG_DEBUG("Signal power in W: " << signalPowerW);
-        NS_LOG_DEBUG("Signal energy: " << signalEnergy);
-
-        // Check whether the packet survives the interference of this spreading factor
-        double snirIsolation = m_collisionSnir[unsigned(sf) - 7][unsigned(currentSf) - 7];
-        NS_LOG_DEBUG("The needed isolation to survive is " << snirIsolation << " dB");
-        double snir =
-            10 * log10(signalEnergy / cumulativeInterferenceEnergy.at(unsigned(currentSf) - 7));
-        NS_LOG_DEBUG("The current SNIR is " << snir << " dB");
-
-        if (snir >= snirIsolation)
+                     << cumulativeInterferenceEnergy[currentSfIndex]);
+
+        if (SurvivesInterference(signalEnergy,
+                                 cumulativeInterferenceEnergy[currentSfIndex],
+                                 sfIndex,
+                                 currentSfIndex))
         {
             // Move on and check the rest of the interferers
-            NS_LOG_DEBUG("Packet survived interference with SF " << currentSf);
+            NS_LOG_DEBUG("Packet survived interference with SF " << currentSfIndex + 7);
         }
         else
         {
-            NS_LOG_DEBUG("Packet destroyed by interference with SF" << unsigned(currentSf));
+            NS_LOG_DEBUG("Packet destroyed by interference with SF" << currentSfIndex + 7);
 
-            return currentSf;
+            return uint8_t(currentSfIndex + 7);
         }
     }
     // If we get to here, it means that the packet survived all interference
@@ -372,12 +607,43 @@ LoraInterferenceHelper::IsDestroyedByInterference(Ptr<LoraInterferenceHelper::Ev
     return uint8_t(0);
 }
 
+bool
+LoraInterferenceHelper::SurvivesInterference(double signalEnergy,
+                                             double interferenceEnergy,
+                                             unsigned sfIndex,
+                                             unsigned interfererSfIndex) const
+{
+    // Relative tolerance covering the rounding errors of pow and log10
+    const double tolerance = 1e-9;
+
+    double ratio = signalEnergy / interferenceEnergy;
+    double threshold = m_collisionSnirLinear[sfIndex][interfererSfIndex];
+    if (ratio > threshold * (1 + tolerance))
+    {
+        return true;
+    }
+    if (ratio < threshold * (1 - tolerance))
+    {
+        return false;
+    }
+
+    // The ratio is too close to the threshold (or degenerate, e.g., there is no
+    // interference at all): compare the SNIR in dB.
+    double snirIsolation = m_collisionSnir[sfIndex][interfererSfIndex];
+    NS_LOG_DEBUG("The needed isolation to survive is " << snirIsolation << " dB");
+    double snir = 10 * log10(ratio);
+    NS_LOG_DEBUG("The current SNIR is " << snir << " dB");
+
+    return snir >= snirIsolation;
+}
+
 void
 LoraInterferenceHelper::ClearAllEvents()
 {
     NS_LOG_FUNCTION_NOARGS();
 
     m_events.clear();
+    m_maxEventDuration = Seconds(0);
 }
 
 Time
@@ -23,13 +23,18 @@
 #include "logical-lora-channel.h"
 
 #include "ns3/callback.h"
+#include "ns3/deprecated.h"
 #include "ns3/nstime.h"
 #include "ns3/object.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/traced-callback.h"
 
+#include <array>
+#include <cstddef>
 #include <list>
+#include <map>
+#include <vector>
 
 namespace ns3
 {
@@ -44,21 +49,95 @@ namespace lorawan
  * This class keeps a list of signals that are impinging on the antenna of the
  * device, in order to compute which ones can be correctly received and which
  * ones are lost due to interference.
+ *
+ * Events are stored in one bucket per frequency, sorted by start time. Since
+ * no event is longer than the longest one registered so far, the interferers of
+ * a given event can be found with a binary search on the start time followed by
+ * a scan of the events that can actually overlap with it. Events that can no
+ * longer overlap with any event still being received are evicted from the front
+ * of their bucket as new events are added.
+ *
+ * Buckets keep the fields needed by interference computations in separate
+ * contiguous arrays, with the linear received power computed once when the
+ * event is added.
  */
 class LoraInterferenceHelper
 {
   public:
+    /**
+     * The parameters of a transmission that are the same at all the devices
+     * hearing it.
+     *
+     * LoraChannel creates a single Transmission for each packet it sends, and
+     * the events registered by all receivers refer to it.
+     */
+    class Transmission : public SimpleRefCount<LoraInterferenceHelper::Transmission>
+    {
+      public:
+        /**
+         * Construct a new Transmission object
+         *
+         * \param duration The duration in time.
+         * \param spreadingFactor The modulation spreading factor.
+         * \param packet The packet transmitted.
+         * \param frequencyMHz The carrier frequency of the signal.
+         */
+        Transmission(Time duration,
+                     uint8_t spreadingFactor,
+                     Ptr<Packet> packet,
+                     double frequencyMHz);
+
+        /**
+         * Get the duration of the transmission.
+         *
+         * \return The duration in time.
+         */
+        Time GetDuration() const;
+
+        /**
+         * Get the spreading factor used by the transmission.
+         *
+         * \return The spreading factor value.
+         */
+        uint8_t GetSpreadingFactor() const;
+
+        /**
+         * Get the packet that is transmitted.
+         *
+         * \return A pointer to the packet.
+         */
+        Ptr<Packet> GetPacket() const;
+
+        /**
+         * Get the frequency of the transmission.
+         *
+         * \return The carrier frequency as a double.
+         */
+        double GetFrequency() const;
+
+      private:
+        Time m_duration;       //!< The duration of the transmission.
+        Ptr<Packet> m_packet;  //!< The packet that is transmitted.
+        double m_frequencyMHz; //!< The frequency of the transmission.
+        uint8_t m_sf;          //!< The spreading factor of the transmission.
+    };
+
     /**
      * A class representing a signal in time.
      *
      * Used in LoraInterferenceHelper to keep track of which signals overlap and
-     * cause destructive interference.
+     * cause destructive interference. An event only holds what is specific to
+     * the device it was registered at, i.e., the time the signal started and
+     * its power, and refers to its Transmission for everything else.
      */
+    class EventPool;
+
     class Event : public SimpleRefCount<LoraInterferenceHelper::Event>
     {
       public:
         /**
-         * Construct a new interference signal Event object
+         * Construct a new interference signal Event object, with a
+         * Transmission of its own.
          *
          * \param duration The duration in time.
          * \param rxPowerdBm The power of the signal.
@@ -66,12 +145,22 @@ class LoraInterferenceHelper
          * \param packet The packet transmitted.
          * \param frequencyMHz The carrier frequency of the signal.
          */
+        NS_DEPRECATED_3_41("Use the constructor taking a LoraInterferenceHelper::Transmission")
         Event(Time duration,
               double rxPowerdBm,
               uint8_t spreadingFactor,
               Ptr<Packet> packet,
               double frequencyMHz);
 
+        /**
+         * Construct a new interference signal Event object for a transmission
+         * that starts being received now.
+         *
+         * \param transmission The transmission.
+         * \param rxPowerdBm The power of the signal.
+         */
+        Event(Ptr<const Transmission> transmission, double rxPowerdBm);
+
         ~Event(); //!< Destructor
 
         /**
@@ -123,6 +212,13 @@ class LoraInterferenceHelper
          */
         double GetFrequency() const;
 
+        /**
+         * Get the transmission this event was generated for.
+         *
+         * \return A pointer to the transmission.
+         */
+        Ptr<const Transmission> GetTransmission() const;
+
         /**
          * Print the current event in a human readable form.
          *
@@ -130,13 +226,91 @@ class LoraInterferenceHelper
          */
         void Print(std::ostream& stream) const;
 
+        /**
+         * Allocate an Event from the system allocator, for events that are not
+         * created by a LoraInterferenceHelper.
+         *
+         * \param size The size of the object.
+         * \return A pointer to the allocated memory.
+         */
+        static void* operator new(std::size_t size);
+
+        /**
+         * Allocate an Event from the pool of a LoraInterferenceHelper, so that
+         * the reception path doesn't go through the system allocator once the
+         * events in flight have been allocated.
+         *
+         * \param size The size of the object.
+         * \param pool The pool to allocate the event from.
+         * \return A pointer to the allocated memory.
+         */
+        static void* operator new(std::size_t size, EventPool& pool);
+
+        /**
+         * Give the memory of an Event back to the pool it was allocated from,
+         * or to the system allocator.
+         *
+         * \param pointer A pointer to the allocated memory.
+         * \param size The size of the object.
+         */
+        static void operator delete(void* pointer, std::size_t size);
+
+        /**
+         * Give the memory of an Event whose construction failed back to its
+         * pool.
+         *
+         * \param pointer A pointer to the allocated memory.
+         * \param pool The pool the event was allocated from.
+         */
+        static void operator delete(void* pointer, EventPool& pool);
+
+      private:
+        Time m_startTime;                       //!< The time this signal begins (at the device).
+        double m_rxPowerdBm;                    //!< The power of this event in dBm (at the device).
+        Ptr<const Transmission> m_transmission; //!< The transmission this event was generated for.
+    };
+
+    /**
+     * Storage for the events of a LoraInterferenceHelper, which are created
+     * for each packet at each receiving device and released soon after. Memory
+     * is taken from the system in chunks of events, whose size doubles from
+     * one chunk to the next so that the pools of devices hearing few packets
+     * at a time stay small, and released events are kept in a free list for
+     * reuse. Since an event can outlive the helper
+     * that created it, each event holds a reference to its pool, and the
+     * chunks are returned to the system once the helper and all its events
+     * are gone.
+     */
+    class EventPool : public SimpleRefCount<LoraInterferenceHelper::EventPool>
+    {
+      public:
+        ~EventPool(); //!< Destructor
+
+        /**
+         * Take a block able to hold an Event from the free list, or from the
+         * current chunk.
+         *
+         * \return A pointer to the block.
+         */
+        void* Allocate();
+
+        /**
+         * Put a block back in the free list.
+         *
+         * \param block A pointer to the block.
+         */
+        void Release(void* block);
+
       private:
-        Time m_startTime;      //!< The time this signal begins (at the device).
-        Time m_endTime;        //!< The time this signal ends (at the device).
-        uint8_t m_sf;          //!< The spreading factor of this signal.
-        double m_rxPowerdBm;   //!< The power of this event in dBm (at the device).
-        Ptr<Packet> m_packet;  //!< The packet this event was generated for.
-        double m_frequencyMHz; //!<  The frequency this event was on.
+        /// The number of events in the first chunk
+        static constexpr std::size_t FIRST_CHUNK_SIZE = 8;
+        /// The largest number of events in a chunk
+        static constexpr std::size_t MAX_CHUNK_SIZE = 4096;
+
+        std::vector<char*> m_chunks; //!< The chunks taken from the system
+        void* m_freeList = nullptr;  //!< The first released block
+        std::size_t m_chunkSize = 0; //!< The number of events in the last chunk
+        std::size_t m_nextBlock = 0; //!< The first unused block of the last chunk
     };
 
     /**
@@ -160,6 +334,10 @@ class LoraInterferenceHelper
     /**
      * Add an event to the InterferenceHelper.
      *
+     * This method allocates a Transmission for this event alone: use the
+     * overload taking a Transmission shared by all the devices hearing it
+     * instead.
+     *
      * \param duration The duration of the packet.
      * \param rxPower The received power in dBm.
      * \param spreadingFactor The spreading factor used by the transmission.
@@ -168,16 +346,27 @@ class LoraInterferenceHelper
      *
      * \return The newly created event.
      */
+    NS_DEPRECATED_3_41("Use Add with a LoraInterferenceHelper::Transmission")
     Ptr<LoraInterferenceHelper::Event> Add(Time duration,
                                            double rxPower,
                                            uint8_t spreadingFactor,
                                            Ptr<Packet> packet,
                                            double frequencyMHz);
 
+    /**
+     * Add an event for a transmission that starts being received now.
+     *
+     * \param transmission The transmission, possibly shared with other helpers.
+     * \param rxPower The received power in dBm.
+     *
+     * \return The newly created event.
+     */
+    Ptr<LoraInterferenceHelper::Event> Add(Ptr<const Transmission> transmission, double rxPower);
+
     /**
      * Get a list of the interferers currently registered at this InterferenceHelper.
      *
-     * \return The list of pointers to interference Event objects.
+     * \return The list of pointers to interference Event objects, sorted by start time.
      */
     std::list<Ptr<LoraInterferenceHelper::Event>> GetInterferers();
 
@@ -226,6 +415,79 @@ class LoraInterferenceHelper
     static std::vector<std::vector<double>> collisionSnirGoursaud; //!< GOURSAUD collision matrix
 
   private:
+    /**
+     * Events on a single frequency, sorted by start time.
+     *
+     * Element i of each array describes the same event. Only the start time
+     * and the power are specific to this device: the duration and spreading
+     * factor are read from the transmission, which is shared by all the
+     * devices hearing it. Events before index head have been deleted, and are
+     * compacted away once they make up half of the bucket.
+     */
+    struct EventBucket
+    {
+        /**
+         * Get the end time of an event.
+         *
+         * \param i The index of the event.
+         * \return The end time of the event, in time steps.
+         */
+        int64_t GetEndTimeStep(std::size_t i) const
+        {
+            return startTimeSteps[i] + transmissions[i]->GetDuration().GetTimeStep();
+        }
+
+        std::vector<Ptr<LoraInterferenceHelper::Event>> events; //!< The events
+        std::vector<int64_t> startTimeSteps; //!< The start time of each event, in time steps
+        std::vector<double> rxPowerW;        //!< The received power of each event, in W
+        std::vector<const Transmission*>
+            transmissions;    //!< The transmission of each event, kept alive by the event
+        std::size_t head = 0; //!< The index of the first event still stored
+    };
+
+    /**
+     * Insert an event in a bucket, keeping it sorted by start time.
+     *
+     * \param bucket The bucket of the event's frequency.
+     * \param event The event to insert.
+     */
+    void InsertEvent(EventBucket& bucket, Ptr<LoraInterferenceHelper::Event> event);
+
+    /**
+     * Check whether an event can be safely deleted, i.e., whether it ended long
+     * enough ago that it can't overlap with any event that is still being received.
+     *
+     * \param endTimeStep The end time of the event, in time steps.
+     * \return True if the event is old.
+     */
+    bool IsOld(int64_t endTimeStep) const;
+
+    /**
+     * Delete old events from the front of a bucket.
+     *
+     * \param bucket The bucket to clean.
+     */
+    void CleanOldEvents(EventBucket& bucket);
+
+    /**
+     * Decide whether a packet survives the interference of a spreading factor.
+     *
+     * The comparison is carried out in the linear domain, and falls back to
+     * the SNIR in dB only when the energy ratio is too close to the threshold
+     * for rounding errors to be ruled out, so that the outcome is the same as
+     * comparing 10 * log10(signalEnergy / interferenceEnergy) to the isolation.
+     *
+     * \param signalEnergy The energy of the desired signal, in J.
+     * \param interferenceEnergy The energy of the interferers using the spreading factor, in J.
+     * \param sfIndex The spreading factor of the desired signal, minus 7.
+     * \param interfererSfIndex The spreading factor of the interferers, minus 7.
+     * \return True if the packet survives.
+     */
+    bool SurvivesInterference(double signalEnergy,
+                              double interferenceEnergy,
+                              unsigned sfIndex,
+                              unsigned interfererSfIndex) const;
+
     /**
      * Set the collision matrix.
      *
@@ -237,8 +499,12 @@ class LoraInterferenceHelper
 
     std::vector<std::vector<double>> m_collisionSnir; //!< The matrix containing information about
                                                       //!< how packets survive interference
-    std::list<Ptr<LoraInterferenceHelper::Event>>
-        m_events; //!< List of the events this LoraInterferenceHelper is keeping track of
+    std::array<std::array<double, 6>, 6>
+        m_collisionSnirLinear; //!< The collision matrix, as a linear energy ratio
+    std::map<double, EventBucket> m_events; //!< The events this LoraInterferenceHelper is keeping
+                                            //!< track of, bucketed by frequency
+    Ptr<EventPool> m_eventPool; //!< The storage of the events created by this helper
+    Time m_maxEventDuration; //!< The duration of the longest event registered in this helper
     static Time oldEventThreshold; //!< The threshold after which an event is considered old and
                                    //!< removed from the list
 };
@@ -23,6 +23,8 @@
 #include "ns3/simulator.h"
 
 #include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace ns3
 {
@@ -157,17 +159,130 @@ LoraPhy::SetTxFinishedCallback(TxFinishedCallback callback)
     m_txFinishedCallback = callback;
 }
 
+void
+LoraPhy::StartReceive(Ptr<Packet> packet,
+                      double rxPowerDbm,
+                      uint8_t sf,
+                      Time duration,
+                      double frequencyMHz)
+{
+    StartReceive(Create<LoraInterferenceHelper::Transmission>(duration, sf, packet, frequencyMHz),
+                 rxPowerDbm);
+}
+
+void
+LoraPhy::StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                      double rxPowerDbm)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    StartReceive(transmission->GetPacket(),
+                 rxPowerDbm,
+                 transmission->GetSpreadingFactor(),
+                 transmission->GetDuration(),
+                 transmission->GetFrequency());
+#pragma GCC diagnostic pop
+}
+
+void
+LoraPhy::AddInterference(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                         double rxPowerDbm)
+{
+    NS_LOG_FUNCTION(this << rxPowerDbm);
+
+    m_interference.Add(transmission, rxPowerDbm);
+}
+
 Time
 LoraPhy::GetTSym(LoraTxParameters txParams)
 {
     return Seconds(pow(2, int(txParams.sf)) / (txParams.bandwidthHz));
 }
 
+namespace
+{
+
+const uint32_t TABLE_PAYLOAD_SIZES = 256; //!< Payload sizes covered by the time on air table
+const int TABLE_ROWS = 6 * 3 * 4 * 8;     //!< SF, bandwidth, coding rate and flag combinations
+
+/**
+ * Get the row of the time on air table for a set of transmission parameters.
+ *
+ * \param txParams The transmission parameters.
+ * \return The index of the row, or -1 if the parameters are not covered by the table.
+ */
+int
+GetTableRow(const LoraTxParameters& txParams)
+{
+    if (txParams.sf < 7 || txParams.sf > 12 || txParams.codingRate < 1 ||
+        txParams.codingRate > 4 || txParams.nPreamble != 8)
+    {
+        return -1;
+    }
+
+    int bandwidth;
+    if (txParams.bandwidthHz == 125000)
+    {
+        bandwidth = 0;
+    }
+    else if (txParams.bandwidthHz == 250000)
+    {
+        bandwidth = 1;
+    }
+    else if (txParams.bandwidthHz == 500000)
+    {
+        bandwidth = 2;
+    }
+    else
+    {
+        return -1;
+    }
+
+    int flags = txParams.headerDisabled * 4 + txParams.crcEnabled * 2 +
+                txParams.lowDataRateOptimizationEnabled;
+    return (((txParams.sf - 7) * 3 + bandwidth) * 4 + txParams.codingRate - 1) * 8 + flags;
+}
+
+} // namespace
+
 Time
 LoraPhy::GetOnAirTime(Ptr<Packet> packet, LoraTxParameters txParams)
 {
     NS_LOG_FUNCTION(packet << txParams);
 
+    return GetOnAirTime(packet->GetSize(), txParams);
+}
+
+Time
+LoraPhy::GetOnAirTime(uint32_t payloadSize, LoraTxParameters txParams)
+{
+    int row = GetTableRow(txParams);
+    if (row < 0 || payloadSize >= TABLE_PAYLOAD_SIZES)
+    {
+        return ComputeOnAirTime(payloadSize, txParams);
+    }
+
+    // Rows are allocated on first use, with all their entries set to zero
+    // until they are computed. The table is never destroyed, so that it can
+    // be used until the end of the program.
+    static auto table = new std::vector<std::unique_ptr<Time[]>>(TABLE_ROWS);
+    std::unique_ptr<Time[]>& entries = (*table)[row];
+    if (!entries)
+    {
+        entries = std::make_unique<Time[]>(TABLE_PAYLOAD_SIZES);
+    }
+    if (entries[payloadSize].IsZero())
+    {
+        entries[payloadSize] = ComputeOnAirTime(payloadSize, txParams);
+    }
+    return entries[payloadSize];
+}
+
+Time
+LoraPhy::ComputeOnAirTime(uint32_t payloadSize, LoraTxParameters txParams)
+{
+    NS_LOG_FUNCTION(payloadSize << txParams);
+
     // The contents of this function are based on [1].
     // [1] SX1272 LoRa modem designer's guide.
 
@@ -179,7 +294,7 @@ LoraPhy::GetOnAirTime(Ptr<Packet> packet, LoraTxParameters txParams)
     double tPreamble = (double(txParams.nPreamble) + 4.25) * tSym;
 
     // Payload size
-    uint32_t pl = packet->GetSize(); // Size in bytes
+    uint32_t pl = payloadSize; // Size in bytes
     NS_LOG_DEBUG("Packet of size " << pl << " bytes");
 
     // This step is needed since the formula deals with double values.
@@ -24,6 +24,7 @@
 #include "lora-interference-helper.h"
 
 #include "ns3/callback.h"
+#include "ns3/deprecated.h"
 #include "ns3/mobility-model.h"
 #include "ns3/net-device.h"
 #include "ns3/node.h"
@@ -111,7 +112,13 @@ class LoraPhy : public Object
     /**
      * Start receiving a packet.
      *
-     * This method is typically called by LoraChannel.
+     * By default, this method allocates a Transmission for this PHY alone and
+     * passes it to the overload taking a Transmission, which should be used
+     * instead since the channel shares the Transmission among all the PHYs
+     * hearing it. Subclasses written against the previous version of this
+     * class can still override this method: the other overload forwards to it
+     * unless it is overridden too, so each subclass must override at least
+     * one of the two.
      *
      * \param packet The packet that is arriving at this PHY layer.
      * \param rxPowerDbm The power of the arriving packet (assumed to be constant for the whole
@@ -120,11 +127,39 @@ class LoraPhy : public Object
      * \param duration The on air time of this packet.
      * \param frequencyMHz The frequency this packet is being transmitted on.
      */
+    NS_DEPRECATED_3_41("Use StartReceive with a LoraInterferenceHelper::Transmission")
     virtual void StartReceive(Ptr<Packet> packet,
                               double rxPowerDbm,
                               uint8_t sf,
                               Time duration,
-                              double frequencyMHz) = 0;
+                              double frequencyMHz);
+
+    /**
+     * Start receiving a transmission whose parameters are shared with the
+     * other PHYs hearing it.
+     *
+     * This method is typically called by LoraChannel. By default, it forwards
+     * the parameters of the transmission to the deprecated overload.
+     *
+     * \param transmission The transmission that is arriving at this PHY layer.
+     * \param rxPowerDbm The power of the arriving packet (assumed to be constant for the whole
+     * reception).
+     */
+    virtual void StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                              double rxPowerDbm);
+
+    /**
+     * Register a transmission as interference only, without attempting to
+     * receive it.
+     *
+     * This method is used by AggregateInterferenceSource to inject the
+     * transmissions of devices that are not simulated explicitly.
+     *
+     * \param transmission The interfering transmission.
+     * \param rxPowerDbm The power the transmission is received with.
+     */
+    void AddInterference(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                         double rxPowerDbm);
 
     /**
      * Finish reception of a packet.
@@ -267,6 +302,29 @@ class LoraPhy : public Object
      */
     static Time GetOnAirTime(Ptr<Packet> packet, LoraTxParameters txParams);
 
+    /**
+     * Compute the time that a packet of a given size will take to be transmitted.
+     *
+     * Results are kept in a table, filled as it is used, covering payloads of up to 255 bytes sent
+     * with 8 preamble symbols, SF 7 to 12, a bandwidth of 125, 250 or 500 kHz and any other
+     * parameter. Other transmissions are computed by ComputeOnAirTime on every call.
+     *
+     * \param payloadSize The size of the packet [bytes].
+     * \param txParams The set of parameters that will be used for transmission.
+     * \return The time necessary to transmit the packet.
+     */
+    static Time GetOnAirTime(uint32_t payloadSize, LoraTxParameters txParams);
+
+    /**
+     * Compute the time that a packet of a given size will take to be transmitted, without using
+     * the table of GetOnAirTime.
+     *
+     * \param payloadSize The size of the packet [bytes].
+     * \param txParams The set of parameters that will be used for transmission.
+     * \return The time necessary to transmit the packet.
+     */
+    static Time ComputeOnAirTime(uint32_t payloadSize, LoraTxParameters txParams);
+
   private:
     Ptr<MobilityModel> m_mobility; //!< The mobility model associated to this PHY.
 
@@ -66,19 +66,15 @@ ConfirmedMessagesComponent::~ConfirmedMessagesComponent()
 }
 
 void
-ConfirmedMessagesComponent::OnReceivedPacket(Ptr<const Packet> packet,
+ConfirmedMessagesComponent::OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                                              Ptr<EndDeviceStatus> status,
                                              Ptr<NetworkStatus> networkStatus)
 {
-    NS_LOG_FUNCTION(this->GetTypeId() << packet << networkStatus);
+    NS_LOG_FUNCTION(this->GetTypeId() << uplink->GetPacket() << networkStatus);
 
     // Check whether the received packet requires an acknowledgment.
-    LorawanMacHeader mHdr;
-    LoraFrameHeader fHdr;
-    fHdr.SetAsUplink();
-    Ptr<Packet> myPacket = packet->Copy();
-    myPacket->RemoveHeader(mHdr);
-    myPacket->RemoveHeader(fHdr);
+    const LorawanMacHeader& mHdr = uplink->GetMacHeader();
+    const LoraFrameHeader& fHdr = uplink->GetFrameHeader();
 
     NS_LOG_INFO("Received packet Mac Header: " << mHdr);
     NS_LOG_INFO("Received packet Frame Header: " << fHdr);
@@ -144,11 +140,11 @@ LinkCheckComponent::~LinkCheckComponent()
 }
 
 void
-LinkCheckComponent::OnReceivedPacket(Ptr<const Packet> packet,
+LinkCheckComponent::OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                                      Ptr<EndDeviceStatus> status,
                                      Ptr<NetworkStatus> networkStatus)
 {
-    NS_LOG_FUNCTION(this->GetTypeId() << packet << networkStatus);
+    NS_LOG_FUNCTION(this->GetTypeId() << uplink->GetPacket() << networkStatus);
 
     // We will only act just before reply, when all Gateways will have received
     // the packet.
@@ -160,12 +156,7 @@ LinkCheckComponent::BeforeSendingReply(Ptr<EndDeviceStatus> status,
 {
     NS_LOG_FUNCTION(this << status << networkStatus);
 
-    Ptr<Packet> myPacket = status->GetLastPacketReceivedFromDevice()->Copy();
-    LorawanMacHeader mHdr;
-    LoraFrameHeader fHdr;
-    fHdr.SetAsUplink();
-    myPacket->RemoveHeader(mHdr);
-    myPacket->RemoveHeader(fHdr);
+    const LoraFrameHeader& fHdr = status->GetLastReceivedUplink()->GetFrameHeader();
 
     Ptr<LinkCheckReq> command = fHdr.GetMacCommand<LinkCheckReq>();
 
@@ -176,7 +167,7 @@ LinkCheckComponent::BeforeSendingReply(Ptr<EndDeviceStatus> status,
 
         // Get the number of gateways that received the packet and the best
         // margin
-        uint8_t gwCount = status->GetLastReceivedPacketInfo().gwList.size();
+        uint8_t gwCount = status->GetReceivedPacketList().GetRecent().gwList.GetSize();
 
         Ptr<LinkCheckAns> replyCommand = Create<LinkCheckAns>();
         replyCommand->SetGwCnt(gwCount);
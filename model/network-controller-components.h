@@ -21,6 +21,7 @@
 #define NETWORK_CONTROLLER_COMPONENTS_H
 
 #include "network-status.h"
+#include "parsed-uplink.h"
 
 #include "ns3/log.h"
 #include "ns3/object.h"
@@ -62,11 +63,11 @@ class NetworkControllerComponent : public Object
     /**
      * Function called as a new uplink packet is received by the NetworkServer application.
      *
-     * \param packet The newly received packet.
+     * \param uplink The newly received packet, with its decoded headers.
      * \param status A pointer to the status of the end device that sent the packet.
      * \param networkStatus A pointer to the NetworkStatus object.
      */
-    virtual void OnReceivedPacket(Ptr<const Packet> packet,
+    virtual void OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                                   Ptr<EndDeviceStatus> status,
                                   Ptr<NetworkStatus> networkStatus) = 0;
     /**
@@ -107,11 +108,11 @@ class ConfirmedMessagesComponent : public NetworkControllerComponent
      * This method checks whether the received packet requires an acknowledgment
      * and sets up the appropriate reply in case it does.
      *
-     * \param packet The newly received packet.
+     * \param uplink The newly received packet, with its decoded headers.
      * \param status A pointer to the EndDeviceStatus object of the sender.
      * \param networkStatus A pointer to the NetworkStatus object.
      */
-    void OnReceivedPacket(Ptr<const Packet> packet,
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                           Ptr<EndDeviceStatus> status,
                           Ptr<NetworkStatus> networkStatus) override;
 
@@ -141,11 +142,11 @@ class LinkCheckComponent : public NetworkControllerComponent
      * This method checks whether the received packet requires an acknowledgment
      * and sets up the appropriate reply in case it does.
      *
-     * \param packet The newly received packet.
+     * \param uplink The newly received packet, with its decoded headers.
      * \param status A pointer to the EndDeviceStatus object of the sender.
      * \param networkStatus A pointer to the NetworkStatus object.
      */
-    void OnReceivedPacket(Ptr<const Packet> packet,
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink,
                           Ptr<EndDeviceStatus> status,
                           Ptr<NetworkStatus> networkStatus) override;
 
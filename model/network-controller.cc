@@ -62,18 +62,19 @@ NetworkController::Install(Ptr<NetworkControllerComponent> component)
 }
 
 void
-NetworkController::OnNewPacket(Ptr<const Packet> packet)
+NetworkController::OnNewPacket(Ptr<const ParsedUplink> uplink)
 {
-    NS_LOG_FUNCTION(this << packet);
+    NS_LOG_FUNCTION(this << uplink->GetPacket());
 
     // NOTE As a future optimization, we can allow components to register their
     // callbacks and only be called in case a certain MAC command is contained.
     // For now, we call all components.
 
     // Inform each component about the new packet
+    Ptr<EndDeviceStatus> edStatus = m_status->GetEndDeviceStatus(uplink->GetAddress());
     for (auto it = m_components.begin(); it != m_components.end(); ++it)
     {
-        (*it)->OnReceivedPacket(packet, m_status->GetEndDeviceStatus(packet), m_status);
+        (*it)->OnReceivedPacket(uplink, edStatus, m_status);
     }
 }
 
@@ -22,6 +22,7 @@
 
 #include "network-controller-components.h"
 #include "network-status.h"
+#include "parsed-uplink.h"
 
 #include "ns3/object.h"
 #include "ns3/packet.h"
@@ -70,9 +71,9 @@ class NetworkController : public Object
     /**
      * Method that is called by the NetworkServer application when a new packet is received.
      *
-     * \param packet The newly received packet.
+     * \param uplink The newly received packet, with its decoded headers.
      */
-    void OnNewPacket(Ptr<const Packet> packet);
+    void OnNewPacket(Ptr<const ParsedUplink> uplink);
 
     /**
      * Method that is called by the NetworkScheduler just before sending a reply
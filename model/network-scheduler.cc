@@ -1,5 +1,8 @@
 #include "network-scheduler.h"
 
+#include <algorithm>
+#include <functional>
+
 namespace ns3
 {
 namespace lorawan
@@ -16,6 +19,12 @@ NetworkScheduler::GetTypeId()
         TypeId("ns3::NetworkScheduler")
             .SetParent<Object>()
             .AddConstructor<NetworkScheduler>()
+            .AddAttribute("PlanningWindow",
+                          "Replies whose first receive window opens within this time from "
+                          "the first one are assigned gateways together",
+                          TimeValue(MilliSeconds(500)),
+                          MakeTimeAccessor(&NetworkScheduler::m_planningWindow),
+                          MakeTimeChecker(Seconds(0)))
             .AddTraceSource("ReceiveWindowOpened",
                             "Trace source that is fired when a receive window opportunity happens.",
                             MakeTraceSourceAccessor(&NetworkScheduler::m_receiveWindowOpened),
@@ -39,27 +48,30 @@ NetworkScheduler::~NetworkScheduler()
 }
 
 void
-NetworkScheduler::OnReceivedPacket(Ptr<const Packet> packet)
+NetworkScheduler::OnReceivedPacket(Ptr<const ParsedUplink> uplink)
+{
+    OnReceivedPacket(uplink, Simulator::Now());
+}
+
+void
+NetworkScheduler::OnReceivedPacket(Ptr<const ParsedUplink> uplink, Time receptionTime)
 {
-    NS_LOG_FUNCTION(packet);
+    NS_LOG_FUNCTION(uplink->GetPacket() << receptionTime);
 
-    // Get the current packet's frame counter
-    Ptr<Packet> packetCopy = packet->Copy();
-    LorawanMacHeader receivedMacHdr;
-    packetCopy->RemoveHeader(receivedMacHdr);
-    LoraFrameHeader receivedFrameHdr;
-    receivedFrameHdr.SetAsUplink();
-    packetCopy->RemoveHeader(receivedFrameHdr);
+    // Extract the address
+    LoraDeviceAddress deviceAddress = uplink->GetAddress();
+    Ptr<EndDeviceStatus> edStatus = m_status->GetEndDeviceStatus(deviceAddress);
 
     // Need to decide whether to schedule a receive window
-    if (!m_status->GetEndDeviceStatus(packet)->HasReceiveWindowOpportunityScheduled())
+    if (!edStatus->HasReceiveWindowOpportunityScheduled())
     {
-        // Extract the address
-        LoraDeviceAddress deviceAddress = receivedFrameHdr.GetAddress();
+        // The reply will be planned when the first receive window opens, or
+        // earlier together with the reply of another device
+        m_pendingReplies.push_back({deviceAddress, receptionTime + Seconds(1)});
 
         // Schedule OnReceiveWindowOpportunity event
-        m_status->GetEndDeviceStatus(packet)->SetReceiveWindowOpportunity(
-            Simulator::Schedule(Seconds(1),
+        edStatus->SetReceiveWindowOpportunity(
+            Simulator::Schedule(receptionTime + Seconds(1) - Simulator::Now(),
                                 &NetworkScheduler::OnReceiveWindowOpportunity,
                                 this,
                                 deviceAddress,
@@ -74,16 +86,27 @@ NetworkScheduler::OnReceiveWindowOpportunity(LoraDeviceAddress deviceAddress, in
 
     NS_LOG_DEBUG("Opening receive window number " << window << " for device " << deviceAddress);
 
-    // Check whether we can send a reply to the device, again by using
-    // NetworkStatus
-    Address gwAddress = m_status->GetBestGatewayForDevice(deviceAddress, window);
+    auto planned = m_plannedReplies.find(deviceAddress.Get());
+    if (planned == m_plannedReplies.end())
+    {
+        // Plan the reply of this device, together with the ones of the devices
+        // whose first receive window opens shortly after
+        PlanReplies();
+        planned = m_plannedReplies.find(deviceAddress.Get());
+    }
+    NS_ABORT_MSG_IF(planned == m_plannedReplies.end(), "No reply planned for " << deviceAddress);
+    PlannedReply reply = planned->second;
 
-    if (gwAddress == Address() && window == 1)
+    if (!reply.packet)
+    {
+        NS_LOG_DEBUG("No reply is needed");
+        m_plannedReplies.erase(planned);
+    }
+    else if (window == 1 && reply.window == 2)
     {
         NS_LOG_DEBUG("No suitable gateway found for first window.");
 
-        // No suitable gateway was found, but there's still hope to find one for the
-        // second window.
+        // The reply was planned in the second window.
         // Schedule another OnReceiveWindowOpportunity event
         m_status->GetEndDeviceStatus(deviceAddress)
             ->SetReceiveWindowOpportunity(
@@ -93,7 +116,7 @@ NetworkScheduler::OnReceiveWindowOpportunity(LoraDeviceAddress deviceAddress, in
                                     deviceAddress,
                                     2)); // This will be the second receive window
     }
-    else if (gwAddress == Address() && window == 2)
+    else if (reply.gwId == NO_GATEWAY)
     {
         // No suitable gateway was found and this was our last opportunity
         // Simply give up.
@@ -102,33 +125,247 @@ NetworkScheduler::OnReceiveWindowOpportunity(LoraDeviceAddress deviceAddress, in
 
         // Reset the reply
         // XXX Should we reset it here or keep it for the next opportunity?
+        m_plannedReplies.erase(planned);
         m_status->GetEndDeviceStatus(deviceAddress)->RemoveReceiveWindowOpportunity();
         m_status->GetEndDeviceStatus(deviceAddress)->InitializeReply();
     }
     else
     {
-        // A gateway was found
+        NS_LOG_INFO("Sending reply through gateway " << reply.gwId);
+
+        // Send the reply through the gateway it was planned on
+        m_plannedReplies.erase(planned);
+        m_status->SendThroughGateway(reply.packet, reply.gwId);
+
+        // Reset the reply
+        m_status->GetEndDeviceStatus(deviceAddress)->RemoveReceiveWindowOpportunity();
+        m_status->GetEndDeviceStatus(deviceAddress)->InitializeReply();
+    }
+}
+
+void
+NetworkScheduler::PlanReplies()
+{
+    NS_LOG_FUNCTION(this);
+
+    Time now = Simulator::Now();
+
+    // Take the replies due within the planning window
+    auto due = std::stable_partition(m_pendingReplies.begin(),
+                                     m_pendingReplies.end(),
+                                     [this, now](const PendingReply& pending) {
+                                         return pending.rx1Time <= now + m_planningWindow;
+                                     });
+    std::vector<PendingReply> batch(m_pendingReplies.begin(), due);
+    m_pendingReplies.erase(m_pendingReplies.begin(), due);
+
+    // Forget the transmissions that no longer constrain the gateways
+    m_timelines.resize(m_status->m_gatewayStatuses.size());
+    for (auto& timeline : m_timelines)
+    {
+        timeline.erase(std::remove_if(timeline.begin(),
+                                      timeline.end(),
+                                      [now](const Booking& booking) {
+                                          return booking.end <= now &&
+                                                 booking.dutyCycleEnd <= now;
+                                      }),
+                       timeline.end());
+    }
 
-        NS_LOG_DEBUG("Found available gateway with address: " << gwAddress);
+    // A reply of the batch
+    struct Item
+    {
+        LoraDeviceAddress address;                   //!< The address of the device
+        Time rx1Time;                                //!< The opening of the first window
+        Ptr<Packet> packet;                          //!< The reply for the first window
+        std::vector<std::pair<double, uint32_t>> gw; //!< Received power and id of the gateways
+        uint32_t gwId;                               //!< The gateway assigned to the reply
+        bool assigned;                               //!< Whether the reply has a gateway
+    };
 
-        m_controller->BeforeSendingReply(m_status->GetEndDeviceStatus(deviceAddress));
+    std::vector<Item> items;
+    items.reserve(batch.size());
+    for (const auto& pending : batch)
+    {
+        Ptr<EndDeviceStatus> edStatus = m_status->GetEndDeviceStatus(pending.address);
+        m_controller->BeforeSendingReply(edStatus);
 
         // Check whether this device needs a response by querying m_status
-        bool needsReply = m_status->NeedsReply(deviceAddress);
+        if (!m_status->NeedsReply(pending.address))
+        {
+            m_plannedReplies[pending.address.Get()] = {nullptr, NO_GATEWAY, 1};
+            continue;
+        }
+
+        Item item{pending.address,
+                  pending.rx1Time,
+                  m_status->GetReplyForDevice(pending.address, 1),
+                  {},
+                  0,
+                  false};
+        const EndDeviceStatus::GatewayList& gwList =
+            edStatus->GetReceivedPacketList().GetRecent().gwList;
+        for (std::size_t i = 0; i < gwList.GetSize(); i++)
+        {
+            item.gw.emplace_back(gwList.Get(i).rxPower, gwList.Get(i).gwId);
+        }
+        std::sort(item.gw.begin(), item.gw.end(), std::greater<>());
+        items.push_back(item);
+    }
 
-        if (needsReply)
+    // Devices reachable by fewer gateways choose first
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.gw.size() < b.gw.size() ||
+               (a.gw.size() == b.gw.size() && a.rx1Time < b.rx1Time);
+    });
+
+    for (auto& item : items)
+    {
+        for (const auto& gw : item.gw)
+        {
+            Booking booking = MakeBooking(gw.second, item.address, item.packet, item.rx1Time);
+            if (IsFree(gw.second, booking))
+            {
+                m_timelines[gw.second].push_back(booking);
+                item.gwId = gw.second;
+                item.assigned = true;
+                break;
+            }
+        }
+
+        // Try to make room on a gateway by moving a reply of this batch
+        // blocking it to another of its gateways
+        for (std::size_t i = 0; i < item.gw.size() && !item.assigned; i++)
+        {
+            uint32_t gwId = item.gw[i].second;
+            Booking booking = MakeBooking(gwId, item.address, item.packet, item.rx1Time);
+            std::vector<std::size_t> conflicts = FindConflicts(gwId, booking);
+            if (conflicts.size() != 1)
+            {
+                continue;
+            }
+            auto other = std::find_if(items.begin(), items.end(), [&](const Item& candidate) {
+                return candidate.assigned && candidate.gwId == gwId &&
+                       candidate.address == m_timelines[gwId][conflicts[0]].address;
+            });
+            if (other == items.end())
+            {
+                continue;
+            }
+
+            Booking blocking = m_timelines[gwId][conflicts[0]];
+            m_timelines[gwId].erase(m_timelines[gwId].begin() + conflicts[0]);
+            if (IsFree(gwId, booking))
+            {
+                for (const auto& gw : other->gw)
+                {
+                    Booking moved =
+                        MakeBooking(gw.second, other->address, other->packet, other->rx1Time);
+                    if (gw.second != gwId && IsFree(gw.second, moved))
+                    {
+                        NS_LOG_DEBUG("Moving the reply to " << other->address << " to gateway "
+                                                            << gw.second);
+                        m_timelines[gw.second].push_back(moved);
+                        other->gwId = gw.second;
+                        m_timelines[gwId].push_back(booking);
+                        item.gwId = gwId;
+                        item.assigned = true;
+                        break;
+                    }
+                }
+            }
+            if (!item.assigned)
+            {
+                m_timelines[gwId].push_back(blocking);
+            }
+        }
+    }
+
+    // Record the plan, falling back to the second receive window for the
+    // replies that found no room in the first one
+    for (const auto& item : items)
+    {
+        if (item.assigned)
+        {
+            m_plannedReplies[item.address.Get()] = {item.packet, item.gwId, 1};
+            continue;
+        }
+
+        Ptr<Packet> packet = m_status->GetReplyForDevice(item.address, 2);
+        PlannedReply reply{packet, NO_GATEWAY, 2};
+        for (const auto& gw : item.gw)
         {
-            NS_LOG_INFO("A reply is needed");
+            Booking booking =
+                MakeBooking(gw.second, item.address, packet, item.rx1Time + Seconds(1));
+            if (IsFree(gw.second, booking))
+            {
+                m_timelines[gw.second].push_back(booking);
+                reply.gwId = gw.second;
+                break;
+            }
+        }
+        m_plannedReplies[item.address.Get()] = reply;
+    }
+}
+
+NetworkScheduler::Booking
+NetworkScheduler::MakeBooking(uint32_t gwId,
+                              LoraDeviceAddress address,
+                              Ptr<const Packet> reply,
+                              Time start) const
+{
+    Ptr<GatewayLorawanMac> gwMac = m_status->m_gatewayStatuses[gwId]->GetGatewayMac();
+
+    LoraTag tag;
+    reply->PeekPacketTag(tag);
+    Ptr<SubBand> subBand = gwMac->GetSubBand(tag.GetFrequency());
+
+    // The sub-band is blocked as computed by the LogicalLoraChannelHelper of
+    // the gateway when the reply is sent
+    double timeOnAir = gwMac->GetOnAirTime(reply).GetSeconds();
+    return {address,
+            start,
+            start + Seconds(timeOnAir),
+            tag.GetFrequency(),
+            subBand,
+            start + Seconds(timeOnAir / subBand->GetDutyCycle() - timeOnAir)};
+}
+
+bool
+NetworkScheduler::IsFree(uint32_t gwId, const Booking& booking) const
+{
+    // Check the duty cycle already used by the gateway
+    Time waitingTime =
+        m_status->m_gatewayStatuses[gwId]->GetGatewayMac()->GetWaitingTime(booking.frequency);
+    if (booking.start < Simulator::Now() + waitingTime)
+    {
+        return false;
+    }
+
+    return FindConflicts(gwId, booking).empty();
+}
 
-            // Send the reply through that gateway
-            m_status->SendThroughGateway(m_status->GetReplyForDevice(deviceAddress, window),
-                                         gwAddress);
+std::vector<std::size_t>
+NetworkScheduler::FindConflicts(uint32_t gwId, const Booking& booking) const
+{
+    std::vector<std::size_t> conflicts;
+    const std::vector<Booking>& timeline = m_timelines[gwId];
+    for (std::size_t i = 0; i < timeline.size(); i++)
+    {
+        // We can't send multiple packets at once, see SX1301 V2.01 page 29
+        bool overlaps = booking.start < timeline[i].end && timeline[i].start < booking.end;
 
-            // Reset the reply
-            m_status->GetEndDeviceStatus(deviceAddress)->RemoveReceiveWindowOpportunity();
-            m_status->GetEndDeviceStatus(deviceAddress)->InitializeReply();
+        // Transmissions on the same sub-band are spaced by its duty cycle
+        bool dutyCycle = booking.subBand == timeline[i].subBand &&
+                         booking.start < timeline[i].dutyCycleEnd &&
+                         timeline[i].start < booking.dutyCycleEnd;
+
+        if (overlaps || dutyCycle)
+        {
+            conflicts.push_back(i);
         }
     }
+    return conflicts;
 }
 } // namespace lorawan
 } // namespace ns3
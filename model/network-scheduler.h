@@ -25,11 +25,15 @@
 #include "lorawan-mac-header.h"
 #include "network-controller.h"
 #include "network-status.h"
+#include "parsed-uplink.h"
 
 #include "ns3/core-module.h"
 #include "ns3/object.h"
 #include "ns3/packet.h"
 
+#include <unordered_map>
+#include <vector>
+
 namespace ns3
 {
 namespace lorawan
@@ -43,6 +47,14 @@ class NetworkController; // Forward declaration
  *
  * Network server component in charge of scheduling downling packets onto devices' reception windows
  *
+ * Replies are planned jointly: when the first receive window of a device
+ * opens, the replies of all devices whose first receive window opens within
+ * the PlanningWindow are assigned a gateway and a receive window together.
+ * The scheduler keeps, for each gateway, a timeline of the downlink
+ * transmissions booked on it, with their frequency and the sub-band they
+ * draw duty cycle from, so that replies booked in the future are accounted
+ * for when planning the following ones.
+ *
  * \todo We should probably add getters and setters or remove default constructor
  */
 class NetworkScheduler : public Object
@@ -72,9 +84,21 @@ class NetworkScheduler : public Object
      *
      * This function schedules the OnReceiveWindowOpportunity events 1 and 2 seconds later.
      *
-     * \param packet A pointer to the new Packet instance.
+     * \param uplink The newly arrived packet, with its decoded headers.
      */
-    void OnReceivedPacket(Ptr<const Packet> packet);
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink);
+
+    /**
+     * Inform the Scheduler of an uplink packet that arrived earlier, for
+     * instance when the NetworkServer processes uplinks in batches.
+     *
+     * The OnReceiveWindowOpportunity events are scheduled 1 and 2 seconds after
+     * the arrival of the packet.
+     *
+     * \param uplink The packet, with its decoded headers.
+     * \param receptionTime The time at which the packet arrived.
+     */
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink, Time receptionTime);
 
     /**
      * Method that is scheduled after packet arrival in order to take action on
@@ -86,6 +110,91 @@ class NetworkScheduler : public Object
     void OnReceiveWindowOpportunity(LoraDeviceAddress deviceAddress, int window);
 
   private:
+    /**
+     * A reply waiting to be planned.
+     */
+    struct PendingReply
+    {
+        LoraDeviceAddress address; //!< The address of the device
+        Time rx1Time;              //!< The time at which the first receive window opens
+    };
+
+    /**
+     * The outcome of the planning of a reply.
+     */
+    struct PlannedReply
+    {
+        Ptr<Packet> packet; //!< The reply, nullptr if the device doesn't need one
+        uint32_t gwId;      //!< The id of the gateway sending the reply, NO_GATEWAY if none can
+        int window;         //!< The receive window the reply is sent in (1 or 2)
+    };
+
+    /**
+     * A downlink transmission booked on a gateway.
+     */
+    struct Booking
+    {
+        LoraDeviceAddress address; //!< The device the transmission is addressed to
+        Time start;                //!< The start of the transmission
+        Time end;                  //!< The end of the transmission
+        double frequency;          //!< The frequency of the transmission [MHz]
+        Ptr<SubBand> subBand;      //!< The sub-band of the frequency
+        Time dutyCycleEnd;         //!< The time at which the sub-band can be used again
+    };
+
+    /**
+     * Plan the replies of the devices whose first receive window opens within
+     * the PlanningWindow from now.
+     *
+     * Replies are assigned greedily, starting from the devices reachable by
+     * the fewest gateways, to the gateway with the highest received power
+     * that has room for them in the first receive window. If there is none,
+     * a reply of the same batch blocking one of the gateways is moved to
+     * another of its gateways when possible. Replies that still don't fit are
+     * planned in the second receive window.
+     */
+    void PlanReplies();
+
+    /**
+     * Build the booking of a reply on a gateway.
+     *
+     * \param gwId The id of the gateway.
+     * \param address The address of the device.
+     * \param reply The reply, carrying a LoraTag with its data rate and frequency.
+     * \param start The start of the transmission.
+     * \return The booking.
+     */
+    Booking MakeBooking(uint32_t gwId,
+                        LoraDeviceAddress address,
+                        Ptr<const Packet> reply,
+                        Time start) const;
+
+    /**
+     * Check whether a transmission fits in the timeline of a gateway.
+     *
+     * \param gwId The id of the gateway.
+     * \param booking The transmission.
+     * \return True if the gateway can perform the transmission.
+     */
+    bool IsFree(uint32_t gwId, const Booking& booking) const;
+
+    /**
+     * Find the bookings of a gateway that prevent a transmission.
+     *
+     * \param gwId The id of the gateway.
+     * \param booking The transmission.
+     * \return The indices of the conflicting bookings in the timeline of the gateway.
+     */
+    std::vector<std::size_t> FindConflicts(uint32_t gwId, const Booking& booking) const;
+
+    static constexpr uint32_t NO_GATEWAY = UINT32_MAX; //!< Marks replies without a gateway
+
+    Time m_planningWindow; //!< Replies due within this time are planned together
+    std::vector<PendingReply> m_pendingReplies; //!< Replies waiting to be planned
+    std::unordered_map<uint32_t, PlannedReply>
+        m_plannedReplies; //!< Replies waiting to be sent, by device address
+    std::vector<std::vector<Booking>> m_timelines; //!< Booked transmissions, by gateway id
+
     TracedCallback<Ptr<const Packet>>
         m_receiveWindowOpened;           //!< Trace callback source for reception windows openings.
                                          //!< \todo Never called. Place calls in the right places.
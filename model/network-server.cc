@@ -31,6 +31,9 @@
 #include "ns3/node-container.h"
 #include "ns3/packet.h"
 #include "ns3/point-to-point-net-device.h"
+#include "ns3/simulator.h"
+
+#include <unordered_set>
 
 namespace ns3
 {
@@ -48,6 +51,13 @@ NetworkServer::GetTypeId()
         TypeId("ns3::NetworkServer")
             .SetParent<Application>()
             .AddConstructor<NetworkServer>()
+            .AddAttribute("BatchWindow",
+                          "Time during which uplinks are accumulated before being processed "
+                          "as a batch, or zero to process each gateway copy on arrival. Must be "
+                          "below the 1 s delay of the first receive window",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&NetworkServer::m_batchWindow),
+                          MakeTimeChecker(Seconds(0)))
             .AddTraceSource(
                 "ReceivedPacket",
                 "Trace source that is fired when a packet arrives at the network server",
@@ -60,7 +70,7 @@ NetworkServer::GetTypeId()
 NetworkServer::NetworkServer()
     : m_status(Create<NetworkStatus>()),
       m_controller(Create<NetworkController>(m_status)),
-      m_scheduler(Create<NetworkScheduler>(m_status, m_controller))
+      m_scheduler(CreateObject<NetworkScheduler>(m_status, m_controller))
 {
     NS_LOG_FUNCTION_NOARGS();
 }
@@ -110,7 +120,15 @@ NetworkServer::AddGateway(Ptr<Node> gateway, Ptr<NetDevice> netDevice)
     // Create new gatewayStatus
     Ptr<GatewayStatus> gwStatus = Create<GatewayStatus>(gatewayAddress, netDevice, gwMac);
 
-    m_status->AddGateway(gatewayAddress, gwStatus);
+    uint32_t gwId = m_status->AddGateway(gatewayAddress, gwStatus);
+
+    // Packets from the gateway are recognized by the NetDevice they arrive on
+    uint32_t ifIndex = netDevice->GetIfIndex();
+    if (m_gatewayIds.size() <= ifIndex)
+    {
+        m_gatewayIds.resize(ifIndex + 1, NO_GATEWAY);
+    }
+    m_gatewayIds[ifIndex] = gwId;
 }
 
 void
@@ -159,24 +177,80 @@ NetworkServer::Receive(Ptr<NetDevice> device,
 {
     NS_LOG_FUNCTION(this << packet << protocol << address);
 
-    // Create a copy of the packet
-    Ptr<Packet> myPacket = packet->Copy();
+    // Decode the headers once for all the components
+    Ptr<const ParsedUplink> uplink = Create<ParsedUplink>(packet);
+
+    uint32_t ifIndex = device->GetIfIndex();
+    NS_ABORT_MSG_IF(ifIndex >= m_gatewayIds.size() || m_gatewayIds[ifIndex] == NO_GATEWAY,
+                    "Packet received from unknown gateway " << address);
+    uint32_t gwId = m_gatewayIds[ifIndex];
 
     // Fire the trace source
     m_receivedPacket(packet);
 
+    if (m_batchWindow.IsStrictlyPositive())
+    {
+        // Receive windows are scheduled relative to the arrival of the packet,
+        // so they must not open before the end of the batch
+        NS_ABORT_MSG_IF(m_batchWindow >= Seconds(1),
+                        "BatchWindow must be below the 1 s delay of the first receive window");
+
+        // Wait for the other gateway copies of the packet
+        m_batch.push_back({uplink, address, gwId, Simulator::Now()});
+        if (!m_batchEvent.IsRunning())
+        {
+            m_batchEvent = Simulator::Schedule(m_batchWindow, &NetworkServer::ProcessBatch, this);
+        }
+        return true;
+    }
+
     // Inform the scheduler of the newly arrived packet
-    m_scheduler->OnReceivedPacket(packet);
+    m_scheduler->OnReceivedPacket(uplink);
 
     // Inform the status of the newly arrived packet
-    m_status->OnReceivedPacket(packet, address);
+    m_status->OnReceivedPacket(uplink, address, gwId);
 
     // Inform the controller of the newly arrived packet
-    m_controller->OnNewPacket(packet);
+    m_controller->OnNewPacket(uplink);
 
     return true;
 }
 
+void
+NetworkServer::ProcessBatch()
+{
+    NS_LOG_FUNCTION(this << m_batch.size());
+
+    std::vector<PendingUplink> batch;
+    std::swap(batch, m_batch);
+
+    // Merge all gateway copies in the status first, so that the components
+    // see the complete gateway list of each packet
+    for (const auto& pending : batch)
+    {
+        m_status->OnReceivedPacket(pending.uplink, pending.gwAddress, pending.gwId);
+    }
+
+    // Then handle each packet once, identified by device address and frame
+    // counter, in order of arrival of its first copy
+    std::unordered_set<uint64_t> handled;
+    for (const auto& pending : batch)
+    {
+        uint64_t key = uint64_t(pending.uplink->GetAddress().Get()) << 16 |
+                       pending.uplink->GetFCnt();
+        if (!handled.insert(key).second)
+        {
+            continue;
+        }
+
+        m_controller->OnNewPacket(pending.uplink);
+        m_scheduler->OnReceivedPacket(pending.uplink, pending.receptionTime);
+    }
+
+    NS_LOG_DEBUG("Processed " << batch.size() << " gateway copies of " << handled.size()
+                              << " packets");
+}
+
 void
 NetworkServer::AddComponent(Ptr<NetworkControllerComponent> component)
 {
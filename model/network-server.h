@@ -36,6 +36,8 @@
 #include "ns3/packet.h"
 #include "ns3/point-to-point-net-device.h"
 
+#include <vector>
+
 namespace ns3
 {
 namespace lorawan
@@ -49,6 +51,13 @@ namespace lorawan
  *
  * This version of the NetworkServer application attempts to closely mimic an actual
  * network server, by providing as much functionality as possible.
+ *
+ * By default, each copy of an uplink forwarded by a gateway is handed to the
+ * scheduler, the status and the controller as soon as it arrives. If the
+ * BatchWindow attribute is positive, copies are instead accumulated for that
+ * time and processed as a batch: all copies are first merged in the status, and
+ * then the controller and the scheduler handle each uplink once, with its
+ * complete gateway list.
  */
 class NetworkServer : public Application
 {
@@ -96,7 +105,8 @@ class NetworkServer : public Application
      * Add the gateway to the list of gateways connected to this network server.
      *
      * Each gateway is identified by its Address in the network connecting it to the network
-     * server.
+     * server. Its id in the NetworkStatus is resolved here, once, and then found from the
+     * NetDevice packets are received on.
      *
      * \param gateway A pointer to the gateway Node.
      * \param netDevice A pointer to the network server's NetDevice connected to the gateway.
@@ -130,6 +140,34 @@ class NetworkServer : public Application
     Ptr<NetworkStatus> GetNetworkStatus();
 
   protected:
+    /**
+     * Process the uplinks received during the last batch window.
+     */
+    void ProcessBatch();
+
+    /**
+     * A gateway copy of an uplink waiting to be processed.
+     */
+    struct PendingUplink
+    {
+        Ptr<const ParsedUplink> uplink; //!< The packet, with its decoded headers
+        Address gwAddress;              //!< The address of the gateway that forwarded the packet
+        uint32_t gwId;                  //!< The id of the gateway that forwarded the packet
+        Time receptionTime;             //!< The time at which the packet arrived
+    };
+
+    Time m_batchWindow;                 //!< Time during which uplinks are accumulated
+    std::vector<PendingUplink> m_batch; //!< The uplinks received in the current batch window
+    EventId m_batchEvent;               //!< The event processing the current batch
+
+    /**
+     * The id of the gateway connected to each NetDevice of this node, by
+     * NetDevice index (NO_GATEWAY for NetDevices not connected to a gateway).
+     */
+    std::vector<uint32_t> m_gatewayIds;
+
+    static constexpr uint32_t NO_GATEWAY = UINT32_MAX; //!< Marks NetDevices without a gateway
+
     Ptr<NetworkStatus> m_status;         //!< Ptr to the NetworkStatus object.
     Ptr<NetworkController> m_controller; //!< Ptr to the NetworkController object.
     Ptr<NetworkScheduler> m_scheduler;   //!< Ptr to the NetworkScheduler object.
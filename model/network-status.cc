@@ -50,6 +50,7 @@ NetworkStatus::GetTypeId()
 }
 
 NetworkStatus::NetworkStatus()
+    : m_endDeviceStatusPool(Create<EndDeviceStatus::Pool>())
 {
     NS_LOG_FUNCTION_NOARGS();
 }
@@ -66,68 +67,76 @@ NetworkStatus::AddNode(Ptr<ClassAEndDeviceLorawanMac> edMac)
 
     // Check whether this device already exists in our list
     LoraDeviceAddress edAddress = edMac->GetDeviceAddress();
-    if (m_endDeviceStatuses.find(edAddress) == m_endDeviceStatuses.end())
+    if (!m_endDeviceStatuses.Find(edAddress))
     {
-        // The device doesn't exist. Create new EndDeviceStatus
+        // The device doesn't exist. Create new EndDeviceStatus, next to the
+        // ones of the other devices
         Ptr<EndDeviceStatus> edStatus =
-            CreateObject<EndDeviceStatus>(edAddress, edMac->GetObject<ClassAEndDeviceLorawanMac>());
+            CompleteConstruct(new (*m_endDeviceStatusPool) EndDeviceStatus(edAddress, edMac));
 
-        // Add it to the map
-        m_endDeviceStatuses.insert(
-            std::pair<LoraDeviceAddress, Ptr<EndDeviceStatus>>(edAddress, edStatus));
+        // Add it to the table
+        m_endDeviceStatuses.Insert(edAddress, edStatus);
         NS_LOG_DEBUG("Added to the list a device with address " << edAddress.Print());
     }
 }
 
-void
+uint32_t
 NetworkStatus::AddGateway(Address& address, Ptr<GatewayStatus> gwStatus)
 {
     NS_LOG_FUNCTION(this);
 
     // Check whether this device already exists in the list
-    if (m_gatewayStatuses.find(address) == m_gatewayStatuses.end())
+    auto it = m_gatewayIds.find(address);
+    if (it != m_gatewayIds.end())
     {
-        // The device doesn't exist.
-
-        // Add it to the map
-        m_gatewayStatuses.insert(std::pair<Address, Ptr<GatewayStatus>>(address, gwStatus));
-        NS_LOG_DEBUG("Added to the list a gateway with address " << address);
+        return it->second;
     }
+
+    // The device doesn't exist: give it the next id
+    uint32_t gwId = m_gatewayStatuses.size();
+    m_gatewayStatuses.push_back(gwStatus);
+    m_gatewayIds.emplace(address, gwId);
+    NS_LOG_DEBUG("Added to the list a gateway with address " << address << " and id " << gwId);
+    return gwId;
 }
 
-void
-NetworkStatus::OnReceivedPacket(Ptr<const Packet> packet, const Address& gwAddress)
+uint32_t
+NetworkStatus::GetGatewayId(const Address& address) const
 {
-    NS_LOG_FUNCTION(this << packet << gwAddress);
-
-    // Create a copy of the packet
-    Ptr<Packet> myPacket = packet->Copy();
+    auto it = m_gatewayIds.find(address);
+    NS_ABORT_MSG_IF(it == m_gatewayIds.end(), "Unknown gateway " << address);
+    return it->second;
+}
 
-    // Extract the headers
-    LorawanMacHeader macHdr;
-    myPacket->RemoveHeader(macHdr);
-    LoraFrameHeader frameHdr;
-    frameHdr.SetAsUplink();
-    myPacket->RemoveHeader(frameHdr);
+void
+NetworkStatus::OnReceivedPacket(Ptr<const ParsedUplink> uplink,
+                                const Address& gwAddress,
+                                uint32_t gwId)
+{
+    NS_LOG_FUNCTION(this << uplink->GetPacket() << gwAddress << gwId);
 
     // Update the correct EndDeviceStatus object
-    LoraDeviceAddress edAddr = frameHdr.GetAddress();
+    LoraDeviceAddress edAddr = uplink->GetAddress();
     NS_LOG_DEBUG("Node address: " << edAddr);
-    m_endDeviceStatuses.at(edAddr)->InsertReceivedPacket(packet, gwAddress);
+    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.Find(edAddr);
+    NS_ABORT_MSG_IF(!edStatus, "Unknown device " << edAddr);
+    edStatus->InsertReceivedPacket(uplink, gwAddress, gwId);
 }
 
 bool
 NetworkStatus::NeedsReply(LoraDeviceAddress deviceAddress)
 {
-    // Throws out of range if no device is found
-    return m_endDeviceStatuses.at(deviceAddress)->NeedsReply();
+    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.Find(deviceAddress);
+    NS_ABORT_MSG_IF(!edStatus, "Unknown device " << deviceAddress);
+    return edStatus->NeedsReply();
 }
 
 Address
 NetworkStatus::GetBestGatewayForDevice(LoraDeviceAddress deviceAddress, int window)
 {
     // Get the endDeviceStatus we are interested in
-    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.at(deviceAddress);
+    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.Find(deviceAddress);
+    NS_ABORT_MSG_IF(!edStatus, "Unknown device " << deviceAddress);
     double replyFrequency;
     if (window == 1)
     {
@@ -145,40 +154,38 @@ NetworkStatus::GetBestGatewayForDevice(LoraDeviceAddress deviceAddress, int wind
     // Get the list of gateways that this device can reach
     // NOTE: At this point, we could also take into account the whole network to
     // identify the best gateway according to various metrics. For now, we just
-    // ask the EndDeviceStatus to pick the best gateway for us via its method.
-    std::map<double, Address> gwAddresses = edStatus->GetPowerGatewayMap();
-
-    // By iterating on the map in reverse, we go from the 'best'
-    // gateway, i.e. the one with the highest received power, to the
-    // worst.
-    Address bestGwAddress;
-    for (auto it = gwAddresses.rbegin(); it != gwAddresses.rend(); it++)
+    // pick the gateway with the highest received power among the available ones.
+    const EndDeviceStatus::GatewayList& gwList =
+        edStatus->GetReceivedPacketList().GetRecent().gwList;
+
+    const EndDeviceStatus::PacketInfoPerGw* best = nullptr;
+    for (std::size_t i = 0; i < gwList.GetSize(); i++)
     {
-        bool isAvailable =
-            m_gatewayStatuses.find(it->second)->second->IsAvailableForTransmission(replyFrequency);
-        if (isAvailable)
+        const EndDeviceStatus::PacketInfoPerGw& gwInfo = gwList.Get(i);
+        if ((!best || gwInfo.rxPower > best->rxPower) &&
+            m_gatewayStatuses[gwInfo.gwId]->IsAvailableForTransmission(replyFrequency))
         {
-            bestGwAddress = it->second;
-            break;
+            best = &gwInfo;
         }
     }
 
-    return bestGwAddress;
+    return best ? best->gwAddress : Address();
 }
 
 void
-NetworkStatus::SendThroughGateway(Ptr<Packet> packet, Address gwAddress)
+NetworkStatus::SendThroughGateway(Ptr<Packet> packet, uint32_t gwId)
 {
-    NS_LOG_FUNCTION(packet << gwAddress);
+    NS_LOG_FUNCTION(packet << gwId);
 
-    m_gatewayStatuses.find(gwAddress)->second->GetNetDevice()->Send(packet, gwAddress, 0x0800);
+    Ptr<GatewayStatus> gwStatus = m_gatewayStatuses[gwId];
+    gwStatus->GetNetDevice()->Send(packet, gwStatus->GetAddress(), 0x0800);
 }
 
 Ptr<Packet>
 NetworkStatus::GetReplyForDevice(LoraDeviceAddress edAddress, int windowNumber)
 {
     // Get the reply packet
-    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.find(edAddress)->second;
+    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.Find(edAddress);
     Ptr<Packet> packet = edStatus->GetCompleteReplyPacket();
 
     // Apply the appropriate tag
@@ -210,16 +217,7 @@ NetworkStatus::GetEndDeviceStatus(Ptr<const Packet> packet)
     Ptr<Packet> myPacket = packet->Copy();
     myPacket->RemoveHeader(mHdr);
     myPacket->RemoveHeader(fHdr);
-    auto it = m_endDeviceStatuses.find(fHdr.GetAddress());
-    if (it != m_endDeviceStatuses.end())
-    {
-        return (*it).second;
-    }
-    else
-    {
-        NS_LOG_ERROR("EndDeviceStatus not found");
-        return nullptr;
-    }
+    return GetEndDeviceStatus(fHdr.GetAddress());
 }
 
 Ptr<EndDeviceStatus>
@@ -227,16 +225,12 @@ NetworkStatus::GetEndDeviceStatus(LoraDeviceAddress address)
 {
     NS_LOG_FUNCTION(this << address);
 
-    auto it = m_endDeviceStatuses.find(address);
-    if (it != m_endDeviceStatuses.end())
-    {
-        return (*it).second;
-    }
-    else
+    Ptr<EndDeviceStatus> edStatus = m_endDeviceStatuses.Find(address);
+    if (!edStatus)
     {
         NS_LOG_ERROR("EndDeviceStatus not found");
-        return nullptr;
     }
+    return edStatus;
 }
 
 int
@@ -244,7 +238,78 @@ NetworkStatus::CountEndDevices()
 {
     NS_LOG_FUNCTION(this);
 
-    return m_endDeviceStatuses.size();
+    return m_endDeviceStatuses.GetSize();
+}
+
+Ptr<EndDeviceStatus>
+EndDeviceStatusMap::Find(LoraDeviceAddress address) const
+{
+    if (m_size == 0)
+    {
+        return nullptr;
+    }
+    return m_slots[Probe(address.Get())].status;
+}
+
+bool
+EndDeviceStatusMap::Insert(LoraDeviceAddress address, Ptr<EndDeviceStatus> status)
+{
+    NS_ASSERT(status);
+
+    // Keep the load factor below 3/4
+    if (4 * (m_size + 1) > 3 * m_slots.size())
+    {
+        Grow();
+    }
+
+    Slot& slot = m_slots[Probe(address.Get())];
+    if (slot.status)
+    {
+        return false;
+    }
+    slot.address = address.Get();
+    slot.status = status;
+    m_size++;
+    return true;
+}
+
+std::size_t
+EndDeviceStatusMap::GetSize() const
+{
+    return m_size;
+}
+
+std::size_t
+EndDeviceStatusMap::Probe(uint32_t address) const
+{
+    // Fibonacci hashing spreads the consecutive addresses of devices over the table
+    std::size_t mask = m_slots.size() - 1;
+    auto i = std::size_t((address * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits));
+    while (m_slots[i].status && m_slots[i].address != address)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void
+EndDeviceStatusMap::Grow()
+{
+    std::vector<Slot> slots(m_slots.empty() ? 16 : 2 * m_slots.size());
+    std::swap(slots, m_slots);
+    m_bits = 0;
+    while ((std::size_t(1) << m_bits) < m_slots.size())
+    {
+        m_bits++;
+    }
+
+    for (auto& slot : slots)
+    {
+        if (slot.status)
+        {
+            m_slots[Probe(slot.address)] = std::move(slot);
+        }
+    }
 }
 } // namespace lorawan
 } // namespace ns3
@@ -26,21 +26,85 @@
 #include "gateway-status.h"
 #include "lora-device-address.h"
 #include "network-scheduler.h"
+#include "parsed-uplink.h"
 
 #include <iterator>
+#include <map>
+#include <vector>
 
 namespace ns3
 {
 namespace lorawan
 {
 
+/**
+ * \ingroup lorawan
+ *
+ * Hash table from device addresses to the status of the devices.
+ *
+ * Entries are stored in a single array with open addressing and linear probing,
+ * keyed by the 32-bit value of the address, so that the cost of a lookup
+ * doesn't grow with the number of devices. Devices are never removed.
+ */
+class EndDeviceStatusMap
+{
+  public:
+    /**
+     * Look up the status of a device.
+     *
+     * \param address The address of the device.
+     * \return The status of the device, or nullptr if the device is unknown.
+     */
+    Ptr<EndDeviceStatus> Find(LoraDeviceAddress address) const;
+
+    /**
+     * Add a device, unless it is already in the table.
+     *
+     * \param address The address of the device.
+     * \param status The status of the device.
+     * \return True if the device was added.
+     */
+    bool Insert(LoraDeviceAddress address, Ptr<EndDeviceStatus> status);
+
+    /**
+     * \return The number of devices in the table.
+     */
+    std::size_t GetSize() const;
+
+  private:
+    /**
+     * An entry of the table.
+     */
+    struct Slot
+    {
+        uint32_t address = 0;        //!< The address of the device
+        Ptr<EndDeviceStatus> status; //!< The status of the device, or nullptr if free
+    };
+
+    /**
+     * \param address The address of a device.
+     * \return The slot of the device, or the free slot where it would be inserted.
+     */
+    std::size_t Probe(uint32_t address) const;
+
+    /**
+     * Double the capacity of the table and insert the entries again.
+     */
+    void Grow();
+
+    std::vector<Slot> m_slots; //!< The table, whose size is zero or a power of two
+    std::size_t m_size = 0;    //!< The number of devices
+    uint8_t m_bits = 0;        //!< The base 2 logarithm of the size of the table
+};
+
 /**
  * \ingroup lorawan
  *
  * This class represents the knowledge about the state of the network that is
- * available at the network server. It is essentially a collection of two maps:
- * one containing DeviceStatus objects, and the other containing GatewayStatus
- * objects.
+ * available at the network server. It is essentially a collection of two
+ * tables: one containing DeviceStatus objects, indexed by device address, and
+ * the other containing GatewayStatus objects, indexed by a small integer id
+ * assigned to each gateway when it is added.
  *
  * This class is meant to be queried by NetworkController components, which
  * can decide to take action based on the current status of the network.
@@ -68,20 +132,30 @@ class NetworkStatus : public Object
      * Add a new gateway to the list of gateways connected to the network.
      *
      * Each gateway is identified by its NetDevice Address in the network connecting it to the
-     * network server.
+     * network server, and is assigned the next free gateway id.
      *
      * \param address The gateway's NetDevice Address.
      * \param gwStatus A pointer to a GatewayStatus object for the gateway.
+     * \return The id of the gateway.
+     */
+    uint32_t AddGateway(Address& address, Ptr<GatewayStatus> gwStatus);
+
+    /**
+     * Get the id of a gateway.
+     *
+     * \param address The gateway's NetDevice Address.
+     * \return The id assigned to the gateway by AddGateway.
      */
-    void AddGateway(Address& address, Ptr<GatewayStatus> gwStatus);
+    uint32_t GetGatewayId(const Address& address) const;
 
     /**
      * Update network status on a received packet.
      *
-     * \param packet The received packet.
-     * \param gwaddress Address of the gateway this packet was received from.
+     * \param uplink The received packet, with its decoded headers.
+     * \param gwAddress Address of the gateway this packet was received from.
+     * \param gwId The id of the gateway, as returned by AddGateway.
      */
-    void OnReceivedPacket(Ptr<const Packet> packet, const Address& gwaddress);
+    void OnReceivedPacket(Ptr<const ParsedUplink> uplink, const Address& gwAddress, uint32_t gwId);
 
     /**
      * Return whether the specified device needs a reply.
@@ -110,9 +184,9 @@ class NetworkStatus : public Object
      * transmission.
      *
      * \param packet The packet.
-     * \param gwAddress The address of the gateway.
+     * \param gwId The id of the gateway, as returned by AddGateway.
      */
-    void SendThroughGateway(Ptr<Packet> packet, Address gwAddress);
+    void SendThroughGateway(Ptr<Packet> packet, uint32_t gwId);
 
     /**
      * Get the reply packet prepared for a reception window of a device.
@@ -147,10 +221,14 @@ class NetworkStatus : public Object
     int CountEndDevices();
 
   public:
-    std::map<LoraDeviceAddress, Ptr<EndDeviceStatus>>
-        m_endDeviceStatuses; //!< Map tracking the state of devices connected to this network server
-    std::map<Address, Ptr<GatewayStatus>>
-        m_gatewayStatuses; //!< Map tracking the state of gateways connected to this network server
+    EndDeviceStatusMap
+        m_endDeviceStatuses; //!< State of devices connected to this network server, by address
+    std::vector<Ptr<GatewayStatus>>
+        m_gatewayStatuses; //!< State of gateways connected to this network server, by gateway id
+    std::map<Address, uint32_t> m_gatewayIds; //!< Ids of the gateways, by NetDevice Address
+
+  private:
+    Ptr<EndDeviceStatus::Pool> m_endDeviceStatusPool; //!< The storage of the end device statuses
 };
 
 } // namespace lorawan
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "parsed-uplink.h"
+
+#include "ns3/log.h"
+
+namespace ns3
+{
+namespace lorawan
+{
+
+NS_LOG_COMPONENT_DEFINE("ParsedUplink");
+
+ParsedUplink::ParsedUplink(Ptr<const Packet> packet)
+    : m_packet(packet)
+{
+    NS_LOG_FUNCTION(this << packet);
+
+    // Work on a copy, so that headers can be removed in sequence
+    Ptr<Packet> myPacket = packet->Copy();
+    myPacket->RemoveHeader(m_macHeader);
+    m_frameHeader.SetAsUplink();
+    myPacket->RemoveHeader(m_frameHeader);
+    packet->PeekPacketTag(m_tag);
+
+    NS_LOG_DEBUG("Parsed uplink from " << m_frameHeader.GetAddress() << " with FCnt "
+                                       << m_frameHeader.GetFCnt());
+}
+
+Ptr<const Packet>
+ParsedUplink::GetPacket() const
+{
+    return m_packet;
+}
+
+const LorawanMacHeader&
+ParsedUplink::GetMacHeader() const
+{
+    return m_macHeader;
+}
+
+const LoraFrameHeader&
+ParsedUplink::GetFrameHeader() const
+{
+    return m_frameHeader;
+}
+
+const LoraTag&
+ParsedUplink::GetTag() const
+{
+    return m_tag;
+}
+
+LoraDeviceAddress
+ParsedUplink::GetAddress() const
+{
+    return m_frameHeader.GetAddress();
+}
+
+uint16_t
+ParsedUplink::GetFCnt() const
+{
+    return m_frameHeader.GetFCnt();
+}
+
+} // namespace lorawan
+} // namespace ns3
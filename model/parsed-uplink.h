@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PARSED_UPLINK_H
+#define PARSED_UPLINK_H
+
+#include "lora-device-address.h"
+#include "lora-frame-header.h"
+#include "lora-tag.h"
+#include "lorawan-mac-header.h"
+
+#include "ns3/packet.h"
+#include "ns3/simple-ref-count.h"
+
+namespace ns3
+{
+namespace lorawan
+{
+
+/**
+ * \ingroup lorawan
+ *
+ * An uplink packet received by the network server, together with its decoded
+ * headers and LoraTag.
+ *
+ * The NetworkServer decodes each uplink once as it arrives, and passes this
+ * object to the NetworkScheduler, the NetworkStatus and the components of the
+ * NetworkController, so that they don't need to copy the packet and
+ * deserialize its headers again.
+ */
+class ParsedUplink : public SimpleRefCount<ParsedUplink>
+{
+  public:
+    /**
+     * Decode the headers and the tag of an uplink packet.
+     *
+     * \param packet The packet, starting with its LorawanMacHeader.
+     */
+    ParsedUplink(Ptr<const Packet> packet);
+
+    /**
+     * Get the packet, as it was received.
+     *
+     * \return A pointer to the packet.
+     */
+    Ptr<const Packet> GetPacket() const;
+
+    /**
+     * Get the MAC header of the packet.
+     *
+     * \return The MAC header.
+     */
+    const LorawanMacHeader& GetMacHeader() const;
+
+    /**
+     * Get the frame header of the packet, including its MAC commands.
+     *
+     * \return The frame header.
+     */
+    const LoraFrameHeader& GetFrameHeader() const;
+
+    /**
+     * Get the LoraTag the packet was received with.
+     *
+     * \return The tag, or a default one if the packet had none.
+     */
+    const LoraTag& GetTag() const;
+
+    /**
+     * Get the address of the device that sent the packet.
+     *
+     * \return The device address in the frame header.
+     */
+    LoraDeviceAddress GetAddress() const;
+
+    /**
+     * Get the frame counter of the packet.
+     *
+     * \return The frame counter in the frame header.
+     */
+    uint16_t GetFCnt() const;
+
+  private:
+    Ptr<const Packet> m_packet;    //!< The received packet
+    LorawanMacHeader m_macHeader;  //!< The MAC header of the packet
+    LoraFrameHeader m_frameHeader; //!< The frame header of the packet
+    LoraTag m_tag;                 //!< The tag of the packet
+};
+
+} // namespace lorawan
+
+} // namespace ns3
+#endif /* PARSED_UPLINK_H */
@@ -117,12 +117,14 @@ SimpleEndDeviceLoraPhy::Send(Ptr<Packet> packet,
 }
 
 void
-SimpleEndDeviceLoraPhy::StartReceive(Ptr<Packet> packet,
-                                     double rxPowerDbm,
-                                     uint8_t sf,
-                                     Time duration,
-                                     double frequencyMHz)
+SimpleEndDeviceLoraPhy::StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                                     double rxPowerDbm)
 {
+    Ptr<Packet> packet = transmission->GetPacket();
+    uint8_t sf = transmission->GetSpreadingFactor();
+    Time duration = transmission->GetDuration();
+    double frequencyMHz = transmission->GetFrequency();
+
     NS_LOG_FUNCTION(this << packet << rxPowerDbm << unsigned(sf) << duration << frequencyMHz);
 
     // Notify the LoraInterferenceHelper of the impinging signal, and remember
@@ -134,7 +136,7 @@ SimpleEndDeviceLoraPhy::StartReceive(Ptr<Packet> packet,
     // still incoming.
 
     Ptr<LoraInterferenceHelper::Event> event;
-    event = m_interference.Add(duration, rxPowerDbm, sf, packet, frequencyMHz);
+    event = m_interference.Add(transmission, rxPowerDbm);
 
     // Switch on the current PHY state
     switch (m_state)
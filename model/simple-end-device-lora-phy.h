@@ -54,12 +54,11 @@ class SimpleEndDeviceLoraPhy : public EndDeviceLoraPhy
     SimpleEndDeviceLoraPhy();           //!< Default constructor
     ~SimpleEndDeviceLoraPhy() override; //!< Destructor
 
+    using LoraPhy::StartReceive;
+
     // Implementation of EndDeviceLoraPhy's pure virtual functions
-    void StartReceive(Ptr<Packet> packet,
-                      double rxPowerDbm,
-                      uint8_t sf,
-                      Time duration,
-                      double frequencyMHz) override;
+    void StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                      double rxPowerDbm) override;
 
     // Implementation of LoraPhy's pure virtual functions
     void EndReceive(Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event) override;
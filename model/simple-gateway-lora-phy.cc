@@ -119,12 +119,14 @@ SimpleGatewayLoraPhy::Send(Ptr<Packet> packet,
 }
 
 void
-SimpleGatewayLoraPhy::StartReceive(Ptr<Packet> packet,
-                                   double rxPowerDbm,
-                                   uint8_t sf,
-                                   Time duration,
-                                   double frequencyMHz)
+SimpleGatewayLoraPhy::StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                                   double rxPowerDbm)
 {
+    Ptr<Packet> packet = transmission->GetPacket();
+    uint8_t sf = transmission->GetSpreadingFactor();
+    Time duration = transmission->GetDuration();
+    double frequencyMHz = transmission->GetFrequency();
+
     NS_LOG_FUNCTION(this << packet << rxPowerDbm << duration << frequencyMHz);
 
     // Fire the trace source
@@ -153,7 +155,7 @@ SimpleGatewayLoraPhy::StartReceive(Ptr<Packet> packet,
 
     // Add the event to the LoraInterferenceHelper
     Ptr<LoraInterferenceHelper::Event> event;
-    event = m_interference.Add(duration, rxPowerDbm, sf, packet, frequencyMHz);
+    event = m_interference.Add(transmission, rxPowerDbm);
 
     // Cycle over the receive paths to check availability to receive the packet
     std::list<Ptr<SimpleGatewayLoraPhy::ReceptionPath>>::iterator it;
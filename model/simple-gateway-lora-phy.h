@@ -55,11 +55,10 @@ class SimpleGatewayLoraPhy : public GatewayLoraPhy
     SimpleGatewayLoraPhy();           //!< Default constructor
     ~SimpleGatewayLoraPhy() override; //!< Destructor
 
-    void StartReceive(Ptr<Packet> packet,
-                      double rxPowerDbm,
-                      uint8_t sf,
-                      Time duration,
-                      double frequencyMHz) override;
+    using LoraPhy::StartReceive;
+
+    void StartReceive(Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                      double rxPowerDbm) override;
 
     void EndReceive(Ptr<Packet> packet, Ptr<LoraInterferenceHelper::Event> event) override;
 
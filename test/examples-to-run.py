@@ -11,10 +11,23 @@ cpp_examples = [
     ("network-server-example", "True", "True"),
     ("complete-network-example", "True", "True"),
     ("adr-example", "True", "True"),
+    ("adr-example --AdrPeriod=10min", "True", "True"),
     ("lorawan-energy-model-example", "True", "True"),
     ("aloha-throughput", "True", "True"),
     ("parallel-reception-example", "True", "True"),
     ("frame-counter-update", "True", "True"),
+    ("interference-helper-benchmark --simTime=1 --eventsPerSecond=1000", "True", "False"),
+    ("packet-tracker-benchmark --nPackets=1000", "True", "False"),
+    ("network-status-benchmark --nUplinks=1000 --maxDevices=1000", "True", "False"),
+    ("adr-benchmark --nDevices=100 --nRounds=25", "True", "False"),
+    ("lorawan-bench --scale=0.01 --repetitions=1", "True", "False"),
+    ("scalability-benchmark --nDevices=100 --simulationTime=600", "True", "False"),
+    ("hybrid-background-example --nDevices=2000 --simulationTime=60", "True", "False"),
+    (
+        "partitioned-network-example --nDevices=200 --simulationTime=600",
+        "ENABLE_MPI == True",
+        "False",
+    ),
 ]
 
 # A list of Python examples to run in order to ensure that they remain
@@ -18,13 +18,20 @@
  */
 
 // Include headers of classes to test
+#include "ns3/aggregate-interference-source.h"
+#include "ns3/boolean.h"
 #include "ns3/constant-position-mobility-model.h"
+#include "ns3/double.h"
 #include "ns3/log.h"
 #include "ns3/lora-helper.h"
+#include "ns3/lora-packet-tracker.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/one-shot-sender-helper.h"
+#include "ns3/random-variable-stream.h"
 #include "ns3/simple-end-device-lora-phy.h"
 #include "ns3/simple-gateway-lora-phy.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -34,6 +41,28 @@ using namespace lorawan;
 
 NS_LOG_COMPONENT_DEFINE("LorawanTestSuite");
 
+/**
+ * Register a transmission heard by a single device in an interference helper.
+ *
+ * \param helper The interference helper.
+ * \param duration The duration of the transmission.
+ * \param rxPower The power the transmission is received with [dBm].
+ * \param sf The spreading factor of the transmission.
+ * \param frequencyMHz The frequency of the transmission.
+ * \return The event created in the helper.
+ */
+Ptr<LoraInterferenceHelper::Event>
+AddTransmission(LoraInterferenceHelper& helper,
+                Time duration,
+                double rxPower,
+                uint8_t sf,
+                double frequencyMHz)
+{
+    return helper.Add(
+        Create<LoraInterferenceHelper::Transmission>(duration, sf, nullptr, frequencyMHz),
+        rxPower);
+}
+
 /**
  * \ingroup lorawan
  *
@@ -77,29 +106,29 @@ InterferenceTest::DoRun()
     Ptr<LoraInterferenceHelper::Event> event1;
 
     // Test overlap duration
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    event1 = interferenceHelper.Add(Seconds(1), 14, 12, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    event1 = AddTransmission(interferenceHelper, Seconds(1), 14, 12, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.GetOverlapTime(event, event1),
                           Seconds(1),
                           "Overlap computation didn't give the expected result");
     interferenceHelper.ClearAllEvents();
 
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    event1 = interferenceHelper.Add(Seconds(1.5), 14, 12, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    event1 = AddTransmission(interferenceHelper, Seconds(1.5), 14, 12, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.GetOverlapTime(event, event1),
                           Seconds(1.5),
                           "Overlap computation didn't give the expected result");
     interferenceHelper.ClearAllEvents();
 
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    event1 = interferenceHelper.Add(Seconds(3), 14, 12, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    event1 = AddTransmission(interferenceHelper, Seconds(3), 14, 12, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.GetOverlapTime(event, event1),
                           Seconds(2),
                           "Overlap computation didn't give the expected result");
     interferenceHelper.ClearAllEvents();
 
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    event1 = interferenceHelper.Add(Seconds(2), 14, 12, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    event1 = AddTransmission(interferenceHelper, Seconds(2), 14, 12, frequency);
     // Because of some strange behavior, this test would get stuck if we used the same syntax of the
     // previous ones. This works instead.
     bool retval = interferenceHelper.GetOverlapTime(event, event1) == Seconds(2);
@@ -107,32 +136,32 @@ InterferenceTest::DoRun()
     interferenceHelper.ClearAllEvents();
 
     // Perfect overlap, packet survives
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14, 12, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14, 12, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
     interferenceHelper.ClearAllEvents();
 
     // Perfect overlap, packet survives
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 - 7, 7, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 - 7, 7, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
     interferenceHelper.ClearAllEvents();
 
     // Perfect overlap, packet destroyed
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 - 6, 7, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 - 6, 7, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           7,
                           "Packet was not destroyed by interference as expected");
     interferenceHelper.ClearAllEvents();
 
     // Partial overlap, packet survives
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(1), 14 - 6, 7, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(1), 14 - 6, 7, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
@@ -141,8 +170,8 @@ InterferenceTest::DoRun()
     // Different frequencys
     // Packet would be destroyed if they were on the same frequency, but survives
     // since they are on different frequencies
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14, 7, nullptr, differentFrequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14, 7, differentFrequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
@@ -151,8 +180,8 @@ InterferenceTest::DoRun()
     // Different SFs
     // Packet would be destroyed if they both were SF7, but survives thanks to spreading factor
     // semi-orthogonality
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 8, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 8, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
@@ -160,16 +189,16 @@ InterferenceTest::DoRun()
 
     // Spreading factor imperfect orthogonality
     // Different SFs are orthogonal only up to a point
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 17, 8, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 17, 8, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           8,
                           "Packet was not destroyed by interference as expected");
     interferenceHelper.ClearAllEvents();
 
     // If a more 'distant' spreading factor is used, isolation gets better
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 17, 10, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 17, 10, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet was destroyed by interference while it should have survived");
@@ -177,10 +206,10 @@ InterferenceTest::DoRun()
 
     // Cumulative interference
     // Same spreading factor interference is cumulative
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 8, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 8, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 8, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 8, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 8, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 8, frequency);
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           8,
                           "Packet was not destroyed by interference as expected");
@@ -188,16 +217,216 @@ InterferenceTest::DoRun()
 
     // Cumulative interference
     // Interference is not cumulative between different SFs
-    event = interferenceHelper.Add(Seconds(2), 14, 7, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 8, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 9, nullptr, frequency);
-    interferenceHelper.Add(Seconds(2), 14 + 16, 10, nullptr, frequency);
+    event = AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 8, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 9, frequency);
+    AddTransmission(interferenceHelper, Seconds(2), 14 + 16, 10, frequency);
+    NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
+                          0,
+                          "Packet did not survive interference as expected");
+    interferenceHelper.ClearAllEvents();
+
+    // Event store
+    // Events on all frequencies are returned, sorted by start time
+    AddTransmission(interferenceHelper, Seconds(2), 14, 7, frequency);
+    AddTransmission(interferenceHelper, Seconds(1), 14, 8, differentFrequency);
+    AddTransmission(interferenceHelper, Seconds(3), 14, 9, frequency);
+    NS_TEST_EXPECT_MSG_EQ(interferenceHelper.GetInterferers().size(),
+                          3,
+                          "Not all registered events were returned");
+    interferenceHelper.ClearAllEvents();
+
+    // Shared transmissions
+    // Helpers registering the same transmission with different powers reach
+    // the outcome each power would give
+    LoraInterferenceHelper otherHelper;
+    Ptr<LoraInterferenceHelper::Transmission> transmission =
+        Create<LoraInterferenceHelper::Transmission>(Seconds(2), 7, nullptr, frequency);
+    event = interferenceHelper.Add(transmission, 14);
+    event1 = otherHelper.Add(transmission, 14 - 4);
+    AddTransmission(interferenceHelper, Seconds(2), 14 - 7, 7, frequency);
+    AddTransmission(otherHelper, Seconds(2), 14 - 7, 7, frequency);
+    NS_TEST_EXPECT_MSG_EQ((event->GetTransmission() == event1->GetTransmission()),
+                          true,
+                          "Events don't refer to the shared transmission");
+    NS_TEST_EXPECT_MSG_EQ(event1->GetDuration(),
+                          Seconds(2),
+                          "Event doesn't have the duration of its transmission");
     NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
                           0,
                           "Packet did not survive interference as expected");
+    NS_TEST_EXPECT_MSG_EQ(otherHelper.IsDestroyedByInterference(event1),
+                          7,
+                          "Packet was not destroyed by interference as expected");
+    interferenceHelper.ClearAllEvents();
+
+    // Interferers of long packets are not cleaned up before the packet ends,
+    // even if they ended more than the old event threshold ago
+    Simulator::Schedule(Seconds(0), [&]() {
+        event = AddTransmission(interferenceHelper, Seconds(10), 14, 12, frequency);
+    });
+    Simulator::Schedule(Seconds(0.5), [&]() {
+        AddTransmission(interferenceHelper, Seconds(0.5), 14 + 10, 12, frequency);
+    });
+    Simulator::Schedule(Seconds(10), [&]() {
+        for (int i = 0; i < 200; i++)
+        {
+            AddTransmission(interferenceHelper, Seconds(1), 14, 7, frequency);
+        }
+        NS_TEST_EXPECT_MSG_EQ(interferenceHelper.IsDestroyedByInterference(event),
+                              12,
+                              "Packet was not destroyed by interference as expected");
+    });
+    Simulator::Run();
+    Simulator::Destroy();
     interferenceHelper.ClearAllEvents();
 }
 
+/**
+ * \ingroup lorawan
+ *
+ * It checks that the outcomes computed by LoraInterferenceHelper on a random
+ * trace of signals are the same as the ones obtained by summing the
+ * interference energy of each event and comparing the SNIR in dB to the
+ * collision matrix
+ */
+class InterferenceOutcomeTest : public TestCase
+{
+  public:
+    InterferenceOutcomeTest();           //!< Default constructor
+    ~InterferenceOutcomeTest() override; //!< Destructor
+
+    /**
+     * Compute the outcome of an event by scanning all the interferers registered in the helper.
+     *
+     * \param helper The interference helper the event was added to.
+     * \param event The event for which to check the outcome.
+     * \param collisionSnir The collision matrix in use.
+     * \return The sf of the packets that caused the loss, or 0 if there was no loss.
+     */
+    static uint8_t GetReferenceOutcome(LoraInterferenceHelper& helper,
+                                       Ptr<LoraInterferenceHelper::Event> event,
+                                       const std::vector<std::vector<double>>& collisionSnir);
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Replay a random trace of signals, and compare the outcome of each packet
+     * with the reference computation.
+     *
+     * \param collisionMatrix The collision matrix to use.
+     */
+    void ReplayTrace(LoraInterferenceHelper::CollisionMatrix collisionMatrix);
+};
+
+InterferenceOutcomeTest::InterferenceOutcomeTest()
+    : TestCase("Verify that LoraInterferenceHelper outcomes match the reference SNIR computation")
+{
+}
+
+InterferenceOutcomeTest::~InterferenceOutcomeTest()
+{
+}
+
+uint8_t
+InterferenceOutcomeTest::GetReferenceOutcome(
+    LoraInterferenceHelper& helper,
+    Ptr<LoraInterferenceHelper::Event> event,
+    const std::vector<std::vector<double>>& collisionSnir)
+{
+    std::vector<double> cumulativeInterferenceEnergy(6, 0);
+    for (const auto& interferer : helper.GetInterferers())
+    {
+        if (!(interferer->GetFrequency() == event->GetFrequency()) || interferer == event)
+        {
+            continue;
+        }
+        Time overlap = helper.GetOverlapTime(event, interferer);
+        double interfererPowerW = pow(10, interferer->GetRxPowerdBm() / 10) / 1000;
+        cumulativeInterferenceEnergy.at(unsigned(interferer->GetSpreadingFactor()) - 7) +=
+            overlap.GetSeconds() * interfererPowerW;
+    }
+
+    for (auto currentSf = uint8_t(7); currentSf <= uint8_t(12); currentSf++)
+    {
+        double signalPowerW = pow(10, event->GetRxPowerdBm() / 10) / 1000;
+        double signalEnergy = event->GetDuration().GetSeconds() * signalPowerW;
+        double snirIsolation =
+            collisionSnir[unsigned(event->GetSpreadingFactor()) - 7][unsigned(currentSf) - 7];
+        double snir =
+            10 * log10(signalEnergy / cumulativeInterferenceEnergy.at(unsigned(currentSf) - 7));
+        if (snir < snirIsolation)
+        {
+            return currentSf;
+        }
+    }
+    return 0;
+}
+
+void
+InterferenceOutcomeTest::ReplayTrace(LoraInterferenceHelper::CollisionMatrix collisionMatrix)
+{
+    LoraInterferenceHelper::collisionMatrix = collisionMatrix;
+    LoraInterferenceHelper interferenceHelper;
+    const std::vector<std::vector<double>>& collisionSnir =
+        (collisionMatrix == LoraInterferenceHelper::ALOHA)
+            ? LoraInterferenceHelper::collisionSnirAloha
+            : LoraInterferenceHelper::collisionSnirGoursaud;
+
+    Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable>();
+    uniform->SetStream(1);
+
+    int packets = 0;
+    int destroyed = 0;
+    int mismatches = 0;
+
+    // Powers and durations are drawn from coarse grids, so that many SNIRs
+    // end up on the isolation thresholds of the collision matrix
+    Time start = Seconds(0);
+    for (int i = 0; i < 2000; i++)
+    {
+        start += MilliSeconds(uniform->GetInteger(0, 40));
+        Time duration = MilliSeconds(100 * uniform->GetInteger(1, 20));
+        double rxPower = -130 + uniform->GetInteger(0, 40);
+        auto sf = uint8_t(uniform->GetInteger(7, 12));
+        double frequency = (uniform->GetInteger(0, 1) == 0) ? 868.1 : 868.3;
+
+        Simulator::Schedule(start, [&, duration, rxPower, sf, frequency]() {
+            Ptr<LoraInterferenceHelper::Event> event =
+                AddTransmission(interferenceHelper, duration, rxPower, sf, frequency);
+            Simulator::Schedule(duration, [&, event]() {
+                uint8_t outcome = interferenceHelper.IsDestroyedByInterference(event);
+                packets++;
+                destroyed += (outcome != 0);
+                mismatches +=
+                    (outcome != GetReferenceOutcome(interferenceHelper, event, collisionSnir));
+            });
+        });
+    }
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(packets, 2000, "Not all packets were checked");
+    NS_TEST_EXPECT_MSG_GT(destroyed, 0, "No packet was destroyed by interference");
+    NS_TEST_EXPECT_MSG_LT(destroyed, packets, "No packet survived interference");
+    NS_TEST_EXPECT_MSG_EQ(mismatches, 0, "Outcomes differ from the reference computation");
+}
+
+void
+InterferenceOutcomeTest::DoRun()
+{
+    NS_LOG_DEBUG("InterferenceOutcomeTest");
+
+    LoraInterferenceHelper::CollisionMatrix defaultCollisionMatrix =
+        LoraInterferenceHelper::collisionMatrix;
+
+    ReplayTrace(LoraInterferenceHelper::GOURSAUD);
+    ReplayTrace(LoraInterferenceHelper::ALOHA);
+
+    LoraInterferenceHelper::collisionMatrix = defaultCollisionMatrix;
+}
+
 /**
  * \ingroup lorawan
  *
@@ -1106,6 +1335,78 @@ TimeOnAirTest::DoRun()
     NS_TEST_EXPECT_MSG_EQ_TOL(duration.GetSeconds(), 2.301952, 0.0001, "Unexpected duration");
 }
 
+/**
+ * \ingroup lorawan
+ *
+ * It checks that every entry of the table used by LoraPhy::GetOnAirTime matches the time on air
+ * computed from the formula
+ */
+class TimeOnAirTableTest : public TestCase
+{
+  public:
+    TimeOnAirTableTest();           //!< Default constructor
+    ~TimeOnAirTableTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+};
+
+// Add some help text to this case to describe what it is intended to test
+TimeOnAirTableTest::TimeOnAirTableTest()
+    : TestCase("Verify that the table of times on air matches the formula it caches")
+{
+}
+
+// Reminder that the test case should clean up after itself
+TimeOnAirTableTest::~TimeOnAirTableTest()
+{
+}
+
+// This method is the pure virtual method from class TestCase that every
+// TestCase must implement
+void
+TimeOnAirTableTest::DoRun()
+{
+    NS_LOG_DEBUG("TimeOnAirTableTest");
+
+    LoraTxParameters txParams;
+    txParams.nPreamble = 8;
+    for (txParams.sf = 7; txParams.sf <= 12; txParams.sf++)
+    {
+        for (double bandwidthHz : {125000, 250000, 500000})
+        {
+            txParams.bandwidthHz = bandwidthHz;
+            for (txParams.codingRate = 1; txParams.codingRate <= 4; txParams.codingRate++)
+            {
+                for (int flags = 0; flags < 8; flags++)
+                {
+                    txParams.headerDisabled = flags & 4;
+                    txParams.crcEnabled = flags & 2;
+                    txParams.lowDataRateOptimizationEnabled = flags & 1;
+                    for (uint32_t size = 0; size < 256; size++)
+                    {
+                        Time expected = LoraPhy::ComputeOnAirTime(size, txParams);
+
+                        // The first lookup fills the entry, the second one reads it
+                        NS_TEST_ASSERT_MSG_EQ(LoraPhy::GetOnAirTime(size, txParams),
+                                              expected,
+                                              "Table entry differs from the formula");
+                        NS_TEST_ASSERT_MSG_EQ(LoraPhy::GetOnAirTime(size, txParams),
+                                              expected,
+                                              "Table entry differs from the formula");
+                    }
+                }
+            }
+        }
+    }
+
+    // Transmissions outside of the table are still computed from the formula
+    txParams.nPreamble = 10;
+    NS_TEST_EXPECT_MSG_EQ(LoraPhy::GetOnAirTime(Create<Packet>(300), txParams),
+                          LoraPhy::ComputeOnAirTime(300, txParams),
+                          "Unexpected duration");
+}
+
 /**
  * \ingroup lorawan
  *
@@ -1576,6 +1877,961 @@ PhyConnectivityTest::DoRun()
     NS_TEST_EXPECT_MSG_EQ(edPhy2->GetState(),
                           SimpleEndDeviceLoraPhy::STANDBY,
                           "State didn't switch to STANDBY as expected");
+
+    Reset();
+
+    // Listening fan-out
+    ////////////////////
+
+    // PHYs that are asleep or on another frequency are not reached at all
+
+    txParams.sf = 12;
+    channel->SetAttribute("ListeningFanOut", BooleanValue(true));
+    edPhy2->SwitchToSleep();
+    edPhy3->SetFrequency(868.3);
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls, 0, "Packet was received by a PHY in SLEEP mode");
+    NS_TEST_EXPECT_MSG_EQ(m_wrongFrequencyCalls,
+                          0,
+                          "Packet was delivered to a PHY listening on a different frequency");
+
+    // PHYs waking up are reached again
+
+    edPhy2->SwitchToStandby();
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          1,
+                          "Packet was not received by a PHY that went back to STANDBY");
+
+    // Removing a PHY keeps the PHYs after it reachable
+
+    channel->Remove(edPhy2);
+    edPhy3->SetFrequency(868.1);
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          2,
+                          "Packet was not received by a PHY after another one was removed");
+
+    // Link budget cache
+    ////////////////////
+
+    Reset();
+
+    channel->SetAttribute("LinkBudgetCache", BooleanValue(true));
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    // Moving a PHY drops its entries from the cache
+    Simulator::Schedule(Seconds(10), [&]() {
+        NS_TEST_EXPECT_MSG_EQ(channel->GetLinkBudgetCacheSize(),
+                              2,
+                              "The link budget towards the receivers was not cached");
+        edPhy3->GetMobility()->SetPosition(Vector(100000.0, 0.0, 0.0));
+        NS_TEST_EXPECT_MSG_EQ(channel->GetLinkBudgetCacheSize(),
+                              1,
+                              "The link budget of a moving PHY was not dropped");
+    });
+
+    Simulator::Schedule(Seconds(20),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          3,
+                          "Packets were not received as expected with the link budget cache");
+    NS_TEST_EXPECT_MSG_EQ(m_underSensitivityCalls,
+                          1,
+                          "A cached link budget was used after the receiver moved");
+
+    // Pairs below the floor are only marked as out of reach
+
+    Reset();
+
+    // edPhy2 receives at about -31 dBm, edPhy3 at about -43 dBm
+    channel->SetAttribute("LinkBudgetCache", BooleanValue(true));
+    channel->SetAttribute("LinkBudgetCacheFloor", DoubleValue(-40));
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Schedule(Seconds(20),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(channel->GetLinkBudgetCacheSize(),
+                          1,
+                          "A pair below the floor was stored with its reception power");
+    NS_TEST_EXPECT_MSG_EQ(channel->GetNBelowInterferenceFloor(),
+                          2,
+                          "Transmissions to a pair below the floor were not dropped");
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          2,
+                          "Packets were not received above the link budget cache floor");
+
+    // Interference floor
+    /////////////////////
+
+    Reset();
+
+    // edPhy2 receives at about -31 dBm, edPhy3 at about -43 dBm
+    channel->SetAttribute("InterferenceFloor", DoubleValue(-40));
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+
+    NS_TEST_EXPECT_MSG_EQ(channel->GetNBelowInterferenceFloor(),
+                          1,
+                          "The reception below the interference floor was not dropped");
+
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          1,
+                          "Only the PHY above the interference floor should receive the packet");
+
+    // Spatial index
+    ////////////////
+
+    Reset();
+
+    // The interference floor is reached at about 17 m, so that edPhy3 is
+    // outside of the cells that are visited
+    channel->SetAttribute("InterferenceFloor", DoubleValue(-40));
+    channel->SetAttribute("SpatialIndex", BooleanValue(true));
+    channel->SetAttribute("SpatialIndexCellSize", DoubleValue(5));
+
+    Simulator::Schedule(Seconds(2),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    // Moving a PHY moves it to another cell
+    Simulator::Schedule(Seconds(10), [&]() {
+        NS_TEST_EXPECT_MSG_EQ(channel->GetNBelowInterferenceFloor(),
+                              0,
+                              "A PHY out of range was not skipped by the spatial index");
+        edPhy3->GetMobility()->SetPosition(Vector(5.0, 0.0, 0.0));
+    });
+
+    Simulator::Schedule(Seconds(20),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        edPhy1,
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+
+    Simulator::Stop(Hours(2));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          3,
+                          "Packets were not received as expected with the spatial index");
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It checks that computing the propagation of a transmission on multiple
+ * threads gives the same outcomes as the serial computation in LoraChannel
+ */
+class ParallelPropagationTest : public TestCase
+{
+  public:
+    ParallelPropagationTest();           //!< Default constructor
+    ~ParallelPropagationTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Send a packet from an end device to a line of end devices at increasing
+     * distance, and record which ones receive it.
+     *
+     * \param propagationThreads The number of threads computing the propagation.
+     * \param random Whether to add a random loss model after the position-only one.
+     * \return For each receiver, whether the packet was received.
+     */
+    std::vector<bool> SendToLine(uint32_t propagationThreads, bool random);
+
+    /**
+     * Callback for tracing ReceivedPacket.
+     *
+     * \param received The reception record to update.
+     * \param i The index of the receiver.
+     * \param packet The packet received.
+     * \param node The receiver node id if any, 0 otherwise.
+     */
+    static void ReceivedPacket(std::vector<bool>* received,
+                               uint32_t i,
+                               Ptr<const Packet> packet,
+                               uint32_t node);
+};
+
+ParallelPropagationTest::ParallelPropagationTest()
+    : TestCase("Verify that parallel propagation in LoraChannel matches the serial computation")
+{
+}
+
+ParallelPropagationTest::~ParallelPropagationTest()
+{
+}
+
+void
+ParallelPropagationTest::ReceivedPacket(std::vector<bool>* received,
+                                        uint32_t i,
+                                        Ptr<const Packet> packet,
+                                        uint32_t node)
+{
+    (*received)[i] = true;
+}
+
+std::vector<bool>
+ParallelPropagationTest::SendToLine(uint32_t propagationThreads, bool random)
+{
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+    if (random)
+    {
+        // The same stream is used in both runs, so that the draws are the same
+        Ptr<RandomPropagationLossModel> randomLoss = CreateObject<RandomPropagationLossModel>();
+        randomLoss->SetAttribute("Variable",
+                                 StringValue("ns3::UniformRandomVariable[Min=0.0|Max=20.0]"));
+        loss->SetNext(randomLoss);
+        loss->AssignStreams(1);
+    }
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+    channel->SetAttribute("PropagationThreads", UintegerValue(propagationThreads));
+
+    const uint32_t nReceivers = 200;
+    std::vector<bool> received(nReceivers, false);
+    std::vector<Ptr<SimpleEndDeviceLoraPhy>> phys;
+    for (uint32_t i = 0; i <= nReceivers; i++)
+    {
+        Ptr<SimpleEndDeviceLoraPhy> phy = CreateObject<SimpleEndDeviceLoraPhy>();
+        Ptr<ConstantPositionMobilityModel> mobility =
+            CreateObject<ConstantPositionMobilityModel>();
+        mobility->SetPosition(Vector(100.0 * i, 0.0, 0.0));
+        phy->SetMobility(mobility);
+        phy->SetFrequency(868.1);
+        phy->SetSpreadingFactor(12);
+        phy->SwitchToStandby();
+        phy->SetChannel(channel);
+        channel->Add(phy);
+        if (i > 0)
+        {
+            phy->TraceConnectWithoutContext(
+                "ReceivedPacket",
+                MakeBoundCallback(&ParallelPropagationTest::ReceivedPacket, &received, i - 1));
+        }
+        phys.push_back(phy);
+    }
+
+    LoraTxParameters txParams;
+    txParams.sf = 12;
+    Simulator::Schedule(Seconds(1),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        phys[0],
+                        Create<Packet>(10),
+                        txParams,
+                        868.1,
+                        14);
+    Simulator::Run();
+    Simulator::Destroy();
+
+    return received;
+}
+
+void
+ParallelPropagationTest::DoRun()
+{
+    NS_LOG_DEBUG("ParallelPropagationTest");
+
+    // Only models that depend on the node positions are thread-safe
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    Ptr<LoraChannel> channel =
+        CreateObject<LoraChannel>(loss, CreateObject<ConstantSpeedPropagationDelayModel>());
+    NS_TEST_EXPECT_MSG_EQ(channel->IsPropagationThreadSafe(),
+                          true,
+                          "The log-distance model should be thread-safe");
+    loss->SetNext(CreateObject<RandomPropagationLossModel>());
+    NS_TEST_EXPECT_MSG_EQ(channel->IsPropagationThreadSafe(),
+                          false,
+                          "A random loss model should not be thread-safe");
+
+    std::vector<bool> serial = SendToLine(1, false);
+    std::vector<bool> parallel = SendToLine(4, false);
+
+    uint32_t nReceived = std::count(serial.begin(), serial.end(), true);
+    NS_TEST_EXPECT_MSG_GT(nReceived, 0, "No receiver got the packet");
+    NS_TEST_EXPECT_MSG_LT(nReceived, serial.size(), "All receivers got the packet");
+    NS_TEST_EXPECT_MSG_EQ((serial == parallel),
+                          true,
+                          "Parallel propagation changed the outcome at some receivers");
+
+    // Random models after the position-only ones are applied serially, and
+    // draw the same values as in a serial run
+    serial = SendToLine(1, true);
+    parallel = SendToLine(4, true);
+
+    NS_TEST_EXPECT_MSG_EQ((serial == parallel),
+                          true,
+                          "Parallel propagation changed the outcome of a random loss model");
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It checks that the counters of LoraPacketTracker give the same counts as the
+ * packet records, with and without retaining the records, including for
+ * packets sent on the boundaries of the counting intervals
+ */
+class PacketTrackerTest : public TestCase
+{
+  public:
+    PacketTrackerTest();           //!< Default constructor
+    ~PacketTrackerTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Schedule calls to the trace sinks of a tracker for a sequence of uplinks.
+     *
+     * \param tracker The tracker to feed.
+     * \param firstSendTime The time the first uplink is sent.
+     */
+    void Feed(LoraPacketTracker& tracker, Time firstSendTime);
+};
+
+// Add some help text to this case to describe what it is intended to test
+PacketTrackerTest::PacketTrackerTest()
+    : TestCase("Verify that LoraPacketTracker counts packets per time bucket correctly")
+{
+}
+
+// Reminder that the test case should clean up after itself
+PacketTrackerTest::~PacketTrackerTest()
+{
+}
+
+void
+PacketTrackerTest::Feed(LoraPacketTracker& tracker, Time firstSendTime)
+{
+    // An uplink every 0.5 s, interfered or received at gateway 100 and under
+    // sensitivity at gateway 101, and acknowledged two times out of three
+    for (int i = 0; i < 200; i++)
+    {
+        Ptr<Packet> packet = Create<Packet>(10);
+        LoraFrameHeader frameHdr;
+        packet->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        packet->AddHeader(macHdr);
+
+        Time sendTime = firstSendTime + Seconds(0.5 * i);
+        Simulator::Schedule(sendTime,
+                            &LoraPacketTracker::MacTransmissionCallback,
+                            &tracker,
+                            packet);
+        Simulator::Schedule(sendTime,
+                            &LoraPacketTracker::TransmissionCallback,
+                            &tracker,
+                            packet,
+                            1);
+        Simulator::Schedule(sendTime + Seconds(1.5),
+                            i % 2 ? &LoraPacketTracker::PacketReceptionCallback
+                                  : &LoraPacketTracker::InterferenceCallback,
+                            &tracker,
+                            packet,
+                            100);
+        Simulator::Schedule(sendTime + Seconds(1.5),
+                            &LoraPacketTracker::UnderSensitivityCallback,
+                            &tracker,
+                            packet,
+                            101);
+        if (i % 2)
+        {
+            Simulator::Schedule(sendTime + Seconds(1.6),
+                                &LoraPacketTracker::MacGwReceptionCallback,
+                                &tracker,
+                                packet);
+        }
+        Simulator::Schedule(sendTime + Seconds(3),
+                            &LoraPacketTracker::RequiredTransmissionsCallback,
+                            &tracker,
+                            uint8_t(1),
+                            i % 3 != 0,
+                            sendTime,
+                            packet);
+    }
+}
+
+void
+PacketTrackerTest::DoRun()
+{
+    NS_LOG_DEBUG("PacketTrackerTest");
+
+    LoraPacketTracker tracker;
+    Feed(tracker, Seconds(0.25));
+    LoraPacketTracker aggregated;
+    aggregated.EnableAggregation(Seconds(10));
+    Feed(aggregated, Seconds(0.25));
+    LoraPacketTracker streaming;
+    streaming.EnableAggregation(Seconds(10), false, Seconds(30));
+    Feed(streaming, Seconds(0.25));
+
+    Simulator::Run();
+    Simulator::Destroy();
+
+    // Bucket-aligned windows, and one that needs the records
+    std::vector<std::pair<Time, Time>> windows = {{Seconds(0), Seconds(10)},
+                                                  {Seconds(10), Seconds(50)},
+                                                  {Seconds(0), Seconds(200)},
+                                                  {Seconds(30), Seconds(30)}};
+    for (const auto& window : windows)
+    {
+        for (int gwId : {100, 101, 102})
+        {
+            std::vector<int> expected =
+                tracker.CountPhyPacketsPerGw(window.first, window.second, gwId);
+            NS_TEST_EXPECT_MSG_EQ(
+                (aggregated.CountPhyPacketsPerGw(window.first, window.second, gwId) == expected),
+                true,
+                "The counters gave wrong PHY counts");
+            NS_TEST_EXPECT_MSG_EQ(
+                (streaming.CountPhyPacketsPerGw(window.first, window.second, gwId) == expected),
+                true,
+                "The counters gave wrong PHY counts without records");
+        }
+        std::string expected = tracker.CountMacPacketsGlobally(window.first, window.second);
+        NS_TEST_EXPECT_MSG_EQ(aggregated.CountMacPacketsGlobally(window.first, window.second),
+                              expected,
+                              "The counters gave wrong MAC counts");
+        NS_TEST_EXPECT_MSG_EQ(streaming.CountMacPacketsGlobally(window.first, window.second),
+                              expected,
+                              "The counters gave wrong MAC counts without records");
+        expected = tracker.CountMacPacketsGloballyCpsr(window.first, window.second);
+        NS_TEST_EXPECT_MSG_EQ(aggregated.CountMacPacketsGloballyCpsr(window.first, window.second),
+                              expected,
+                              "The counters gave wrong retransmission counts");
+        NS_TEST_EXPECT_MSG_EQ(streaming.CountMacPacketsGloballyCpsr(window.first, window.second),
+                              expected,
+                              "The counters gave wrong retransmission counts without records");
+    }
+
+    NS_TEST_EXPECT_MSG_EQ((aggregated.CountPhyPacketsPerGw(Seconds(5), Seconds(45), 100) ==
+                           tracker.CountPhyPacketsPerGw(Seconds(5), Seconds(45), 100)),
+                          true,
+                          "An unaligned window was not counted from the records");
+
+    std::ostringstream metrics;
+    aggregated.PrintMetrics(metrics, Seconds(0), Seconds(200));
+    NS_TEST_EXPECT_MSG_EQ(metrics.str(),
+                          "macSent 200\nmacReceived 100\nmacPdr 0.5\ncpsrSent 200\n"
+                          "cpsrSuccesses 133\n",
+                          "The metrics were not printed correctly");
+    NS_TEST_EXPECT_MSG_LT(streaming.GetMemoryUsage(),
+                          tracker.GetMemoryUsage(),
+                          "Records were retained");
+
+    // Uplinks sent on the bucket boundaries must be counted in the interval
+    // they start, both from the records and from the counters
+    LoraPacketTracker boundaryTracker;
+    Feed(boundaryTracker, Seconds(0));
+    LoraPacketTracker boundaryAggregated;
+    boundaryAggregated.EnableAggregation(Seconds(10));
+    Feed(boundaryAggregated, Seconds(0));
+
+    Simulator::Run();
+    Simulator::Destroy();
+
+    for (const auto& window : windows)
+    {
+        NS_TEST_EXPECT_MSG_EQ(
+            (boundaryAggregated.CountPhyPacketsPerGw(window.first, window.second, 100) ==
+             boundaryTracker.CountPhyPacketsPerGw(window.first, window.second, 100)),
+            true,
+            "The counters and the records disagree on the interval boundaries");
+        NS_TEST_EXPECT_MSG_EQ(
+            boundaryAggregated.CountMacPacketsGlobally(window.first, window.second),
+            boundaryTracker.CountMacPacketsGlobally(window.first, window.second),
+            "The counters and the records disagree on the interval boundaries");
+        NS_TEST_EXPECT_MSG_EQ(
+            boundaryAggregated.CountMacPacketsGloballyCpsr(window.first, window.second),
+            boundaryTracker.CountMacPacketsGloballyCpsr(window.first, window.second),
+            "The counters and the records disagree on the interval boundaries");
+    }
+    NS_TEST_EXPECT_MSG_EQ(boundaryTracker.CountPhyPacketsPerGw(Seconds(0), Seconds(10), 100).at(0),
+                          20,
+                          "The uplink sent at the end of the interval was counted");
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It checks that AggregateInterferenceSource injects transmissions at the rate
+ * of its population, and that they interfere with the receptions of gateways
+ */
+class AggregateInterferenceTest : public TestCase
+{
+  public:
+    AggregateInterferenceTest();           //!< Default constructor
+    ~AggregateInterferenceTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+    /**
+     * Callback for tracing ReceivedPacket.
+     *
+     * \param packet The packet received.
+     * \param node The receiver node id if any, 0 otherwise.
+     */
+    void ReceivedPacket(Ptr<const Packet> packet, uint32_t node);
+    /**
+     * Callback for tracing LostPacketBecauseInterference.
+     *
+     * \param packet The packet lost.
+     * \param node The receiver node id if any, 0 otherwise.
+     */
+    void Interference(Ptr<const Packet> packet, uint32_t node);
+
+    int m_receivedPacketCalls = 0; //!< Counter for ReceivedPacket calls
+    int m_interferenceCalls = 0;   //!< Counter for LostPacketBecauseInterference calls
+};
+
+// Add some help text to this case to describe what it is intended to test
+AggregateInterferenceTest::AggregateInterferenceTest()
+    : TestCase("Verify that AggregateInterferenceSource interferes with gateway receptions")
+{
+}
+
+// Reminder that the test case should clean up after itself
+AggregateInterferenceTest::~AggregateInterferenceTest()
+{
+}
+
+void
+AggregateInterferenceTest::ReceivedPacket(Ptr<const Packet> packet, uint32_t node)
+{
+    NS_LOG_FUNCTION(packet << node);
+
+    m_receivedPacketCalls++;
+}
+
+void
+AggregateInterferenceTest::Interference(Ptr<const Packet> packet, uint32_t node)
+{
+    NS_LOG_FUNCTION(packet << node);
+
+    m_interferenceCalls++;
+}
+
+void
+AggregateInterferenceTest::DoRun()
+{
+    NS_LOG_DEBUG("AggregateInterferenceTest");
+
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+    Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel>();
+    Ptr<LoraChannel> channel = CreateObject<LoraChannel>(loss, delay);
+
+    NodeContainer gateways;
+    gateways.Create(1);
+    MobilityHelper mobility;
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    mobility.Install(gateways);
+    LoraPhyHelper phyHelper;
+    phyHelper.SetChannel(channel);
+    phyHelper.SetDeviceType(LoraPhyHelper::GW);
+    LorawanMacHelper macHelper;
+    macHelper.SetDeviceType(LorawanMacHelper::GW);
+    LoraHelper helper;
+    helper.Install(phyHelper, macHelper, gateways);
+    Ptr<LoraPhy> gatewayPhy = gateways.Get(0)->GetDevice(0)->GetObject<LoraNetDevice>()->GetPhy();
+
+    gatewayPhy->TraceConnectWithoutContext(
+        "ReceivedPacket",
+        MakeCallback(&AggregateInterferenceTest::ReceivedPacket, this));
+    gatewayPhy->TraceConnectWithoutContext(
+        "LostPacketBecauseInterference",
+        MakeCallback(&AggregateInterferenceTest::Interference, this));
+
+    // All background devices are 1 km away from the gateway, using SF7 on
+    // 868.1 MHz, and send 1000 packets per second in total
+    Ptr<ListPositionAllocator> allocator = CreateObject<ListPositionAllocator>();
+    allocator->Add(Vector(1000, 0, 0));
+    Ptr<AggregateInterferenceSource> source = CreateObject<AggregateInterferenceSource>();
+    source->SetAttribute("NDevices", UintegerValue(600000));
+    source->SetAttribute("Period", TimeValue(Seconds(600)));
+    source->SetPositionAllocator(allocator);
+    source->SetFrequencies({868.1});
+    source->Install(channel, gateways);
+    source->AssignStreams(0);
+    source->Start(Seconds(0));
+    source->Stop(Seconds(10));
+
+    // A packet 10 dB weaker than the background is lost while the source is
+    // active, and received once it has stopped
+    Ptr<ConstantPositionMobilityModel> position = CreateObject<ConstantPositionMobilityModel>();
+    position->SetPosition(Vector(1000, 0, 0));
+    double rxPower = channel->GetRxPower(14, position, gatewayPhy->GetMobility()) - 10;
+    LoraTxParameters txParams;
+    txParams.sf = 7;
+    Ptr<Packet> packet = Create<Packet>(10);
+    // A downlink header keeps the gateway MAC from forwarding the packet to
+    // the network server, which doesn't exist
+    LorawanMacHeader macHdr;
+    macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_DOWN);
+    packet->AddHeader(macHdr);
+    Time duration = LoraPhy::GetOnAirTime(packet, txParams);
+    for (Time start : {Seconds(5), Seconds(20)})
+    {
+        Simulator::Schedule(start, [=]() {
+            gatewayPhy->StartReceive(
+                Create<LoraInterferenceHelper::Transmission>(duration, 7, packet->Copy(), 868.1),
+                rxPower);
+        });
+    }
+
+    Simulator::Stop(Seconds(30));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ_TOL(double(source->GetTransmissionCount()),
+                              10000,
+                              500,
+                              "The source didn't transmit at the rate of its population");
+    NS_TEST_EXPECT_MSG_EQ(m_interferenceCalls,
+                          1,
+                          "The background didn't interfere with the packet");
+    NS_TEST_EXPECT_MSG_EQ(m_receivedPacketCalls,
+                          1,
+                          "The packet sent after the background was lost");
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It checks that a LoraChannel split across processes delivers local transmissions to the local
+ * PHYs and forwards them once to each other process, and that transmissions coming from another
+ * process are only delivered locally
+ */
+class PartitionedChannelTest : public TestCase
+{
+  public:
+    PartitionedChannelTest();           //!< Default constructor
+    ~PartitionedChannelTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+
+    /**
+     * A transmission forwarded through the remote send callback.
+     */
+    struct RemoteSend
+    {
+        uint32_t systemId;                                            //!< The destination process
+        Ptr<const LoraInterferenceHelper::Transmission> transmission; //!< The transmission
+        double txPowerDbm;                                            //!< The transmission power
+        Vector senderPosition;                                        //!< The sender position
+    };
+
+    /**
+     * Record a transmission forwarded to another process.
+     *
+     * \param sends The records to update.
+     * \param systemId The system id of the destination process.
+     * \param transmission The transmission.
+     * \param txPowerDbm The power of the transmission.
+     * \param senderPosition The position of the sender.
+     */
+    static void Forward(std::vector<RemoteSend>* sends,
+                        uint32_t systemId,
+                        Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                        double txPowerDbm,
+                        Vector senderPosition);
+
+    /**
+     * Callback for tracing ReceivedPacket.
+     *
+     * \param received The reception counts to update.
+     * \param i The index of the receiver.
+     * \param packet The packet received.
+     * \param node The receiver node id if any, 0 otherwise.
+     */
+    static void ReceivedPacket(std::vector<uint32_t>* received,
+                               uint32_t i,
+                               Ptr<const Packet> packet,
+                               uint32_t node);
+};
+
+PartitionedChannelTest::PartitionedChannelTest()
+    : TestCase("Verify that LoraChannel delivers and forwards transmissions across processes")
+{
+}
+
+PartitionedChannelTest::~PartitionedChannelTest()
+{
+}
+
+void
+PartitionedChannelTest::Forward(std::vector<RemoteSend>* sends,
+                                uint32_t systemId,
+                                Ptr<const LoraInterferenceHelper::Transmission> transmission,
+                                double txPowerDbm,
+                                Vector senderPosition)
+{
+    sends->push_back({systemId, transmission, txPowerDbm, senderPosition});
+}
+
+void
+PartitionedChannelTest::ReceivedPacket(std::vector<uint32_t>* received,
+                                       uint32_t i,
+                                       Ptr<const Packet> packet,
+                                       uint32_t node)
+{
+    (*received)[i]++;
+}
+
+void
+PartitionedChannelTest::DoRun()
+{
+    NS_LOG_DEBUG("PartitionedChannelTest");
+
+    Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel>();
+    loss->SetPathLossExponent(3.76);
+    loss->SetReference(1, 7.7);
+    Ptr<LoraChannel> channel =
+        CreateObject<LoraChannel>(loss, CreateObject<ConstantSpeedPropagationDelayModel>());
+
+    std::vector<RemoteSend> sends;
+    channel->SetRemoteSendCallback(0, MakeBoundCallback(&PartitionedChannelTest::Forward, &sends));
+
+    // A sender and a receiver simulated by this process (system 0), and two
+    // receivers simulated by the other ones
+    const std::vector<uint32_t> systemIds = {0, 0, 1, 2};
+    std::vector<uint32_t> received(systemIds.size(), 0);
+    std::vector<Ptr<SimpleEndDeviceLoraPhy>> phys;
+    for (uint32_t i = 0; i < systemIds.size(); i++)
+    {
+        Ptr<Node> node = CreateObject<Node>(systemIds[i]);
+        Ptr<LoraNetDevice> device = CreateObject<LoraNetDevice>();
+        node->AddDevice(device);
+
+        Ptr<SimpleEndDeviceLoraPhy> phy = CreateObject<SimpleEndDeviceLoraPhy>();
+        Ptr<ConstantPositionMobilityModel> mobility =
+            CreateObject<ConstantPositionMobilityModel>();
+        mobility->SetPosition(Vector(100.0 * i, 0.0, 0.0));
+        phy->SetMobility(mobility);
+        phy->SetDevice(device);
+        phy->SetFrequency(868.1);
+        phy->SetSpreadingFactor(12);
+        phy->SwitchToStandby();
+        phy->SetChannel(channel);
+        channel->Add(phy);
+        phy->TraceConnectWithoutContext(
+            "ReceivedPacket",
+            MakeBoundCallback(&PartitionedChannelTest::ReceivedPacket, &received, i));
+        phys.push_back(phy);
+    }
+
+    // A local transmission is delivered to the local receiver, and forwarded
+    // once to each of the other processes
+    LoraTxParameters txParams;
+    txParams.sf = 12;
+    Ptr<Packet> packet = Create<Packet>(10);
+    Simulator::Schedule(Seconds(1),
+                        &SimpleEndDeviceLoraPhy::Send,
+                        phys[0],
+                        packet,
+                        txParams,
+                        868.1,
+                        14);
+    Simulator::Stop(Seconds(5));
+    Simulator::Run();
+
+    NS_TEST_EXPECT_MSG_EQ(received[1], 1, "The local receiver didn't get the local packet");
+    NS_TEST_EXPECT_MSG_EQ(received[2] + received[3],
+                          0,
+                          "A receiver of another process got the local packet");
+    NS_TEST_ASSERT_MSG_EQ(sends.size(), 2, "The packet wasn't forwarded once to each process");
+    for (uint32_t k = 0; k < sends.size(); k++)
+    {
+        NS_TEST_EXPECT_MSG_EQ(sends[k].systemId, k + 1, "The packet was forwarded to no process");
+        NS_TEST_EXPECT_MSG_EQ(sends[k].transmission->GetPacket(),
+                              packet,
+                              "Another packet was forwarded");
+        NS_TEST_EXPECT_MSG_EQ(unsigned(sends[k].transmission->GetSpreadingFactor()),
+                              12,
+                              "The forwarded transmission has another spreading factor");
+        NS_TEST_EXPECT_MSG_EQ(sends[k].transmission->GetFrequency(),
+                              868.1,
+                              "The forwarded transmission has another frequency");
+        NS_TEST_EXPECT_MSG_EQ(sends[k].txPowerDbm, 14, "Another power was forwarded");
+        NS_TEST_EXPECT_MSG_EQ(sends[k].senderPosition,
+                              Vector(0, 0, 0),
+                              "Another sender position was forwarded");
+    }
+
+    // Transmissions of other processes are delivered to the local PHYs, from
+    // the position of their sender, and never forwarded again
+    Time duration = LoraPhy::GetOnAirTime(packet, txParams);
+    Simulator::Schedule(Seconds(10),
+                        &LoraChannel::DeliverRemote,
+                        channel,
+                        Create<Packet>(10),
+                        14,
+                        Vector(200, 0, 0),
+                        12,
+                        duration,
+                        868.1);
+    // The second sender is out of the range of the local PHYs
+    Simulator::Schedule(Seconds(20),
+                        &LoraChannel::DeliverRemote,
+                        channel,
+                        Create<Packet>(10),
+                        14,
+                        Vector(1e6, 0, 0),
+                        12,
+                        duration,
+                        868.1);
+    Simulator::Stop(Seconds(30));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(received[0], 1, "The local sender didn't get the remote packet");
+    NS_TEST_EXPECT_MSG_EQ(received[1], 2, "The local receiver didn't get the remote packet");
+    NS_TEST_EXPECT_MSG_EQ(received[2] + received[3],
+                          0,
+                          "A receiver of another process got a remote packet");
+    NS_TEST_EXPECT_MSG_EQ(sends.size(), 2, "A remote packet was forwarded again");
+
+    // Remote PHYs are never seen listening by this process: with
+    // ListeningFanOut, transmissions must still be forwarded to their
+    // processes, whatever their frequency, with and without the spatial index
+    for (bool spatialIndex : {false, true})
+    {
+        Ptr<LoraChannel> fanOutChannel =
+            CreateObject<LoraChannel>(loss, CreateObject<ConstantSpeedPropagationDelayModel>());
+        fanOutChannel->SetAttribute("ListeningFanOut", BooleanValue(true));
+        fanOutChannel->SetAttribute("SpatialIndex", BooleanValue(spatialIndex));
+        fanOutChannel->SetAttribute("MaxRange", DoubleValue(10000));
+        std::vector<RemoteSend> fanOutSends;
+        fanOutChannel->SetRemoteSendCallback(
+            0,
+            MakeBoundCallback(&PartitionedChannelTest::Forward, &fanOutSends));
+        for (uint32_t i = 0; i < phys.size(); i++)
+        {
+            phys[i]->SetChannel(fanOutChannel);
+            fanOutChannel->Add(phys[i]);
+        }
+        phys[2]->SwitchToSleep();
+        phys[3]->SetFrequency(868.3);
+
+        Simulator::Schedule(Seconds(1),
+                            &SimpleEndDeviceLoraPhy::Send,
+                            phys[0],
+                            Create<Packet>(10),
+                            txParams,
+                            868.1,
+                            14);
+        Simulator::Stop(Seconds(5));
+        Simulator::Run();
+        Simulator::Destroy();
+
+        NS_TEST_ASSERT_MSG_EQ(fanOutSends.size(),
+                              2,
+                              "A process whose PHYs are not listening locally was skipped");
+        for (uint32_t k = 0; k < fanOutSends.size(); k++)
+        {
+            NS_TEST_EXPECT_MSG_EQ(fanOutSends[k].systemId,
+                                  k + 1,
+                                  "The packet was forwarded to another process");
+        }
+
+        phys[2]->SwitchToStandby();
+        phys[3]->SetFrequency(868.1);
+    }
 }
 
 /**
@@ -1632,12 +2888,18 @@ LorawanTestSuite::LorawanTestSuite()
     LogComponentEnable("LorawanTestSuite", LOG_LEVEL_DEBUG);
     // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
     AddTestCase(new InterferenceTest, TestCase::QUICK);
+    AddTestCase(new InterferenceOutcomeTest, TestCase::QUICK);
     AddTestCase(new AddressTest, TestCase::QUICK);
     AddTestCase(new HeaderTest, TestCase::QUICK);
     AddTestCase(new ReceivePathTest, TestCase::QUICK);
     AddTestCase(new LogicalLoraChannelTest, TestCase::QUICK);
     AddTestCase(new TimeOnAirTest, TestCase::QUICK);
+    AddTestCase(new TimeOnAirTableTest, TestCase::QUICK);
     AddTestCase(new PhyConnectivityTest, TestCase::QUICK);
+    AddTestCase(new ParallelPropagationTest, TestCase::QUICK);
+    AddTestCase(new PacketTrackerTest, TestCase::QUICK);
+    AddTestCase(new AggregateInterferenceTest, TestCase::QUICK);
+    AddTestCase(new PartitionedChannelTest, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
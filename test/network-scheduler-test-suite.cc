@@ -18,6 +18,8 @@
  */
 
 // Include headers of classes to test
+#include "utilities.h"
+
 #include "ns3/log.h"
 #include "ns3/network-scheduler.h"
 
@@ -66,6 +68,238 @@ NetworkSchedulerTest::DoRun()
     // scheduled to happen 1 second after the reception.
 }
 
+/**
+ * \ingroup lorawan
+ *
+ * It verifies that devices whose replies are planned together all receive an acknowledgment, even
+ * if they share a single gateway
+ */
+class ReplyPlanningTest : public TestCase
+{
+  public:
+    ReplyPlanningTest();           //!< Default constructor
+    ~ReplyPlanningTest() override; //!< Destructor
+
+    /**
+     * Record the exit status of a MAC layer packet retransmission process of an end device.
+     *
+     * \param requiredTransmissions Number of transmissions attempted during the process.
+     * \param success Whether the retransmission procedure was successful.
+     * \param time Timestamp of the initial transmission attempt.
+     * \param packet The packet being retransmitted.
+     */
+    void RequiredTransmissions(uint8_t requiredTransmissions,
+                               bool success,
+                               Time time,
+                               Ptr<Packet> packet);
+
+    /**
+     * Send a packet requiring an acknowledgment from an end device.
+     *
+     * \param endDevice A pointer to the end device Node.
+     */
+    void SendPacket(Ptr<Node> endDevice);
+
+  private:
+    void DoRun() override;
+
+    int m_acknowledged = 0; //!< The number of packets acknowledged
+};
+
+ReplyPlanningTest::ReplyPlanningTest()
+    : TestCase("Verify that replies planned together on one gateway are all delivered")
+{
+}
+
+ReplyPlanningTest::~ReplyPlanningTest()
+{
+}
+
+void
+ReplyPlanningTest::RequiredTransmissions(uint8_t requiredTransmissions,
+                                         bool success,
+                                         Time time,
+                                         Ptr<Packet> packet)
+{
+    NS_LOG_DEBUG("Retransmission process ended after " << unsigned(requiredTransmissions)
+                                                        << " transmissions");
+    m_acknowledged += success;
+}
+
+void
+ReplyPlanningTest::SendPacket(Ptr<Node> endDevice)
+{
+    GetMacLayerFromNode<EndDeviceLorawanMac>(endDevice)->SetMType(
+        LorawanMacHeader::CONFIRMED_DATA_UP);
+    endDevice->GetDevice(0)->Send(Create<Packet>(20), Address(), 0);
+}
+
+void
+ReplyPlanningTest::DoRun()
+{
+    NS_LOG_DEBUG("ReplyPlanningTest");
+
+    NetworkComponents components = InitializeNetwork(2, 1);
+
+    NodeContainer endDevices = components.endDevices;
+    for (uint32_t i = 0; i < endDevices.GetN(); i++)
+    {
+        GetMacLayerFromNode<EndDeviceLorawanMac>(endDevices.Get(i))
+            ->TraceConnectWithoutContext(
+                "RequiredTransmissions",
+                MakeCallback(&ReplyPlanningTest::RequiredTransmissions, this));
+    }
+
+    // The first receive windows of the two devices open within the planning
+    // window. Once the gateway sends the first reply, the duty cycle of the
+    // sub-band prevents it from sending the second one in the first receive
+    // window, so that the second reply must be planned in the second one.
+    Simulator::Schedule(Seconds(1), &ReplyPlanningTest::SendPacket, this, endDevices.Get(0));
+    Simulator::Schedule(Seconds(1.3), &ReplyPlanningTest::SendPacket, this, endDevices.Get(1));
+
+    Simulator::Stop(Seconds(10));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_acknowledged, 2, "Both packets should be acknowledged");
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It verifies that a reply blocking the only free gateway of another device is moved to another
+ * of its gateways, so that both replies are sent in the first receive window
+ */
+class ReplyReassignmentTest : public TestCase
+{
+  public:
+    ReplyReassignmentTest();           //!< Default constructor
+    ~ReplyReassignmentTest() override; //!< Destructor
+
+    /**
+     * Record the exit status of a MAC layer packet retransmission process of an end device.
+     *
+     * \param requiredTransmissions Number of transmissions attempted during the process.
+     * \param success Whether the retransmission procedure was successful.
+     * \param time Timestamp of the initial transmission attempt.
+     * \param packet The packet being retransmitted.
+     */
+    void RequiredTransmissions(uint8_t requiredTransmissions,
+                               bool success,
+                               Time time,
+                               Ptr<Packet> packet);
+
+    /**
+     * Count a packet sent by a gateway.
+     *
+     * \param sent The number of packets sent by each gateway.
+     * \param gw The index of the gateway.
+     * \param packet The packet sent.
+     */
+    static void GatewaySent(std::vector<int>* sent, uint32_t gw, Ptr<const Packet> packet);
+
+  private:
+    void DoRun() override;
+
+    int m_acknowledged = 0; //!< The number of packets acknowledged
+};
+
+ReplyReassignmentTest::ReplyReassignmentTest()
+    : TestCase("Verify that a planned reply is moved to another gateway to make room for another")
+{
+}
+
+ReplyReassignmentTest::~ReplyReassignmentTest()
+{
+}
+
+void
+ReplyReassignmentTest::RequiredTransmissions(uint8_t requiredTransmissions,
+                                             bool success,
+                                             Time time,
+                                             Ptr<Packet> packet)
+{
+    m_acknowledged += success;
+}
+
+void
+ReplyReassignmentTest::GatewaySent(std::vector<int>* sent, uint32_t gw, Ptr<const Packet> packet)
+{
+    (*sent)[gw]++;
+}
+
+void
+ReplyReassignmentTest::DoRun()
+{
+    NS_LOG_DEBUG("ReplyReassignmentTest");
+
+    // Gateways G0, G1 and G2 on a line, and devices A, B and C placed so
+    // that A reaches G0 (best) and G2, B reaches G0 and G1, and C only G1
+    Ptr<LoraChannel> channel = CreateChannel();
+    MobilityHelper mobility;
+    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+
+    Ptr<ListPositionAllocator> edPositions = CreateObject<ListPositionAllocator>();
+    edPositions->Add(Vector(-3000, 0, 0));
+    edPositions->Add(Vector(4000, 0, 0));
+    edPositions->Add(Vector(12000, 0, 0));
+    mobility.SetPositionAllocator(edPositions);
+    NodeContainer endDevices = CreateEndDevices(3, mobility, channel);
+
+    Ptr<ListPositionAllocator> gwPositions = CreateObject<ListPositionAllocator>();
+    gwPositions->Add(Vector(0, 0, 0));
+    gwPositions->Add(Vector(8000, 0, 0));
+    gwPositions->Add(Vector(-8000, 0, 0));
+    mobility.SetPositionAllocator(gwPositions);
+    NodeContainer gateways = CreateGateways(3, mobility, channel);
+
+    CreateNetworkServer(endDevices, gateways);
+
+    // Different spreading factors (SF12, SF11 and SF10) keep the uplinks of
+    // A and B, which overlap in time, from colliding at G0
+    for (uint32_t i = 0; i < endDevices.GetN(); i++)
+    {
+        Ptr<EndDeviceLorawanMac> mac = GetMacLayerFromNode<EndDeviceLorawanMac>(endDevices.Get(i));
+        mac->SetDataRate(i);
+        mac->SetMType(LorawanMacHeader::CONFIRMED_DATA_UP);
+        mac->TraceConnectWithoutContext(
+            "RequiredTransmissions",
+            MakeCallback(&ReplyReassignmentTest::RequiredTransmissions, this));
+    }
+
+    std::vector<int> sent(gateways.GetN(), 0);
+    for (uint32_t i = 0; i < gateways.GetN(); i++)
+    {
+        GetMacLayerFromNode<GatewayLorawanMac>(gateways.Get(i))
+            ->TraceConnectWithoutContext(
+                "SentNewPacket",
+                MakeBoundCallback(&ReplyReassignmentTest::GatewaySent, &sent, i));
+    }
+
+    // The reply to C is planned alone, and the duty cycle of its sub-band
+    // then keeps G1 from sending the reply to B in the first receive window.
+    // The first receive windows of A and B open within the planning window,
+    // A's first: A is assigned G0, which B can only get by moving A to G2.
+    Simulator::Schedule(Seconds(1), [&endDevices]() {
+        endDevices.Get(2)->GetDevice(0)->Send(Create<Packet>(20), Address(), 0);
+    });
+    Simulator::Schedule(Seconds(2), [&endDevices]() {
+        endDevices.Get(0)->GetDevice(0)->Send(Create<Packet>(20), Address(), 0);
+    });
+    Simulator::Schedule(Seconds(3), [&endDevices]() {
+        endDevices.Get(1)->GetDevice(0)->Send(Create<Packet>(20), Address(), 0);
+    });
+
+    Simulator::Stop(Seconds(20));
+    Simulator::Run();
+    Simulator::Destroy();
+
+    NS_TEST_EXPECT_MSG_EQ(m_acknowledged, 3, "All packets should be acknowledged");
+    NS_TEST_EXPECT_MSG_EQ(sent[0], 1, "G0 should only send the reply to B");
+    NS_TEST_EXPECT_MSG_EQ(sent[1], 1, "G1 should only send the reply to C");
+    NS_TEST_EXPECT_MSG_EQ(sent[2], 1, "The reply to A should be moved to G2");
+}
+
 /**
  * \ingroup lorawan
  *
@@ -84,6 +318,8 @@ NetworkSchedulerTestSuite::NetworkSchedulerTestSuite()
     LogComponentEnable("NetworkSchedulerTestSuite", LOG_LEVEL_DEBUG);
     // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
     AddTestCase(new NetworkSchedulerTest, TestCase::QUICK);
+    AddTestCase(new ReplyPlanningTest, TestCase::QUICK);
+    AddTestCase(new ReplyReassignmentTest, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
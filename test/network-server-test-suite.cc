@@ -20,20 +20,31 @@
 /*
  * This file includes testing for the following components:
  * - NetworkServer
+ * - AdrComponent
  */
 
 // Include headers of classes to test
 #include "utilities.h"
 
+#include "ns3/adr-component.h"
 #include "ns3/callback.h"
+#include "ns3/class-a-end-device-lorawan-mac.h"
 #include "ns3/core-module.h"
+#include "ns3/end-device-status.h"
 #include "ns3/log.h"
+#include "ns3/lora-frame-header.h"
+#include "ns3/lora-tag.h"
+#include "ns3/lorawan-mac-header.h"
+#include "ns3/mac48-address.h"
 #include "ns3/network-server-helper.h"
 #include "ns3/network-server.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
 
+#include <algorithm>
+#include <numeric>
+
 using namespace ns3;
 using namespace lorawan;
 
@@ -134,7 +145,12 @@ UplinkPacketTest::DoRun()
 class DownlinkPacketTest : public TestCase
 {
   public:
-    DownlinkPacketTest();           //!< Default constructor
+    /**
+     * Constructor.
+     *
+     * \param batchWindow The BatchWindow of the network server.
+     */
+    DownlinkPacketTest(Time batchWindow = Seconds(0));
     ~DownlinkPacketTest() override; //!< Destructor
 
     /**
@@ -165,12 +181,15 @@ class DownlinkPacketTest : public TestCase
     void DoRun() override;
 
     bool m_receivedPacketAtEd = false; //!< Set to true if a packet is received by the end device
+    Time m_batchWindow;                //!< The BatchWindow of the network server
 };
 
 // Add some help text to this case to describe what it is intended to test
-DownlinkPacketTest::DownlinkPacketTest()
+DownlinkPacketTest::DownlinkPacketTest(Time batchWindow)
     : TestCase("Verify that devices requesting an acknowledgment receive"
-               " a reply from the network server.")
+               " a reply from the network server, with a batch window of " +
+               std::to_string(batchWindow.GetMilliSeconds()) + " ms."),
+      m_batchWindow(batchWindow)
 {
 }
 
@@ -217,6 +236,7 @@ DownlinkPacketTest::DoRun()
     NodeContainer endDevices = components.endDevices;
     NodeContainer gateways = components.gateways;
     Ptr<Node> nsNode = components.nsNode;
+    nsNode->GetApplication(0)->SetAttribute("BatchWindow", TimeValue(m_batchWindow));
 
     // Connect the end device's trace source for received packets
     endDevices.Get(0)
@@ -348,6 +368,349 @@ LinkCheckTest::DoRun()
     NS_ASSERT(m_receivedPacketAtEd);
 }
 
+/**
+ * Build an uplink with the ADR bit set, as received by the network server.
+ *
+ * \param address The address of the device.
+ * \param fCnt The frame counter of the uplink.
+ * \param spreadingFactor The spreading factor the uplink was sent with.
+ * \param rxPower The power the uplink was received with [dBm].
+ * \return The uplink with its decoded headers.
+ */
+Ptr<const ParsedUplink>
+CreateParsedUplink(LoraDeviceAddress address,
+                   uint32_t fCnt,
+                   uint8_t spreadingFactor,
+                   double rxPower)
+{
+    Ptr<Packet> packet = Create<Packet>(20);
+    LoraFrameHeader frameHdr;
+    frameHdr.SetAsUplink();
+    frameHdr.SetAddress(address);
+    frameHdr.SetFCnt(fCnt);
+    frameHdr.SetAdr(true);
+    packet->AddHeader(frameHdr);
+    LorawanMacHeader macHdr;
+    macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+    packet->AddHeader(macHdr);
+    LoraTag tag(spreadingFactor);
+    tag.SetFrequency(868.1);
+    tag.SetReceivePower(rxPower);
+    packet->AddPacketTag(tag);
+    return Create<ParsedUplink>(packet);
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * It verifies that the SNR history kept incrementally by the AdrComponent matches a direct walk of
+ * the packet list of the device, for every combining method, across the wraparound of the packet
+ * list and a change of the HistoryRange
+ */
+class AdrHistoryTest : public TestCase
+{
+  public:
+    AdrHistoryTest();           //!< Default constructor
+    ~AdrHistoryTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Combine the SNR of the last historyRange packets of a device by walking its packet list.
+     *
+     * \param adr The AdrComponent whose combining methods to use.
+     * \param status The status of the device.
+     * \return The combined SNR.
+     */
+    double GetReferenceSnr(Ptr<AdrComponent> adr, Ptr<EndDeviceStatus> status);
+
+    /**
+     * Insert the copies of an uplink received by some gateways in the status of a device, and
+     * notify the AdrComponents, as the NetworkServer would.
+     *
+     * \param fCnt The frame counter of the uplink.
+     * \param rxPowers The power the uplink was received with by each gateway [dBm].
+     * \param status The status of the device.
+     * \param adrs The AdrComponents to notify.
+     */
+    void InsertUplink(uint32_t fCnt,
+                      const std::vector<double>& rxPowers,
+                      Ptr<EndDeviceStatus> status,
+                      const std::vector<Ptr<AdrComponent>>& adrs);
+
+    std::vector<Address> m_gwAddresses; //!< The addresses of the receiver gateways
+};
+
+AdrHistoryTest::AdrHistoryTest()
+    : TestCase("Verify that the AdrComponent SNR history matches a walk of the packet list")
+{
+}
+
+AdrHistoryTest::~AdrHistoryTest()
+{
+}
+
+double
+AdrHistoryTest::GetReferenceSnr(Ptr<AdrComponent> adr, Ptr<EndDeviceStatus> status)
+{
+    const EndDeviceStatus::ReceivedPacketList& packetList = status->GetReceivedPacketList();
+    std::size_t nPackets = std::min<std::size_t>(adr->historyRange, packetList.GetSize());
+
+    std::vector<double> snrs;
+    for (std::size_t age = 0; age < nPackets; age++)
+    {
+        snrs.push_back(adr->RxPowerToSNR(adr->GetReceivedPower(packetList.GetRecent(age).gwList)));
+    }
+
+    switch (adr->historyAveraging)
+    {
+    case AdrComponent::AVERAGE:
+        return std::accumulate(snrs.begin(), snrs.end(), 0.0) / snrs.size();
+    case AdrComponent::MAXIMUM:
+        return *std::max_element(snrs.begin(), snrs.end());
+    case AdrComponent::MINIMUM:
+        return *std::min_element(snrs.begin(), snrs.end());
+    }
+    return 0;
+}
+
+void
+AdrHistoryTest::InsertUplink(uint32_t fCnt,
+                             const std::vector<double>& rxPowers,
+                             Ptr<EndDeviceStatus> status,
+                             const std::vector<Ptr<AdrComponent>>& adrs)
+{
+    for (std::size_t gw = 0; gw < rxPowers.size(); gw++)
+    {
+        Ptr<const ParsedUplink> uplink =
+            CreateParsedUplink(status->m_endDeviceAddress, fCnt, 7, rxPowers[gw]);
+        status->InsertReceivedPacket(uplink, m_gwAddresses[gw], gw);
+        for (const auto& adr : adrs)
+        {
+            adr->OnReceivedPacket(uplink, status, nullptr);
+        }
+    }
+}
+
+void
+AdrHistoryTest::DoRun()
+{
+    NS_LOG_DEBUG("AdrHistoryTest");
+
+    const uint32_t maxGateways = 3;
+    for (uint32_t gw = 0; gw < maxGateways; gw++)
+    {
+        m_gwAddresses.emplace_back(Mac48Address::Allocate());
+    }
+
+    // A short packet list, so that it wraps around many times
+    LoraDeviceAddress address(1);
+    Ptr<ClassAEndDeviceLorawanMac> mac = CreateObject<ClassAEndDeviceLorawanMac>();
+    mac->SetDeviceAddress(address);
+    Ptr<EndDeviceStatus> status = CreateObject<EndDeviceStatus>(address, mac);
+    status->SetAttribute("HistoryDepth", UintegerValue(8));
+
+    std::vector<Ptr<AdrComponent>> adrs;
+    for (const auto& method : {"avg", "max", "min"})
+    {
+        Ptr<AdrComponent> adr = CreateObject<AdrComponent>();
+        adr->SetAttribute("MultiplePacketsCombiningMethod", StringValue(method));
+        adrs.push_back(adr);
+    }
+
+    Ptr<UniformRandomVariable> rxPower = CreateObject<UniformRandomVariable>();
+    rxPower->SetAttribute("Min", DoubleValue(-140));
+    rxPower->SetAttribute("Max", DoubleValue(-90));
+    Ptr<UniformRandomVariable> nGateways = CreateObject<UniformRandomVariable>();
+
+    for (uint32_t fCnt = 0; fCnt < 40; fCnt++)
+    {
+        // Enlarge the HistoryRange halfway through
+        if (fCnt == 20)
+        {
+            for (const auto& adr : adrs)
+            {
+                adr->SetAttribute("HistoryRange", IntegerValue(6));
+            }
+        }
+
+        std::vector<double> rxPowers(nGateways->GetInteger(1, maxGateways));
+        for (auto& power : rxPowers)
+        {
+            power = rxPower->GetValue();
+        }
+        InsertUplink(fCnt, rxPowers, status, adrs);
+
+        for (const auto& adr : adrs)
+        {
+            NS_TEST_EXPECT_MSG_EQ_TOL(adr->GetHistorySNR(address, status),
+                                      GetReferenceSnr(adr, status),
+                                      1e-9,
+                                      "The SNR history differs from a walk of the packet list "
+                                      "at packet "
+                                          << fCnt);
+        }
+    }
+}
+
+/**
+ * \ingroup lorawan
+ *
+ * End device MAC layer with a fixed transmission power, to reproduce the state of a device that
+ * already received LinkAdrReq commands
+ */
+class FixedPowerEndDeviceLorawanMac : public ClassAEndDeviceLorawanMac
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * \param txPower The transmission power of the device [dBm].
+     */
+    FixedPowerEndDeviceLorawanMac(uint8_t txPower)
+        : m_fixedTxPower(txPower)
+    {
+    }
+
+    uint8_t GetTransmissionPower() override
+    {
+        return m_fixedTxPower;
+    }
+
+  private:
+    uint8_t m_fixedTxPower; //!< The transmission power of the device [dBm]
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * It verifies that a periodic run of the AdrComponent over a population of devices queues the same
+ * LinkAdrReq commands as the ADR algorithm run for each device before replying to it
+ */
+class AdrPeriodicTest : public TestCase
+{
+  public:
+    AdrPeriodicTest();           //!< Default constructor
+    ~AdrPeriodicTest() override; //!< Destructor
+
+  private:
+    void DoRun() override;
+
+    /**
+     * Get the LinkAdrReq command queued in the reply to a device, if any.
+     *
+     * \param status The status of the device.
+     * \return The command, or nullptr if none is queued.
+     */
+    Ptr<LinkAdrReq> GetLinkAdrReq(Ptr<EndDeviceStatus> status);
+};
+
+AdrPeriodicTest::AdrPeriodicTest()
+    : TestCase("Verify that the periodic ADR algorithm queues the same LinkAdrReq commands as the "
+               "per-reply one")
+{
+}
+
+AdrPeriodicTest::~AdrPeriodicTest()
+{
+}
+
+Ptr<LinkAdrReq>
+AdrPeriodicTest::GetLinkAdrReq(Ptr<EndDeviceStatus> status)
+{
+    for (const auto& command : status->m_reply.frameHeader.GetCommands())
+    {
+        if (command->GetCommandType() == LINK_ADR_REQ)
+        {
+            return DynamicCast<LinkAdrReq>(command);
+        }
+    }
+    return nullptr;
+}
+
+void
+AdrPeriodicTest::DoRun()
+{
+    NS_LOG_DEBUG("AdrPeriodicTest");
+
+    // One component runs the algorithm before each reply, the other one runs
+    // it periodically over all devices
+    Ptr<AdrComponent> perReply = CreateObject<AdrComponent>();
+    Ptr<AdrComponent> periodic = CreateObject<AdrComponent>();
+    periodic->SetAttribute("Period", TimeValue(Hours(1)));
+
+    Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable>();
+    Address gwAddress = Mac48Address::Allocate();
+
+    // Each device is tracked by both components through a status of its own,
+    // since the commands are queued in the status
+    const uint32_t nDevices = 200;
+    std::vector<Ptr<EndDeviceStatus>> perReplyStatuses;
+    std::vector<Ptr<EndDeviceStatus>> periodicStatuses;
+    for (uint32_t device = 0; device < nDevices; device++)
+    {
+        LoraDeviceAddress address(device + 1);
+        auto spreadingFactor = uint8_t(random->GetInteger(7, 12));
+        auto txPower = uint8_t(2 * random->GetInteger(1, 7));
+
+        perReplyStatuses.push_back(CreateObject<EndDeviceStatus>(
+            address,
+            CreateObject<FixedPowerEndDeviceLorawanMac>(txPower)));
+        periodicStatuses.push_back(CreateObject<EndDeviceStatus>(
+            address,
+            CreateObject<FixedPowerEndDeviceLorawanMac>(txPower)));
+
+        // The history spans SNR margins from well below to well above the
+        // thresholds of all spreading factors
+        for (uint32_t fCnt = 0; fCnt < 4; fCnt++)
+        {
+            Ptr<const ParsedUplink> uplink =
+                CreateParsedUplink(address, fCnt, spreadingFactor, random->GetValue(-145, -90));
+            perReplyStatuses[device]->InsertReceivedPacket(uplink, gwAddress, 0);
+            perReply->OnReceivedPacket(uplink, perReplyStatuses[device], nullptr);
+            periodicStatuses[device]->InsertReceivedPacket(uplink, gwAddress, 0);
+            periodic->OnReceivedPacket(uplink, periodicStatuses[device], nullptr);
+        }
+
+        perReply->BeforeSendingReply(perReplyStatuses[device], nullptr);
+    }
+
+    periodic->RunPeriodicAdr();
+
+    for (uint32_t device = 0; device < nDevices; device++)
+    {
+        Ptr<LinkAdrReq> expected = GetLinkAdrReq(perReplyStatuses[device]);
+        Ptr<LinkAdrReq> actual = GetLinkAdrReq(periodicStatuses[device]);
+        NS_TEST_EXPECT_MSG_EQ(bool(actual),
+                              bool(expected),
+                              "The periodic ADR algorithm did not queue the same commands for "
+                              "device "
+                                  << device);
+        if (actual && expected)
+        {
+            NS_TEST_EXPECT_MSG_EQ(unsigned(actual->GetDataRate()),
+                                  unsigned(expected->GetDataRate()),
+                                  "The periodic ADR algorithm prescribed another data rate to "
+                                  "device "
+                                      << device);
+            NS_TEST_EXPECT_MSG_EQ(unsigned(actual->GetTxPower()),
+                                  unsigned(expected->GetTxPower()),
+                                  "The periodic ADR algorithm prescribed another transmission "
+                                  "power to device "
+                                      << device);
+        }
+    }
+
+    // Without new uplinks, the periodic runs stop
+    Simulator::Stop(Hours(10));
+    Simulator::Run();
+    NS_TEST_EXPECT_MSG_EQ(periodic->m_periodicEvent.IsRunning(),
+                          false,
+                          "The periodic ADR algorithm is still scheduled without new uplinks");
+    Simulator::Destroy();
+}
+
 /**
  * \ingroup lorawan
  *
@@ -383,7 +746,12 @@ NetworkServerTestSuite::NetworkServerTestSuite()
     // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
     AddTestCase(new UplinkPacketTest, TestCase::QUICK);
     AddTestCase(new DownlinkPacketTest, TestCase::QUICK);
+    AddTestCase(new DownlinkPacketTest(MilliSeconds(100)), TestCase::QUICK);
+    // The largest batch window below the delay of the first receive window
+    AddTestCase(new DownlinkPacketTest(MilliSeconds(999)), TestCase::QUICK);
     AddTestCase(new LinkCheckTest, TestCase::QUICK);
+    AddTestCase(new AdrHistoryTest, TestCase::QUICK);
+    AddTestCase(new AdrPeriodicTest, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
@@ -29,7 +29,11 @@
 
 #include "ns3/end-device-status.h"
 #include "ns3/log.h"
+#include "ns3/lora-tag.h"
+#include "ns3/mac48-address.h"
 #include "ns3/network-status.h"
+#include "ns3/nstime.h"
+#include "ns3/uinteger.h"
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -42,7 +46,9 @@ NS_LOG_COMPONENT_DEFINE("NetworkStatusTestSuite");
 /**
  * \ingroup lorawan
  *
- * It tests the constructor of the EndDeviceStatus class
+ * It tests the constructor of the EndDeviceStatus class, and the bounded
+ * history of received packets it keeps, merging copies of a packet received by
+ * different gateways
  */
 class EndDeviceStatusTest : public TestCase
 {
@@ -74,6 +80,54 @@ EndDeviceStatusTest::DoRun()
 
     // Create an EndDeviceStatus object
     EndDeviceStatus eds = EndDeviceStatus();
+
+    // Only the reception information of the last HistoryDepth packets is kept
+    Ptr<EndDeviceStatus> status = CreateObject<EndDeviceStatus>();
+    status->SetAttribute("HistoryDepth", UintegerValue(3));
+
+    Ptr<Packet> lastPacket;
+    for (uint16_t fCnt = 1; fCnt <= 5; fCnt++)
+    {
+        lastPacket = Create<Packet>(10);
+        LoraFrameHeader frameHdr;
+        frameHdr.SetAsUplink();
+        frameHdr.SetFCnt(fCnt);
+        lastPacket->AddHeader(frameHdr);
+        LorawanMacHeader macHdr;
+        macHdr.SetMType(LorawanMacHeader::UNCONFIRMED_DATA_UP);
+        lastPacket->AddHeader(macHdr);
+        LoraTag tag(7);
+        tag.SetReceivePower(-100 - fCnt);
+        lastPacket->AddPacketTag(tag);
+
+        // The last packet is received by more gateways than are stored inline
+        Ptr<const ParsedUplink> uplink = Create<ParsedUplink>(lastPacket);
+        for (uint8_t gw = 1; gw <= (fCnt == 5 ? 6 : 1); gw++)
+        {
+            status->InsertReceivedPacket(uplink, Mac48Address::Allocate(), gw);
+        }
+    }
+
+    const EndDeviceStatus::ReceivedPacketList& packetList = status->GetReceivedPacketList();
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetSize(), 3, "Packet history exceeded its depth");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(0).fCnt, 5, "Wrong last packet");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(2).fCnt, 3, "Wrong oldest packet");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(0).gwList.GetSize(), 6, "Wrong gateway count");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(1).gwList.GetSize(), 1, "Wrong gateway count");
+    NS_TEST_EXPECT_MSG_EQ(status->GetLastPacketReceivedFromDevice(),
+                          lastPacket,
+                          "Wrong last packet received from device");
+
+    // Shrinking the history keeps the most recent packets
+    status->SetAttribute("HistoryDepth", UintegerValue(2));
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetSize(), 2, "Packet history exceeded its depth");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(1).fCnt, 4, "Wrong oldest packet");
+
+    // Outside of the deduplication window, a known frame counter is a new packet
+    status->SetAttribute("DeduplicationWindow", TimeValue(Seconds(0)));
+    status->InsertReceivedPacket(Create<ParsedUplink>(lastPacket), Mac48Address::Allocate(), 0);
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(1).fCnt, 5, "Packet was merged after the window");
+    NS_TEST_EXPECT_MSG_EQ(packetList.GetRecent(0).gwList.GetSize(), 1, "Wrong gateway count");
 }
 
 /**